@@ -190,6 +190,8 @@ tutos = {
     "tuto_bvh2_gltf_brdf",
     "tuto_ray_gltf",
     
+    "pipeline",
+    
 }
 
 for i, name in ipairs(tutos) do
@@ -286,6 +288,125 @@ project("bench_scene")
 	files ( gkit_files )
 	files { gkit_dir .. "/tutos/bench/bench_scene.cpp" }
 	
+project("bench_remap")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/bench_remap.cpp" }
+	
+project("bench_layout")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/bench_layout.cpp" }
+	
+project("bench_update")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/bench_update.cpp" }
+	
+project("bench_bvh")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/bench_bvh.cpp" }
+	
+project("bench_bvh_build")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/bench_bvh_build.cpp" }
+	
+project("bench_tlas")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/bench_tlas.cpp" }
+	
+project("bench_triangle")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/bench_triangle.cpp" }
+	
+project("bench_occlusion")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/bench_occlusion.cpp" }
+	
+project("bench_packet")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/bench_packet.cpp" }
+	
+project("bench_refit")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/bench_refit.cpp" }
+	
+project("bench_bvh_cache")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/bench_bvh_cache.cpp" }
+	
+project("bench_quantized")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/bench_quantized.cpp" }
+	
+project("bench_rasterizer")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/bench_rasterizer.cpp" }
+	
+project("bench_visibility")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/bench_visibility.cpp" }
+	
+project("bench_vertex")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/bench_vertex.cpp" }
+	
+project("bench_shader")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/bench_shader.cpp" }
+	
+project("test_clipping")
+	language "C++"
+	kind "ConsoleApp"
+	targetdir "bin"
+	files ( gkit_files )
+	files { gkit_dir .. "/tutos/bench/test_clipping.cpp" }
+	
 project("bench_setup")
 	language "C++"
 	kind "ConsoleApp"
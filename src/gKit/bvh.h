@@ -0,0 +1,3433 @@
+
+#ifndef _BVH_H
+#define _BVH_H
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "vec.h"
+#include "mat.h"
+#include "mesh.h"
+#include "files.h"
+
+
+//! \addtogroup objet3D
+///@{
+
+//! \file
+//! bvh, arbre d'englobants parametre par le type des primitives, triangles ou instances. cf tuto_bvh2.cpp et sah.txt.
+
+//! rayon.
+struct Ray
+{
+    Point o;            //!< origine.
+    float pad;
+    Vector d;           //!< direction.
+    float tmax;         //!< tmax= 1 ou \inf, le rayon est un segment ou une demi droite infinie.
+
+    Ray( const Point& _o, const Point& _e ) :  o(_o), d(Vector(_o, _e)), tmax(1) {}                 //!< segment, t entre 0 et 1.
+    Ray( const Point& _o, const Vector& _d ) :  o(_o), d(_d), tmax(FLT_MAX) {}                      //!< demi droite, t entre 0 et \inf.
+    Ray( const Point& _o, const Vector& _d, const float _tmax ) :  o(_o), d(_d), tmax(_tmax) {}     //!< explicite.
+};
+
+//! intersection avec un triangle.
+struct Hit
+{
+    float t;            //!< p(t)= o + td, position du point d'intersection sur le rayon.
+    float u, v;         //!< p(u, v), position du point d'intersection sur le triangle.
+    int instance_id;    //!< indice de l'instance, pour retrouver la transformation.
+    int mesh_id;        //!< indice du mesh, indexation globale du triangle dans une scene gltf.
+    int primitive_id;   //!< indice du groupe de primitives dans le mesh.
+    int triangle_id;    //!< indice du triangle.
+    int pad;
+
+    Hit( ) : t(FLT_MAX), u(), v(), instance_id(-1), mesh_id(-1), primitive_id(-1), triangle_id(-1) {}
+    Hit( const Ray& ray ) : t(ray.tmax), u(), v(), instance_id(-1), mesh_id(-1), primitive_id(-1), triangle_id(-1) {}
+
+    Hit( const float _t, const float _u, const float _v, const int _id ) : t(_t), u(_u), v(_v),
+        instance_id(-1), mesh_id(-1), primitive_id(-1), triangle_id(_id) {}
+    Hit( const float _t, const float _u, const float _v, const int _mesh_id, const int _primitive_id, const int _id ) : t(_t), u(_u), v(_v),
+        instance_id(-1), mesh_id(_mesh_id), primitive_id(_primitive_id), triangle_id(_id) {}
+
+    operator bool ( ) const { return (triangle_id != -1); }     //!< renvoie vrai si l'intersection est definie / existe.
+};
+
+//! intersection avec une boite / un englobant.
+struct BBoxHit
+{
+    float tmin, tmax;
+
+    BBoxHit() : tmin(FLT_MAX), tmax(-FLT_MAX) {}
+    BBoxHit( const float _tmin, const float _tmax ) : tmin(_tmin), tmax(_tmax) {}
+
+    float centroid( ) const { return (tmin + tmax) / 2; }
+    operator bool( ) const { return tmin <= tmax; }     //!< renvoie vrai si l'intersection est definie / existe.
+};
+
+
+//! boite englobante.
+struct BBox
+{
+    Point pmin, pmax;
+
+    BBox( ) : pmin(), pmax() {}
+
+    BBox( const Point& p ) : pmin(p), pmax(p) {}
+    BBox( const Point& a, const Point& b ) : pmin(a), pmax(b) {}
+    BBox( const BBox& box ) : pmin(box.pmin), pmax(box.pmax) {}
+    BBox( const BBox& a, const BBox& b ) : pmin(min(a.pmin, b.pmin)), pmax(max(a.pmax, b.pmax)) {}
+
+    BBox& operator= ( const BBox& box ) { pmin= box.pmin; pmax= box.pmax; return *this; }
+
+    BBox& insert( const Point& p ) { pmin= min(pmin, p); pmax= max(pmax, p); return *this; }
+    BBox& insert( const BBox& box ) { pmin= min(pmin, box.pmin); pmax= max(pmax, box.pmax); return *this; }
+
+    float centroid( const int axis ) const { return (pmin(axis) + pmax(axis)) / 2; }
+    Point centroid( ) const { return (pmin + pmax) / 2; }
+
+    //! renvoie vrai si la boite est vide, cf EmptyBox().
+    bool empty( ) const { return pmin.x > pmax.x || pmin.y > pmax.y || pmin.z > pmax.z; }
+
+    //! renvoie l'aire de la boite.
+    float area( ) const
+    {
+        if(empty())
+            return 0;
+
+        Vector d(pmin, pmax);
+        return 2 * d.x*d.y + 2 * d.x*d.z + 2 * d.y*d.z;
+    }
+
+    //! intersection avec un rayon, entre 0 et htmax.
+    BBoxHit intersect( const Ray& ray, const Vector& invd, const float htmax ) const
+    {
+        Point rmin= pmin;
+        Point rmax= pmax;
+        // signe de invd, et pas de ray.d, cf -0 et 1 / -0 == -inf
+        if(invd.x < 0) std::swap(rmin.x, rmax.x);
+        if(invd.y < 0) std::swap(rmin.y, rmax.y);
+        if(invd.z < 0) std::swap(rmin.z, rmax.z);
+        Vector dmin= (rmin - ray.o) * invd;
+        Vector dmax= (rmax - ray.o) * invd;
+
+        float tmin= std::max(dmin.z, std::max(dmin.y, std::max(dmin.x, 0.f)));
+        float tmax= std::min(dmax.z, std::min(dmax.y, std::min(dmax.x, htmax)));
+        return BBoxHit(tmin, tmax);
+    }
+};
+
+//! renvoie une boite vide, insert() la remplace par le premier point ou la premiere boite.
+inline BBox EmptyBox( )
+{
+    return BBox(Point(FLT_MAX, FLT_MAX, FLT_MAX), Point(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+}
+
+
+//! noeud de l'arbre, noeud interne ou feuille.
+struct Node
+{
+    BBox bounds;
+    int left;
+    int right;
+
+    bool internal( ) const { return right > 0; }                        //!< renvoie vrai si le noeud est un noeud interne.
+    int internal_left( ) const { assert(internal()); return left; }     //!< renvoie le fils gauche du noeud interne.
+    int internal_right( ) const { assert(internal()); return right; }   //!< renvoie le fils droit.
+
+    bool leaf( ) const { return right < 0; }                            //!< renvoie vrai si le noeud est une feuille.
+    int leaf_begin( ) const { assert(leaf()); return -left; }           //!< renvoie le premier objet de la feuille.
+    int leaf_end( ) const { assert(leaf()); return -right; }            //!< renvoie le dernier objet.
+};
+
+//! creation d'un noeud interne.
+inline Node make_node( const BBox& bounds, const int left, const int right )
+{
+    Node node { bounds, left, right };
+    assert(node.internal());    // verifie que c'est bien un noeud...
+    return node;
+}
+
+//! creation d'une feuille.
+inline Node make_leaf( const BBox& bounds, const int begin, const int end )
+{
+    Node node { bounds, -begin, -end };
+    assert(node.leaf());        // verifie que c'est bien une feuille...
+    return node;
+}
+
+
+/*! noeud d'un bvh a W fils, cf BVHT::collapse(). les englobants des fils sont ranges par axe, pour les tester tous ensemble.
+    un fils inutilise a un englobant vide et n'est jamais touche.
+ */
+template < int W >
+struct WideNode
+{
+    float bounds[2][3][W];  //!< englobants des fils : bounds[0][axe][fils] point min, bounds[1][axe][fils] point max.
+    int child[W];           //!< indice du noeud fils, ou premiere primitive d'une feuille.
+    int count[W];           //!< nombre de primitives d'une feuille, 0 pour un noeud interne.
+
+    int child_index( const int k ) const { return child[k]; }       //!< renvoie l'indice du fils k, ou sa premiere primitive.
+    int child_count( const int k ) const { return count[k]; }       //!< renvoie le nombre de primitives du fils k, 0 pour un noeud interne.
+    bool child_empty( const int k ) const { return child[k] == -1; }    //!< renvoie vrai si le fils k est inutilise.
+
+    //! renvoie l'englobant du fils k.
+    BBox child_bounds( const int k ) const { return BBox(Point(bounds[0][0][k], bounds[0][1][k], bounds[0][2][k]), Point(bounds[1][0][k], bounds[1][1][k], bounds[1][2][k])); }
+};
+
+/*! noeud compresse d'un bvh a W fils, cf BVHOptions::quantized. les englobants des fils sont quantifies sur 8 bits dans l'englobant du noeud :
+    fils k, axe a : [origin[a] + bounds[0][a][k] * 2^exponent[a], origin[a] + bounds[1][a][k] * 2^exponent[a]], arrondis vers l'exterieur.
+    les fils internes sont ranges a la suite, a partir de child, puis les feuilles, dont les primitives sont rangees a la suite, a partir de primitive.
+    80 octets pour 8 fils, au lieu de 256 pour WideNode<8>, cf "efficient incoherent ray traversal on GPUs through compressed wide BVHs", H. Ylitie, T. Karras, S. Laine, 2017.
+ */
+template < int W >
+struct QuantizedNode
+{
+    float origin[3];                    //!< point min de l'englobant du noeud.
+    signed char exponent[3];            //!< pas de quantification, par axe : 2^exponent.
+    unsigned char used;                 //!< bit k : le fils k existe.
+    int child;                          //!< indice du premier fils interne.
+    int primitive;                      //!< premiere primitive de la premiere feuille.
+    unsigned char count[W];             //!< nombre de primitives de chaque feuille, 0 pour un noeud interne.
+    unsigned char bounds[2][3][W];      //!< englobants quantifies des fils : bounds[0][axe][fils] point min, bounds[1][axe][fils] point max.
+
+    //! renvoie le pas de quantification sur un axe.
+    float scale( const int axis ) const
+    {
+        unsigned int bits= unsigned(exponent[axis] + 127) << 23;
+        float s;
+        memcpy(&s, &bits, sizeof(s));
+        return s;
+    }
+
+    int child_index( const int k ) const
+    {
+        if(count[k] == 0)
+            return child + k;   // les fils internes sont ranges en premier...
+
+        int first= primitive;
+        for(int i= 0; i < k; i++)
+            first+= count[i];
+        return first;
+    }
+
+    int child_count( const int k ) const { return count[k]; }
+    bool child_empty( const int k ) const { return (used & (1 << k)) == 0; }
+
+    //! renvoie l'englobant decode du fils k, il contient toujours l'englobant d'origine : origin + q * scale est exact ou arrondi vers le float le plus proche.
+    BBox child_bounds( const int k ) const
+    {
+        Point pmin, pmax;
+        for(int axis= 0; axis < 3; axis++)
+        {
+            pmin(axis)= origin[axis] + float(bounds[0][axis][k]) * scale(axis);
+            pmax(axis)= origin[axis] + float(bounds[1][axis][k]) * scale(axis);
+        }
+        return BBox(pmin, pmax);
+    }
+};
+
+//! rayon pour les tests rayon / englobants des noeuds larges.
+struct WideRay
+{
+    float o[3];
+    float invd[3];
+    int sign[3];        //!< 1 si la direction est negative, le plan d'entree est le point max de l'englobant.
+
+    WideRay( const Ray& ray )
+    {
+        for(int axis= 0; axis < 3; axis++)
+        {
+            o[axis]= ray.o(axis);
+            invd[axis]= 1 / ray.d(axis);
+            sign[axis]= (invd[axis] < 0) ? 1 : 0;      // cf BBox::intersect()
+        }
+    }
+};
+
+//! intersection d'un rayon avec les englobants des fils d'un noeud, entre 0 et htmax. renvoie un bit par fils touche, et la distance d'entree dans chaque englobant.
+template < int W >
+inline int intersect_children( const WideNode<W>& node, const WideRay& ray, const float htmax, float tmin[W] )
+{
+    int hits= 0;
+    for(int k= 0; k < W; k++)
+    {
+        float t0= 0;
+        float t1= htmax;
+        for(int axis= 0; axis < 3; axis++)
+        {
+            float near= (node.bounds[ray.sign[axis]][axis][k] - ray.o[axis]) * ray.invd[axis];
+            float far= (node.bounds[1 - ray.sign[axis]][axis][k] - ray.o[axis]) * ray.invd[axis];
+            t0= std::max(t0, near);
+            t1= std::min(t1, far);
+        }
+
+        tmin[k]= t0;
+        if(t0 <= t1)
+            hits|= 1 << k;
+    }
+
+    return hits;
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+//! intersection avec les 4 fils, sse.
+template < >
+inline int intersect_children( const WideNode<4>& node, const WideRay& ray, const float htmax, float tmin[4] )
+{
+    __m128 t0= _mm_setzero_ps();
+    __m128 t1= _mm_set1_ps(htmax);
+    for(int axis= 0; axis < 3; axis++)
+    {
+        __m128 o= _mm_set1_ps(ray.o[axis]);
+        __m128 invd= _mm_set1_ps(ray.invd[axis]);
+        __m128 near= _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[ray.sign[axis]][axis]), o), invd);
+        __m128 far= _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[1 - ray.sign[axis]][axis]), o), invd);
+        // min / max renvoient le 2ieme operande si le premier est un NaN, comme std::min / std::max
+        t0= _mm_max_ps(near, t0);
+        t1= _mm_min_ps(far, t1);
+    }
+
+    _mm_storeu_ps(tmin, t0);
+    return _mm_movemask_ps(_mm_cmple_ps(t0, t1));
+}
+#endif
+
+#ifdef __AVX__
+//! intersection avec les 8 fils, avx.
+template < >
+inline int intersect_children( const WideNode<8>& node, const WideRay& ray, const float htmax, float tmin[8] )
+{
+    __m256 t0= _mm256_setzero_ps();
+    __m256 t1= _mm256_set1_ps(htmax);
+    for(int axis= 0; axis < 3; axis++)
+    {
+        __m256 o= _mm256_set1_ps(ray.o[axis]);
+        __m256 invd= _mm256_set1_ps(ray.invd[axis]);
+        __m256 near= _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.bounds[ray.sign[axis]][axis]), o), invd);
+        __m256 far= _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.bounds[1 - ray.sign[axis]][axis]), o), invd);
+        t0= _mm256_max_ps(near, t0);
+        t1= _mm256_min_ps(far, t1);
+    }
+
+    _mm256_storeu_ps(tmin, t0);
+    return _mm256_movemask_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ));
+}
+#endif
+
+
+/*! intersection d'un rayon avec les englobants quantifies des fils d'un noeud compresse, cf intersect_children( WideNode ).
+    les englobants sont decodes pendant le test : t= (origin + q * scale - o) / d= q * (scale / d) + (origin - o) / d.
+ */
+template < int W >
+inline int intersect_children( const QuantizedNode<W>& node, const WideRay& ray, const float htmax, float tmin[W] )
+{
+    float a[3], b[3];
+    for(int axis= 0; axis < 3; axis++)
+    {
+        a[axis]= node.scale(axis) * ray.invd[axis];
+        b[axis]= (node.origin[axis] - ray.o[axis]) * ray.invd[axis];
+    }
+
+    int hits= 0;
+    for(int k= 0; k < W; k++)
+    {
+        float t0= 0;
+        float t1= htmax;
+        for(int axis= 0; axis < 3; axis++)
+        {
+            float near= float(node.bounds[ray.sign[axis]][axis][k]) * a[axis] + b[axis];
+            float far= float(node.bounds[1 - ray.sign[axis]][axis][k]) * a[axis] + b[axis];
+            t0= std::max(t0, near);
+            t1= std::min(t1, far);
+        }
+
+        tmin[k]= t0;
+        if(t0 <= t1)
+            hits|= 1 << k;
+    }
+
+    return hits & node.used;
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+//! convertit 4 octets en 4 floats, sse2.
+inline __m128 unpack4( const unsigned char *q )
+{
+    int bytes;
+    memcpy(&bytes, q, sizeof(bytes));
+    const __m128i zero= _mm_setzero_si128();
+    __m128i words= _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero);
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+}
+
+//! intersection avec les 4 fils d'un noeud compresse, sse.
+template < >
+inline int intersect_children( const QuantizedNode<4>& node, const WideRay& ray, const float htmax, float tmin[4] )
+{
+    __m128 t0= _mm_setzero_ps();
+    __m128 t1= _mm_set1_ps(htmax);
+    for(int axis= 0; axis < 3; axis++)
+    {
+        __m128 a= _mm_set1_ps(node.scale(axis) * ray.invd[axis]);
+        __m128 b= _mm_set1_ps((node.origin[axis] - ray.o[axis]) * ray.invd[axis]);
+        __m128 near= _mm_add_ps(_mm_mul_ps(unpack4(node.bounds[ray.sign[axis]][axis]), a), b);
+        __m128 far= _mm_add_ps(_mm_mul_ps(unpack4(node.bounds[1 - ray.sign[axis]][axis]), a), b);
+        t0= _mm_max_ps(near, t0);
+        t1= _mm_min_ps(far, t1);
+    }
+
+    _mm_storeu_ps(tmin, t0);
+    return _mm_movemask_ps(_mm_cmple_ps(t0, t1)) & node.used;
+}
+#endif
+
+#ifdef __AVX__
+//! convertit 8 octets en 8 floats, avx, sans les entiers 256 bits d'avx2.
+inline __m256 unpack8( const unsigned char *q )
+{
+    const __m128i zero= _mm_setzero_si128();
+    __m128i words= _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) q), zero);
+    __m128 lo= _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+    __m128 hi= _mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero));
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+//! intersection avec les 8 fils d'un noeud compresse, avx.
+template < >
+inline int intersect_children( const QuantizedNode<8>& node, const WideRay& ray, const float htmax, float tmin[8] )
+{
+    __m256 t0= _mm256_setzero_ps();
+    __m256 t1= _mm256_set1_ps(htmax);
+    for(int axis= 0; axis < 3; axis++)
+    {
+        __m256 a= _mm256_set1_ps(node.scale(axis) * ray.invd[axis]);
+        __m256 b= _mm256_set1_ps((node.origin[axis] - ray.o[axis]) * ray.invd[axis]);
+        __m256 near= _mm256_add_ps(_mm256_mul_ps(unpack8(node.bounds[ray.sign[axis]][axis]), a), b);
+        __m256 far= _mm256_add_ps(_mm256_mul_ps(unpack8(node.bounds[1 - ray.sign[axis]][axis]), a), b);
+        t0= _mm256_max_ps(near, t0);
+        t1= _mm256_min_ps(far, t1);
+    }
+
+    _mm256_storeu_ps(tmin, t0);
+    return _mm256_movemask_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ)) & node.used;
+}
+#endif
+
+
+/*! L floats, calculs sur les triangles d'un bloc, cf TriangleBlock, ou sur les rayons d'un paquet, cf RayPacket.
+    Lanes<1> calcule un seul triangle ou rayon a la fois, Lanes<4> utilise sse et Lanes<8> avx.
+ */
+template < int L >
+struct Lanes;
+
+template < >
+struct Lanes<1>
+{
+    typedef bool Mask;
+    float x;
+
+    explicit Lanes( const float _x ) : x(_x) {}
+    static Lanes load( const float *p ) { return Lanes(*p); }
+    void store( float *p ) const { *p= x; }
+    static int bits( const Mask m ) { return m ? 1 : 0; }
+};
+
+inline Lanes<1> operator+ ( const Lanes<1>& a, const Lanes<1>& b ) { return Lanes<1>(a.x + b.x); }
+inline Lanes<1> operator- ( const Lanes<1>& a, const Lanes<1>& b ) { return Lanes<1>(a.x - b.x); }
+inline Lanes<1> operator* ( const Lanes<1>& a, const Lanes<1>& b ) { return Lanes<1>(a.x * b.x); }
+inline Lanes<1> operator/ ( const Lanes<1>& a, const Lanes<1>& b ) { return Lanes<1>(a.x / b.x); }
+inline bool operator<= ( const Lanes<1>& a, const Lanes<1>& b ) { return a.x <= b.x; }
+inline bool operator>= ( const Lanes<1>& a, const Lanes<1>& b ) { return a.x >= b.x; }
+inline bool operator!= ( const Lanes<1>& a, const Lanes<1>& b ) { return a.x != b.x; }
+inline Lanes<1> vmin( const Lanes<1>& a, const Lanes<1>& b ) { return Lanes<1>(std::min(a.x, b.x)); }
+inline Lanes<1> vmax( const Lanes<1>& a, const Lanes<1>& b ) { return Lanes<1>(std::max(a.x, b.x)); }
+
+#if defined(__SSE2__) || defined(_M_X64)
+template < >
+struct Lanes<4>
+{
+    typedef Lanes<4> Mask;
+    __m128 x;
+
+    Lanes( const __m128 _x ) : x(_x) {}
+    explicit Lanes( const float _x ) : x(_mm_set1_ps(_x)) {}
+    static Lanes load( const float *p ) { return Lanes(_mm_loadu_ps(p)); }
+    void store( float *p ) const { _mm_storeu_ps(p, x); }
+    static int bits( const Mask m ) { return _mm_movemask_ps(m.x); }
+};
+
+inline Lanes<4> operator+ ( const Lanes<4>& a, const Lanes<4>& b ) { return _mm_add_ps(a.x, b.x); }
+inline Lanes<4> operator- ( const Lanes<4>& a, const Lanes<4>& b ) { return _mm_sub_ps(a.x, b.x); }
+inline Lanes<4> operator* ( const Lanes<4>& a, const Lanes<4>& b ) { return _mm_mul_ps(a.x, b.x); }
+inline Lanes<4> operator/ ( const Lanes<4>& a, const Lanes<4>& b ) { return _mm_div_ps(a.x, b.x); }
+inline Lanes<4> operator<= ( const Lanes<4>& a, const Lanes<4>& b ) { return _mm_cmple_ps(a.x, b.x); }
+inline Lanes<4> operator>= ( const Lanes<4>& a, const Lanes<4>& b ) { return _mm_cmpge_ps(a.x, b.x); }
+inline Lanes<4> operator!= ( const Lanes<4>& a, const Lanes<4>& b ) { return _mm_cmpneq_ps(a.x, b.x); }
+inline Lanes<4> operator& ( const Lanes<4>& a, const Lanes<4>& b ) { return _mm_and_ps(a.x, b.x); }
+inline Lanes<4> operator| ( const Lanes<4>& a, const Lanes<4>& b ) { return _mm_or_ps(a.x, b.x); }
+inline Lanes<4> vmin( const Lanes<4>& a, const Lanes<4>& b ) { return _mm_min_ps(a.x, b.x); }
+inline Lanes<4> vmax( const Lanes<4>& a, const Lanes<4>& b ) { return _mm_max_ps(a.x, b.x); }
+#endif
+
+#ifdef __AVX__
+template < >
+struct Lanes<8>
+{
+    typedef Lanes<8> Mask;
+    __m256 x;
+
+    Lanes( const __m256 _x ) : x(_x) {}
+    explicit Lanes( const float _x ) : x(_mm256_set1_ps(_x)) {}
+    static Lanes load( const float *p ) { return Lanes(_mm256_loadu_ps(p)); }
+    void store( float *p ) const { _mm256_storeu_ps(p, x); }
+    static int bits( const Mask m ) { return _mm256_movemask_ps(m.x); }
+};
+
+inline Lanes<8> operator+ ( const Lanes<8>& a, const Lanes<8>& b ) { return _mm256_add_ps(a.x, b.x); }
+inline Lanes<8> operator- ( const Lanes<8>& a, const Lanes<8>& b ) { return _mm256_sub_ps(a.x, b.x); }
+inline Lanes<8> operator* ( const Lanes<8>& a, const Lanes<8>& b ) { return _mm256_mul_ps(a.x, b.x); }
+inline Lanes<8> operator/ ( const Lanes<8>& a, const Lanes<8>& b ) { return _mm256_div_ps(a.x, b.x); }
+inline Lanes<8> operator<= ( const Lanes<8>& a, const Lanes<8>& b ) { return _mm256_cmp_ps(a.x, b.x, _CMP_LE_OQ); }
+inline Lanes<8> operator>= ( const Lanes<8>& a, const Lanes<8>& b ) { return _mm256_cmp_ps(a.x, b.x, _CMP_GE_OQ); }
+inline Lanes<8> operator!= ( const Lanes<8>& a, const Lanes<8>& b ) { return _mm256_cmp_ps(a.x, b.x, _CMP_NEQ_UQ); }
+inline Lanes<8> operator& ( const Lanes<8>& a, const Lanes<8>& b ) { return _mm256_and_ps(a.x, b.x); }
+inline Lanes<8> operator| ( const Lanes<8>& a, const Lanes<8>& b ) { return _mm256_or_ps(a.x, b.x); }
+inline Lanes<8> vmin( const Lanes<8>& a, const Lanes<8>& b ) { return _mm256_min_ps(a.x, b.x); }
+inline Lanes<8> vmax( const Lanes<8>& a, const Lanes<8>& b ) { return _mm256_max_ps(a.x, b.x); }
+#endif
+
+//! nombre de triangles ou de rayons testes ensemble dans un bloc de W triangles ou un paquet de W rayons, selon le jeu d'instructions disponible.
+template < int W >
+struct BlockLanes { enum { L= 1 }; };
+
+#if defined(__SSE2__) || defined(_M_X64)
+template < >
+struct BlockLanes<4> { enum { L= 4 }; };
+#endif
+
+#ifdef __AVX__
+template < >
+struct BlockLanes<8> { enum { L= 8 }; };
+#elif defined(__SSE2__) || defined(_M_X64)
+template < >
+struct BlockLanes<8> { enum { L= 4 }; };
+#endif
+
+
+//! paquet de 8 rayons, coordonnees rangees par axe, pour tester un englobant avec les 8 rayons en meme temps, cf BVHT::intersect( rays, n, hits ).
+struct RayPacket
+{
+    enum { W= 8 };
+    float o[3][W];
+    float invd[3][W];
+    float tmax[W];      //!< intersection la plus proche de chaque rayon, -1 pour un rayon inutilise.
+    int sign[3];        //!< signe des directions, le meme pour tous les rayons du paquet, cf BBox::intersect().
+
+    //! intersection des rayons du paquet avec un englobant. renvoie un bit par rayon qui touche l'englobant.
+    int intersect( const BBox& bounds ) const
+    {
+        const int L= BlockLanes<W>::L;
+        typedef Lanes<L> F;
+
+        int hits= 0;
+        for(int k= 0; k < W; k+= L)
+        {
+            F tmin(0.f);
+            F tmax= F::load(this->tmax + k);
+            for(int axis= 0; axis < 3; axis++)
+            {
+                F o= F::load(this->o[axis] + k);
+                F invd= F::load(this->invd[axis] + k);
+                F dmin= (F(sign[axis] ? bounds.pmax(axis) : bounds.pmin(axis)) - o) * invd;
+                F dmax= (F(sign[axis] ? bounds.pmin(axis) : bounds.pmax(axis)) - o) * invd;
+                tmin= vmax(tmin, dmin);
+                tmax= vmin(tmax, dmax);
+            }
+            hits|= F::bits(tmin <= tmax) << k;
+        }
+
+        return hits;
+    }
+};
+
+//! statistiques du parcours par paquets, cf BVHT::intersect( rays, n, hits ).
+struct PacketStats
+{
+    int rays;               //!< nombre de rayons.
+    int packets;            //!< nombre de paquets parcourus ensemble, les rayons d'un paquet ont des directions dans le meme octant.
+    int incoherent;         //!< nombre de paquets parcourus rayon par rayon, directions trop differentes, cf BVHOptions::packet_coherence.
+    long long fallbacks;    //!< nombre de rayons qui finissent un sous arbre seuls, cf BVHOptions::packet_min.
+    long long visits;       //!< nombre de noeuds visites par les paquets.
+    long long active;       //!< nombre de rayons actifs, cumule sur les noeuds visites.
+
+    PacketStats( ) : rays(0), packets(0), incoherent(0), fallbacks(0), visits(0), active(0) {}
+
+    //! utilisation moyenne des 8 rayons d'un paquet, sur les noeuds visites.
+    float utilization( ) const { return visits ? float(double(active) / double(visits * RayPacket::W)) : 0; }
+
+    void print( const char *name= "packets" ) const
+    {
+        printf("%s: %d rays, %d packets, %d incoherent, %lld fallback rays, %lld visits, %.1f%% lane utilization\n",
+            name, rays, packets, incoherent, fallbacks, visits, utilization() * 100);
+    }
+};
+
+
+//! repartition des primitives entre les fils d'un noeud.
+enum BVHBuilder
+{
+    BVH_MIDPOINT= 0,    //!< coupe l'englobant des centres au milieu de son axe le plus etire.
+    BVH_SAH,            //!< minimise le cout / surface area heuristic, evalue sur un histogramme, cf sah.txt.
+    BVH_LBVH            //!< trie les centres le long d'une courbe de morton, construction rapide, cf "maximizing parallelism in the construction of BVHs, octrees, and k-d trees", T. Karras, 2012.
+};
+
+//! parametres de construction, cf BVHT::build().
+struct BVHOptions
+{
+    BVHBuilder builder;     //!< repartition des primitives.
+    int leaf_max;           //!< nombre max de primitives par feuille.
+    int bins;               //!< nombre de cellules de l'histogramme par axe, BVH_SAH.
+    float box_cost;         //!< cout d'un test rayon / englobant.
+    float primitive_cost;   //!< cout d'un test rayon / primitive.
+    bool treelet;           //!< BVH_LBVH, reorganise les sous arbres de 7 feuilles pour minimiser leur cout, cf "fast parallel construction of high-quality bounding volume hierarchies", T. Karras, T. Aila, 2013.
+    int width;              //!< 2, 4 ou 8 fils par noeud pour le parcours, cf BVHT::collapse().
+    int leaf_block;         //!< triangles : teste les triangles des feuilles par blocs de 4 ou 8, ou un par un, 0. cf TriangleBlock.
+    bool watertight;        //!< triangles : test rayon / triangle etanche, cf intersect_block_watertight(). utilise les blocs de triangles.
+    int packet_min;         //!< paquets de rayons : nombre min de rayons actifs pour continuer le parcours ensemble, sinon les rayons finissent le sous arbre un par un.
+    float packet_coherence; //!< paquets de rayons : cosinus min entre la direction moyenne et les directions des rayons, sinon les rayons sont parcourus un par un.
+    float refit_threshold;  //!< refit() : reconstruit l'arbre lorsque son cout sah depasse refit_threshold fois le cout apres la construction.
+    bool quantized;         //!< noeuds larges compresses, englobants des fils quantifies sur 8 bits, cf QuantizedNode. width 4 ou 8.
+
+    BVHOptions( ) : builder(BVH_SAH), leaf_max(4), bins(16), box_cost(1), primitive_cost(1), treelet(false), width(2), leaf_block(4), watertight(false), packet_min(3), packet_coherence(.9f), refit_threshold(1.5f), quantized(false) {}
+    BVHOptions( const BVHBuilder _builder, const int _leaf_max= 4 ) : builder(_builder), leaf_max(_leaf_max), bins(16), box_cost(1), primitive_cost(1), treelet(false), width(2), leaf_block(4), watertight(false), packet_min(3), packet_coherence(.9f), refit_threshold(1.5f), quantized(false) {}
+};
+
+// format des fichiers bvh : entete + blocs alignes sur 64 octets, dans l'ordre de BVHFileBlock, cf BVHT::write() et BVHT::read().
+// les noeuds sont stockes exactement comme dans les tableaux de BVHT, sizes[] verifie que les structures sont les memes.
+enum BVHFileBlock
+{
+    BVH_FILE_NODES= 0,
+    BVH_FILE_NODES4,
+    BVH_FILE_NODES8,
+    BVH_FILE_ORDER,         //!< indice des primitives dans l'ordre des feuilles.
+    BVH_FILE_QNODES4,       //!< noeuds compresses, cf BVHOptions::quantized.
+    BVH_FILE_QNODES8,
+    BVH_FILE_BLOCKS
+};
+
+struct BVHFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t sizes[5];                  //!< sizeof(Node), sizeof(WideNode<4>), sizeof(WideNode<8>), sizeof(QuantizedNode<4>), sizeof(QuantizedNode<8>).
+    uint64_t key;                       //!< empreinte des primitives, cf mesh_hash().
+    int32_t root;
+    int32_t builder;                    //!< parametres de construction, cf BVHOptions.
+    int32_t leaf_max;
+    int32_t bins;
+    int32_t treelet;
+    int32_t width;
+    int32_t quantized;
+    float box_cost;
+    float primitive_cost;
+    float build_cost;
+    uint64_t count[BVH_FILE_BLOCKS];    //!< nombre d'elements de chaque bloc.
+    uint64_t offset[BVH_FILE_BLOCKS];   //!< position de chaque bloc dans le fichier.
+    uint64_t size[BVH_FILE_BLOCKS];     //!< taille de chaque bloc, en octets.
+};
+
+static const char bvh_file_magic[8]= { 'g', 'k', 'b', 'v', 'h', 0, 0, 0 };
+static const uint32_t bvh_file_version= 2;
+static const uint64_t bvh_file_align= 64;
+
+//! ecrit un fichier bvh : place les blocs, ecrit un fichier temporaire puis le renomme, comme write_mesh_cache(). renvoie faux en cas d'erreur.
+inline bool write_bvh_file( const char *filename, BVHFileHeader& header, const void *data[BVH_FILE_BLOCKS] )
+{
+    uint64_t offset= sizeof(header);
+    for(int i= 0; i < BVH_FILE_BLOCKS; i++)
+    {
+        offset= (offset + bvh_file_align -1) / bvh_file_align * bvh_file_align;
+        header.offset[i]= offset;
+        offset+= header.size[i];
+    }
+
+    // fichier temporaire unique : plusieurs threads, ou processus, peuvent construire et enregistrer le meme arbre, cf BVHT::build_cached()
+    std::string tmp= temporary_filename(filename);
+    FILE *out= fopen(tmp.c_str(), "wb");
+    if(out == nullptr)
+    {
+        printf("[error] writing bvh '%s'...\n", filename);
+        return false;
+    }
+
+    bool error= (fwrite(&header, sizeof(header), 1, out) != 1);
+    const char padding[bvh_file_align]= { };
+    uint64_t position= sizeof(header);
+    for(int i= 0; i < BVH_FILE_BLOCKS && !error; i++)
+    {
+        if(header.offset[i] > position)
+            error= (fwrite(padding, header.offset[i] - position, 1, out) != 1);
+        if(header.size[i] > 0 && !error)
+            error= (fwrite(data[i], header.size[i], 1, out) != 1);
+
+        position= header.offset[i] + header.size[i];
+    }
+
+    if(fclose(out) != 0)
+        error= true;
+
+    if(!error)
+    {
+#ifdef _WIN32
+        remove(filename);   // windows ne remplace pas un fichier existant...
+#endif
+        // posix : rename() remplace le fichier de maniere atomique, l'ancien fichier reste lisible jusqu'au renommage
+        error= (rename(tmp.c_str(), filename) != 0);
+    }
+
+    if(error)
+    {
+        remove(tmp.c_str());
+        printf("[error] writing bvh '%s'...\n", filename);
+        return false;
+    }
+
+    return true;
+}
+
+
+//! statistiques de l'arbre, cf BVHT::stats().
+struct BVHStats
+{
+    int primitives;             //!< nombre de primitives.
+    int nodes;                  //!< nombre de noeuds internes.
+    int leaves;                 //!< nombre de feuilles.
+    int depth_max;              //!< profondeur max des feuilles.
+    float depth_average;        //!< profondeur moyenne des feuilles.
+    int leaf_max;               //!< nombre max de primitives par feuille.
+    float leaf_average;         //!< nombre moyen de primitives par feuille.
+    float sah_cost;             //!< cout de l'arbre, cf sah.txt.
+    float build_time;           //!< duree de la construction, en millisecondes.
+
+    BVHStats( ) : primitives(0), nodes(0), leaves(0), depth_max(0), depth_average(0), leaf_max(0), leaf_average(0), sah_cost(0), build_time(0) {}
+
+    void print( const char *name= "bvh" ) const
+    {
+        printf("%s: %d primitives, %d nodes, %d leaves, depth %d max %.1f avg, leaf %d max %.1f avg, sah cost %.2f, build %.1fms\n",
+            name, primitives, nodes, leaves, depth_max, depth_average, leaf_max, leaf_average, sah_cost, build_time);
+    }
+};
+
+
+/*! tests rayon / primitives des feuilles, par blocs de primitives. rien pour les primitives quelconques, elles sont testees une par une.
+    cf la specialisation pour les triangles, LeafBlocks<Triangle>.
+ */
+template < typename T >
+struct LeafBlocks
+{
+    void build( const std::vector<T>&, const std::vector<Node>&, const BVHOptions& ) {}
+    void clear( ) {}
+
+    //! intersection avec les primitives [begin .. end) d'une feuille. renvoie faux si les primitives doivent etre testees une par une.
+    bool intersect( const std::vector<T>&, const int, const int, const Ray&, Hit& ) const { return false; }
+
+    //! occultation par les primitives [begin .. end) d'une feuille, cf intersect().
+    bool occluded( const std::vector<T>&, const int, const int, const Ray&, const float, bool& ) const { return false; }
+};
+
+
+/*! bvh parametre par le type des primitives, cf Triangle et Instance.
+
+    T doit fournir :
+    \code
+    struct T
+    {
+        BBox bounds( ) const;
+        Hit intersect( const Ray& ray, const float htmax ) const;
+        bool occluded( const Ray& ray, const float htmax ) const;
+    };
+    \endcode
+
+    \code
+    std::vector<Triangle> triangles= { ... };
+
+    BVH bvh;
+    bvh.build(triangles);               // sah, 4 triangles max par feuille
+    bvh.stats().print();
+
+    if(Hit hit= bvh.intersect(ray))
+        // touche !
+
+    if(bvh.occluded(shadow_ray))
+        // a l'ombre, pas la peine de chercher l'intersection la plus proche...
+    \endcode
+ */
+template < typename T >
+struct BVHT
+{
+    BVHT( ) : nodes(), nodes4(), nodes8(), qnodes4(), qnodes8(), blocks(), primitives(), root(-1), options(), build_time(0), build_cost(0), refit_cost(0), refit_time(0), m_order(), m_refs(), m_boxes(), m_centroids(), m_flags(), m_tmp(), m_used(), m_codes(), m_lnodes() {}
+
+    /*! construit un bvh pour l'ensemble de primitives. renvoie l'indice de la racine.
+        construction en parallele : les noeuds superieurs repartissent leurs primitives en parallele, puis chaque sous arbre est construit par une tache.
+        BVH_LBVH trie les primitives avant de construire tous les noeuds en parallele, cf build_lbvh().
+        l'arbre ne depend pas du nombre de threads.
+        si options.width vaut 4 ou 8, construit aussi les noeuds larges, cf collapse().
+     */
+    int build( const std::vector<T>& _primitives, const BVHOptions& _options= BVHOptions() )
+    {
+        auto start= std::chrono::high_resolution_clock::now();
+
+        options= _options;
+        options.leaf_max= std::max(1, options.leaf_max);
+        options.bins= std::max(2, std::min(int(BINS_MAX), options.bins));
+
+        nodes.clear();          // efface les noeuds
+        blocks.clear();
+        primitives.clear();
+        m_order.clear();
+        root= -1;
+        build_cost= 0;
+
+        const int n= int(_primitives.size());
+        if(n > 0)
+        {
+            // englobants et centres des primitives, calcules une seule fois
+            m_refs.resize(n);
+            m_boxes.resize(n);
+            m_centroids.resize(n);
+#pragma omp parallel for schedule(static, 4096)
+            for(int i= 0; i < n; i++)
+            {
+                m_refs[i]= i;
+                m_boxes[i]= _primitives[i].bounds();
+                m_centroids[i]= m_boxes[i].centroid();
+            }
+
+            // un sous arbre de k primitives utilise au plus 2k-1 noeuds, a partir de sa racine.
+            // chaque sous arbre recoit ses noeuds a l'avance, les threads ne partagent pas de compteur, cf build_node().
+            nodes.resize(2*n -1);
+            m_used.assign(2*n -1, 0);
+
+            if(options.builder == BVH_LBVH)
+                build_lbvh();
+
+            else
+            {
+                if(n > PARALLEL_MIN)
+                {
+                    m_flags.resize(n);
+                    m_tmp.resize(n);
+                }
+
+                // 1. noeuds superieurs, repartition des primitives en parallele
+                std::vector<Subtree> subtrees;
+                build_top(0, 0, n, subtrees);
+
+                // 2. sous arbres, en parallele, les plus gros d'abord
+                std::sort(subtrees.begin(), subtrees.end(),
+                    []( const Subtree& a, const Subtree& b ) { return (a.end - a.begin) > (b.end - b.begin); });
+                build_subtrees(subtrees);
+            }
+
+            // 3. supprime les noeuds inutilises
+            compact();
+            root= 0;
+            build_cost= update_cost(false);
+
+            // range les primitives dans l'ordre des feuilles
+            primitives= _primitives;
+#pragma omp parallel for schedule(static, 4096)
+            for(int i= 0; i < n; i++)
+                primitives[i]= _primitives[m_refs[i]];
+
+            // conserve l'ordre des primitives pour refit()
+            std::swap(m_order, m_refs);
+
+            // nettoyage
+            m_refs= std::vector<int>();
+            m_boxes= std::vector<BBox>();
+            m_centroids= std::vector<Point>();
+            m_flags= std::vector<unsigned char>();
+            m_tmp= std::vector<int>();
+        }
+
+        collapse(options.width);
+        blocks.build(primitives, nodes, options);
+        refit_cost= build_cost;
+
+        auto stop= std::chrono::high_resolution_clock::now();
+        build_time= std::chrono::duration<float, std::milli>(stop - start).count();
+        return root;
+    }
+
+    /*! met a jour l'arbre apres une deformation des primitives : objets animes, squelettes, etc.
+        _primitives est dans le meme ordre et de meme taille que pour build(). les englobants des noeuds sont recalcules des feuilles vers la racine, en parallele,
+        sans changer la structure de l'arbre, puis les noeuds larges et les blocs de triangles sont reconstruits.
+        la qualite de l'arbre se degrade avec les deformations : si son cout sah depasse options.refit_threshold fois le cout apres la construction, l'arbre est reconstruit.
+        renvoie vrai si l'arbre a ete reconstruit.
+     */
+    bool refit( const std::vector<T>& _primitives )
+    {
+        if(root < 0 || _primitives.size() != m_order.size())
+        {
+            if(root >= 0)
+                printf("[error] bvh refit: %d primitives, expected %d... rebuild.\n", int(_primitives.size()), int(m_order.size()));
+            build(_primitives, options);
+            refit_time= build_time;
+            return true;
+        }
+
+        auto start= std::chrono::high_resolution_clock::now();
+
+        const int n= int(_primitives.size());
+#pragma omp parallel for schedule(static, 4096)
+        for(int i= 0; i < n; i++)
+            primitives[i]= _primitives[m_order[i]];
+
+        refit_cost= update_cost(true);
+        bool rebuild= (refit_cost > options.refit_threshold * build_cost);
+        if(rebuild)
+            build(_primitives, options);
+        else
+        {
+            collapse(options.width);
+            blocks.build(primitives, nodes, options);
+        }
+
+        auto stop= std::chrono::high_resolution_clock::now();
+        refit_time= std::chrono::duration<float, std::milli>(stop - start).count();
+        return rebuild;
+    }
+
+    //! renvoie l'augmentation du cout sah de l'arbre depuis sa construction, cf refit().
+    float refit_growth( ) const { return (build_cost > 0) ? refit_cost / build_cost : 1; }
+
+    /*! enregistre l'arbre dans un fichier binaire : parametres de construction, noeuds, noeuds larges et ordre des primitives.
+        key identifie les primitives, cf mesh_hash(). les primitives ne sont pas enregistrees, read() les reordonne. renvoie faux en cas d'erreur.
+     */
+    bool write( const char *filename, const uint64_t key ) const
+    {
+        BVHFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, bvh_file_magic, sizeof(header.magic));
+        header.version= bvh_file_version;
+        header.sizes[0]= sizeof(Node);
+        header.sizes[1]= sizeof(WideNode<4>);
+        header.sizes[2]= sizeof(WideNode<8>);
+        header.sizes[3]= sizeof(QuantizedNode<4>);
+        header.sizes[4]= sizeof(QuantizedNode<8>);
+        header.key= key;
+        header.root= root;
+        header.builder= options.builder;
+        header.leaf_max= options.leaf_max;
+        header.bins= options.bins;
+        header.treelet= options.treelet;
+        header.width= options.width;
+        header.quantized= options.quantized;
+        header.box_cost= options.box_cost;
+        header.primitive_cost= options.primitive_cost;
+        header.build_cost= build_cost;
+
+        const void *data[BVH_FILE_BLOCKS]= { nodes.data(), nodes4.data(), nodes8.data(), m_order.data(), qnodes4.data(), qnodes8.data() };
+        header.count[BVH_FILE_NODES]= nodes.size();
+        header.size[BVH_FILE_NODES]= nodes.size() * sizeof(Node);
+        header.count[BVH_FILE_NODES4]= nodes4.size();
+        header.size[BVH_FILE_NODES4]= nodes4.size() * sizeof(WideNode<4>);
+        header.count[BVH_FILE_NODES8]= nodes8.size();
+        header.size[BVH_FILE_NODES8]= nodes8.size() * sizeof(WideNode<8>);
+        header.count[BVH_FILE_ORDER]= m_order.size();
+        header.size[BVH_FILE_ORDER]= m_order.size() * sizeof(int);
+        header.count[BVH_FILE_QNODES4]= qnodes4.size();
+        header.size[BVH_FILE_QNODES4]= qnodes4.size() * sizeof(QuantizedNode<4>);
+        header.count[BVH_FILE_QNODES8]= qnodes8.size();
+        header.size[BVH_FILE_QNODES8]= qnodes8.size() * sizeof(QuantizedNode<8>);
+
+        return write_bvh_file(filename, header, data);
+    }
+
+    /*! relit un arbre enregistre par write(), sans le reconstruire : le fichier est projete en memoire et les noeuds sont recopies directement.
+        _primitives doit etre le meme ensemble, dans le meme ordre, que pour build(). renvoie faux si le fichier n'existe pas, n'est pas valide,
+        ou s'il ne correspond pas a key ou aux parametres de construction de _options. les parametres de parcours de _options sont utilises.
+     */
+    bool read( const char *filename, const uint64_t key, const std::vector<T>& _primitives, const BVHOptions& _options= BVHOptions() )
+    {
+        auto start= std::chrono::high_resolution_clock::now();
+
+        MappedFile file= map_file(filename);
+        if(file.data == nullptr)
+            return false;
+
+        BVHFileHeader header;
+        bool valid= (file.size >= sizeof(header));
+        if(valid)
+        {
+            memcpy(&header, file.data, sizeof(header));
+            valid= (memcmp(header.magic, bvh_file_magic, sizeof(header.magic)) == 0 && header.version == bvh_file_version)
+                && header.sizes[0] == sizeof(Node) && header.sizes[1] == sizeof(WideNode<4>) && header.sizes[2] == sizeof(WideNode<8>)
+                && header.sizes[3] == sizeof(QuantizedNode<4>) && header.sizes[4] == sizeof(QuantizedNode<8>);
+            if(!valid)
+                printf("[error] invalid bvh '%s'...\n", filename);
+        }
+
+        // verifie les blocs
+        const uint64_t element_size[BVH_FILE_BLOCKS]= { sizeof(Node), sizeof(WideNode<4>), sizeof(WideNode<8>), sizeof(int), sizeof(QuantizedNode<4>), sizeof(QuantizedNode<8>) };
+        for(int i= 0; i < BVH_FILE_BLOCKS && valid; i++)
+        {
+            if(header.offset[i] > file.size || header.size[i] > file.size - header.offset[i] || header.count[i] * element_size[i] != header.size[i])
+            {
+                printf("[error] invalid bvh '%s'...\n", filename);
+                valid= false;
+            }
+        }
+
+        // meme primitives, meme arbre ?
+        const int n= int(_primitives.size());
+        BVHOptions tree= _options;
+        tree.leaf_max= std::max(1, tree.leaf_max);
+        tree.bins= std::max(2, std::min(int(BINS_MAX), tree.bins));
+        if(valid)
+            valid= header.key == key && header.count[BVH_FILE_ORDER] == uint64_t(n)
+                && header.root == (n > 0 ? 0 : -1)
+                && header.builder == tree.builder && header.leaf_max == tree.leaf_max && header.bins == tree.bins && bool(header.treelet) == tree.treelet
+                && header.box_cost == tree.box_cost && header.primitive_cost == tree.primitive_cost;
+
+        if(!valid)
+        {
+            unmap_file(file);
+            return false;
+        }
+
+        const Node *file_nodes= (const Node *) (file.data + header.offset[BVH_FILE_NODES]);
+        const WideNode<4> *file_nodes4= (const WideNode<4> *) (file.data + header.offset[BVH_FILE_NODES4]);
+        const WideNode<8> *file_nodes8= (const WideNode<8> *) (file.data + header.offset[BVH_FILE_NODES8]);
+        const int *file_order= (const int *) (file.data + header.offset[BVH_FILE_ORDER]);
+        const QuantizedNode<4> *file_qnodes4= (const QuantizedNode<4> *) (file.data + header.offset[BVH_FILE_QNODES4]);
+        const QuantizedNode<8> *file_qnodes8= (const QuantizedNode<8> *) (file.data + header.offset[BVH_FILE_QNODES8]);
+
+        options= tree;
+        options.width= header.width;
+        options.quantized= header.quantized;
+        nodes.assign(file_nodes, file_nodes + header.count[BVH_FILE_NODES]);
+        nodes4.assign(file_nodes4, file_nodes4 + header.count[BVH_FILE_NODES4]);
+        nodes8.assign(file_nodes8, file_nodes8 + header.count[BVH_FILE_NODES8]);
+        qnodes4.assign(file_qnodes4, file_qnodes4 + header.count[BVH_FILE_QNODES4]);
+        qnodes8.assign(file_qnodes8, file_qnodes8 + header.count[BVH_FILE_QNODES8]);
+        m_order.assign(file_order, file_order + n);
+        unmap_file(file);
+
+        root= header.root;
+        build_cost= header.build_cost;
+        refit_cost= build_cost;
+
+        // range les primitives dans l'ordre des feuilles
+        primitives= _primitives;
+        int errors= 0;
+#pragma omp parallel for schedule(static, 4096) reduction(+: errors)
+        for(int i= 0; i < n; i++)
+        {
+            if(m_order[i] < 0 || m_order[i] >= n)
+                errors++;
+            else
+                primitives[i]= _primitives[m_order[i]];
+        }
+        if(errors || !check_nodes(n))
+        {
+            printf("[error] invalid bvh '%s'...\n", filename);
+            nodes.clear();
+            nodes4.clear();
+            nodes8.clear();
+            qnodes4.clear();
+            qnodes8.clear();
+            primitives.clear();
+            m_order.clear();
+            root= -1;
+            return false;
+        }
+
+        // change de noeuds larges, si necessaire
+        if(header.width != _options.width || bool(header.quantized) != _options.quantized)
+        {
+            options.quantized= _options.quantized;
+            collapse(_options.width);
+        }
+        blocks.build(primitives, nodes, options);
+
+        auto stop= std::chrono::high_resolution_clock::now();
+        build_time= std::chrono::duration<float, std::milli>(stop - start).count();
+        return true;
+    }
+
+    /*! relit l'arbre dans le cache, ou le construit et l'enregistre. le fichier directory/<key>.bvh est nomme par l'empreinte des primitives, cf mesh_hash(),
+        et par les parametres de construction : les processus qui utilisent les memes objets partagent le cache. renvoie l'indice de la racine.
+     */
+    int build_cached( const std::string& directory, const uint64_t key, const std::vector<T>& _primitives, const BVHOptions& _options= BVHOptions() )
+    {
+        std::string filename= cache_filename(directory, key, _options);
+        if(read(filename.c_str(), key, _primitives, _options))
+            return root;
+
+        build(_primitives, _options);
+        write(filename.c_str(), key);
+        return root;
+    }
+
+    /*! change le parcours de l'arbre, sans le reconstruire : 2, 4 ou 8 fils par noeud.
+        les noeuds larges regroupent les noeuds binaires, en ouvrant le fils de plus grande aire, tant qu'il reste de la place, cf "shallow bounding volume hierarchies for fast SIMD ray tracing of incoherent rays", H. Dammertz, J. Hanika, A. Keller, 2008.
+        intersect() teste tous les fils d'un noeud large en meme temps et les parcourt du plus proche au plus loin.
+        si options.quantized, les noeuds larges sont compresses, cf QuantizedNode, et les primitives sont reordonnees pour ranger les feuilles de chaque noeud a la suite.
+     */
+    void collapse( const int width )
+    {
+        nodes4.clear();
+        nodes8.clear();
+        qnodes4.clear();
+        qnodes8.clear();
+        options.width= (width >= 8) ? 8 : (width >= 4) ? 4 : 2;
+        if(root < 0)
+            return;
+
+        int depth= 0;
+        if(options.quantized && options.width > 2)
+        {
+            depth= (options.width == 4) ? quantize(qnodes4) : quantize(qnodes8);
+            if(depth < 0)
+            {
+                // noeuds larges non compresses...
+                options.quantized= false;
+                depth= 0;
+            }
+        }
+
+        if(!options.quantized)
+        {
+            if(options.width == 4)
+                collapse_node(nodes4, root, 1, depth);
+            else if(options.width == 8)
+                collapse_node(nodes8, root, 1, depth);
+        }
+
+        // pile de parcours, cf intersect_wide()
+        if(depth * (options.width -1) +1 > STACK_MAX)
+        {
+            printf("[error] bvh: depth %d, can't use %d wide nodes...\n", depth, options.width);
+            nodes4.clear();
+            nodes8.clear();
+            qnodes4.clear();
+            qnodes8.clear();
+            options.width= 2;
+        }
+    }
+
+    //! intersection avec un rayon, entre 0 et htmax.
+    Hit intersect( const Ray& ray, const float htmax ) const
+    {
+        Hit hit;
+        hit.t= htmax;
+        if(root < 0)
+            return hit;
+
+        if(options.width == 4 && options.quantized)
+            intersect_wide(qnodes4, ray, hit);
+        else if(options.width == 8 && options.quantized)
+            intersect_wide(qnodes8, ray, hit);
+        else if(options.width == 4)
+            intersect_wide(nodes4, ray, hit);
+        else if(options.width == 8)
+            intersect_wide(nodes8, ray, hit);
+        else
+        {
+            Vector invd= Vector(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+            intersect(root, ray, invd, hit);
+        }
+        return hit;
+    }
+
+    //! intersection avec un rayon, entre 0 et ray.tmax.
+    Hit intersect( const Ray& ray ) const { return intersect(ray, ray.tmax); }
+
+    /*! intersection d'un ensemble de rayons, par paquets de 8 rayons : hits[i]= intersect(rays[i]), en parallele. renvoie le nombre de rayons qui touchent une primitive.
+        les rayons sont regroupes par octant de leur direction, par groupes de 256 rayons consecutifs, puis forment des paquets de 8 rayons.
+        les 8 rayons d'un paquet parcourent les noeuds binaires, ou larges cf options.width, ensemble : chaque englobant est teste avec les 8 rayons en meme temps, cf RayPacket.
+        les rayons voisins dans le tableau doivent etre coherents : pixels voisins, cf tuiles de 4x2 pixels, ou rebonds sur une meme surface.
+        un paquet dont les directions sont trop differentes, cf options.packet_coherence, est parcouru rayon par rayon, avec les noeuds larges s'ils existent.
+        les rayons qui touchent un noeud avec moins de options.packet_min rayons actifs finissent le sous arbre un par un.
+        stats, si non nul, recupere l'utilisation moyenne des rayons des paquets.
+     */
+    int intersect( const Ray *rays, const int n, Hit *hits, PacketStats *stats= nullptr ) const
+    {
+        const int streams= (n + STREAM_MAX -1) / STREAM_MAX;
+
+        int count= 0;
+        int packets= 0;
+        int incoherent= 0;
+        long long fallbacks= 0;
+        long long visits= 0;
+        long long active= 0;
+    #pragma omp parallel reduction(+: count, packets, incoherent, fallbacks, visits, active) if(n >= 4096)
+        {
+            PacketStats local;
+            std::vector<PacketItem> stack;
+        #pragma omp for schedule(dynamic, 1)
+            for(int i= 0; i < streams; i++)
+            {
+                int begin= i * STREAM_MAX;
+                int end= std::min(n, begin + STREAM_MAX);
+                intersect_stream(rays, begin, end, hits, stack, local);
+
+                for(int k= begin; k < end; k++)
+                    if(hits[k])
+                        count++;
+            }
+
+            packets+= local.packets;
+            incoherent+= local.incoherent;
+            fallbacks+= local.fallbacks;
+            visits+= local.visits;
+            active+= local.active;
+        }
+
+        if(stats)
+        {
+            stats->rays= n;
+            stats->packets= packets;
+            stats->incoherent= incoherent;
+            stats->fallbacks= fallbacks;
+            stats->visits= visits;
+            stats->active= active;
+        }
+        return count;
+    }
+
+    /*! renvoie vrai si le rayon touche une primitive entre 0 et htmax. rayons d'ombre, visibilite, occultation ambiante...
+        le parcours s'arrete sur la premiere intersection, qui n'est pas forcement la plus proche, cf intersect().
+     */
+    bool occluded( const Ray& ray, const float htmax ) const
+    {
+        if(root < 0)
+            return false;
+
+        if(options.width == 4 && options.quantized)
+            return occluded_wide(qnodes4, ray, htmax);
+        else if(options.width == 8 && options.quantized)
+            return occluded_wide(qnodes8, ray, htmax);
+        else if(options.width == 4)
+            return occluded_wide(nodes4, ray, htmax);
+        else if(options.width == 8)
+            return occluded_wide(nodes8, ray, htmax);
+
+        Vector invd= Vector(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+        return occluded(root, ray, invd, htmax);
+    }
+
+    //! occultation d'un rayon, entre 0 et ray.tmax.
+    bool occluded( const Ray& ray ) const { return occluded(ray, ray.tmax); }
+
+    /*! occultation d'un ensemble de rayons, en parallele : results[i]= occluded(rays[i]), 0 ou 1. renvoie le nombre de rayons occultes.
+        les rayons voisins dans le tableau sont testes par le meme thread, il vaut mieux les ranger dans un ordre coherent, cf pixels voisins.
+     */
+    int occluded( const Ray *rays, const int n, unsigned char *results ) const
+    {
+        int count= 0;
+    #pragma omp parallel for schedule(dynamic, 256) reduction(+: count) if(n >= 4096)
+        for(int i= 0; i < n; i++)
+        {
+            results[i]= occluded(rays[i], rays[i].tmax);
+            count+= results[i];
+        }
+
+        return count;
+    }
+
+    //! renvoie l'englobant de l'arbre.
+    BBox bounds( ) const { return (root < 0) ? EmptyBox() : nodes[root].bounds; }
+
+    //! renvoie les statistiques de l'arbre : nombre de noeuds, profondeur, cout, etc.
+    BVHStats stats( ) const
+    {
+        BVHStats stats;
+        stats.primitives= int(primitives.size());
+        stats.build_time= build_time;
+        if(root < 0)
+            return stats;
+
+        float root_area= nodes[root].bounds.area();
+        if(root_area <= 0)
+            root_area= 1;
+
+        // parcours de l'arbre, sans recursion
+        std::vector<std::pair<int, int>> stack;
+        stack.push_back( {root, 0} );
+
+        double cost= 0;
+        double depths= 0;
+        while(!stack.empty())
+        {
+            int index= stack.back().first;
+            int depth= stack.back().second;
+            stack.pop_back();
+
+            const Node& node= nodes[index];
+            float area= node.bounds.area() / root_area;
+            if(node.leaf())
+            {
+                int n= node.leaf_end() - node.leaf_begin();
+                stats.leaves++;
+                stats.leaf_max= std::max(stats.leaf_max, n);
+                stats.depth_max= std::max(stats.depth_max, depth);
+                depths+= depth;
+                cost+= area * n * options.primitive_cost;
+            }
+            else
+            {
+                stats.nodes++;
+                cost+= area * 2 * options.box_cost;
+                stack.push_back( {node.internal_left(), depth +1} );
+                stack.push_back( {node.internal_right(), depth +1} );
+            }
+        }
+
+        stats.depth_average= float(depths / stats.leaves);
+        stats.leaf_average= float(stats.primitives) / float(stats.leaves);
+        stats.sah_cost= float(cost);
+        return stats;
+    }
+
+    std::vector<Node> nodes;    //!< noeuds de l'arbre, la racine est le noeud 0, puis en profondeur d'abord : le fils gauche suit son pere.
+    std::vector<WideNode<4>> nodes4;    //!< noeuds a 4 fils, si options.width == 4, la racine est le noeud 0.
+    std::vector<WideNode<8>> nodes8;    //!< noeuds a 8 fils, si options.width == 8.
+    std::vector<QuantizedNode<4>> qnodes4;  //!< noeuds compresses a 4 fils, si options.width == 4 et options.quantized, la racine est le noeud 0.
+    std::vector<QuantizedNode<8>> qnodes8;  //!< noeuds compresses a 8 fils, si options.width == 8 et options.quantized.
+    LeafBlocks<T> blocks;       //!< primitives des feuilles, rangees par blocs, cf options.leaf_block.
+    std::vector<T> primitives;  //!< primitives, triees dans l'ordre des feuilles.
+    int root;                   //!< indice de la racine, -1 si l'arbre est vide.
+    BVHOptions options;         //!< parametres de construction.
+    float build_time;           //!< duree de la construction, ou du chargement, cf read(), en millisecondes.
+    float build_cost;           //!< cout sah de l'arbre apres la construction, cf stats().
+    float refit_cost;           //!< cout sah de l'arbre apres le dernier refit().
+    float refit_time;           //!< duree du dernier refit(), en millisecondes.
+
+protected:
+    enum
+    {
+        BINS_MAX= 64,
+        PARALLEL_MIN= 64*1024,      // repartition des primitives en parallele au dessus de PARALLEL_MIN primitives
+        TASK_MIN= 4096,             // nouvelle tache pour les sous arbres de plus de TASK_MIN primitives
+        TREELET_LEAVES= 7,          // nombre de feuilles des treelets, cf optimize_treelet()
+        STACK_MAX= 512,             // taille de la pile de parcours des noeuds larges, cf intersect_wide()
+        STREAM_MAX= 256             // nombre de rayons regroupes par octant avant de former les paquets, cf intersect_stream()
+    };
+
+    // englobants des primitives de la cellule d'un histogramme
+    struct Bin
+    {
+        BBox bounds;
+        int n;
+    };
+
+    // sous arbre a construire, cf build_subtrees()
+    struct Subtree
+    {
+        int index;
+        int begin;
+        int end;
+    };
+
+    // nombre de blocs / threads pour les calculs en parallele
+    static int thread_blocks( )
+    {
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    // construit les noeuds superieurs, les sous arbres de moins de PARALLEL_MIN primitives sont construits par build_subtrees()
+    void build_top( const int index, const int begin, const int end, std::vector<Subtree>& subtrees )
+    {
+        if(end - begin <= PARALLEL_MIN)
+        {
+            subtrees.push_back( {index, begin, end} );
+            return;
+        }
+
+        BBox bounds, cbounds;
+        node_bounds(begin, end, bounds, cbounds, true);
+
+        int m= split(bounds, cbounds, begin, end, true);
+        if(m < 0)
+        {
+            set_node(index, make_leaf(bounds, begin, end));
+            return;
+        }
+
+        // le fils gauche suit son pere, le fils droit suit le sous arbre gauche
+        int left= index +1;
+        int right= index + 2*(m - begin);
+        set_node(index, make_node(bounds, left, right));
+
+        build_top(left, begin, m, subtrees);
+        build_top(right, m, end, subtrees);
+    }
+
+    // construit les sous arbres, en parallele
+    void build_subtrees( const std::vector<Subtree>& subtrees )
+    {
+#if defined(_OPENMP) && _OPENMP >= 200805
+        // openMP 3 : une tache par sous arbre, les gros sous arbres creent d'autres taches, cf build_node()
+#pragma omp parallel
+#pragma omp single
+        for(unsigned i= 0; i < subtrees.size(); i++)
+        {
+            const Subtree subtree= subtrees[i];
+#pragma omp task firstprivate(subtree)
+            build_node(subtree.index, subtree.begin, subtree.end);
+        }
+#else
+        // openMP 2 : repartit les sous arbres entre les threads
+#pragma omp parallel for schedule(dynamic, 1)
+        for(int i= 0; i < int(subtrees.size()); i++)
+            build_node(subtrees[i].index, subtrees[i].begin, subtrees[i].end);
+#endif
+    }
+
+    // construit le sous arbre des primitives [begin .. end), sa racine est le noeud index
+    void build_node( const int index, const int begin, const int end )
+    {
+        assert(end > begin);
+
+        BBox bounds, cbounds;
+        node_bounds(begin, end, bounds, cbounds, false);
+
+        int m= split(bounds, cbounds, begin, end, false);
+        if(m < 0)
+        {
+            set_node(index, make_leaf(bounds, begin, end));
+            return;
+        }
+
+        // le fils gauche suit son pere, le fils droit suit le sous arbre gauche
+        int left= index +1;
+        int right= index + 2*(m - begin);
+        set_node(index, make_node(bounds, left, right));
+
+        // construire le fils gauche, les primitives se trouvent dans [begin .. m)
+#if defined(_OPENMP) && _OPENMP >= 200805
+        if(m - begin > TASK_MIN)
+        {
+#pragma omp task firstprivate(left, begin, m)
+            build_node(left, begin, m);
+        }
+        else
+#endif
+            build_node(left, begin, m);
+
+        // on recommence pour le fils droit, les primitives se trouvent dans [m .. end)
+        build_node(right, m, end);
+    }
+
+    // cout sah de l'arbre, divise par l'aire de la racine, cf stats(). recalcule d'abord les englobants des noeuds, si refit est vrai.
+    float update_cost( const bool refit )
+    {
+        double cost= 0;
+#if defined(_OPENMP) && _OPENMP >= 200805
+#pragma omp parallel
+#pragma omp single
+#endif
+        cost= refit_node(root, refit);
+
+        float root_area= nodes[root].bounds.area();
+        if(root_area <= 0)
+            root_area= 1;
+        return float(cost / root_area);
+    }
+
+    // verifie les indices des fils et des primitives des noeuds relus par read(), un fichier abime ne doit pas planter le parcours
+    bool check_nodes( const int n ) const
+    {
+        const int count= int(nodes.size());
+        if((n > 0) != (count > 0))
+            return false;
+
+        for(int i= 0; i < count; i++)
+        {
+            const Node& node= nodes[i];
+            if(node.internal() && (node.left <= i || node.right <= i || node.left >= count || node.right >= count))
+                return false;
+            if(node.leaf() && (node.leaf_begin() < 0 || node.leaf_begin() >= node.leaf_end() || node.leaf_end() > n))
+                return false;
+        }
+
+        // noeuds larges utilises par le parcours, cf options.width, options.quantized et intersect()
+        if(options.width != 2 && options.width != 4 && options.width != 8)
+            return false;
+        if(n > 0 && options.width == 4 && (options.quantized ? qnodes4.empty() : nodes4.empty()))
+            return false;
+        if(n > 0 && options.width == 8 && (options.quantized ? qnodes8.empty() : nodes8.empty()))
+            return false;
+
+        return check_wide(nodes4, n) && check_wide(nodes8, n) && check_wide(qnodes4, n) && check_wide(qnodes8, n);
+    }
+
+    template < template < int > class N, int W >
+    static bool check_wide( const std::vector<N<W>>& wide, const int n )
+    {
+        // les fils sont ranges apres leur pere : calcule la profondeur des noeuds en partant de la fin
+        const int count= int(wide.size());
+        std::vector<int> depth(count, 1);
+        int depth_max= 0;
+        for(int i= count -1; i >= 0; i--)
+        {
+            for(int k= 0; k < W; k++)
+            {
+                if(wide[i].child_empty(k))
+                    continue;
+
+                int child= wide[i].child_index(k);
+                int leaf= wide[i].child_count(k);
+                if(leaf == 0 && (child <= i || child >= count))
+                    return false;
+                if(leaf != 0 && (child < 0 || leaf < 0 || child + leaf > n))
+                    return false;
+                if(leaf == 0)
+                    depth[i]= std::max(depth[i], depth[child] +1);
+            }
+            depth_max= std::max(depth_max, depth[i]);
+        }
+
+        // pile de parcours, cf collapse() et intersect_wide()
+        return count == 0 || depth_max * (W -1) +1 <= STACK_MAX;
+    }
+
+    // nom du fichier cache : empreinte des primitives et des parametres de construction
+    static std::string cache_filename( const std::string& directory, const uint64_t key, const BVHOptions& options )
+    {
+        const int values[]= { int(options.builder), std::max(1, options.leaf_max), std::max(2, std::min(int(BINS_MAX), options.bins)), int(options.treelet), options.width, int(options.quantized) };
+        uint64_t h= key;
+        for(int v : values)
+            h= (h ^ uint64_t(unsigned(v))) * 1099511628211ull;
+        for(float v : { options.box_cost, options.primitive_cost })
+        {
+            unsigned bits;
+            memcpy(&bits, &v, sizeof(bits));
+            h= (h ^ uint64_t(bits)) * 1099511628211ull;
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bvh", (unsigned long long) h);
+        if(!directory.empty() && directory.back() != '/' && directory.back() != '\\')
+            return directory + "/" + name;
+        return directory + name;
+    }
+
+    // recalcule les englobants du sous arbre index, si refit est vrai, et renvoie son cout
+    double refit_node( const int index, const bool refit )
+    {
+        Node& node= nodes[index];
+        if(node.leaf())
+        {
+            if(refit)
+            {
+                BBox bounds= EmptyBox();
+                for(int i= node.leaf_begin(); i < node.leaf_end(); i++)
+                    bounds.insert(primitives[i].bounds());
+                node.bounds= bounds;
+            }
+            return double(options.primitive_cost) * node.bounds.area() * (node.leaf_end() - node.leaf_begin());
+        }
+
+        // le sous arbre gauche occupe les noeuds [left .. right)
+        const int left= node.internal_left();
+        const int right= node.internal_right();
+        double left_cost= 0;
+        double right_cost= 0;
+#if defined(_OPENMP) && _OPENMP >= 200805
+        if(right - left > TASK_MIN)
+        {
+#pragma omp task shared(left_cost)
+            left_cost= refit_node(left, refit);
+            right_cost= refit_node(right, refit);
+#pragma omp taskwait
+        }
+        else
+#endif
+        {
+            left_cost= refit_node(left, refit);
+            right_cost= refit_node(right, refit);
+        }
+
+        if(refit)
+            node.bounds= BBox(nodes[left].bounds, nodes[right].bounds);
+        return double(2 * options.box_cost) * node.bounds.area() + left_cost + right_cost;
+    }
+
+    void set_node( const int index, const Node& node )
+    {
+        assert(m_used[index] == 0);
+        nodes[index]= node;
+        m_used[index]= 1;
+    }
+
+    // lbvh : noeuds internes [0 .. n-1), feuilles [n-1 .. 2n-1), la racine est le noeud 0, cf build_hierarchy()
+    struct LBVHNode
+    {
+        BBox bounds;
+        float cost;         // cout du sous arbre, non normalise, cf node_cost()
+        int left;
+        int right;
+        int parent;
+        int count;          // nombre de primitives du sous arbre
+    };
+
+    // premier element du bloc b, lorsque [begin .. end) est decoupe en blocks blocs
+    static int block_begin( const int begin, const int end, const int b, const int blocks )
+    {
+        return begin + int(size_t(end - begin) * b / blocks);
+    }
+
+    /* construction lbvh :
+        1. code de morton du centre de chaque primitive, 10 bits par axe,
+        2. tri des codes, radix sort,
+        3. construction des noeuds internes, en parallele, cf build_hierarchy(),
+        4. englobants, des feuilles vers la racine, et optimisation des treelets, cf build_bounds(),
+        5. recopie dans nodes, les sous arbres de moins de leaf_max primitives deviennent des feuilles, cf emit_lbvh().
+     */
+    void build_lbvh( )
+    {
+        const int n= int(m_refs.size());
+
+        BBox bounds, cbounds;
+        node_bounds(0, n, bounds, cbounds, n > PARALLEL_MIN);
+
+        Vector extent= Vector(cbounds.pmin, cbounds.pmax);
+        Vector scale= Vector(extent.x > 0 ? 1024 / extent.x : 0, extent.y > 0 ? 1024 / extent.y : 0, extent.z > 0 ? 1024 / extent.z : 0);
+
+        m_codes.resize(n);
+#pragma omp parallel for schedule(static, 4096)
+        for(int i= 0; i < n; i++)
+            m_codes[i]= morton_code(m_centroids[i], cbounds.pmin, scale);
+
+        sort_codes();
+
+        m_lnodes.resize(2*n -1);
+        m_lnodes[0].parent= -1;
+        build_hierarchy();
+        build_bounds();
+
+        m_tmp.resize(n);
+#if defined(_OPENMP) && _OPENMP >= 200805
+#pragma omp parallel
+#pragma omp single
+#endif
+        emit_lbvh(0, 0, 0);
+
+        // ordre des primitives dans les feuilles
+        std::swap(m_refs, m_tmp);
+
+        m_codes= std::vector<unsigned int>();
+        m_lnodes= std::vector<LBVHNode>();
+    }
+
+    // intercale 2 bits a 0 entre les 10 bits de x
+    static unsigned int expand_bits( unsigned int x )
+    {
+        x= (x * 0x00010001u) & 0xFF0000FFu;
+        x= (x * 0x00000101u) & 0x0F00F00Fu;
+        x= (x * 0x00000011u) & 0xC30C30C3u;
+        x= (x * 0x00000005u) & 0x49249249u;
+        return x;
+    }
+
+    // code de morton d'un point, position relative a pmin sur 10 bits par axe
+    static unsigned int morton_code( const Point& p, const Point& pmin, const Vector& scale )
+    {
+        unsigned int x= unsigned(std::max(0.f, std::min(1023.f, (p.x - pmin.x) * scale.x)));
+        unsigned int y= unsigned(std::max(0.f, std::min(1023.f, (p.y - pmin.y) * scale.y)));
+        unsigned int z= unsigned(std::max(0.f, std::min(1023.f, (p.z - pmin.z) * scale.z)));
+        return (expand_bits(x) << 2) | (expand_bits(y) << 1) | expand_bits(z);
+    }
+
+    // trie les codes et les indices des primitives, radix sort stable, 3 passes de 10 bits
+    void sort_codes( )
+    {
+        const int n= int(m_codes.size());
+        const int blocks= (n > PARALLEL_MIN) ? thread_blocks() : 1;
+
+        std::vector<unsigned int> codes(n);
+        std::vector<int> refs(n);
+        std::vector<int> offsets(blocks * 1024);
+        for(int shift= 0; shift < 30; shift+= 10)
+        {
+            // compte les codes de chaque bloc
+            std::fill(offsets.begin(), offsets.end(), 0);
+#pragma omp parallel for schedule(static, 1) if(blocks > 1)
+            for(int b= 0; b < blocks; b++)
+            {
+                int *counts= offsets.data() + b * 1024;
+                for(int i= block_begin(0, n, b, blocks); i < block_begin(0, n, b+1, blocks); i++)
+                    counts[(m_codes[i] >> shift) & 1023]++;
+            }
+
+            // position du premier code de chaque valeur, dans chaque bloc
+            int position= 0;
+            for(int k= 0; k < 1024; k++)
+            for(int b= 0; b < blocks; b++)
+            {
+                int count= offsets[b * 1024 + k];
+                offsets[b * 1024 + k]= position;
+                position+= count;
+            }
+
+            // recopie les codes a leur place, dans l'ordre, le tri est stable
+#pragma omp parallel for schedule(static, 1) if(blocks > 1)
+            for(int b= 0; b < blocks; b++)
+            {
+                int *positions= offsets.data() + b * 1024;
+                for(int i= block_begin(0, n, b, blocks); i < block_begin(0, n, b+1, blocks); i++)
+                {
+                    int k= positions[(m_codes[i] >> shift) & 1023]++;
+                    codes[k]= m_codes[i];
+                    refs[k]= m_refs[i];
+                }
+            }
+
+            std::swap(codes, m_codes);
+            std::swap(refs, m_refs);
+        }
+    }
+
+    static int leading_zeros( const unsigned int x )
+    {
+#ifdef __GNUC__
+        return x ? __builtin_clz(x) : 32;
+#else
+        int n= 0;
+        for(unsigned int bit= 1u << 31; bit && !(x & bit); bit>>= 1)
+            n++;
+        return n;
+#endif
+    }
+
+    // longueur du prefixe commun des codes tries i et j, ou -1 si j n'existe pas. les codes identiques sont departages par leur indice.
+    int prefix( const int i, const int j ) const
+    {
+        if(j < 0 || j >= int(m_codes.size()))
+            return -1;
+
+        if(m_codes[i] == m_codes[j])
+            return 32 + leading_zeros(unsigned(i ^ j));
+        return leading_zeros(m_codes[i] ^ m_codes[j]);
+    }
+
+    // construit chaque noeud interne independamment des autres, cf Karras 2012
+    void build_hierarchy( )
+    {
+        const int n= int(m_codes.size());
+#pragma omp parallel for schedule(static, 4096)
+        for(int i= 0; i < n -1; i++)
+        {
+            // direction de l'intervalle du noeud : vers le voisin qui partage le plus long prefixe
+            int d= (prefix(i, i+1) - prefix(i, i-1)) > 0 ? 1 : -1;
+
+            // borne de la longueur de l'intervalle
+            int pmin= prefix(i, i - d);
+            int lmax= 2;
+            while(prefix(i, i + lmax*d) > pmin)
+                lmax*= 2;
+
+            // recherche dichotomique de l'autre extremite de l'intervalle
+            int l= 0;
+            for(int t= lmax / 2; t >= 1; t/= 2)
+                if(prefix(i, i + (l + t)*d) > pmin)
+                    l+= t;
+            int j= i + l*d;
+
+            // recherche dichotomique de la separation : le dernier code qui partage le prefixe du noeud + 1 bit
+            int pnode= prefix(i, j);
+            int s= 0;
+            int t= l;
+            do
+            {
+                t= (t + 1) / 2;
+                if(prefix(i, i + (s + t)*d) > pnode)
+                    s+= t;
+            }
+            while(t > 1);
+            int split= i + s*d + std::min(d, 0);
+
+            // les fils sont des feuilles, si leur intervalle ne contient qu'un seul code
+            int left= (std::min(i, j) == split) ? n-1 + split : split;
+            int right= (std::max(i, j) == split +1) ? n-1 + split +1 : split +1;
+
+            m_lnodes[i].left= left;
+            m_lnodes[i].right= right;
+            m_lnodes[left].parent= i;
+            m_lnodes[right].parent= i;
+        }
+    }
+
+    // cout d'un sous arbre : tester les 2 fils, ou toutes ses primitives, si le sous arbre peut devenir une feuille, cf stats()
+    float node_cost( const float area, const int count, const float children_cost ) const
+    {
+        float cost= 2 * options.box_cost * area + children_cost;
+        if(count <= options.leaf_max)
+            cost= std::min(cost, leaf_cost(area, count));
+        return cost;
+    }
+
+    float leaf_cost( const float area, const int count ) const
+    {
+        return options.primitive_cost * area * count;
+    }
+
+    void update_node( const int index )
+    {
+        LBVHNode& node= m_lnodes[index];
+        const LBVHNode& left= m_lnodes[node.left];
+        const LBVHNode& right= m_lnodes[node.right];
+
+        node.bounds= BBox(left.bounds, right.bounds);
+        node.count= left.count + right.count;
+        node.cost= node_cost(node.bounds.area(), node.count, left.cost + right.cost);
+    }
+
+    // englobants des noeuds, des feuilles vers la racine : le dernier fils qui arrive sur un noeud le termine
+    void build_bounds( )
+    {
+        const int n= int(m_codes.size());
+        std::unique_ptr<std::atomic<int>[]> visits(new std::atomic<int>[n]);
+        for(int i= 0; i < n; i++)
+            visits[i]= 0;
+
+#pragma omp parallel for schedule(static, 1024)
+        for(int i= 0; i < n; i++)
+        {
+            LBVHNode& leaf= m_lnodes[n-1 + i];
+            leaf.bounds= m_boxes[m_refs[i]];
+            leaf.count= 1;
+            leaf.cost= leaf_cost(leaf.bounds.area(), 1);
+
+            for(int index= leaf.parent; index != -1; index= m_lnodes[index].parent)
+            {
+                if(visits[index].fetch_add(1) == 0)
+                    break;      // l'autre fils n'est pas termine
+
+                update_node(index);
+                // les treelets plus petits sont des feuilles, ou presque...
+                if(options.treelet && m_lnodes[index].count >= TREELET_LEAVES * options.leaf_max)
+                    optimize_treelet(index);
+            }
+        }
+    }
+
+    /* reorganise le treelet de 7 feuilles sous le noeud index, si un autre arbre est moins couteux, cf Karras, Aila 2013.
+        les feuilles du treelet sont des sous arbres deja termines, le treelet est forme en remplacant la feuille de plus grande aire par ses fils.
+     */
+    void optimize_treelet( const int index )
+    {
+        const int internal_count= int(m_codes.size()) -1;
+
+        int leaves[TREELET_LEAVES];
+        int internals[TREELET_LEAVES -1];
+        int leaf_count= 2;
+        int internals_count= 1;
+        leaves[0]= m_lnodes[index].left;
+        leaves[1]= m_lnodes[index].right;
+        internals[0]= index;
+        while(leaf_count < TREELET_LEAVES)
+        {
+            int k= -1;
+            float area_max= -1;
+            for(int i= 0; i < leaf_count; i++)
+            {
+                float area= m_lnodes[leaves[i]].bounds.area();
+                if(leaves[i] < internal_count && area > area_max)
+                {
+                    area_max= area;
+                    k= i;
+                }
+            }
+            if(k == -1)
+                break;
+
+            int expand= leaves[k];
+            internals[internals_count++]= expand;
+            leaves[k]= m_lnodes[expand].left;
+            leaves[leaf_count++]= m_lnodes[expand].right;
+        }
+
+        // cout optimal de chaque sous ensemble de feuilles, les sous ensembles d'un ensemble s sont plus petits que s
+        const int subsets= 1 << leaf_count;
+        BBox bounds[1 << TREELET_LEAVES];
+        float cost[1 << TREELET_LEAVES];
+        int count[1 << TREELET_LEAVES];
+        unsigned char partitions[1 << TREELET_LEAVES];
+        for(int i= 0; i < leaf_count; i++)
+        {
+            bounds[1 << i]= m_lnodes[leaves[i]].bounds;
+            count[1 << i]= m_lnodes[leaves[i]].count;
+            cost[1 << i]= m_lnodes[leaves[i]].cost;
+        }
+
+        for(int s= 1; s < subsets; s++)
+        {
+            int first= s & -s;
+            if(s == first)
+                continue;       // une seule feuille
+
+            // englobant de s : premiere feuille + le reste, deja calcule
+            bounds[s]= BBox(bounds[first], bounds[s ^ first]);
+            count[s]= count[first] + count[s ^ first];
+
+            // evalue chaque partition de s en 2 sous ensembles, une seule fois : p contient la premiere feuille de s
+            const int rest= s ^ first;
+            float cost_min= FLT_MAX;
+            int partition= 0;
+            for(int q= (rest -1) & rest; ; q= (q -1) & rest)
+            {
+                int p= q | first;
+                float c= cost[p] + cost[s ^ p];
+                if(c < cost_min)
+                {
+                    cost_min= c;
+                    partition= p;
+                }
+
+                if(q == 0)
+                    break;
+            }
+
+            cost[s]= node_cost(bounds[s].area(), count[s], cost_min);
+            partitions[s]= (unsigned char) partition;
+        }
+
+        if(cost[subsets -1] >= m_lnodes[index].cost)
+            return;     // pas mieux...
+
+        // reconstruit le treelet, en reutilisant ses noeuds internes
+        int next= 0;
+        rebuild_treelet(subsets -1, leaves, leaf_count, internals, next, partitions);
+        assert(next == internals_count);
+    }
+
+    int rebuild_treelet( const int s, const int *leaves, const int leaf_count, const int *internals, int& next, const unsigned char *partitions )
+    {
+        if((s & (s -1)) == 0)
+        {
+            for(int i= 0; i < leaf_count; i++)
+                if(s == (1 << i))
+                    return leaves[i];
+        }
+
+        int index= internals[next++];
+        int left= rebuild_treelet(partitions[s], leaves, leaf_count, internals, next, partitions);
+        int right= rebuild_treelet(s ^ partitions[s], leaves, leaf_count, internals, next, partitions);
+
+        m_lnodes[index].left= left;
+        m_lnodes[index].right= right;
+        m_lnodes[left].parent= index;
+        m_lnodes[right].parent= index;
+        update_node(index);
+        return index;
+    }
+
+    // range les primitives du sous arbre lbvh index a partir de k, renvoie la position suivante
+    int gather_lbvh( const int index, int k )
+    {
+        const int internal_count= int(m_codes.size()) -1;
+        if(index >= internal_count)
+        {
+            m_tmp[k]= m_refs[index - internal_count];
+            return k +1;
+        }
+
+        k= gather_lbvh(m_lnodes[index].left, k);
+        return gather_lbvh(m_lnodes[index].right, k);
+    }
+
+    // recopie le sous arbre lbvh index dans nodes, a partir du noeud slot, cf build_top(). ses primitives sont rangees a partir de offset.
+    void emit_lbvh( const int slot, const int index, const int offset )
+    {
+        const int internal_count= int(m_codes.size()) -1;
+        const LBVHNode& node= m_lnodes[index];
+        if(index >= internal_count
+        || (node.count <= options.leaf_max && leaf_cost(node.bounds.area(), node.count) <= node.cost))
+        {
+            // feuille, range les primitives du sous arbre
+            int end= gather_lbvh(index, offset);
+            set_node(slot, make_leaf(node.bounds, offset, end));
+            return;
+        }
+
+        int left_count= m_lnodes[node.left].count;
+        int left= slot +1;
+        int right= slot + 2*left_count;
+        set_node(slot, make_node(node.bounds, left, right));
+
+#if defined(_OPENMP) && _OPENMP >= 200805
+        if(left_count > TASK_MIN)
+        {
+            const int node_left= node.left;
+#pragma omp task firstprivate(left, node_left, offset)
+            emit_lbvh(left, node_left, offset);
+        }
+        else
+#endif
+            emit_lbvh(left, node.left, offset);
+
+        emit_lbvh(right, node.right, offset + left_count);
+    }
+
+    // supprime les noeuds inutilises, conserve leur ordre
+    void compact( )
+    {
+        const int count= int(nodes.size());
+        std::vector<int> remap(count);
+        int next= 0;
+        for(int i= 0; i < count; i++)
+        {
+            remap[i]= next;
+            next+= m_used[i];
+        }
+
+        std::vector<Node> compacted(next);
+#pragma omp parallel for schedule(static, 4096)
+        for(int i= 0; i < count; i++)
+        {
+            if(m_used[i] == 0)
+                continue;
+
+            Node node= nodes[i];
+            if(node.internal())
+            {
+                node.left= remap[node.left];
+                node.right= remap[node.right];
+            }
+            compacted[remap[i]]= node;
+        }
+
+        std::swap(nodes, compacted);
+        m_used= std::vector<unsigned char>();
+    }
+
+    // englobant des primitives et englobant de leurs centres
+    void node_bounds( const int begin, const int end, BBox& bounds, BBox& cbounds, const bool parallel )
+    {
+        bounds= EmptyBox();
+        cbounds= EmptyBox();
+
+        const int blocks= parallel ? thread_blocks() : 1;
+        if(blocks == 1)
+        {
+            for(int i= begin; i < end; i++)
+            {
+                bounds.insert(m_boxes[m_refs[i]]);
+                cbounds.insert(m_centroids[m_refs[i]]);
+            }
+            return;
+        }
+
+        std::vector<BBox> block_bounds(2*blocks, EmptyBox());
+#pragma omp parallel for schedule(static, 1)
+        for(int b= 0; b < blocks; b++)
+        {
+            int first= begin + int(size_t(end - begin) * b / blocks);
+            int last= begin + int(size_t(end - begin) * (b+1) / blocks);
+            for(int i= first; i < last; i++)
+            {
+                block_bounds[2*b].insert(m_boxes[m_refs[i]]);
+                block_bounds[2*b+1].insert(m_centroids[m_refs[i]]);
+            }
+        }
+
+        for(int b= 0; b < blocks; b++)
+        {
+            bounds.insert(block_bounds[2*b]);
+            cbounds.insert(block_bounds[2*b+1]);
+        }
+    }
+
+    // repartit les primitives [begin .. end). renvoie l'indice de la premiere primitive du fils droit, ou -1 s'il vaut mieux construire une feuille.
+    int split( const BBox& bounds, const BBox& cbounds, const int begin, const int end, const bool parallel )
+    {
+        const int n= end - begin;
+        if(n == 1)
+            return -1;
+
+        int m= -1;
+        if(options.builder == BVH_SAH)
+        {
+            if(!split_sah(bounds, cbounds, begin, end, parallel, m))
+                return -1;
+        }
+        else
+        {
+            if(n <= options.leaf_max)
+                return -1;
+
+            m= split_midpoint(cbounds, begin, end, parallel);
+        }
+
+        // la repartition peut echouer, et toutes les primitives sont du meme cote...
+        if(m == begin || m == end)
+        {
+            if(n <= options.leaf_max)
+                return -1;
+
+            // forcer quand meme un decoupage en 2 ensembles de meme taille
+            m= split_median(cbounds, begin, end);
+        }
+        assert(m != begin);
+        assert(m != end);
+        return m;
+    }
+
+    /* repartit les primitives [begin .. end) en 2 groupes, predicate(id) == true puis false. renvoie l'indice de la premiere primitive du 2ieme groupe.
+        en parallele : repartition stable, chaque bloc compte ses primitives, puis les recopie a leur place.
+     */
+    template < typename Predicate >
+    int partition( const int begin, const int end, const Predicate& predicate, const bool parallel )
+    {
+        const int blocks= parallel ? thread_blocks() : 1;
+        if(!parallel)
+        {
+            int *pm= std::partition(m_refs.data() + begin, m_refs.data() + end, predicate);
+            return int(std::distance(m_refs.data(), pm));
+        }
+
+        // compte les primitives du 1er groupe dans chaque bloc
+        std::vector<int> counts(blocks);
+#pragma omp parallel for schedule(static, 1)
+        for(int b= 0; b < blocks; b++)
+        {
+            int first= begin + int(size_t(end - begin) * b / blocks);
+            int last= begin + int(size_t(end - begin) * (b+1) / blocks);
+            int count= 0;
+            for(int i= first; i < last; i++)
+            {
+                m_flags[i]= predicate(m_refs[i]) ? 1 : 0;
+                count+= m_flags[i];
+            }
+            counts[b]= count;
+        }
+
+        int m= begin;
+        for(int b= 0; b < blocks; b++)
+            m+= counts[b];
+
+        // recopie les primitives de chaque bloc apres celles des blocs precedents
+#pragma omp parallel for schedule(static, 1)
+        for(int b= 0; b < blocks; b++)
+        {
+            int first= begin + int(size_t(end - begin) * b / blocks);
+            int last= begin + int(size_t(end - begin) * (b+1) / blocks);
+
+            int left= begin;
+            int right= m;
+            for(int k= 0; k < b; k++)
+            {
+                int block_first= begin + int(size_t(end - begin) * k / blocks);
+                int block_last= begin + int(size_t(end - begin) * (k+1) / blocks);
+                left+= counts[k];
+                right+= (block_last - block_first) - counts[k];
+            }
+
+            for(int i= first; i < last; i++)
+            {
+                if(m_flags[i])
+                    m_tmp[left++]= m_refs[i];
+                else
+                    m_tmp[right++]= m_refs[i];
+            }
+        }
+
+#pragma omp parallel for schedule(static, 4096)
+        for(int i= begin; i < end; i++)
+            m_refs[i]= m_tmp[i];
+
+        return m;
+    }
+
+    // axe le plus etire d'un englobant
+    static int longest_axis( const BBox& bounds )
+    {
+        Vector d= Vector(bounds.pmin, bounds.pmax);
+        if(d.x > d.y && d.x > d.z)  // x plus grand que y et z ?
+            return 0;
+        else if(d.y > d.z)          // y plus grand que z ? (et que x implicitement)
+            return 1;
+        else                        // x et y ne sont pas les plus grands...
+            return 2;
+    }
+
+    // coupe l'englobant des centres au milieu de son axe le plus etire
+    int split_midpoint( const BBox& cbounds, const int begin, const int end, const bool parallel )
+    {
+        int axis= longest_axis(cbounds);
+        float cut= cbounds.centroid(axis);
+
+        const Point *centroids= m_centroids.data();
+        return partition(begin, end,
+            [centroids, axis, cut]( const int id )
+            {
+                return centroids[id](axis) < cut;
+            },
+            parallel
+        );
+    }
+
+    // repartit le meme nombre de primitives dans chaque fils
+    int split_median( const BBox& cbounds, const int begin, const int end )
+    {
+        int axis= longest_axis(cbounds);
+        int m= (begin + end) / 2;
+
+        const Point *centroids= m_centroids.data();
+        std::nth_element(m_refs.data() + begin, m_refs.data() + m, m_refs.data() + end,
+            [centroids, axis]( const int a, const int b )
+            {
+                return centroids[a](axis) < centroids[b](axis);
+            }
+        );
+        return m;
+    }
+
+    // indice de la cellule de l'histogramme qui contient c
+    static int bin_index( const float c, const float cmin, const float scale, const int bins )
+    {
+        int k= int((c - cmin) * scale);
+        // attention aux calculs sur les floats... verifier que k est bien un indice de cellule
+        if(k < 0) k= 0;
+        if(k >= bins) k= bins -1;
+        return k;
+    }
+
+    // histogrammes des centres des primitives [begin .. end) sur les 3 axes
+    void bin( const int begin, const int end, const BBox& cbounds, const float scale[3], Bin *histograms, const bool parallel )
+    {
+        const int bins= options.bins;
+        for(int k= 0; k < 3*bins; k++)
+        {
+            histograms[k].bounds= EmptyBox();
+            histograms[k].n= 0;
+        }
+
+        const int blocks= parallel ? thread_blocks() : 1;
+        if(blocks == 1)
+        {
+            for(int i= begin; i < end; i++)
+            {
+                int id= m_refs[i];
+                for(int axis= 0; axis < 3; axis++)
+                {
+                    Bin& bin= histograms[axis*bins + bin_index(m_centroids[id](axis), cbounds.pmin(axis), scale[axis], bins)];
+                    bin.bounds.insert(m_boxes[id]);
+                    bin.n++;
+                }
+            }
+            return;
+        }
+
+        // un histogramme par bloc, puis regroupe les histogrammes
+        std::vector<Bin> block_histograms(blocks * 3*bins, Bin{EmptyBox(), 0});
+#pragma omp parallel for schedule(static, 1)
+        for(int b= 0; b < blocks; b++)
+        {
+            Bin *block= block_histograms.data() + b * 3*bins;
+            int first= begin + int(size_t(end - begin) * b / blocks);
+            int last= begin + int(size_t(end - begin) * (b+1) / blocks);
+            for(int i= first; i < last; i++)
+            {
+                int id= m_refs[i];
+                for(int axis= 0; axis < 3; axis++)
+                {
+                    Bin& bin= block[axis*bins + bin_index(m_centroids[id](axis), cbounds.pmin(axis), scale[axis], bins)];
+                    bin.bounds.insert(m_boxes[id]);
+                    bin.n++;
+                }
+            }
+        }
+
+        for(int b= 0; b < blocks; b++)
+        for(int k= 0; k < 3*bins; k++)
+        {
+            histograms[k].bounds.insert(block_histograms[b * 3*bins + k].bounds);
+            histograms[k].n+= block_histograms[b * 3*bins + k].n;
+        }
+    }
+
+    /* evalue les repartitions sur un histogramme des centres, sur chaque axe, cf sah.txt.
+        renvoie faux s'il vaut mieux construire une feuille, sinon repartit les primitives, m est l'indice de la premiere primitive du fils droit.
+     */
+    bool split_sah( const BBox& bounds, const BBox& cbounds, const int begin, const int end, const bool parallel, int& m )
+    {
+        const int n= end - begin;
+        const int bins= options.bins;
+
+        float area= bounds.area();
+        if(area <= 0)
+            area= 1;
+
+        float scale[3];
+        for(int axis= 0; axis < 3; axis++)
+        {
+            float extent= cbounds.pmax(axis) - cbounds.pmin(axis);
+            scale[axis]= (extent > 0) ? float(bins) / extent : 0;
+        }
+
+        // compte le nombre de primitives par cellule des histogrammes
+        Bin histograms[3*BINS_MAX];
+        bin(begin, end, cbounds, scale, histograms, parallel);
+
+        int min_axis= -1;
+        int min_index= -1;
+        float min_cost= FLT_MAX;
+        for(int axis= 0; axis < 3; axis++)
+        {
+            if(scale[axis] == 0)
+                continue;       // tous les centres sont dans le meme plan...
+
+            const Bin *histogram= histograms + axis*bins;
+
+            // evalue chaque repartition : le fils gauche recupere les cellules [0 .. i), le fils droit [i .. bins)
+            // aire et nombre de primitives des fils droits, de droite a gauche
+            float right_area[BINS_MAX];
+            int right_n[BINS_MAX];
+            BBox right= EmptyBox();
+            int count= 0;
+            for(int i= bins -1; i > 0; i--)
+            {
+                right.insert(histogram[i].bounds);
+                count+= histogram[i].n;
+                right_area[i]= right.area();
+                right_n[i]= count;
+            }
+
+            // et de gauche a droite pour les fils gauches
+            BBox left= EmptyBox();
+            count= 0;
+            for(int i= 1; i < bins; i++)
+            {
+                left.insert(histogram[i-1].bounds);
+                count+= histogram[i-1].n;
+                if(count == 0 || right_n[i] == 0)
+                    continue;
+
+                float cost= 2 * options.box_cost                                                // 2 tests rayon/boite
+                    + (left.area() * count + right_area[i] * right_n[i]) / area * options.primitive_cost;  // + visites des fils * primitives des fils
+                if(cost < min_cost)
+                {
+                    min_cost= cost;
+                    min_axis= axis;
+                    min_index= i;
+                }
+            }
+        }
+
+        // tester toutes les primitives est moins cher, construire une feuille
+        if(n <= options.leaf_max && n * options.primitive_cost <= min_cost)
+            return false;
+
+        if(min_axis == -1)
+        {
+            // pas de repartition, les centres sont confondus...
+            m= begin;
+            return true;
+        }
+
+        // repartit les primitives
+        float cmin= cbounds.pmin(min_axis);
+        float cscale= scale[min_axis];
+        const Point *centroids= m_centroids.data();
+        m= partition(begin, end,
+            [centroids, min_axis, min_index, cmin, cscale, bins]( const int id )
+            {
+                return bin_index(centroids[id](min_axis), cmin, cscale, bins) < min_index;
+            },
+            parallel
+        );
+        return true;
+    }
+
+    // intersection avec les primitives d'une feuille, par blocs ou une par une
+    void intersect_leaf( const int begin, const int end, const Ray& ray, Hit& hit ) const
+    {
+        if(blocks.intersect(primitives, begin, end, ray, hit))
+            return;
+
+        for(int i= begin; i < end; i++)
+            if(Hit h= primitives[i].intersect(ray, hit.t))
+                hit= h;
+    }
+
+    // intersection et parcours simple
+    void intersect( const int index, const Ray& ray, const Vector& invd, Hit& hit ) const
+    {
+        const Node& node= nodes[index];
+        if(node.bounds.intersect(ray, invd, hit.t))
+        {
+            if(node.leaf())
+                intersect_leaf(node.leaf_begin(), node.leaf_end(), ray, hit);
+            else // if(node.internal())
+            {
+                intersect(node.internal_left(), ray, invd, hit);
+                intersect(node.internal_right(), ray, invd, hit);
+            }
+        }
+    }
+
+    struct PacketItem
+    {
+        int index;      // noeud binaire, ou pere d'un noeud large
+        int child;      // fils du noeud large pere, -1 pour la racine, 0 pour les noeuds binaires
+        int mask;       // rayons actifs
+    };
+
+    static int first_lane( const int mask )
+    {
+        int k= 0;
+        while((mask & (1 << k)) == 0)
+            k++;
+        return k;
+    }
+
+    static int active_count( int mask )
+    {
+        int n= 0;
+        for(; mask; mask&= mask -1)
+            n++;
+        return n;
+    }
+
+    // regroupe les rayons [begin .. end) par octant de leur direction, puis parcours par paquets de 8 rayons de meme octant
+    void intersect_stream( const Ray *rays, const int begin, const int end, Hit *hits, std::vector<PacketItem>& stack, PacketStats& stats ) const
+    {
+        const int W= RayPacket::W;
+
+        // tri par denombrement, conserve l'ordre des rayons dans chaque octant, cf pixels voisins
+        unsigned char octants[STREAM_MAX];
+        int offsets[9]= { };
+        for(int i= begin; i < end; i++)
+        {
+            // signe de la direction, comme le signe de 1 / d, cf -0
+            const Vector& d= rays[i].d;
+            int octant= (std::signbit(d.x) ? 1 : 0) | (std::signbit(d.y) ? 2 : 0) | (std::signbit(d.z) ? 4 : 0);
+            octants[i - begin]= octant;
+            offsets[octant +1]++;
+        }
+        for(int k= 0; k < 8; k++)
+            offsets[k +1]+= offsets[k];
+
+        int ids[STREAM_MAX];
+        for(int i= begin; i < end; i++)
+            ids[offsets[octants[i - begin]]++]= i;
+
+        // les paquets, un changement d'octant termine le paquet
+        const int count= end - begin;
+        for(int i= 0; i < count; )
+        {
+            int octant= octants[ids[i] - begin];
+            int n= 1;
+            while(n < W && i + n < count && octants[ids[i + n] - begin] == octant)
+                n++;
+
+            intersect_packet(rays, ids + i, n, hits, stack, stats);
+            i+= n;
+        }
+    }
+
+    // parcours d'un paquet de n <= 8 rayons, rays[ids[k]], avec une pile et un masque de rayons actifs par noeud
+    void intersect_packet( const Ray *rays, const int *ids, const int n, Hit *hits, std::vector<PacketItem>& stack, PacketStats& stats ) const
+    {
+        const int W= RayPacket::W;
+
+        // directions trop differentes, les rayons ne vont pas visiter les memes noeuds... parcours rayon par rayon
+        float directions[W][3];
+        float mean[3]= { 0, 0, 0 };
+        for(int k= 0; k < n; k++)
+        {
+            const Vector& d= rays[ids[k]].d;
+            float inv_length= 1 / std::sqrt(d.x*d.x + d.y*d.y + d.z*d.z);
+            for(int axis= 0; axis < 3; axis++)
+            {
+                directions[k][axis]= d(axis) * inv_length;
+                mean[axis]+= directions[k][axis];
+            }
+        }
+
+        // cos(mean, d) >= packet_coherence, sans normaliser mean
+        float mean_length= std::sqrt(mean[0]*mean[0] + mean[1]*mean[1] + mean[2]*mean[2]);
+        bool coherent= true;
+        for(int k= 0; k < n; k++)
+            if(mean[0]*directions[k][0] + mean[1]*directions[k][1] + mean[2]*directions[k][2] < options.packet_coherence * mean_length)
+                coherent= false;
+
+        if(!coherent || root < 0)
+        {
+            stats.incoherent++;
+            for(int k= 0; k < n; k++)
+                hits[ids[k]]= intersect(rays[ids[k]], rays[ids[k]].tmax);
+            return;
+        }
+
+        // les directions sont dans le meme octant, cf intersect_stream()
+        RayPacket packet;
+        for(int axis= 0; axis < 3; axis++)
+            packet.sign[axis]= std::signbit(rays[ids[0]].d(axis)) ? 1 : 0;
+
+        for(int k= 0; k < W; k++)
+        {
+            const Ray& ray= rays[ids[std::min(k, n -1)]];
+            for(int axis= 0; axis < 3; axis++)
+            {
+                packet.o[axis][k]= ray.o(axis);
+                packet.invd[axis][k]= 1 / ray.d(axis);
+            }
+            packet.tmax[k]= (k < n) ? ray.tmax : -1;    // rayon inutilise, ne touche aucun englobant
+        }
+
+        for(int k= 0; k < n; k++)
+        {
+            hits[ids[k]]= Hit();
+            hits[ids[k]].t= rays[ids[k]].tmax;
+        }
+
+        stats.packets++;
+        if(options.width == 4 && options.quantized)
+            intersect_packet_wide(qnodes4, rays, ids, n, hits, packet, stack, stats);
+        else if(options.width == 8 && options.quantized)
+            intersect_packet_wide(qnodes8, rays, ids, n, hits, packet, stack, stats);
+        else if(options.width == 4)
+            intersect_packet_wide(nodes4, rays, ids, n, hits, packet, stack, stats);
+        else if(options.width == 8)
+            intersect_packet_wide(nodes8, rays, ids, n, hits, packet, stack, stats);
+        else
+            intersect_packet_binary(rays, ids, n, hits, packet, stack, stats);
+    }
+
+    // parcours d'un paquet, noeuds binaires
+    void intersect_packet_binary( const Ray *rays, const int *ids, const int n, Hit *hits, RayPacket& packet, std::vector<PacketItem>& stack, PacketStats& stats ) const
+    {
+        stack.clear();
+        stack.push_back( { root, 0, (1 << n) -1 } );
+        while(!stack.empty())
+        {
+            PacketItem item= stack.back();
+            stack.pop_back();
+
+            const Node& node= nodes[item.index];
+            int mask= item.mask & packet.intersect(node.bounds);
+            if(mask == 0)
+                continue;
+
+            int count= active_count(mask);
+            stats.visits++;
+            stats.active+= count;
+
+            if(count < options.packet_min)
+            {
+                // plus assez de rayons actifs, finir le sous arbre rayon par rayon
+                for(int k= 0; k < n; k++)
+                    if(mask & (1 << k))
+                    {
+                        Vector invd= Vector(packet.invd[0][k], packet.invd[1][k], packet.invd[2][k]);
+                        intersect(item.index, rays[ids[k]], invd, hits[ids[k]]);
+                        packet.tmax[k]= hits[ids[k]].t;
+                        stats.fallbacks++;
+                    }
+            }
+            else if(node.leaf())
+            {
+                for(int k= 0; k < n; k++)
+                    if(mask & (1 << k))
+                    {
+                        intersect_leaf(node.leaf_begin(), node.leaf_end(), rays[ids[k]], hits[ids[k]]);
+                        packet.tmax[k]= hits[ids[k]].t;
+                    }
+            }
+            else
+            {
+                // visite d'abord le fils le plus proche, dans la direction du premier rayon actif
+                int left= node.internal_left();
+                int right= node.internal_right();
+                const Ray& ray= rays[ids[first_lane(mask)]];
+                Vector d(nodes[left].bounds.centroid(), nodes[right].bounds.centroid());
+                if(dot(d, ray.d) < 0)
+                    std::swap(left, right);
+
+                stack.push_back( { right, 0, mask } );
+                stack.push_back( { left, 0, mask } );
+            }
+        }
+    }
+
+    // parcours d'un paquet, noeuds larges : les englobants des W fils sont testes chacun avec les 8 rayons
+    template < template < int > class N, int W >
+    void intersect_packet_wide( const std::vector<N<W>>& wide, const Ray *rays, const int *ids, const int n, Hit *hits, RayPacket& packet, std::vector<PacketItem>& stack, PacketStats& stats ) const
+    {
+        stack.clear();
+        stack.push_back( { 0, -1, (1 << n) -1 } );
+        while(!stack.empty())
+        {
+            PacketItem item= stack.back();
+            stack.pop_back();
+
+            // teste l'englobant du fils avec les tmax des rayons, raccourcis par les intersections trouvees depuis son insertion dans la pile
+            int mask= item.mask;
+            int index= 0;
+            int leaf= 0;
+            if(item.child >= 0)
+            {
+                const N<W>& parent= wide[item.index];
+                mask&= packet.intersect(parent.child_bounds(item.child));
+                if(mask == 0)
+                    continue;
+
+                index= parent.child_index(item.child);
+                leaf= parent.child_count(item.child);
+            }
+
+            int count= active_count(mask);
+            stats.visits++;
+            stats.active+= count;
+
+            if(leaf > 0)
+            {
+                for(int k= 0; k < n; k++)
+                    if(mask & (1 << k))
+                    {
+                        intersect_leaf(index, index + leaf, rays[ids[k]], hits[ids[k]]);
+                        packet.tmax[k]= hits[ids[k]].t;
+                    }
+            }
+            else if(count < options.packet_min)
+            {
+                // plus assez de rayons actifs, finir le sous arbre rayon par rayon
+                for(int k= 0; k < n; k++)
+                    if(mask & (1 << k))
+                    {
+                        intersect_wide(wide, rays[ids[k]], hits[ids[k]], index);
+                        packet.tmax[k]= hits[ids[k]].t;
+                        stats.fallbacks++;
+                    }
+            }
+            else
+            {
+                // trie les fils touches, du plus loin au plus proche, dans la direction du premier rayon actif. leurs englobants seront re-testes en sortant de la pile
+                const N<W>& node= wide[index];
+                const Ray& ray= rays[ids[first_lane(mask)]];
+
+                int children[W];
+                int masks[W];
+                float keys[W];
+                int m= 0;
+                for(int c= 0; c < W; c++)
+                {
+                    if(node.child_empty(c))
+                        continue;
+
+                    BBox bounds= node.child_bounds(c);
+                    int child_mask= mask & packet.intersect(bounds);
+                    if(child_mask == 0)
+                        continue;
+
+                    float key= (bounds.pmin.x + bounds.pmax.x) * ray.d.x + (bounds.pmin.y + bounds.pmax.y) * ray.d.y + (bounds.pmin.z + bounds.pmax.z) * ray.d.z;
+                    int i= m++;
+                    for(; i > 0 && keys[i-1] < key; i--)
+                    {
+                        children[i]= children[i-1];
+                        masks[i]= masks[i-1];
+                        keys[i]= keys[i-1];
+                    }
+                    children[i]= c;
+                    masks[i]= child_mask;
+                    keys[i]= key;
+                }
+
+                // le plus proche sur le dessus de la pile
+                for(int i= 0; i < m; i++)
+                    stack.push_back( { index, children[i], masks[i] } );
+            }
+        }
+    }
+
+    // occultation par les primitives d'une feuille, par blocs ou une par une
+    bool occluded_leaf( const int begin, const int end, const Ray& ray, const float htmax ) const
+    {
+        bool result;
+        if(blocks.occluded(primitives, begin, end, ray, htmax, result))
+            return result;
+
+        for(int i= begin; i < end; i++)
+            if(primitives[i].occluded(ray, htmax))
+                return true;
+
+        return false;
+    }
+
+    // occultation et parcours simple, s'arrete sur la premiere intersection
+    bool occluded( const int index, const Ray& ray, const Vector& invd, const float htmax ) const
+    {
+        const Node& node= nodes[index];
+        if(!node.bounds.intersect(ray, invd, htmax))
+            return false;
+
+        if(node.leaf())
+            return occluded_leaf(node.leaf_begin(), node.leaf_end(), ray, htmax);
+        else
+            return occluded(node.internal_left(), ray, invd, htmax) || occluded(node.internal_right(), ray, invd, htmax);
+    }
+
+    // selectionne les fils du noeud large qui regroupe le noeud index et ses descendants, renvoie leur nombre
+    template < int W >
+    int collapse_children( const int index, int children[W] ) const
+    {
+        // ouvre le fils interne de plus grande aire, tant qu'il reste de la place
+        int n= 0;
+        if(nodes[index].leaf())
+            children[n++]= index;
+        else
+        {
+            children[n++]= nodes[index].internal_left();
+            children[n++]= nodes[index].internal_right();
+        }
+
+        while(n < W)
+        {
+            int k= -1;
+            float area_max= -1;
+            for(int i= 0; i < n; i++)
+            {
+                float area= nodes[children[i]].bounds.area();
+                if(nodes[children[i]].internal() && area > area_max)
+                {
+                    area_max= area;
+                    k= i;
+                }
+            }
+            if(k == -1)
+                break;
+
+            int open= children[k];
+            children[k]= nodes[open].internal_left();
+            children[n++]= nodes[open].internal_right();
+        }
+
+        return n;
+    }
+
+    // construit le noeud large qui regroupe le noeud index et ses descendants, renvoie son indice
+    template < int W >
+    int collapse_node( std::vector<WideNode<W>>& wide, const int index, const int depth, int& depth_max )
+    {
+        depth_max= std::max(depth_max, depth);
+
+        int children[W];
+        int n= collapse_children<W>(index, children);
+
+        // attention : wide est modifie par la recursion, pas de reference sur le noeud...
+        int id= int(wide.size());
+        wide.push_back( WideNode<W>() );
+
+        for(int k= 0; k < W; k++)
+        {
+            BBox bounds= EmptyBox();
+            int child= -1;
+            int count= 0;
+            if(k < n)
+            {
+                const Node& node= nodes[children[k]];
+                bounds= node.bounds;
+                if(node.leaf())
+                {
+                    child= node.leaf_begin();
+                    count= node.leaf_end() - node.leaf_begin();
+                }
+                else
+                    child= collapse_node(wide, children[k], depth +1, depth_max);
+            }
+
+            for(int axis= 0; axis < 3; axis++)
+            {
+                wide[id].bounds[0][axis][k]= bounds.pmin(axis);
+                wide[id].bounds[1][axis][k]= bounds.pmax(axis);
+            }
+            wide[id].child[k]= child;
+            wide[id].count[k]= count;
+        }
+
+        return id;
+    }
+
+    /* construit le noeud compresse slot qui regroupe le noeud index et ses descendants, avec les memes fils que collapse_node().
+        les fils internes sont ranges a la suite a la fin de qnodes, les primitives des feuilles a la suite dans order, et les feuilles des noeuds binaires sont renumerotees.
+     */
+    template < int W >
+    void quantize_node( std::vector<QuantizedNode<W>>& qnodes, const int slot, const int index, const int depth, int& depth_max, std::vector<int>& order )
+    {
+        depth_max= std::max(depth_max, depth);
+
+        int children[W];
+        int n= collapse_children<W>(index, children);
+        // les fils internes d'abord
+        std::stable_partition(children, children + n, [&]( const int c ) { return nodes[c].internal(); });
+
+        QuantizedNode<W> node;
+        memset(&node, 0, sizeof(node));
+        node.child= int(qnodes.size());
+        node.primitive= int(order.size());
+
+        // pas de quantification : la plus petite puissance de 2 telle que 255 pas couvrent l'englobant
+        const BBox& bounds= nodes[index].bounds;
+        double origin[3], scale[3];
+        for(int axis= 0; axis < 3; axis++)
+        {
+            int e= 0;
+            std::frexp((double(bounds.pmax(axis)) - double(bounds.pmin(axis))) / 255, &e);
+            e= std::max(-126, std::min(127, e));
+            node.origin[axis]= bounds.pmin(axis);
+            node.exponent[axis]= (signed char) e;
+            origin[axis]= bounds.pmin(axis);
+            scale[axis]= std::ldexp(1.0, e);
+        }
+
+        int internals= 0;
+        for(int k= 0; k < W; k++)
+        {
+            if(k >= n)
+            {
+                // fils inutilise, englobant vide
+                for(int axis= 0; axis < 3; axis++)
+                {
+                    node.bounds[0][axis][k]= 1;
+                    node.bounds[1][axis][k]= 0;
+                }
+                continue;
+            }
+
+            // arrondis vers l'exterieur, l'englobant quantifie contient l'englobant du fils
+            node.used|= 1 << k;
+            Node& child= nodes[children[k]];
+            for(int axis= 0; axis < 3; axis++)
+            {
+                double qmin= std::floor((double(child.bounds.pmin(axis)) - origin[axis]) / scale[axis]);
+                double qmax= std::ceil((double(child.bounds.pmax(axis)) - origin[axis]) / scale[axis]);
+                node.bounds[0][axis][k]= (unsigned char) std::max(0.0, std::min(255.0, qmin));
+                node.bounds[1][axis][k]= (unsigned char) std::max(0.0, std::min(255.0, qmax));
+            }
+
+            if(child.internal())
+            {
+                internals++;
+                continue;
+            }
+
+            int begin= child.leaf_begin();
+            int end= child.leaf_end();
+            node.count[k]= (unsigned char) (end - begin);
+            int first= int(order.size());
+            for(int i= begin; i < end; i++)
+                order.push_back(i);
+            child= make_leaf(child.bounds, first, first + end - begin);
+        }
+
+        // attention : qnodes est modifie par la recursion, pas de reference sur le noeud...
+        qnodes.resize(qnodes.size() + internals);
+        qnodes[slot]= node;
+        for(int k= 0; k < internals; k++)
+            quantize_node(qnodes, node.child + k, children[k], depth +1, depth_max, order);
+    }
+
+    // construit les noeuds compresses et range les primitives dans l'ordre de leurs feuilles. renvoie la profondeur de l'arbre, ou -1 si une feuille est trop grosse.
+    template < int W >
+    int quantize( std::vector<QuantizedNode<W>>& qnodes )
+    {
+        for(unsigned i= 0; i < nodes.size(); i++)
+            if(nodes[i].leaf() && nodes[i].leaf_end() - nodes[i].leaf_begin() > 255)
+            {
+                printf("[error] bvh: leaf with %d primitives, can't use quantized nodes...\n", nodes[i].leaf_end() - nodes[i].leaf_begin());
+                return -1;
+            }
+
+        std::vector<int> order;
+        order.reserve(primitives.size());
+        qnodes.assign(1, QuantizedNode<W>());
+
+        int depth= 0;
+        quantize_node(qnodes, 0, root, 1, depth, order);
+
+        const std::vector<T> tmp= primitives;
+        const std::vector<int> tmp_order= m_order;
+        const int n= int(order.size());
+#pragma omp parallel for schedule(static, 4096)
+        for(int i= 0; i < n; i++)
+        {
+            primitives[i]= tmp[order[i]];
+            m_order[i]= tmp_order[order[i]];
+        }
+
+        return depth;
+    }
+
+    // parcours des noeuds larges, du plus proche au plus loin, avec une pile. a partir de la racine ou d'un autre noeud, cf intersect_packet_wide()
+    template < template < int > class N, int W >
+    void intersect_wide( const std::vector<N<W>>& wide, const Ray& ray, Hit& hit, const int start= 0 ) const
+    {
+        struct Item
+        {
+            int child;
+            int count;
+            float t;    // entree dans l'englobant
+        };
+
+        WideRay wray(ray);
+        Item stack[STACK_MAX];
+        int top= 0;
+        stack[top++]= { start, 0, 0 };
+        while(top > 0)
+        {
+            Item item= stack[--top];
+            if(item.t > hit.t)
+                continue;       // le fils est derriere l'intersection la plus proche...
+
+            if(item.count > 0)
+            {
+                intersect_leaf(item.child, item.child + item.count, ray, hit);
+                continue;
+            }
+
+            const N<W>& node= wide[item.child];
+            float tmin[W];
+            int hits= intersect_children(node, wray, hit.t, tmin);
+
+            // trie les fils touches, du plus loin au plus proche
+            Item items[W];
+            int n= 0;
+            for(int k= 0; k < W; k++)
+            {
+                if((hits & (1 << k)) == 0)
+                    continue;
+
+                Item child= { node.child_index(k), node.child_count(k), tmin[k] };
+                int i= n++;
+                for(; i > 0 && items[i-1].t < child.t; i--)
+                    items[i]= items[i-1];
+                items[i]= child;
+            }
+
+            // le plus proche sur le dessus de la pile
+            for(int i= 0; i < n; i++)
+                stack[top++]= items[i];
+        }
+    }
+
+    // occultation et parcours des noeuds larges, sans trier les fils, s'arrete sur la premiere intersection
+    template < template < int > class N, int W >
+    bool occluded_wide( const std::vector<N<W>>& wide, const Ray& ray, const float htmax ) const
+    {
+        struct Item
+        {
+            int child;
+            int count;
+        };
+
+        WideRay wray(ray);
+        Item stack[STACK_MAX];
+        int top= 0;
+        stack[top++]= { 0, 0 };
+        while(top > 0)
+        {
+            Item item= stack[--top];
+            if(item.count > 0)
+            {
+                if(occluded_leaf(item.child, item.child + item.count, ray, htmax))
+                    return true;
+                continue;
+            }
+
+            const N<W>& node= wide[item.child];
+            float tmin[W];
+            int hits= intersect_children(node, wray, htmax, tmin);
+            for(int k= 0; k < W; k++)
+                if(hits & (1 << k))
+                    stack[top++]= { node.child_index(k), node.child_count(k) };
+        }
+
+        return false;
+    }
+
+    // indice des primitives dans le tableau initial, dans l'ordre des feuilles, cf refit()
+    std::vector<int> m_order;
+
+    // donnees temporaires de construction
+    std::vector<int> m_refs;
+    std::vector<BBox> m_boxes;
+    std::vector<Point> m_centroids;
+    std::vector<unsigned char> m_flags;
+    std::vector<int> m_tmp;
+    std::vector<unsigned char> m_used;
+    std::vector<unsigned int> m_codes;
+    std::vector<LBVHNode> m_lnodes;
+};
+
+
+//! triangle pour le bvh, cf fonction bounds() et intersect().
+struct Triangle
+{
+    Point a, b, c;      //!< sommets du triangle. cf TriangleBlock pour pre-calculer les aretes.
+    int mesh_id;
+    int primitive_id;
+    int triangle_id;
+
+    Triangle( const TriangleData& data, const int _id ) : a(data.a), b(data.b), c(data.c),
+        mesh_id(-1), primitive_id(-1), triangle_id(_id) {}
+
+    Triangle( const vec3& _a, const vec3& _b, const vec3& _c, const int _id ) :
+        a(_a), b(_b), c(_c),
+        mesh_id(-1), primitive_id(-1), triangle_id(_id) {}
+
+    Triangle( const vec3& _a, const vec3& _b, const vec3& _c, const int _mesh_id, const int _primitive_id, const int _id ) :
+        a(_a), b(_b), c(_c),
+        mesh_id(_mesh_id), primitive_id(_primitive_id), triangle_id(_id) {}
+
+    /*! calcule l'intersection ray/triangle
+        cf "fast, minimum storage ray-triangle intersection"
+
+        renvoie faux s'il n'y a pas d'intersection valide (une intersection peut exister mais peut ne pas se trouver dans l'intervalle [0 tmax] du rayon.)
+        renvoie vrai + les coordonnees barycentriques (u, v) du point d'intersection + sa position le long du rayon (t).
+        convention barycentrique : p(u, v)= (1 - u - v) * a + u * b + v * c
+    */
+    Hit intersect( const Ray &ray, const float htmax ) const
+    {
+        Vector e1(a, b);
+        Vector e2(a, c);
+        Vector pvec= cross(ray.d, e2);
+        float det= dot(e1, pvec);
+
+        float inv_det= 1 / det;
+        Vector tvec(a, ray.o);
+
+        // les tests rejettent aussi les NaN, cf triangles degeneres, det == 0
+        float u= dot(tvec, pvec) * inv_det;
+        if(!(u >= 0 && u <= 1)) return Hit();
+
+        Vector qvec= cross(tvec, e1);
+        float v= dot(ray.d, qvec) * inv_det;
+        if(!(v >= 0 && u + v <= 1)) return Hit();
+
+        float t= dot(e2, qvec) * inv_det;
+        if(!(t >= 0 && t <= htmax)) return Hit();
+
+        return Hit(t, u, v, mesh_id, primitive_id, triangle_id);
+    }
+
+    //! renvoie vrai si le rayon touche le triangle entre 0 et htmax.
+    bool occluded( const Ray &ray, const float htmax ) const { return bool(intersect(ray, htmax)); }
+
+    BBox bounds( ) const
+    {
+        BBox box(a);
+        return box.insert(b).insert(c);
+    }
+};
+
+
+/*! bloc de W triangles d'une feuille, coordonnees rangees par axe, pour tester tous les triangles du bloc en meme temps, cf BVHOptions::leaf_block.
+    test de Moller-Trumbore : sommet a et aretes ab, ac, pre-calculees. test watertight : sommets a, b, c.
+    les triangles inutilises sont des NaN, tous les tests echouent et ils ne sont jamais touches.
+ */
+template < int W >
+struct TriangleBlock
+{
+    float v[3][3][W];   //!< v[sommet ou arete][axe][triangle].
+    int index[W];       //!< indice du triangle, -1 si inutilise.
+};
+
+//! remplit un bloc avec les triangles [first .. first + n), n <= W.
+template < int W >
+void make_block( TriangleBlock<W>& block, const Triangle *triangles, const int first, const int n, const bool watertight )
+{
+    for(int k= 0; k < W; k++)
+    {
+        // un triangle degenere peut etre touche, a cause des erreurs d'arrondi dans les fonctions d'aretes...
+        Point a(NAN, NAN, NAN), b= a, c= a;
+        if(k < n)
+        {
+            const Triangle& triangle= triangles[first + k];
+            a= triangle.a;
+            b= triangle.b;
+            c= triangle.c;
+        }
+
+        // meme calcul des aretes que Triangle::intersect()
+        Vector e1(a, b);
+        Vector e2(a, c);
+        for(int axis= 0; axis < 3; axis++)
+        {
+            block.v[0][axis][k]= a(axis);
+            block.v[1][axis][k]= watertight ? b(axis) : e1(axis);
+            block.v[2][axis][k]= watertight ? c(axis) : e2(axis);
+        }
+        block.index[k]= (k < n) ? first + k : -1;
+    }
+}
+
+/*! intersection d'un rayon et des W triangles d'un bloc, entre 0 et htmax, cf Triangle::intersect().
+    renvoie un bit par triangle touche, et la position t, u, v de chaque intersection.
+ */
+template < int W >
+int intersect_block( const TriangleBlock<W>& block, const Ray& ray, const float htmax, float t[W], float u[W], float v[W] )
+{
+    const int L= BlockLanes<W>::L;
+    typedef Lanes<L> F;
+
+    const F dx(ray.d.x), dy(ray.d.y), dz(ray.d.z);
+    const F ox(ray.o.x), oy(ray.o.y), oz(ray.o.z);
+    const F zero(0.f), one(1.f), tmax(htmax);
+
+    int hits= 0;
+    for(int k= 0; k < W; k+= L)
+    {
+        F e1x= F::load(block.v[1][0] + k), e1y= F::load(block.v[1][1] + k), e1z= F::load(block.v[1][2] + k);
+        F e2x= F::load(block.v[2][0] + k), e2y= F::load(block.v[2][1] + k), e2z= F::load(block.v[2][2] + k);
+
+        // pvec= cross(d, e2)
+        F px= dy * e2z - dz * e2y;
+        F py= dz * e2x - dx * e2z;
+        F pz= dx * e2y - dy * e2x;
+        F det= e1x * px + e1y * py + e1z * pz;
+        F inv_det= one / det;
+
+        // tvec= o - a
+        F tx= ox - F::load(block.v[0][0] + k);
+        F ty= oy - F::load(block.v[0][1] + k);
+        F tz= oz - F::load(block.v[0][2] + k);
+        F bu= (tx * px + ty * py + tz * pz) * inv_det;
+
+        // qvec= cross(tvec, e1)
+        F qx= ty * e1z - tz * e1y;
+        F qy= tz * e1x - tx * e1z;
+        F qz= tx * e1y - ty * e1x;
+        F bv= (dx * qx + dy * qy + dz * qz) * inv_det;
+        F bt= (e2x * qx + e2y * qy + e2z * qz) * inv_det;
+
+        // les comparaisons rejettent aussi les NaN, cf triangles degeneres et inutilises, det == 0
+        typename F::Mask mask= (bu >= zero) & (bu <= one) & (bv >= zero) & (bu + bv <= one) & (bt >= zero) & (bt <= tmax);
+        hits|= F::bits(mask) << k;
+
+        bt.store(t + k);
+        bu.store(u + k);
+        bv.store(v + k);
+    }
+
+    return hits;
+}
+
+//! rayon pour le test watertight : axes permutes et cisaillement qui transforme la direction en (0, 0, 1), cf intersect_block_watertight().
+struct WatertightRay
+{
+    Point o;
+    int kx, ky, kz;
+    float sx, sy, sz;
+
+    WatertightRay( const Ray& ray ) : o(ray.o)
+    {
+        // axe dominant de la direction
+        Vector d= ray.d;
+        kz= 0;
+        if(std::abs(d.y) > std::abs(d(kz))) kz= 1;
+        if(std::abs(d.z) > std::abs(d(kz))) kz= 2;
+        kx= (kz + 1) % 3;
+        ky= (kx + 1) % 3;
+        // conserve l'orientation des triangles
+        if(d(kz) < 0) std::swap(kx, ky);
+
+        sx= d(kx) / d(kz);
+        sy= d(ky) / d(kz);
+        sz= 1 / d(kz);
+    }
+};
+
+/*! intersection rayon / triangles etanche, un rayon qui touche l'arete commune de 2 triangles touche au moins un des 2 triangles.
+    cf "watertight ray/triangle intersection", S. Woop, C. Benthin, I. Wald, 2013.
+    le bloc doit etre construit avec watertight= true, cf make_block().
+ */
+template < int W >
+int intersect_block_watertight( const TriangleBlock<W>& block, const WatertightRay& ray, const float htmax, float t[W], float u[W], float v[W] )
+{
+    const int L= BlockLanes<W>::L;
+    typedef Lanes<L> F;
+
+    const F ox(ray.o(ray.kx)), oy(ray.o(ray.ky)), oz(ray.o(ray.kz));
+    const F sx(ray.sx), sy(ray.sy), sz(ray.sz);
+    const F zero(0.f), tmax(htmax);
+
+    int hits= 0;
+    for(int k= 0; k < W; k+= L)
+    {
+        // sommets dans le repere du rayon
+        F az= F::load(block.v[0][ray.kz] + k) - oz;
+        F bz= F::load(block.v[1][ray.kz] + k) - oz;
+        F cz= F::load(block.v[2][ray.kz] + k) - oz;
+        F ax= F::load(block.v[0][ray.kx] + k) - ox - sx * az;
+        F ay= F::load(block.v[0][ray.ky] + k) - oy - sy * az;
+        F bx= F::load(block.v[1][ray.kx] + k) - ox - sx * bz;
+        F by= F::load(block.v[1][ray.ky] + k) - oy - sy * bz;
+        F cx= F::load(block.v[2][ray.kx] + k) - ox - sx * cz;
+        F cy= F::load(block.v[2][ray.ky] + k) - oy - sy * cz;
+
+        // fonctions d'aretes, du meme signe si le rayon passe dans le triangle
+        F eu= cx * by - cy * bx;
+        F ev= ax * cy - ay * cx;
+        F ew= bx * ay - by * ax;
+        typename F::Mask inside= ((eu >= zero) & (ev >= zero) & (ew >= zero)) | ((eu <= zero) & (ev <= zero) & (ew <= zero));
+
+        F det= eu + ev + ew;
+        F inv_det= F(1.f) / det;
+        F bt= (eu * sz * az + ev * sz * bz + ew * sz * cz) * inv_det;
+        F bu= ev * inv_det;
+        F bv= ew * inv_det;
+
+        typename F::Mask mask= inside & (det != zero) & (bt >= zero) & (bt <= tmax);
+        hits|= F::bits(mask) << k;
+
+        bt.store(t + k);
+        bu.store(u + k);
+        bv.store(v + k);
+    }
+
+    return hits;
+}
+
+
+/*! triangles des feuilles ranges par blocs de 4 ou 8, cf BVHOptions::leaf_block et TriangleBlock.
+    les blocs d'une feuille sont contigus, first[] donne le premier bloc de la feuille.
+ */
+template < >
+struct LeafBlocks<Triangle>
+{
+    std::vector<TriangleBlock<4>> blocks4;
+    std::vector<TriangleBlock<8>> blocks8;
+    std::vector<int> first;     //!< premier bloc de la feuille qui commence par le triangle i.
+    int width;                  //!< 4 ou 8 triangles par bloc, 0 pas de blocs.
+    bool watertight;
+
+    LeafBlocks( ) : blocks4(), blocks8(), first(), width(0), watertight(false) {}
+
+    void clear( )
+    {
+        blocks4.clear();
+        blocks8.clear();
+        first.clear();
+        width= 0;
+        watertight= false;
+    }
+
+    void build( const std::vector<Triangle>& triangles, const std::vector<Node>& nodes, const BVHOptions& options )
+    {
+        clear();
+        width= (options.leaf_block >= 8) ? 8 : (options.leaf_block >= 4) ? 4 : 0;
+        watertight= options.watertight;
+        if(watertight && width == 0)
+            width= 4;   // pas de test watertight sans blocs...
+
+        if(width == 4)
+            build(blocks4, triangles, nodes);
+        else if(width == 8)
+            build(blocks8, triangles, nodes);
+    }
+
+    bool intersect( const std::vector<Triangle>& triangles, const int begin, const int end, const Ray& ray, Hit& hit ) const
+    {
+        if(width == 4)
+            intersect(blocks4, triangles, begin, end, ray, hit);
+        else if(width == 8)
+            intersect(blocks8, triangles, begin, end, ray, hit);
+        else
+            return false;
+
+        return true;
+    }
+
+    bool occluded( const std::vector<Triangle>&, const int begin, const int end, const Ray& ray, const float htmax, bool& result ) const
+    {
+        if(width == 4)
+            result= occluded(blocks4, begin, end, ray, htmax);
+        else if(width == 8)
+            result= occluded(blocks8, begin, end, ray, htmax);
+        else
+            return false;
+
+        return true;
+    }
+
+protected:
+    template < int W >
+    void build( std::vector<TriangleBlock<W>>& blocks, const std::vector<Triangle>& triangles, const std::vector<Node>& nodes )
+    {
+        first.assign(triangles.size(), -1);
+        for(unsigned i= 0; i < nodes.size(); i++)
+        {
+            if(!nodes[i].leaf())
+                continue;
+
+            int begin= nodes[i].leaf_begin();
+            int end= nodes[i].leaf_end();
+            first[begin]= int(blocks.size());
+            for(int k= begin; k < end; k+= W)
+            {
+                blocks.push_back( TriangleBlock<W>() );
+                make_block(blocks.back(), triangles.data(), k, std::min(W, end - k), watertight);
+            }
+        }
+    }
+
+    template < int W >
+    void intersect( const std::vector<TriangleBlock<W>>& blocks, const std::vector<Triangle>& triangles, const int begin, const int end, const Ray& ray, Hit& hit ) const
+    {
+        const int count= (end - begin + W -1) / W;
+        const TriangleBlock<W> *leaf= blocks.data() + first[begin];
+
+        float t[W], u[W], v[W];
+        if(watertight)
+        {
+            WatertightRay wray(ray);
+            for(int i= 0; i < count; i++)
+                closest(leaf[i], intersect_block_watertight(leaf[i], wray, hit.t, t, u, v), t, u, v, triangles, hit);
+        }
+        else
+        {
+            for(int i= 0; i < count; i++)
+                closest(leaf[i], intersect_block(leaf[i], ray, hit.t, t, u, v), t, u, v, triangles, hit);
+        }
+    }
+
+    template < int W >
+    bool occluded( const std::vector<TriangleBlock<W>>& blocks, const int begin, const int end, const Ray& ray, const float htmax ) const
+    {
+        const int count= (end - begin + W -1) / W;
+        const TriangleBlock<W> *leaf= blocks.data() + first[begin];
+
+        float t[W], u[W], v[W];
+        if(watertight)
+        {
+            WatertightRay wray(ray);
+            for(int i= 0; i < count; i++)
+                if(intersect_block_watertight(leaf[i], wray, htmax, t, u, v))
+                    return true;
+        }
+        else
+        {
+            for(int i= 0; i < count; i++)
+                if(intersect_block(leaf[i], ray, htmax, t, u, v))
+                    return true;
+        }
+
+        return false;
+    }
+
+    // garde l'intersection la plus proche, dans l'ordre des triangles, comme le test des triangles un par un
+    template < int W >
+    static void closest( const TriangleBlock<W>& block, const int hits, const float *t, const float *u, const float *v, const std::vector<Triangle>& triangles, Hit& hit )
+    {
+        if(hits == 0)
+            return;
+
+        for(int k= 0; k < W; k++)
+            if((hits & (1 << k)) && t[k] <= hit.t)
+            {
+                const Triangle& triangle= triangles[block.index[k]];
+                hit= Hit(t[k], u[k], v[k], triangle.mesh_id, triangle.primitive_id, triangle.triangle_id);
+            }
+    }
+};
+
+typedef BVHT<Triangle> BVH;
+typedef BVHT<Triangle> BLAS;
+
+
+//! instance pour le bvh, cf fonctions bounds() et intersect().
+struct Instance
+{
+    Transform object_transform;
+    BBox world_bounds;
+    const BVH *object_bvh;
+    int instance_id;
+
+    Instance( const BBox& bounds, const Transform& model, const BVH *bvh, const int id ) :
+        object_transform(Inverse(model)), world_bounds(transform(bounds, model)),
+        object_bvh(bvh),
+        instance_id(id)
+    {}
+
+    Instance( const BBox& bounds, const Transform& model, const BVH& bvh, const int id ) : Instance(bounds, model, &bvh, id) {}
+
+    BBox bounds( ) const { return world_bounds; }
+
+    Hit intersect( const Ray &ray, const float htmax ) const
+    {
+        // transforme le rayon
+        Ray object_ray(object_transform(ray.o), object_transform(ray.d), htmax);
+        // et intersection dans le bvh de l'objet instancie...
+
+        Hit hit= object_bvh->intersect(object_ray, htmax);
+        if(hit)
+            // si intersection, stocker aussi l'indice de l'instance, cf retrouver la transformation et la matiere associee au mesh/triangle...
+            hit.instance_id= instance_id;
+
+        return hit;
+    }
+
+    //! renvoie vrai si le rayon touche l'objet instancie entre 0 et htmax.
+    bool occluded( const Ray &ray, const float htmax ) const
+    {
+        Ray object_ray(object_transform(ray.o), object_transform(ray.d), htmax);
+        return object_bvh->occluded(object_ray, htmax);
+    }
+
+protected:
+    static BBox transform( const BBox& bbox, const Transform& m )
+    {
+        BBox bounds= BBox( m(bbox.pmin) );
+        // enumere les sommets de la bbox
+        for(unsigned i= 1; i < 8; i++)
+        {
+            // chaque sommet de la bbox est soit pmin soit pmax sur chaque axe...
+            Point p= bbox.pmin;
+            if(i & 1) p.x= bbox.pmax.x;
+            if(i & 2) p.y= bbox.pmax.y;
+            if(i & 4) p.z= bbox.pmax.z;
+
+            // transforme le sommet de l'englobant
+            bounds.insert( m(p) );
+        }
+
+        return bounds;
+    }
+};
+
+typedef BVHT<Instance> TLAS;
+
+///@}
+#endif
@@ -160,8 +160,11 @@ void DrawParam::draw( Mesh& mesh )
     bool use_normal= mesh.has_normal();
     bool use_color= mesh.has_color();
 
+    // positions quantifiees, cf Mesh::layout(VERTEX_PACKED)
+    Transform decode= mesh.position_decode();
+    
     Transform mv= m_view * m_model;
-    Transform mvp= m_projection * mv;
+    Transform mvp= m_projection * mv * decode;
     
     GLuint program= 0;
     if(m_debug_texcoords)
@@ -177,7 +180,7 @@ void DrawParam::draw( Mesh& mesh )
         glUseProgram(program);
         //~ program_use_texture(program, "diffuse_color", 0, m_debug_texture);
         program_uniform(program, "mvpMatrix", mvp);
-        program_uniform(program, "mvMatrix", mv);
+        program_uniform(program, "mvMatrix", mv * decode);
         
         mesh.draw(program,  /* position */ true, use_texcoord, false, false, /* material_index */ false);
         return;
@@ -193,7 +196,7 @@ void DrawParam::draw( Mesh& mesh )
     if(use_normal)
         program_uniform(program, "normalMatrix", mv.normal()); // transforme les normales dans le repere camera.
     else
-        program_uniform(program, "mvMatrix", mv);
+        program_uniform(program, "mvMatrix", mv * decode);
     
     // utiliser une texture, elle ne sera visible que si le mesh a des texcoords...
     if(use_texcoord && m_texture > 0)
@@ -203,7 +206,7 @@ void DrawParam::draw( Mesh& mesh )
     {
         program_uniform(program, "light", m_view(m_light));       // transforme la position de la source dans le repere camera, comme les normales
         program_uniform(program, "light_color", m_light_color);
-        program_uniform(program, "mvMatrix", mv);
+        program_uniform(program, "mvMatrix", mv * decode);
     }
     
     if(m_use_alpha_test)
@@ -254,14 +257,17 @@ void DrawParam::draw( const TriangleGroup& group, Mesh& mesh )
     else
         program_uniform(program, "mesh_color", mesh.materials().default_material().diffuse);
     
+    // positions quantifiees, cf Mesh::layout(VERTEX_PACKED)
+    Transform decode= mesh.position_decode();
+    
     Transform mv= m_view * m_model;
-    Transform mvp= m_projection * mv;
+    Transform mvp= m_projection * mv * decode;
     
     program_uniform(program, "mvpMatrix", mvp);
     if(use_normal)
         program_uniform(program, "normalMatrix", mv.normal()); // transforme les normales dans le repere camera.
     else
-        program_uniform(program, "mvMatrix", mv);
+        program_uniform(program, "mvMatrix", mv * decode);
         
     // utiliser une texture, elle ne sera visible que si le mesh a des texcoords...
     if(use_texcoord && m_texture > 0)
@@ -271,7 +277,7 @@ void DrawParam::draw( const TriangleGroup& group, Mesh& mesh )
     {
         program_uniform(program, "light", m_view(m_light));       // transforme la position de la source dans le repere camera, comme les normales
         program_uniform(program, "light_color", m_light_color);
-        program_uniform(program, "mvMatrix", mv);
+        program_uniform(program, "mvMatrix", mv * decode);
     }
     
     if(m_use_alpha_test)
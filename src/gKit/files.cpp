@@ -6,8 +6,18 @@
     #include <sys/stat.h>
 #endif
 
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#include <cstdio>
 #include <string>
 #include <algorithm>
+#include <atomic>
 
 #include "files.h"
 
@@ -115,3 +125,102 @@ std::string relative_filename( const std::string& filename, const std::string& p
     
     return filename.substr(i);
 }
+
+
+std::string temporary_filename( const std::string& filename )
+{
+    // identifiant du processus et compteur : plusieurs threads ou plusieurs processus peuvent ecrire le meme fichier en meme temps
+    static std::atomic<unsigned> counter(0);
+#ifdef _WIN32
+    unsigned long long pid= (unsigned long long) GetCurrentProcessId();
+#else
+    unsigned long long pid= (unsigned long long) getpid();
+#endif
+    
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%llx.%x.tmp", pid, counter++);
+    return filename + suffix;
+}
+
+
+MappedFile map_file( const std::string& filename )
+{
+    MappedFile file;
+#ifndef _WIN32
+    int fd= open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+        return file;
+    
+    struct stat info;
+    if(fstat(fd, &info) < 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
+    {
+        close(fd);
+        return file;
+    }
+    
+    void *data= mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);      // la projection reste valide apres la fermeture du fichier
+    if(data == MAP_FAILED)
+    {
+        printf("[error] mapping file '%s'...\n", filename.c_str());
+        return file;
+    }
+    
+    // lecture sequentielle, en general...
+    madvise(data, size_t(info.st_size), MADV_SEQUENTIAL);
+    
+    file.data= (const char *) data;
+    file.size= size_t(info.st_size);
+    
+#else
+    HANDLE in= CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(in == INVALID_HANDLE_VALUE)
+        return file;
+    
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(in, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(in);
+        return file;
+    }
+    
+    HANDLE mapping= CreateFileMappingA(in, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(in);
+    if(mapping == nullptr)
+    {
+        printf("[error] mapping file '%s'...\n", filename.c_str());
+        return file;
+    }
+    
+    void *data= MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(data == nullptr)
+    {
+        CloseHandle(mapping);
+        printf("[error] mapping file '%s'...\n", filename.c_str());
+        return file;
+    }
+    
+    file.data= (const char *) data;
+    file.size= size_t(size.QuadPart);
+    file.handle= mapping;
+#endif
+    
+    return file;
+}
+
+void unmap_file( MappedFile& file )
+{
+    if(file.data == nullptr)
+        return;
+    
+#ifndef _WIN32
+    munmap((void *) file.data, file.size);
+#else
+    UnmapViewOfFile(file.data);
+    CloseHandle((HANDLE) file.handle);
+#endif
+    
+    file.data= nullptr;
+    file.size= 0;
+    file.handle= nullptr;
+}
@@ -27,4 +27,23 @@ std::string normalize_filename( const std::string& filename );
 */
 std::string relative_filename( const std::string& filename, const std::string& path );
 
+//! renvoie un nom de fichier temporaire unique, dans le meme repertoire que filename, a renommer une fois le fichier ecrit.
+std::string temporary_filename( const std::string& filename );
+
+
+//! fichier projete en memoire, en lecture seule. cf map_file() et unmap_file().
+struct MappedFile
+{
+    const char *data;   //!< contenu du fichier, ou nullptr.
+    size_t size;        //!< taille du fichier, en octets.
+    void *handle;       //!< interne, windows.
+    
+    MappedFile( ) : data(nullptr), size(0), handle(nullptr) {}
+};
+
+//! projette un fichier en memoire, sans le lire. renvoie un MappedFile vide (data == nullptr) en cas d'erreur. a detruire avec unmap_file().
+MappedFile map_file( const std::string& filename );
+//! detruit la projection d'un fichier.
+void unmap_file( MappedFile& file );
+
 #endif
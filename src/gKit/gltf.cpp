@@ -2,6 +2,15 @@
 #include <cstdio>
 #include <cstring>
 #include <cfloat>
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "files.h"
 #include "texture.h"
@@ -16,33 +25,88 @@
 
 
 
-Mesh read_gltf_mesh( const char *filename )
+// renvoie les donnees d'un accesseur, si elles sont stockees directement dans le buffer, sans conversion : 
+// pas sparse, pas normalise, et pas entrelace avec d'autres attributs. sinon renvoie nullptr, il faut utiliser cgltf_accessor_unpack_floats() / read_index()...
+static
+const uint8_t *packed_data( const cgltf_accessor *accessor, const cgltf_component_type type )
 {
-    printf("loading glTF mesh '%s'...\n", filename);
+    if(accessor->is_sparse || accessor->normalized || accessor->buffer_view == nullptr)
+        return nullptr;
+    if(accessor->component_type != type)
+        return nullptr;
     
-    cgltf_options options= { };
-    cgltf_data *data= nullptr;
-    cgltf_result code= cgltf_parse_file(&options, filename, &data);
-    if(code != cgltf_result_success)
+    size_t size= (type == cgltf_component_type_r_8u) ? 1 : (type == cgltf_component_type_r_16u) ? 2 : 4;
+    if(accessor->stride != cgltf_num_components(accessor->type) * size)
+        return nullptr;
+    
+    const cgltf_buffer_view *view= accessor->buffer_view;
+    if(view->data)
+        // donnees decompressees par une extension
+        return (const uint8_t *) view->data + accessor->offset;
+    if(view->buffer->data == nullptr)
+        return nullptr;
+    
+    return (const uint8_t *) view->buffer->data + view->offset + accessor->offset;
+}
+
+// copie les indices d'un accesseur dans indices[0 .. count), ajoute offset a chaque indice.
+static
+void read_indices( const cgltf_accessor *accessor, unsigned *indices, const unsigned offset= 0 )
+{
+    const size_t n= accessor->count;
+    
+    if(const uint8_t *data= packed_data(accessor, cgltf_component_type_r_32u))
     {
-        printf("[error] loading glTF mesh '%s'...\n", filename);
-        return Mesh::error();
+        memcpy(indices, data, n * sizeof(unsigned));
+        if(offset)
+            for(size_t i= 0; i < n; i++)
+                indices[i]+= offset;
     }
-    
-    if(cgltf_validate(data) != cgltf_result_success)
+    else if(const uint8_t *data= packed_data(accessor, cgltf_component_type_r_16u))
     {
-        printf("[error] invalid glTF mesh '%s'...\n", filename);
-        return Mesh::error();
+        size_t i= 0;
+    #if defined(__SSE2__) || defined(_M_X64)
+        // elargit 8 indices 16 bits en 2x4 indices 32 bits
+        const __m128i zero= _mm_setzero_si128();
+        const __m128i base= _mm_set1_epi32(int(offset));
+        for(; i + 8 <= n; i+= 8)
+        {
+            __m128i v= _mm_loadu_si128((const __m128i *) (data + 2*i));
+            _mm_storeu_si128((__m128i *) (indices + i), _mm_add_epi32(_mm_unpacklo_epi16(v, zero), base));
+            _mm_storeu_si128((__m128i *) (indices + i + 4), _mm_add_epi32(_mm_unpackhi_epi16(v, zero), base));
+        }
+    #endif
+        const uint16_t *data16= (const uint16_t *) data;
+        for(; i < n; i++)
+            indices[i]= offset + data16[i];
     }
-    
-    code= cgltf_load_buffers(&options, data, filename);
-    if(code != cgltf_result_success)
+    else if(const uint8_t *data= packed_data(accessor, cgltf_component_type_r_8u))
     {
-        printf("[error] loading glTF buffers...\n");
-        return Mesh::error();
+        for(size_t i= 0; i < n; i++)
+            indices[i]= offset + data[i];
     }
-    
-    // 
+    else
+    {
+        for(size_t i= 0; i < n; i++)
+            indices[i]= offset + unsigned(cgltf_accessor_read_index(accessor, i));
+    }
+}
+
+// copie les floats d'un accesseur dans values[0 .. count * components), cf vec2 / vec3.
+static
+void read_floats( const cgltf_accessor *accessor, float *values )
+{
+    const size_t n= cgltf_num_components(accessor->type) * accessor->count;
+    if(const uint8_t *data= packed_data(accessor, cgltf_component_type_r_32f))
+        memcpy(values, data, n * sizeof(float));
+    else
+        cgltf_accessor_unpack_floats(accessor, values, n);
+}
+
+
+static
+Mesh build_mesh( cgltf_data *data, const char *filename )
+{
     std::vector<unsigned> indices;
     std::vector<int> material_indices;
     std::vector<vec3> positions;
@@ -221,8 +285,9 @@ Mesh read_gltf_mesh( const char *filename )
             // indices
             if(primitives->indices)
             {
-                for(unsigned i= 0; i < primitives->indices->count; i++)
-                    indices.push_back(offset + cgltf_accessor_read_index(primitives->indices, i));
+                size_t first= indices.size();
+                indices.resize(first + primitives->indices->count);
+                read_indices(primitives->indices, indices.data() + first, offset);
                 assert(indices.size() % 3 == 0);
                 
                 // un indice de matiere par triplet d'indices / par triangle
@@ -327,8 +392,6 @@ Mesh read_gltf_mesh( const char *filename )
         }
     }
     
-    cgltf_free(data);
-    
     // reconstruit le mesh...
     Mesh mesh(GL_TRIANGLES);
     
@@ -403,30 +466,11 @@ std::vector<GLTFCamera> read_gltf_cameras( const char *filename )
 {
     printf("loading glTF camera '%s'...\n", filename);
     
-    cgltf_options options= { };
-    cgltf_data *data= nullptr;
-    cgltf_result code= cgltf_parse_file(&options, filename, &data);
-    if(code != cgltf_result_success)
-    {
-        printf("[error] loading glTF mesh '%s'...\n", filename);
+    GLTFAsset asset;
+    if(!asset.load(filename))
         return {};
-    }
     
-    if(cgltf_validate(data) != cgltf_result_success)
-    {
-        printf("[error] invalid glTF mesh '%s'...\n", filename);
-        return {};
-    }
-    
-    if(data->cameras_count == 0)
-    {
-        printf("[warning] no camera...\n");
-        return {};
-    }
-    
-    std::vector<GLTFCamera> cameras= read_cameras(data);
-    cgltf_free(data);
-    return cameras;
+    return asset.cameras();
 }
 
 
@@ -468,30 +512,11 @@ std::vector<GLTFLight> read_gltf_lights( const char *filename )
 {
     printf("loading glTF lights '%s'...\n", filename);
     
-    cgltf_options options= { };
-    cgltf_data *data= nullptr;
-    cgltf_result code= cgltf_parse_file(&options, filename, &data);
-    if(code != cgltf_result_success)
-    {
-        printf("[error] loading glTF mesh '%s'...\n", filename);
-        return {};
-    }
-    
-    if(cgltf_validate(data) != cgltf_result_success)
-    {
-        printf("[error] invalid glTF mesh '%s'...\n", filename);
+    GLTFAsset asset;
+    if(!asset.load(filename))
         return {};
-    }
     
-    if(data->lights_count == 0)
-    {
-        printf("[warning] no lights...\n");
-        return {};
-    }
-    
-    std::vector<GLTFLight> lights= read_lights(data);
-    cgltf_free(data);
-    return lights;
+    return asset.lights();
 }
 
 
@@ -625,229 +650,154 @@ std::vector<GLTFMaterial> read_gltf_materials( const char *filename )
 {
     printf("loading glTF materials '%s'...\n", filename);
     
-    cgltf_options options= { };
-    cgltf_data *data= nullptr;
-    cgltf_result code= cgltf_parse_file(&options, filename, &data);
-    if(code != cgltf_result_success)
-    {
-        printf("[error] loading glTF mesh '%s'...\n", filename);
+    GLTFAsset asset;
+    if(!asset.load(filename))
         return {};
-    }
     
-    if(cgltf_validate(data) != cgltf_result_success)
+    return asset.materials();
+}
+
+
+static
+ImageData read_image( cgltf_data *data, const char *filename, const unsigned i )
+{
+    if(data->images[i].uri)
     {
-        printf("[error] invalid glTF mesh '%s'...\n", filename);
-        return {};
+        //~ printf("  [%u] %s\n", i, data->images[i].uri);
+        std::string image_filename= pathname(filename) + std::string(data->images[i].uri);
+        return read_image_data(image_filename.c_str());
     }
-    
-    if(data->materials_count ==0)
+    else if(data->images[i].buffer_view)
     {
-        printf("[warning] no materials...\n");
-        return {};
+        // extraire l'image du glb...
+        cgltf_buffer_view *view= data->images[i].buffer_view;
+        assert(view->buffer->data);
+        //~ printf("  [%u] %s offset %lu size %lu, type '%s'\n", i, data->images[i].name, view->offset, view->size, data->images[i].mime_type);
+        
+        SDL_RWops *read= SDL_RWFromConstMem((uint8_t *) view->buffer->data + view->offset, view->size);
+        assert(read);
+        
+        return image_data( IMG_Load_RW(read, /* free RWops */ 1) );
     }
     
-    std::vector<GLTFMaterial> materials= read_materials(data);
-    cgltf_free(data);
-    return materials;
+    return ImageData();
 }
 
-
 std::vector<ImageData> read_gltf_images( const char *filename )
 {
     printf("loading glTF images '%s'...\n", filename);
     
-    cgltf_options options= { };
-    cgltf_data *data= nullptr;
-    cgltf_result code= cgltf_parse_file(&options, filename, &data);
-    if(code != cgltf_result_success)
-    {
-        printf("[error] loading glTF mesh '%s'...\n", filename);
-        return {};
-    }
-    
-    if(cgltf_validate(data) != cgltf_result_success)
-    {
-        printf("[error] invalid glTF mesh '%s'...\n", filename);
+    GLTFAsset asset;
+    if(!asset.load(filename))
         return {};
-    }
     
-    if(data->images_count == 0)
+    if(asset.image_count() == 0)
     {
         printf("[warning] no images...\n");
         return {};
     }
     
-    // detecte s'il faut charger aussi les buffers...
-    for(unsigned i= 0; i < data->images_count; i++)
-        if(!data->images[i].uri)
-        {
-            code= cgltf_load_buffers(&options, data, filename);
-            if(code != cgltf_result_success)
-            {
-                printf("[error] loading glTF internal images...\n");
-                cgltf_free(data);
-                return {};
-            }
-            
-            break;
-        }
-    
-    
-    std::vector<ImageData> images(data->images_count);
-    
-#pragma omp parallel for schedule(dynamic, 1)
-    for(unsigned i= 0; i < data->images_count; i++)
-    {
-        if(data->images[i].uri)
-        {
-            //~ printf("  [%u] %s\n", i, data->images[i].uri);
-            std::string image_filename= pathname(filename) + std::string(data->images[i].uri);
-            images[i]= read_image_data(image_filename.c_str());
-        }
-        else if(data->images[i].buffer_view)
-        {
-            // extraire l'image du glb...
-            cgltf_buffer_view *view= data->images[i].buffer_view;
-            assert(view->buffer->data);
-            //~ printf("  [%u] %s offset %lu size %lu, type '%s'\n", i, data->images[i].name, view->offset, view->size, data->images[i].mime_type);
-            
-            SDL_RWops *read= SDL_RWFromConstMem((uint8_t *) view->buffer->data + view->offset, view->size);
-            assert(read);
-            
-            images[i]= image_data( IMG_Load_RW(read, /* free RWops */ 1) );
-        }
-    }
-    
-    cgltf_free(data);
-    return images;
+    return asset.images();
 }
 
 
-GLTFScene read_gltf_scene( const char *filename )
+static
+GLTFScene build_scene( cgltf_data *data )
 {
-    printf("loading glTF scene '%s'...\n", filename);
-    
-    cgltf_options options= { };
-    cgltf_data *data= nullptr;
-    cgltf_result code= cgltf_parse_file(&options, filename, &data);
-    if(code != cgltf_result_success)
-    {
-        printf("[error] loading glTF mesh '%s'...\n", filename);
-        return { };
-    }
-    
-    if(cgltf_validate(data) != cgltf_result_success)
-    {
-        printf("[error] invalid glTF mesh '%s'...\n", filename);
-        return { };
-    }
-    
-    code= cgltf_load_buffers(&options, data, filename);
-    if(code != cgltf_result_success)
-    {
-        printf("[error] loading glTF buffers...\n");
-        return { };
-    }
-    
-    //
     GLTFScene scene;
     
 // etape 1 : construire les meshs et les groupes de triangles / primitives
-    int primitives_index= 0;
-    std::vector<float> buffer;
+    // numerote les primitives de tous les meshs, pour les construire en parallele
+    struct primitive_ref { unsigned mesh_id; unsigned primitive_id; };
+    std::vector<primitive_ref> refs;
     
-    // parcourir tous les meshs de la scene
+    scene.meshes.resize(data->meshes_count);
     for(unsigned mesh_id= 0; mesh_id < data->meshes_count; mesh_id++)
     {
-        GLTFMesh m= { };
-        m.pmin= Point(FLT_MAX, FLT_MAX, FLT_MAX);
-        m.pmax= Point(-FLT_MAX, -FLT_MAX, -FLT_MAX);
-        
         cgltf_mesh *mesh= &data->meshes[mesh_id];
-        // parcourir les groupes de triangles du mesh...
+        scene.meshes[mesh_id].primitives.resize(mesh->primitives_count);
         for(unsigned primitive_id= 0; primitive_id < mesh->primitives_count; primitive_id++)
+            refs.push_back( {mesh_id, primitive_id} );
+    }
+    
+    // parcourir les groupes de triangles de tous les meshs...
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int k= 0; k < int(refs.size()); k++)
+    {
+        cgltf_primitive *primitives= &data->meshes[refs[k].mesh_id].primitives[refs[k].primitive_id];
+        assert(primitives->type == cgltf_primitive_type_triangles);
+        
+        GLTFPrimitives& p= scene.meshes[refs[k].mesh_id].primitives[refs[k].primitive_id];
+        p.primitives_index= k;
+        
+        // matiere associee au groupe de triangles
+        p.material_index= -1;
+        if(primitives->material)
+            p.material_index= std::distance(data->materials, primitives->material);
+        
+        // indices
+        if(primitives->indices)
         {
-            cgltf_primitive *primitives= &mesh->primitives[primitive_id];
-            assert(primitives->type == cgltf_primitive_type_triangles);
-            
-            GLTFPrimitives p= { };
-            
-            // matiere associee au groupe de triangles
-            p.material_index= -1;
-            if(primitives->material)
-                p.material_index= std::distance(data->materials, primitives->material);
+            p.indices.resize(primitives->indices->count);
+            read_indices(primitives->indices, p.indices.data());
+            assert(p.indices.size() % 3 == 0);
+        }
+        
+        // attributs
+        for(unsigned attribute_id= 0; attribute_id < primitives->attributes_count; attribute_id++)
+        {
+            cgltf_attribute *attribute= &primitives->attributes[attribute_id];
             
-            // indices
-            if(primitives->indices)
+            if(attribute->type == cgltf_attribute_type_position)
             {
-                for(unsigned i= 0; i < primitives->indices->count; i++)
-                    p.indices.push_back(cgltf_accessor_read_index(primitives->indices, i));
-                assert(p.indices.size() % 3 == 0);
+                assert(attribute->data->type == cgltf_type_vec3);
+                
+                p.positions.resize(attribute->data->count);
+                read_floats(attribute->data, (float *) p.positions.data());
+                
+            #if 0
+                assert(attribute->data->has_min);
+                assert(attribute->data->has_max);
+                p.pmin= vec3(attribute->data->min[0], attribute->data->min[1], attribute->data->min[2]);
+                p.pmax= vec3(attribute->data->max[0], attribute->data->max[1], attribute->data->max[2]);
+            #else
+                bounds(p.positions.data(), p.positions.size(), p.pmin, p.pmax);
+            #endif
             }
             
-            // attributs
-            for(unsigned attribute_id= 0; attribute_id < primitives->attributes_count; attribute_id++)
+            if(attribute->type == cgltf_attribute_type_normal)
             {
-                cgltf_attribute *attribute= &primitives->attributes[attribute_id];
-                
-                if(attribute->type == cgltf_attribute_type_position)
-                {
-                    assert(attribute->data->type == cgltf_type_vec3);
-                    
-                    buffer.resize(cgltf_accessor_unpack_floats(attribute->data, nullptr, 0));
-                    cgltf_accessor_unpack_floats(attribute->data, buffer.data(), buffer.size());
-                    
-                    // transforme les positions des sommets
-                    for(unsigned i= 0; i+2 < buffer.size(); i+= 3)
-                        p.positions.push_back( vec3(buffer[i], buffer[i+1], buffer[i+2]) );
-                    
-                #if 0
-                    assert(attribute->data->has_min);
-                    assert(attribute->data->has_max);
-                    p.pmin= vec3(attribute->data->min[0], attribute->data->min[1], attribute->data->min[2]);
-                    p.pmax= vec3(attribute->data->max[0], attribute->data->max[1], attribute->data->max[2]);
-                #else
-                    p.pmin= p.positions[0];
-                    p.pmax= p.positions[0];
-                    for(unsigned i= 1; i < p.positions.size(); i++)
-                    {
-                        p.pmin= min(p.pmin, p.positions[i]);
-                        p.pmax= max(p.pmax, p.positions[i]);
-                    }
-                #endif
-                    m.pmin= min(m.pmin, p.pmin);
-                    m.pmax= max(m.pmax, p.pmax);
-                }
+                assert(attribute->data->type == cgltf_type_vec3);
                 
-                if(attribute->type == cgltf_attribute_type_normal)
-                {
-                    assert(attribute->data->type == cgltf_type_vec3);
-                    
-                    buffer.resize(cgltf_accessor_unpack_floats(attribute->data, nullptr, 0));
-                    cgltf_accessor_unpack_floats(attribute->data, buffer.data(), buffer.size());
-                    
-                    // transforme les normales des sommets
-                    for(unsigned i= 0; i+2 < buffer.size(); i+= 3)
-                        p.normals.push_back( vec3(buffer[i], buffer[i+1], buffer[i+2]) );
-                }
+                p.normals.resize(attribute->data->count);
+                read_floats(attribute->data, (float *) p.normals.data());
+            }
+            
+            // uniquement le premier ensemble de texcoords, TEXCOORD_0
+            if(attribute->type == cgltf_attribute_type_texcoord && attribute->index == 0)
+            {
+                assert(attribute->data->type == cgltf_type_vec2);
                 
-                if(attribute->type == cgltf_attribute_type_texcoord)
-                {
-                    assert(attribute->data->type == cgltf_type_vec2);
-                    
-                    buffer.resize(cgltf_accessor_unpack_floats(attribute->data, nullptr, 0));
-                    cgltf_accessor_unpack_floats(attribute->data, buffer.data(), buffer.size());
-                    
-                    for(unsigned i= 0; i+1 < buffer.size(); i+= 2)
-                        p.texcoords.push_back( vec2(buffer[i], buffer[i+1]) );
-                }
+                p.texcoords.resize(attribute->data->count);
+                read_floats(attribute->data, (float *) p.texcoords.data());
             }
+        }
+    }
+    
+    // englobants des meshs
+    for(unsigned mesh_id= 0; mesh_id < scene.meshes.size(); mesh_id++)
+    {
+        GLTFMesh& m= scene.meshes[mesh_id];
+        m.pmin= Point(FLT_MAX, FLT_MAX, FLT_MAX);
+        m.pmax= Point(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for(unsigned i= 0; i < m.primitives.size(); i++)
+        {
+            if(m.primitives[i].positions.empty())
+                continue;
             
-            p.primitives_index= primitives_index++;
-            m.primitives.push_back(p);
+            m.pmin= min(m.pmin, m.primitives[i].pmin);
+            m.pmax= max(m.pmax, m.primitives[i].pmax);
         }
-        
-        scene.meshes.push_back(m);
     }
     
 // etape 2 : parcourir les noeuds, retrouver les transforms pour placer les meshes
@@ -875,12 +825,244 @@ GLTFScene read_gltf_scene( const char *filename )
     scene.lights= read_lights(data);
     scene.cameras= read_cameras(data);
     
-// etape : nettoyage...
-    cgltf_free(data);
+    return scene;
+}
+
+GLTFScene read_gltf_scene( const char *filename )
+{
+    printf("loading glTF scene '%s'...\n", filename);
+    
+    GLTFAsset asset;
+    if(!asset.load(filename))
+        return { };
+    
+    return asset.scene();
+}
+
+Mesh read_gltf_mesh( const char *filename )
+{
+    printf("loading glTF mesh '%s'...\n", filename);
+    
+    GLTFAsset asset;
+    if(!asset.load(filename))
+        return Mesh::error();
+    
+    return asset.mesh();
+}
+
+
+// duree d'une etape du chargement, en millisecondes.
+static
+float elapsed( const std::chrono::high_resolution_clock::time_point start )
+{
+    auto stop= std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<float, std::milli>(stop - start).count();
+}
+
+GLTFAsset::~GLTFAsset( )
+{
+    release();
+}
+
+void GLTFAsset::release( )
+{
+    if(m_data)
+        cgltf_free(m_data);
+    
+    m_data= nullptr;
+    m_buffers= false;
+    m_filename.clear();
+    m_images.clear();
+    m_images_loaded.clear();
+    m_timings= GLTFTimings();
+}
+
+bool GLTFAsset::load( const char *filename )
+{
+    release();
+    
+    auto start= std::chrono::high_resolution_clock::now();
+    cgltf_options options= { };
+    cgltf_result code= cgltf_parse_file(&options, filename, &m_data);
+    m_timings.parse= elapsed(start);
+    if(code != cgltf_result_success)
+    {
+        printf("[error] loading glTF mesh '%s'...\n", filename);
+        m_data= nullptr;
+        return false;
+    }
+    
+    start= std::chrono::high_resolution_clock::now();
+    code= cgltf_validate(m_data);
+    m_timings.validate= elapsed(start);
+    if(code != cgltf_result_success)
+    {
+        printf("[error] invalid glTF mesh '%s'...\n", filename);
+        release();
+        return false;
+    }
+    
+    m_filename= filename;
+    m_images.resize(m_data->images_count);
+    m_images_loaded.assign(m_data->images_count, 0);
+    return true;
+}
+
+bool GLTFAsset::load_buffers( )
+{
+    if(m_data == nullptr)
+        return false;
+    if(m_buffers)
+        return true;
+    
+    auto start= std::chrono::high_resolution_clock::now();
+    cgltf_options options= { };
+    cgltf_result code= cgltf_load_buffers(&options, m_data, m_filename.c_str());
+    m_timings.buffers= elapsed(start);
+    if(code != cgltf_result_success)
+    {
+        printf("[error] loading glTF buffers...\n");
+        return false;
+    }
+    
+    m_buffers= true;
+    return true;
+}
+
+Mesh GLTFAsset::mesh( )
+{
+    if(!load_buffers())
+        return Mesh::error();
     
+    auto start= std::chrono::high_resolution_clock::now();
+    Mesh mesh= build_mesh(m_data, m_filename.c_str());
+    m_timings.mesh+= elapsed(start);
+    return mesh;
+}
+
+GLTFScene GLTFAsset::scene( )
+{
+    if(!load_buffers())
+        return { };
+    
+    auto start= std::chrono::high_resolution_clock::now();
+    GLTFScene scene= build_scene(m_data);
+    m_timings.scene+= elapsed(start);
     return scene;
 }
 
+std::vector<GLTFMaterial> GLTFAsset::materials( )
+{
+    if(m_data == nullptr)
+        return {};
+    if(m_data->materials_count == 0)
+    {
+        printf("[warning] no materials...\n");
+        return {};
+    }
+    
+    auto start= std::chrono::high_resolution_clock::now();
+    std::vector<GLTFMaterial> materials= read_materials(m_data);
+    m_timings.scene+= elapsed(start);
+    return materials;
+}
+
+std::vector<GLTFCamera> GLTFAsset::cameras( )
+{
+    if(m_data == nullptr)
+        return {};
+    if(m_data->cameras_count == 0)
+    {
+        printf("[warning] no camera...\n");
+        return {};
+    }
+    
+    return read_cameras(m_data);
+}
+
+std::vector<GLTFLight> GLTFAsset::lights( )
+{
+    if(m_data == nullptr)
+        return {};
+    if(m_data->lights_count == 0)
+    {
+        printf("[warning] no lights...\n");
+        return {};
+    }
+    
+    return read_lights(m_data);
+}
+
+int GLTFAsset::image_count( ) const
+{
+    return int(m_images.size());
+}
+
+// les images stockees dans le fichier glb ont besoin des buffers.
+static
+bool has_packed_images( cgltf_data *data, const std::vector<int>& ids )
+{
+    for(unsigned k= 0; k < ids.size(); k++)
+        if(data->images[ids[k]].uri == nullptr)
+            return true;
+    
+    return false;
+}
+
+void GLTFAsset::load_images( const std::vector<int>& ids )
+{
+    std::vector<int> missing;
+    for(unsigned k= 0; k < ids.size(); k++)
+    {
+        int id= ids[k];
+        if(id >= 0 && id < int(m_images.size()) && !m_images_loaded[id])
+            missing.push_back(id);
+    }
+    if(missing.empty())
+        return;
+    
+    if(has_packed_images(m_data, missing) && !load_buffers())
+        return;
+    
+    auto start= std::chrono::high_resolution_clock::now();
+    
+    // decode les images en parallele
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int k= 0; k < int(missing.size()); k++)
+    {
+        int id= missing[k];
+        m_images[id]= read_image(m_data, m_filename.c_str(), id);
+        m_images_loaded[id]= 1;
+    }
+    
+    m_timings.images+= elapsed(start);
+}
+
+const ImageData& GLTFAsset::image( const int id )
+{
+    assert(id >= 0 && id < int(m_images.size()));
+    load_images( {id} );
+    return m_images[id];
+}
+
+const std::vector<ImageData>& GLTFAsset::images( )
+{
+    std::vector<int> ids(m_images.size());
+    for(unsigned i= 0; i < ids.size(); i++)
+        ids[i]= i;
+    
+    load_images(ids);
+    return m_images;
+}
+
+void GLTFAsset::print_timings( ) const
+{
+    printf("glTF '%s':\n", m_filename.c_str());
+    printf("  parse %.1fms, validate %.1fms, buffers %.1fms\n", m_timings.parse, m_timings.validate, m_timings.buffers);
+    printf("  mesh %.1fms, scene %.1fms, images %.1fms\n", m_timings.mesh, m_timings.scene, m_timings.images);
+    printf("  total %.1fms\n", m_timings.parse + m_timings.validate + m_timings.buffers + m_timings.mesh + m_timings.scene + m_timings.images);
+}
+
 std::vector<GLTFInstances> GLTFScene::instances( ) const
 {
     std::vector<GLTFInstances> instances(meshes.size());
@@ -900,22 +1082,27 @@ std::vector<GLTFInstances> GLTFScene::instances( ) const
 
 void GLTFScene::bounds( Point& pmin, Point& pmax ) const
 {
+    // transforme les englobants des meshs, cf read_gltf_scene(), pas les sommets... quelques operations par noeud, le resultat n'est pas conserve : les noeuds peuvent etre modifies directement
     pmin= Point(FLT_MAX, FLT_MAX, FLT_MAX);
     pmax= Point(-FLT_MAX, -FLT_MAX, -FLT_MAX);
     for(unsigned node_id= 0; node_id < nodes.size(); node_id++)
     {
         const GLTFNode& node= nodes[node_id];
         const GLTFMesh& mesh= meshes[node.mesh_index];
-        for(unsigned primitive_id= 0; primitive_id < mesh.primitives.size(); primitive_id++)
+        if(mesh.pmin.x > mesh.pmax.x)
+            continue;   // pas de sommets
+        
+        // sommets de l'englobant
+        for(int i= 0; i < 8; i++)
         {
-            const GLTFPrimitives& primitives= mesh.primitives[primitive_id];
-            for(unsigned i= 0; i < primitives.positions.size(); i++)
-            {
-                //~ Point p= node.model(Point(primitives.positions[i]));
-                Point p= Point(primitives.positions[i]);
-                pmin= min(pmin, p);
-                pmax= max(pmax, p);
-            }
+            Point p= Point(
+                (i & 1) ? mesh.pmax.x : mesh.pmin.x,
+                (i & 2) ? mesh.pmax.y : mesh.pmin.y,
+                (i & 4) ? mesh.pmax.z : mesh.pmin.z );
+            
+            p= node.model(p);
+            pmin= min(pmin, p);
+            pmax= max(pmax, p);
         }
     }
 }
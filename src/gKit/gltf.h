@@ -4,6 +4,7 @@
 #ifndef _GLTF_MESH_H
 #define _GLTF_MESH_H
 
+#include <string>
 #include <vector>
 
 #include "vec.h"
@@ -11,6 +12,7 @@
 #include "mesh.h"
 #include "image_io.h"
 
+struct cgltf_data;
 
 //! charge un fichier .gltf et construit un mesh statique, sans animation.
 Mesh read_gltf_mesh( const char *filename );
@@ -154,12 +156,94 @@ struct GLTFScene
     std::vector<GLTFLight> lights;          //!< lumieres.
     std::vector<GLTFCamera> cameras;        //!< cameras.
     
-    void bounds( Point& pmin, Point& pmax) const;   //!< calcule les points extremes de la scene, utile pour regler un orbiter.
+    //! calcule les points extremes de la scene, utile pour regler un orbiter. transforme les englobants des maillages, pas les sommets.
+    void bounds( Point& pmin, Point& pmax) const;
     std::vector<GLTFInstances> instances( ) const;  //!< regroupe les instances de chaque maillage.
 };
 
 //! charge un fichier .gltf et construit une scene statique, sans animation.
 GLTFScene read_gltf_scene( const char *filename );
 
+
+//! duree de chaque etape du chargement d'un fichier glTF, en millisecondes.
+struct GLTFTimings
+{
+    float parse;        //!< analyse du fichier.
+    float validate;     //!< verification.
+    float buffers;      //!< chargement des buffers.
+    float mesh;         //!< construction des meshs, cf GLTFAsset::mesh().
+    float scene;        //!< construction des scenes et des matieres.
+    float images;       //!< decompression des images.
+    
+    GLTFTimings( ) : parse(0), validate(0), buffers(0), mesh(0), scene(0), images(0) {}
+};
+
+/*! fichier glTF analyse une seule fois. 
+    les buffers ne sont charges que si necessaire, et les images ne sont decompressees qu'a la demande, en parallele.
+    
+    \code
+    GLTFAsset asset;
+    if(!asset.load("data/robot.gltf"))
+        return "erreur";
+    
+    GLTFScene scene= asset.scene();
+    std::vector<ImageData> images= asset.images();
+    asset.print_timings();
+    \endcode
+    
+    read_gltf_scene(), read_gltf_mesh(), read_gltf_images(), etc. chargent un fichier glTF pour une seule utilisation.
+ */
+class GLTFAsset
+{
+public:
+    GLTFAsset( ) : m_data(nullptr), m_buffers(false), m_filename(), m_images(), m_images_loaded(), m_timings() {}
+    ~GLTFAsset( );
+    
+    //! analyse et verifie un fichier .gltf / .glb. renvoie false en cas d'erreur.
+    bool load( const char *filename );
+    //! detruit les donnees.
+    void release( );
+    
+    //! construit un mesh statique, sans animation, cf read_gltf_mesh().
+    Mesh mesh( );
+    //! construit la scene statique, cf read_gltf_scene().
+    GLTFScene scene( );
+    //! renvoie les matieres, cf read_gltf_materials().
+    std::vector<GLTFMaterial> materials( );
+    //! renvoie les cameras, cf read_gltf_cameras().
+    std::vector<GLTFCamera> cameras( );
+    //! renvoie les sources de lumiere, cf read_gltf_lights().
+    std::vector<GLTFLight> lights( );
+    
+    //! renvoie le nombre d'images.
+    int image_count( ) const;
+    //! renvoie une image, la decompresse si necessaire.
+    const ImageData& image( const int id );
+    //! decompresse les images, en parallele, si necessaire.
+    void load_images( const std::vector<int>& ids );
+    //! renvoie toutes les images, cf read_gltf_images(). decompresse les images manquantes en parallele.
+    const std::vector<ImageData>& images( );
+    
+    //! renvoie la duree des etapes du chargement.
+    const GLTFTimings& timings( ) const { return m_timings; }
+    //! affiche la duree des etapes du chargement.
+    void print_timings( ) const;
+    
+protected:
+    //! charge les buffers, si necessaire.
+    bool load_buffers( );
+    
+    // pas de copie, les donnees cgltf ne sont pas partagees
+    GLTFAsset( const GLTFAsset& );
+    GLTFAsset& operator= ( const GLTFAsset& );
+    
+    cgltf_data *m_data;
+    bool m_buffers;
+    std::string m_filename;
+    std::vector<ImageData> m_images;
+    std::vector<unsigned char> m_images_loaded;
+    GLTFTimings m_timings;
+};
+
 #endif
 
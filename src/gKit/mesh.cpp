@@ -1,5 +1,8 @@
 
 #include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
 #include <cassert>
 #include <string>
 #include <algorithm>
@@ -11,6 +14,11 @@
 #include "uniforms.h"
 
 #include "window.h"
+#include "update_buffer.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 int Mesh::create( const GLenum primitives )
@@ -69,6 +77,7 @@ Mesh& Mesh::texcoord( const vec2& uv )
 unsigned int Mesh::vertex( const vec3& position )
 {
     m_update_buffers= true;
+    m_groups.clear();
     m_positions.push_back(position);
 
     // copie les autres attributs du sommet, uniquement s'ils sont definis
@@ -101,41 +110,42 @@ unsigned int Mesh::vertex( const vec3& position )
     return index;
 }
 
-// update attributes
+// update attributes, seuls les sommets modifies seront transferes, cf update_dirty_buffers()
 Mesh& Mesh::color( const unsigned int id, const vec4& c )
 {
     assert(id < m_colors.size());
-    m_update_buffers= true;
     m_colors[id]= c;
+    m_dirty_colors.insert(id);
     return *this;
 }
 
 Mesh& Mesh::normal( const unsigned int id, const vec3& n )
 {
     assert(id < m_normals.size());
-    m_update_buffers= true;
     m_normals[id]= n;
+    m_dirty_normals.insert(id);
     return *this;
 }
 
 Mesh& Mesh::texcoord( const unsigned int id, const vec2& uv )
 {
     assert(id < m_texcoords.size());
-    m_update_buffers= true;
     m_texcoords[id]= uv;
+    m_dirty_texcoords.insert(id);
     return *this;
 }
 
 void Mesh::vertex( const unsigned int id, const vec3& p )
 {
     assert(id < m_positions.size());
-    m_update_buffers= true;
     m_positions[id]= p;
+    m_dirty_positions.insert(id);
 }
 
 void Mesh::clear( )
 {
     m_update_buffers= true;
+    m_groups.clear();
     
     m_positions.clear();
     m_texcoords.clear();
@@ -153,6 +163,7 @@ Mesh& Mesh::triangle( const unsigned int a, const unsigned int b, const unsigned
     assert(b < m_positions.size());
     assert(c < m_positions.size());
     m_update_buffers= true;
+    m_groups.clear();
     m_indices.push_back(a);
     m_indices.push_back(b);
     m_indices.push_back(c);
@@ -171,6 +182,7 @@ Mesh& Mesh::triangle_last( const int a, const int b, const int c )
     assert(b < 0);
     assert(c < 0);
     m_update_buffers= true;
+    m_groups.clear();
     m_indices.push_back(int(m_positions.size()) + a);
     m_indices.push_back(int(m_positions.size()) + b);
     m_indices.push_back(int(m_positions.size()) + c);
@@ -186,6 +198,7 @@ Mesh& Mesh::triangle_last( const int a, const int b, const int c )
 Mesh& Mesh::restart_strip( )
 {
     m_update_buffers= true;
+    m_groups.clear();
     m_indices.push_back(~0u);   // ~0u plus grand entier non signe representable, ou UINT_MAX...
 #if 1
     glPrimitiveRestartIndex(~0u);
@@ -213,6 +226,7 @@ Mesh& Mesh::index( const int a )
         m_triangle_materials.push_back(m_triangle_materials.back());
     
     m_update_buffers= true;
+    m_groups.clear();
     return *this;
 }
 
@@ -239,6 +253,7 @@ Mesh& Mesh::material( const unsigned int id )
     else
         m_triangle_materials.back()= id;
     m_update_buffers= true;
+    m_groups.clear();
     return *this;
 }
 
@@ -260,18 +275,151 @@ const Material &Mesh::triangle_material( const unsigned int id ) const
 }
 
 
+// re-organise un tableau d'attributs, stride valeurs par triangle : values[i]= values[remap[i]].
+template < typename T >
+static
+void remap_values( std::vector<T>& values, const std::vector<int>& remap, const int stride )
+{
+    std::vector<T> tmp(values.size());
+    
+#pragma omp parallel for schedule(static, 4096)
+    for(int i= 0; i < int(remap.size()); i++)
+        for(int k= 0; k < stride; k++)
+            tmp[size_t(i) * stride + k]= values[size_t(remap[i]) * stride + k];
+    
+    std::swap(values, tmp);
+}
+
+// meme chose, sans copie du tableau : suit les cycles de la permutation.
+template < typename T >
+static
+void remap_values_in_place( std::vector<T>& values, const std::vector<int>& remap, const int stride )
+{
+    assert(stride <= 3);
+    std::vector<bool> done(remap.size(), false);
+    for(int i= 0; i < int(remap.size()); i++)
+    {
+        if(done[i] || remap[i] == i)
+            continue;
+        
+        // conserve le premier element du cycle
+        T first[3];
+        for(int k= 0; k < stride; k++)
+            first[k]= values[size_t(i) * stride + k];
+        
+        int j= i;
+        while(remap[j] != i)
+        {
+            for(int k= 0; k < stride; k++)
+                values[size_t(j) * stride + k]= values[size_t(remap[j]) * stride + k];
+            done[j]= true;
+            j= remap[j];
+        }
+        
+        for(int k= 0; k < stride; k++)
+            values[size_t(j) * stride + k]= first[k];
+        done[j]= true;
+    }
+}
+
+template < typename T >
+static
+void remap_values( std::vector<T>& values, const std::vector<int>& remap, const int stride, const bool in_place )
+{
+    if(in_place)
+        remap_values_in_place(values, remap, stride);
+    else
+        remap_values(values, remap, stride);
+}
+
+/* tri par denombrement, stable et en parallele. les proprietes sont des petits entiers, les indices de matieres, par exemple.
+    chaque thread compte les proprietes d'un bloc de triangles, puis place ses triangles dans l'ordre des proprietes, 
+    apres les triangles des blocs precedents. construit aussi les groupes.
+    renvoie false si les valeurs des proprietes sont trop grandes, plus de 64K, cf le tri classique dans groups().
+ */
+static
+bool counting_sort( const std::vector<unsigned int>& keys, std::vector<int>& remap, std::vector<TriangleGroup>& groups )
+{
+    const int n= int(keys.size());
+    
+    unsigned int max_key= 0;
+    for(int i= 0; i < n; i++)
+        max_key= std::max(max_key, keys[i]);
+    
+    // nombre de proprietes limite, independamment du nombre de triangles, sinon tri classique
+    if(max_key >= (1u << 16))
+        return false;
+    
+    const int buckets= int(max_key) +1;
+    int blocks= 1;
+#ifdef _OPENMP
+    blocks= std::max(1, std::min(omp_get_max_threads(), n / 4096));
+#endif
+    // un histogramme par bloc : moins de blocs lorsqu'il y a beaucoup de proprietes, pour ne pas allouer plus de compteurs que de triangles
+    blocks= std::max(1, std::min(blocks, n / buckets));
+    
+    // 1. compte les proprietes de chaque bloc
+    std::vector<int> histogram(size_t(blocks) * buckets, 0);
+#pragma omp parallel for schedule(static, 1)
+    for(int b= 0; b < blocks; b++)
+    {
+        int *h= histogram.data() + size_t(b) * buckets;
+        int begin= int(size_t(n) * b / blocks);
+        int end= int(size_t(n) * (b+1) / blocks);
+        for(int i= begin; i < end; i++)
+            h[keys[i]]++;
+    }
+    
+    // 2. position du premier triangle de chaque propriete, pour chaque bloc, et groupes
+    groups.clear();
+    int offset= 0;
+    for(int k= 0; k < buckets; k++)
+    {
+        int first= offset;
+        for(int b= 0; b < blocks; b++)
+        {
+            int count= histogram[size_t(b) * buckets + k];
+            histogram[size_t(b) * buckets + k]= offset;
+            offset+= count;
+        }
+        
+        if(offset > first)
+            groups.push_back( {k, 3*first, 3*(offset - first)} );
+    }
+    
+    // 3. place les triangles
+    remap.resize(n);
+#pragma omp parallel for schedule(static, 1)
+    for(int b= 0; b < blocks; b++)
+    {
+        int *h= histogram.data() + size_t(b) * buckets;
+        int begin= int(size_t(n) * b / blocks);
+        int end= int(size_t(n) * (b+1) / blocks);
+        for(int i= begin; i < end; i++)
+            remap[h[keys[i]]++]= i;
+    }
+    
+    return true;
+}
+
 std::vector<TriangleGroup> Mesh::groups( )
 {
-    return groups(m_triangle_materials);
+    // deja fait, si les triangles n'ont pas ete modifies...
+    if(!m_groups.empty() && m_groups.back().first + m_groups.back().n == 3*triangle_count())
+        return m_groups;
+    
+    std::vector<TriangleGroup> groups= this->groups(m_triangle_materials);
+    m_groups= groups;
+    return groups;
 }
 
-std::vector<TriangleGroup> Mesh::groups( const std::vector<unsigned int>& triangle_properties )
+std::vector<TriangleGroup> Mesh::groups( const std::vector<unsigned int>& triangle_properties, const bool in_place )
 {
     if(m_primitives != GL_TRIANGLES)
         return {};
     
     // pas le bon nombre d'infos, renvoyer un seul groupe
-    if(int(triangle_properties.size()) != triangle_count())
+    if(int(triangle_properties.size()) != triangle_count() || triangle_count() == 0)
     {
         if(m_indices.size())
             return { {0, 0, int(m_indices.size())} };
@@ -280,113 +428,58 @@ std::vector<TriangleGroup> Mesh::groups( const std::vector<unsigned int>& triang
     }
     
     // trie les triangles
-    std::vector<int> remap(triangle_count());
-    for(unsigned i= 0; i < remap.size(); i++)
-        remap[i]= i;
-
-    struct triangle_sort
+    std::vector<int> remap;
+    std::vector<TriangleGroup> groups;
+    if(!counting_sort(triangle_properties, remap, groups))
     {
-        const std::vector<unsigned int>& properties;
+        // proprietes quelconques, tri classique
+        remap.resize(triangle_count());
+        for(unsigned i= 0; i < remap.size(); i++)
+            remap[i]= i;
         
-        triangle_sort( const std::vector<unsigned int>& _properties ) : properties(_properties) {}
+        std::stable_sort(remap.begin(), remap.end(), 
+            [&triangle_properties]( const int a, const int b ) { return triangle_properties[a] < triangle_properties[b]; });
         
-        bool operator() ( const int& a, const int& b ) const
-        {
-            return properties[a] < properties[b];
-        }
-    };
+        int first= 0;
+        for(unsigned i= 1; i <= remap.size(); i++)
+            if(i == remap.size() || triangle_properties[remap[i]] != triangle_properties[remap[first]])
+            {
+                groups.push_back( {int(triangle_properties[remap[first]]), 3*first, 3*(int(i) - first)} );
+                first= i;
+            }
+    }
     
-    std::stable_sort(remap.begin(), remap.end(), triangle_sort(triangle_properties));
+    // triangles deja dans le bon ordre ?
+    bool sorted= true;
+    for(unsigned i= 0; i < remap.size() && sorted; i++)
+        sorted= (remap[i] == int(i));
+    if(sorted)
+        return groups;
     
-    // re-organise les triangles, et construit les groupes
-    std::vector<TriangleGroup> groups;
+    // re-organise les triangles
     if(m_indices.size())
     {
-        int first= 0;
-        int property_id= triangle_properties[remap[0]];
-        
         // re-organise l'index buffer...
-        std::vector<unsigned int> indices;
-        std::vector<unsigned int> material_indices;
-        for(unsigned i= 0; i < remap.size(); i++)
-        {
-            int id= triangle_properties[remap[i]];
-            if(id != property_id)
-            {
-                groups.push_back( {property_id, first, int(3*i) - first} );
-                first= 3*i;
-                property_id= id;
-            }
-            
-            indices.push_back(m_indices[3*remap[i]]);
-            indices.push_back(m_indices[3*remap[i]+1]);
-            indices.push_back(m_indices[3*remap[i]+2]);
-            
-            material_indices.push_back(m_triangle_materials[remap[i]]);
-        }
-        
-        // dernier groupe
-        groups.push_back( {property_id, first, int(3 * remap.size()) - first} );
-        
-        std::swap(m_indices, indices);
-        std::swap(m_triangle_materials, material_indices);
+        remap_values(m_indices, remap, 3, in_place);
     }
     else
     {
-        int first= 0;
-        int property_id= triangle_properties[remap[0]];
-        
         // re-organise les attributs !!
-        std::vector<vec3> positions;
-        std::vector<vec2> texcoords;
-        std::vector<vec3> normals;
-        std::vector<vec4> colors;
-        std::vector<unsigned int> material_indices;
-        for(unsigned i= 0; i < remap.size(); i++)
-        {
-            int id= triangle_properties[remap[i]];
-            if(id != property_id)
-            {
-                groups.push_back( {property_id, first, int(3*i) - first} );
-                first= 3*i;
-                property_id= id;
-            }
-            
-            positions.push_back(m_positions[3*remap[i]]);
-            positions.push_back(m_positions[3*remap[i]+1]);
-            positions.push_back(m_positions[3*remap[i]+2]);
-            if(has_texcoord())
-            {
-                texcoords.push_back(m_texcoords[3*remap[i]]);
-                texcoords.push_back(m_texcoords[3*remap[i]+1]);
-                texcoords.push_back(m_texcoords[3*remap[i]+2]);
-            }
-            if(has_normal())
-            {
-                normals.push_back(m_normals[3*remap[i]]);
-                normals.push_back(m_normals[3*remap[i]+1]);
-                normals.push_back(m_normals[3*remap[i]+2]);
-            }
-            if(has_color())
-            {
-                colors.push_back(m_colors[3*remap[i]]);
-                colors.push_back(m_colors[3*remap[i]+1]);
-                colors.push_back(m_colors[3*remap[i]+2]);
-            }
-            
-            material_indices.push_back(m_triangle_materials[remap[i]]);
-        }
-        
-        // dernier groupe
-        groups.push_back( {property_id, first, int(3 * remap.size()) - first} );
-        
-        std::swap(m_positions, positions);
-        std::swap(m_texcoords, texcoords);
-        std::swap(m_normals, normals);
-        std::swap(m_colors, colors);
-        std::swap(m_triangle_materials, material_indices);
+        remap_values(m_positions, remap, 3, in_place);
+        if(has_texcoord())
+            remap_values(m_texcoords, remap, 3, in_place);
+        if(has_normal())
+            remap_values(m_normals, remap, 3, in_place);
+        if(has_color())
+            remap_values(m_colors, remap, 3, in_place);
     }
     
+    // triangle_properties peut etre m_triangle_materials, ne plus l'utiliser...
+    if(has_material_index())
+        remap_values(m_triangle_materials, remap, 1, in_place);
+    
+    m_groups.clear();
+    m_update_buffers= true;
     return groups;
 }
 
@@ -460,80 +553,266 @@ TriangleData Mesh::triangle( const unsigned int id ) const
 
 void Mesh::bounds( Point& pmin, Point& pmax ) const
 {
-    if(m_positions.size() < 1)
-        return;
+    ::bounds(m_positions.data(), m_positions.size(), pmin, pmax);
+}
+
 
-    pmin= Point(m_positions[0]);
-    pmax= pmin;
 
-    for(unsigned i= 1; i < m_positions.size(); i++)
+
+
+// un indice de matiere par sommet, a partir des indices de matiere des triangles.
+static
+void vertex_material_indices( const Mesh& mesh, std::vector<unsigned char>& buffer )
+{
+    const std::vector<unsigned int>& indices= mesh.m_indices;
+    const std::vector<unsigned int>& materials= mesh.m_triangle_materials;
+    
+    buffer.assign(mesh.m_positions.size(), 0);
+    if(indices.size())
     {
-        vec3 p= m_positions[i];
-        pmin= Point( std::min(pmin.x, p.x), std::min(pmin.y, p.y), std::min(pmin.z, p.z) );
-        pmax= Point( std::max(pmax.x, p.x), std::max(pmax.y, p.y), std::max(pmax.z, p.z) );
+        //!! ne fonctionne que parce que read_indexed_mesh() duplique les sommets partages par 2 matieres !!
+        //!! ca ne fonctionnera probablement pas avec les mesh indexes construits par l'application... mais c'est long de detecter le probleme...
+        for(int triangle_id= 0; triangle_id < int(materials.size()); triangle_id++)
+        {
+            int material_id= materials[triangle_id];
+            assert(triangle_id*3+2 < int(indices.size()));
+            unsigned a= indices[triangle_id*3];
+            unsigned b= indices[triangle_id*3 +1];
+            unsigned c= indices[triangle_id*3 +2];
+            
+            buffer[a]= material_id;
+            buffer[b]= material_id;
+            buffer[c]= material_id;
+        }
+    }
+    else
+    {
+        for(int triangle_id= 0; triangle_id < int(materials.size()); triangle_id++)
+        {
+            int material_id= materials[triangle_id];
+            assert(triangle_id*3+2 < int(buffer.size()));
+            unsigned a= triangle_id*3;
+            unsigned b= triangle_id*3 +1;
+            unsigned c= triangle_id*3 +2;
+            
+            buffer[a]= material_id;
+            buffer[b]= material_id;
+            buffer[c]= material_id;
+        }
     }
 }
 
+//! position des attributs dans un sommet entrelace, 0 si l'attribut n'est pas utilise. la position est toujours au debut du sommet.
+struct VertexFormat
+{
+    size_t stride;
+    size_t texcoord;
+    size_t normal;
+    size_t color;
+    size_t material;
+};
 
+static
+VertexFormat vertex_format( const VertexLayout layout, const bool use_texcoord, const bool use_normal, const bool use_color, const bool use_material_index )
+{
+    bool packed= (layout == VERTEX_PACKED);
+    
+    VertexFormat format= { };
+    format.stride= packed ? 4*sizeof(uint16_t) : sizeof(vec3);  // packed : 3 composantes + 1 pour aligner les attributs suivants sur 4 octets
+    if(use_texcoord)
+    {
+        format.texcoord= format.stride;
+        format.stride+= packed ? 2*sizeof(uint16_t) : sizeof(vec2);
+    }
+    if(use_normal)
+    {
+        format.normal= format.stride;
+        format.stride+= packed ? sizeof(uint32_t) : sizeof(vec3);
+    }
+    if(use_color)
+    {
+        format.color= format.stride;
+        format.stride+= packed ? 4*sizeof(uint8_t) : sizeof(vec4);
+    }
+    if(use_material_index)
+    {
+        format.material= format.stride;
+        format.stride+= 4;      // 1 octet, + alignement sur 4 octets
+    }
+    
+    return format;
+}
 
+// conversion float vers half float, arrondi au plus proche. les valeurs trop petites sont remplacees par 0, les valeurs trop grandes par +/- infini.
+static
+uint16_t half_float( const float f )
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    
+    uint32_t sign= (x >> 16) & 0x8000;
+    int exponent= int((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa= x & 0x7fffff;
+    if(exponent <= 0)
+        return uint16_t(sign);
+    if(exponent >= 31)
+        return uint16_t(sign | 0x7c00);
+    
+    uint32_t h= sign | uint32_t(exponent) << 10 | mantissa >> 13;
+    if(mantissa & 0x1000)
+        h++;    // arrondi, le debordement sur l'exposant donne le bon resultat
+    return uint16_t(h);
+}
+
+static
+float clamp( const float x, const float a, const float b )
+{
+    return std::min(std::max(x, a), b);
+}
 
+// normale sur 3x 10 bits signes normalises, cf GL_INT_2_10_10_10_REV.
+static
+uint32_t pack_normal( const vec3& n )
+{
+    uint32_t x= uint32_t(int(std::round(clamp(n.x, -1, 1) * 511))) & 0x3ff;
+    uint32_t y= uint32_t(int(std::round(clamp(n.y, -1, 1) * 511))) & 0x3ff;
+    uint32_t z= uint32_t(int(std::round(clamp(n.z, -1, 1) * 511))) & 0x3ff;
+    return x | y << 10 | z << 20;
+}
 
-//! buffer unique de copie / mise a jour des vertex buffers statiques. singleton. tous les meshs utilisent le meme buffer de copie...
-class UpdateBuffer
+// construit les attributs entrelaces des sommets [first .. last), cf vertex_format(). materials : indice de matiere de chaque sommet du mesh, cf vertex_material_indices().
+static
+void interleaved_buffer( const Mesh& mesh, const VertexFormat& format, const bool packed, const std::vector<unsigned char>& materials, const int first, const int last, std::vector<unsigned char>& buffer )
 {
-public:
-    //! transfere les donnees dans un buffer statique.
-    void copy( GLenum target, const size_t offset, const size_t length, const void *data )
+    buffer.assign(size_t(last - first) * format.stride, 0);
+    
+    const vec3 pmin= mesh.m_decode_pmin;
+    const vec3 scale= vec3(1 / mesh.m_decode_extent.x, 1 / mesh.m_decode_extent.y, 1 / mesh.m_decode_extent.z);
+    
+#pragma omp parallel for schedule(static, 4096)
+    for(int i= first; i < last; i++)
     {
-        if(m_buffer == 0)
-            glGenBuffers(1, &m_buffer);
+        unsigned char *vertex= buffer.data() + size_t(i - first) * format.stride;
         
-        assert(m_buffer);
-        glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
-        if(length > m_size)
+        if(packed)
         {
-            m_size= (length / (16*1024*1024) + 1) * (16*1024*1024); // alloue par bloc de 16Mo 
-            assert(m_size >= length);
+            // position quantifiee dans l'englobant, 16 bits par composante
+            const vec3& p= mesh.m_positions[i];
+            uint16_t q[4];
+            q[0]= uint16_t(clamp((p.x - pmin.x) * scale.x, 0, 1) * 65535 + 0.5f);
+            q[1]= uint16_t(clamp((p.y - pmin.y) * scale.y, 0, 1) * 65535 + 0.5f);
+            q[2]= uint16_t(clamp((p.z - pmin.z) * scale.z, 0, 1) * 65535 + 0.5f);
+            q[3]= 0;
+            memcpy(vertex, q, sizeof(q));
             
-            // alloue un buffer intermediaire dynamique...
-            glBufferData(GL_COPY_READ_BUFFER, m_size, nullptr, GL_DYNAMIC_DRAW);
-            printf("[UpdateBuffer] allocate %dMo staging buffer...\n", int(m_size / 1024 / 1024));
+            if(format.texcoord)
+            {
+                uint16_t t[2]= { half_float(mesh.m_texcoords[i].x), half_float(mesh.m_texcoords[i].y) };
+                memcpy(vertex + format.texcoord, t, sizeof(t));
+            }
+            if(format.normal)
+            {
+                uint32_t n= pack_normal(mesh.m_normals[i]);
+                memcpy(vertex + format.normal, &n, sizeof(n));
+            }
+            if(format.color)
+            {
+                const vec4& c= mesh.m_colors[i];
+                vertex[format.color]= uint8_t(clamp(c.x, 0, 1) * 255 + 0.5f);
+                vertex[format.color +1]= uint8_t(clamp(c.y, 0, 1) * 255 + 0.5f);
+                vertex[format.color +2]= uint8_t(clamp(c.z, 0, 1) * 255 + 0.5f);
+                vertex[format.color +3]= uint8_t(clamp(c.w, 0, 1) * 255 + 0.5f);
+            }
+        }
+        else
+        {
+            memcpy(vertex, &mesh.m_positions[i], sizeof(vec3));
+            if(format.texcoord)
+                memcpy(vertex + format.texcoord, &mesh.m_texcoords[i], sizeof(vec2));
+            if(format.normal)
+                memcpy(vertex + format.normal, &mesh.m_normals[i], sizeof(vec3));
+            if(format.color)
+                memcpy(vertex + format.color, &mesh.m_colors[i], sizeof(vec4));
         }
         
-        // place les donnees dans le buffer intermediaire
-        glBufferSubData(GL_COPY_READ_BUFFER, 0, length, data);
-        // copie les donnees dans le vertex buffer statique
-        glCopyBufferSubData(GL_COPY_READ_BUFFER, target, 0, offset, length);
+        if(format.material)
+            vertex[format.material]= materials[i];
     }
-    
-    //! detruit le buffer.
-    ~UpdateBuffer( ) 
-    { 
-        release(); 
+}
+
+
+Mesh& Mesh::layout( const VertexLayout layout )
+{
+    if(layout != m_layout)
+    {
+        m_layout= layout;
+        m_update_buffers= true;
     }
-    
-    //! detruit le buffer.
-    void release( )
+    return *this;
+}
+
+size_t Mesh::layout_buffer_size( const VertexLayout layout, const bool use_texcoord, const bool use_normal, const bool use_color, const bool use_material_index ) const
+{
+    if(layout == VERTEX_SEPARATE)
     {
-        glDeleteBuffers(1, &m_buffer);
-        m_buffer= 0;
-        m_size= 0;
+        size_t size= vertex_buffer_size();
+        if(use_texcoord && has_texcoord())
+            size+= texcoord_buffer_size();
+        if(use_normal && has_normal())
+            size+= normal_buffer_size();
+        if(use_color && has_color())
+            size+= color_buffer_size();
+        if(use_material_index && has_material_index())
+            size+= m_positions.size() * sizeof(unsigned char);
+        return size;
     }
     
-    //! acces au singleton.
-    static UpdateBuffer& manager( )
+    VertexFormat format= vertex_format(layout, use_texcoord && has_texcoord(), use_normal && has_normal(), use_color && has_color(), use_material_index && has_material_index());
+    return m_positions.size() * format.stride;
+}
+
+// verifie que les positions modifiees sont toujours dans l'englobant utilise pour les quantifier.
+static
+bool decode_bounds_valid( const Mesh& mesh )
+{
+    const DirtyRange& range= mesh.m_dirty_positions;
+    const vec3& pmin= mesh.m_decode_pmin;
+    const vec3 pmax= vec3(pmin.x + mesh.m_decode_extent.x, pmin.y + mesh.m_decode_extent.y, pmin.z + mesh.m_decode_extent.z);
+    for(unsigned i= range.first; i < range.last; i++)
     {
-        static UpdateBuffer buffer;
-        return buffer;
+        const vec3& p= mesh.m_positions[i];
+        if(p.x < pmin.x || p.y < pmin.y || p.z < pmin.z
+        || p.x > pmax.x || p.y > pmax.y || p.z > pmax.z)
+            return false;
     }
     
-protected:
-    //! constructeur prive. singleton.
-    UpdateBuffer( ) : m_buffer(0), m_size(0) {}
+    return true;
+}
+
+Transform Mesh::position_decode( )
+{
+    if(m_layout != VERTEX_PACKED)
+        return Identity();
     
-    GLuint m_buffer;
-    size_t m_size;
-};
+    // re-calcule l'englobant si les positions ont change depuis le dernier transfert, 
+    // toutes les positions seront quantifiees de nouveau, cf update_buffers()
+    if(m_vao == 0 || m_update_buffers || !decode_bounds_valid(*this))
+    {
+        m_update_buffers= true;
+        
+        Point pmin, pmax;
+        bounds(pmin, pmax);
+        
+        m_decode_pmin= vec3(pmin);
+        m_decode_extent= vec3(pmax - pmin);
+        // englobant plat, evite de diviser par 0
+        if(m_decode_extent.x <= 0) m_decode_extent.x= 1;
+        if(m_decode_extent.y <= 0) m_decode_extent.y= 1;
+        if(m_decode_extent.z <= 0) m_decode_extent.z= 1;
+    }
+    
+    return Translation(Vector(m_decode_pmin)) * Scale(m_decode_extent.x, m_decode_extent.y, m_decode_extent.z);
+}
 
 
 GLuint Mesh::create_buffers( const bool use_texcoord, const bool use_normal, const bool use_color, const bool use_material_index )
@@ -561,15 +840,7 @@ GLuint Mesh::create_buffers( const bool use_texcoord, const bool use_normal, con
     glBindVertexArray(m_vao);
     
     // determine la taille du buffer pour stocker tous les attributs et les indices
-    m_vertex_buffer_size= vertex_buffer_size();
-    if(use_texcoord && has_texcoord())
-        m_vertex_buffer_size+= texcoord_buffer_size();
-    if(use_normal && has_normal())
-        m_vertex_buffer_size+= normal_buffer_size();
-    if(use_color && has_color())
-        m_vertex_buffer_size+= color_buffer_size();
-    if(use_material_index && has_material_index())
-        m_vertex_buffer_size+= m_positions.size() * sizeof(unsigned char);
+    m_vertex_buffer_size= layout_buffer_size(m_layout, use_texcoord, use_normal, use_color, use_material_index);
     
     // alloue le buffer
     glGenBuffers(1, &m_buffer);
@@ -582,7 +853,8 @@ GLuint Mesh::create_buffers( const bool use_texcoord, const bool use_normal, con
     {
         glGenBuffers(1, &m_index_buffer);    
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer_size, index_buffer(), GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer_size, nullptr, GL_STATIC_DRAW);
+        UpdateBuffer::manager().copy(GL_ELEMENT_ARRAY_BUFFER, 0, m_index_buffer_size, index_buffer());
     }
 
     // transfere les donnees dans les buffers
@@ -595,7 +867,7 @@ int Mesh::update_buffers( const bool use_texcoord, const bool use_normal, const
 {
     assert(m_vao > 0);
     assert(m_buffer > 0);
-    if(!m_update_buffers)
+    if(!m_update_buffers && !dirty())
         return 0;
 
     // alloue un buffer de copie, necessaire pour transferer plus de 256Mo... cf tuto_stream.cpp / transfert de donnees gpu
@@ -605,15 +877,15 @@ int Mesh::update_buffers( const bool use_texcoord, const bool use_normal, const
     glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
     
     // determine la taille du buffer pour stocker tous les attributs et les indices
-    size_t size= vertex_buffer_size();
-    if(use_texcoord && has_texcoord())
-        size+= texcoord_buffer_size();
-    if(use_normal && has_normal())
-        size+= normal_buffer_size();
-    if(use_color && has_color())
-        size+= color_buffer_size();
-    if(use_material_index && has_material_index())
-        size+= m_positions.size() * sizeof(unsigned char);
+    size_t size= layout_buffer_size(m_layout, use_texcoord, use_normal, use_color, use_material_index);
+    
+    // quelques sommets modifies, transfere uniquement les intervalles modifies, si c'est possible
+    if(!m_update_buffers && size == m_vertex_buffer_size && update_dirty_buffers(use_texcoord, use_normal, use_color, use_material_index))
+        return 1;
+    
+    m_upload_stats.bytes+= size;
+    m_upload_stats.full_bytes+= size;
+    m_upload_stats.full_updates++;
     
     if(size != m_vertex_buffer_size)
     {
@@ -621,95 +893,116 @@ int Mesh::update_buffers( const bool use_texcoord, const bool use_normal, const
         glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STATIC_DRAW);
     }
     
-    // transferer les attributs et configurer le format de sommet (vao)
-    size_t offset= 0;
-    size= vertex_buffer_size();
-    //~ glBufferSubData(GL_ARRAY_BUFFER, offset, size, vertex_buffer());        // copie les donnees dans le vertex buffer
-    update.copy(GL_ARRAY_BUFFER, offset, size, vertex_buffer());                // copie les donnees dans le vertex buffer
-    
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (const void *) offset);
-    glEnableVertexAttribArray(0);
-    
-    if(use_texcoord && has_texcoord())
+    if(m_layout != VERTEX_SEPARATE)
     {
-        offset= offset + size;
-        size= texcoord_buffer_size();
-        //~ glBufferSubData(GL_ARRAY_BUFFER, offset, size, texcoord_buffer());  // copie les donnees dans le vertex buffer
-        update.copy(GL_ARRAY_BUFFER, offset, size, texcoord_buffer());          // copie les donnees dans le vertex buffer
+        // attributs entrelaces, construits dans un seul buffer et transferes en une seule fois
+        bool packed= (m_layout == VERTEX_PACKED);
+        if(packed)
+            position_decode();  // englobant des positions quantifiees
         
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (const void *) offset);
-        glEnableVertexAttribArray(1);
-    }
-    
-    if(use_normal && has_normal())
-    {
-        offset= offset + size;
-        size= normal_buffer_size();
-        //~ glBufferSubData(GL_ARRAY_BUFFER, offset, size, normal_buffer());    // copie les donnees dans le vertex buffer
-        update.copy(GL_ARRAY_BUFFER, offset, size, normal_buffer());            // copie les donnees dans le vertex buffer
+        VertexFormat format= vertex_format(m_layout, use_texcoord && has_texcoord(), use_normal && has_normal(), use_color && has_color(), use_material_index && has_material_index());
         
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (const void *) offset);
-        glEnableVertexAttribArray(2);
-    }
-    
-    if(use_color && has_color())
-    {
-        offset= offset + size;
-        size= color_buffer_size();
-        //~ glBufferSubData(GL_ARRAY_BUFFER, offset, size, color_buffer());     // copie les donnees dans le vertex buffer
-        update.copy(GL_ARRAY_BUFFER, offset, size, color_buffer());             // copie les donnees dans le vertex buffer
+        // indices de matieres des sommets, conserves pour les transferts partiels : les matieres et les indices ne changent pas sans transfert complet
+        m_vertex_materials.clear();
+        if(format.material)
+            vertex_material_indices(*this, m_vertex_materials);
+        
+        std::vector<unsigned char> buffer;
+        interleaved_buffer(*this, format, packed, m_vertex_materials, 0, int(m_positions.size()), buffer);
+        update.copy(GL_ARRAY_BUFFER, 0, buffer.size(), buffer.data());
+        
+        GLsizei stride= GLsizei(format.stride);
+        glVertexAttribPointer(0, 3, packed ? GL_UNSIGNED_SHORT : GL_FLOAT, packed ? GL_TRUE : GL_FALSE, stride, (const void *) 0);
+        glEnableVertexAttribArray(0);
+        
+        if(format.texcoord)
+        {
+            glVertexAttribPointer(1, 2, packed ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, stride, (const void *) format.texcoord);
+            glEnableVertexAttribArray(1);
+        }
+        
+        if(format.normal)
+        {
+            if(packed)
+                glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (const void *) format.normal);
+            else
+                glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (const void *) format.normal);
+            glEnableVertexAttribArray(2);
+        }
+        
+        if(format.color)
+        {
+            glVertexAttribPointer(3, 4, packed ? GL_UNSIGNED_BYTE : GL_FLOAT, packed ? GL_TRUE : GL_FALSE, stride, (const void *) format.color);
+            glEnableVertexAttribArray(3);
+        }
         
-        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 0, (const void *) offset);
-        glEnableVertexAttribArray(3);
+        if(format.material)
+        {
+            glVertexAttribIPointer(4, 1, GL_UNSIGNED_BYTE, stride, (const void *) format.material);
+            glEnableVertexAttribArray(4);
+        }
     }
-    
-    if(use_material_index && has_material_index())
+    else
     {
-        assert(int(m_triangle_materials.size()) == triangle_count());
-        
-        offset= offset + size;
-        size= m_positions.size() * sizeof(unsigned char);
+        // transferer les attributs et configurer le format de sommet (vao)
+        size_t offset= 0;
+        size= vertex_buffer_size();
+        //~ glBufferSubData(GL_ARRAY_BUFFER, offset, size, vertex_buffer());        // copie les donnees dans le vertex buffer
+        update.copy(GL_ARRAY_BUFFER, offset, size, vertex_buffer());                // copie les donnees dans le vertex buffer
+    
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (const void *) offset);
+        glEnableVertexAttribArray(0);
+    
+        if(use_texcoord && has_texcoord())
+        {
+            offset= offset + size;
+            size= texcoord_buffer_size();
+            //~ glBufferSubData(GL_ARRAY_BUFFER, offset, size, texcoord_buffer());  // copie les donnees dans le vertex buffer
+            update.copy(GL_ARRAY_BUFFER, offset, size, texcoord_buffer());          // copie les donnees dans le vertex buffer
         
-        // prepare un indice de matiere par sommet / 3 indices par triangle
-        std::vector<unsigned char> buffer(m_positions.size());
-        if(m_indices.size())
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (const void *) offset);
+            glEnableVertexAttribArray(1);
+        }
+    
+        if(use_normal && has_normal())
         {
-            //!! ne fonctionne que parce que read_indexed_mesh() duplique les sommets partages par 2 matieres !!
-            //!! ca ne fonctionnera probablement pas avec les mesh indexes construits par l'application... mais c'est long de detecter le probleme...
-            for(int triangle_id= 0; triangle_id < int(m_triangle_materials.size()); triangle_id++)
-            {
-                int material_id= m_triangle_materials[triangle_id];
-                assert(triangle_id*3+2 < int(m_indices.size()));
-                unsigned a= m_indices[triangle_id*3];
-                unsigned b= m_indices[triangle_id*3 +1];
-                unsigned c= m_indices[triangle_id*3 +2];
-                
-                buffer[a]= material_id;
-                buffer[b]= material_id;
-                buffer[c]= material_id;
-            }
+            offset= offset + size;
+            size= normal_buffer_size();
+            //~ glBufferSubData(GL_ARRAY_BUFFER, offset, size, normal_buffer());    // copie les donnees dans le vertex buffer
+            update.copy(GL_ARRAY_BUFFER, offset, size, normal_buffer());            // copie les donnees dans le vertex buffer
+        
+            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (const void *) offset);
+            glEnableVertexAttribArray(2);
         }
-        else
+    
+        if(use_color && has_color())
         {
-            for(int triangle_id= 0; triangle_id < int(m_triangle_materials.size()); triangle_id++)
-            {
-                int material_id= m_triangle_materials[triangle_id];
-                assert(triangle_id*3+2 < int(m_positions.size()));
-                unsigned a= triangle_id*3;
-                unsigned b= triangle_id*3 +1;
-                unsigned c= triangle_id*3 +2;
-                
-                buffer[a]= material_id;
-                buffer[b]= material_id;
-                buffer[c]= material_id;
-            }
+            offset= offset + size;
+            size= color_buffer_size();
+            //~ glBufferSubData(GL_ARRAY_BUFFER, offset, size, color_buffer());     // copie les donnees dans le vertex buffer
+            update.copy(GL_ARRAY_BUFFER, offset, size, color_buffer());             // copie les donnees dans le vertex buffer
+        
+            glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 0, (const void *) offset);
+            glEnableVertexAttribArray(3);
         }
+    
+        if(use_material_index && has_material_index())
+        {
+            assert(int(m_triangle_materials.size()) == triangle_count());
+        
+            offset= offset + size;
+            size= m_positions.size() * sizeof(unsigned char);
+        
+            // prepare un indice de matiere par sommet / 3 indices par triangle
+            std::vector<unsigned char> buffer;
+            vertex_material_indices(*this, buffer);
         
-        //~ glBufferSubData(GL_ARRAY_BUFFER, offset, size, buffer.data());      // copie les donnees dans le vertex buffer
-        update.copy(GL_ARRAY_BUFFER, offset, size, buffer.data());              // copie les donnees dans le vertex buffer
+            //~ glBufferSubData(GL_ARRAY_BUFFER, offset, size, buffer.data());      // copie les donnees dans le vertex buffer
+            update.copy(GL_ARRAY_BUFFER, offset, size, buffer.data());              // copie les donnees dans le vertex buffer
         
-        glVertexAttribIPointer(4, 1, GL_UNSIGNED_BYTE, 0, (const void *) offset);
-        glEnableVertexAttribArray(4);
+            glVertexAttribIPointer(4, 1, GL_UNSIGNED_BYTE, 0, (const void *) offset);
+            glEnableVertexAttribArray(4);
+        }
     }
     
     // index buffer
@@ -717,14 +1010,102 @@ int Mesh::update_buffers( const bool use_texcoord, const bool use_normal, const
     if(size != m_index_buffer_size)
     {
         m_index_buffer_size= index_buffer_size();
+        if(m_index_buffer == 0)
+            glGenBuffers(1, &m_index_buffer);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_size(), index_buffer(), GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer_size, nullptr, GL_STATIC_DRAW);
+        update.copy(GL_ELEMENT_ARRAY_BUFFER, 0, m_index_buffer_size, index_buffer());
+        
+        m_upload_stats.bytes+= m_index_buffer_size;
+        m_upload_stats.full_bytes+= m_index_buffer_size;
     }
     
+    m_dirty_positions.clear();
+    m_dirty_texcoords.clear();
+    m_dirty_normals.clear();
+    m_dirty_colors.clear();
     m_update_buffers= false;
     return 1;
 }
 
+// transfere une partie d'un tableau d'attributs, renvoie le nombre d'octets transferes.
+static
+size_t copy_range( UpdateBuffer& update, const size_t offset, const DirtyRange& range, const size_t stride, const void *data )
+{
+    if(range.empty())
+        return 0;
+    
+    size_t length= size_t(range.count()) * stride;
+    update.copy(GL_ARRAY_BUFFER, offset + size_t(range.first) * stride, length, (const unsigned char *) data + size_t(range.first) * stride);
+    return length;
+}
+
+int Mesh::update_dirty_buffers( const bool use_texcoord, const bool use_normal, const bool use_color, const bool use_material_index )
+{
+    UpdateBuffer& update= UpdateBuffer::manager();
+    
+    size_t bytes= 0;
+    if(m_layout == VERTEX_SEPARATE)
+    {
+        // un tableau par attribut, meme organisation que update_buffers()
+        size_t offset= 0;
+        bytes+= copy_range(update, offset, m_dirty_positions, sizeof(vec3), vertex_buffer());
+        offset+= vertex_buffer_size();
+        
+        if(use_texcoord && has_texcoord())
+        {
+            bytes+= copy_range(update, offset, m_dirty_texcoords, sizeof(vec2), texcoord_buffer());
+            offset+= texcoord_buffer_size();
+        }
+        if(use_normal && has_normal())
+        {
+            bytes+= copy_range(update, offset, m_dirty_normals, sizeof(vec3), normal_buffer());
+            offset+= normal_buffer_size();
+        }
+        if(use_color && has_color())
+        {
+            bytes+= copy_range(update, offset, m_dirty_colors, sizeof(vec4), color_buffer());
+            offset+= color_buffer_size();
+        }
+    }
+    else
+    {
+        // attributs entrelaces, re-construit tous les attributs des sommets modifies
+        VertexFormat format= vertex_format(m_layout, use_texcoord && has_texcoord(), use_normal && has_normal(), use_color && has_color(), use_material_index && has_material_index());
+        bool packed= (m_layout == VERTEX_PACKED);
+        
+        DirtyRange range= m_dirty_positions;
+        if(format.texcoord) range.insert(m_dirty_texcoords);
+        if(format.normal) range.insert(m_dirty_normals);
+        if(format.color) range.insert(m_dirty_colors);
+        
+        // les positions doivent rester dans l'englobant utilise pour les quantifier, sinon re-construit tout le buffer
+        if(packed && !decode_bounds_valid(*this))
+            return 0;
+        // indices de matieres construits par le dernier transfert complet
+        if(format.material && m_vertex_materials.size() != m_positions.size())
+            return 0;
+        
+        if(!range.empty())
+        {
+            std::vector<unsigned char> buffer;
+            interleaved_buffer(*this, format, packed, m_vertex_materials, int(range.first), int(range.last), buffer);
+            update.copy(GL_ARRAY_BUFFER, size_t(range.first) * format.stride, buffer.size(), buffer.data());
+            bytes+= buffer.size();
+        }
+    }
+    
+    m_upload_stats.bytes+= bytes;
+    m_upload_stats.full_bytes+= m_vertex_buffer_size;
+    m_upload_stats.partial_updates++;
+    
+    m_dirty_positions.clear();
+    m_dirty_texcoords.clear();
+    m_dirty_normals.clear();
+    m_dirty_colors.clear();
+    return 1;
+}
+
 void Mesh::draw( const GLuint program, const bool use_position, const bool use_texcoord, const bool use_normal, const bool use_color, const bool use_material_index )
 {
     if(m_indices.size())
@@ -747,7 +1128,7 @@ void Mesh::draw( const int first, const int n, const GLuint program, const bool
         create_buffers(has_texcoord(), has_normal(), has_color(), has_material_index());
     assert(m_vao != 0);
     
-    if(m_update_buffers)
+    if(m_update_buffers || dirty())
         update_buffers(has_texcoord(), has_normal(), has_color(), has_material_index());
     
     glBindVertexArray(m_vao);
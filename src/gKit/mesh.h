@@ -98,6 +98,42 @@ struct TriangleData
     vec2 ta, tb, tc;    //!< texcoords
 };
 
+//! organisation des attributs dans le vertex buffer, cf Mesh::layout().
+enum VertexLayout
+{
+    VERTEX_SEPARATE= 0,     //!< un tableau par attribut, en float. organisation par defaut.
+    VERTEX_INTERLEAVED,     //!< attributs entrelaces, tous les attributs d'un sommet sont consecutifs, en float.
+    VERTEX_PACKED           //!< attributs entrelaces et compresses : positions 16 bits, normales 10 bits, texcoords half float, couleurs 8 bits.
+};
+
+//! intervalle des sommets modifies depuis le dernier transfert, cf Mesh::vertex(id, p), Mesh::normal(id, n), etc.
+struct DirtyRange
+{
+    unsigned int first;     //!< premier sommet modifie.
+    unsigned int last;      //!< dernier sommet modifie +1. l'intervalle est vide si first >= last.
+    
+    DirtyRange( ) : first(~0u), last(0) {}
+    
+    //! ajoute un sommet a l'intervalle.
+    void insert( const unsigned int id ) { if(id < first) first= id; if(id +1 > last) last= id +1; }
+    //! ajoute un intervalle.
+    void insert( const DirtyRange& r ) { if(r.empty()) return; if(r.first < first) first= r.first; if(r.last > last) last= r.last; }
+    //! vide l'intervalle.
+    void clear( ) { first= ~0u; last= 0; }
+    
+    bool empty( ) const { return first >= last; }
+    unsigned int count( ) const { return empty() ? 0 : last - first; }
+};
+
+//! statistiques des transferts des buffers d'un mesh, cf Mesh::upload_stats().
+struct MeshUploadStats
+{
+    size_t bytes;           //!< octets transferes.
+    size_t full_bytes;      //!< octets qui auraient ete transferes en re-transferant tous les attributs.
+    int full_updates;       //!< nombre de transferts complets.
+    int partial_updates;    //!< nombre de transferts des sommets modifies uniquement.
+};
+
 //! representation d'un ensemble de triangles de meme matiere.
 struct TriangleGroup
 {
@@ -115,11 +151,15 @@ public:
     //@{
     //! constructeur par defaut.
     Mesh( ) : m_positions(), m_texcoords(), m_normals(), m_colors(), m_indices(), 
-        m_color(White()), m_primitives(GL_POINTS), m_vao(0), m_buffer(0), m_index_buffer(0), m_vertex_buffer_size(0), m_index_buffer_size(0), m_update_buffers(false) {}
+        m_color(White()), m_primitives(GL_POINTS), m_vao(0), m_buffer(0), m_index_buffer(0), m_vertex_buffer_size(0), m_index_buffer_size(0), 
+        m_layout(VERTEX_SEPARATE), m_decode_pmin(), m_decode_extent(1, 1, 1), 
+        m_dirty_positions(), m_dirty_texcoords(), m_dirty_normals(), m_dirty_colors(), m_upload_stats(), m_vertex_materials(), m_groups(), m_update_buffers(false) {}
     
     //! constructeur.
     Mesh( const GLenum primitives ) : m_positions(), m_texcoords(), m_normals(), m_colors(), m_indices(), 
-        m_color(White()), m_primitives(primitives), m_vao(0), m_buffer(0), m_index_buffer(0), m_vertex_buffer_size(0), m_index_buffer_size(0), m_update_buffers(false) {}
+        m_color(White()), m_primitives(primitives), m_vao(0), m_buffer(0), m_index_buffer(0), m_vertex_buffer_size(0), m_index_buffer_size(0), 
+        m_layout(VERTEX_SEPARATE), m_decode_pmin(), m_decode_extent(1, 1, 1), 
+        m_dirty_positions(), m_dirty_texcoords(), m_dirty_normals(), m_dirty_colors(), m_upload_stats(), m_vertex_materials(), m_groups(), m_update_buffers(false) {}
     
     //! construit les objets openGL.
     int create( const GLenum primitives );
@@ -259,10 +299,14 @@ public:
     //! renvoie la matiere d'un triangle.
     const Material &triangle_material( const unsigned int id ) const;
     
-    //! renvoie les groupes de triangles de meme matiere. re-organise les triangles. permet d'afficher l'objet matiere par matiere.
+    /*! renvoie les groupes de triangles de meme matiere. re-organise les triangles. permet d'afficher l'objet matiere par matiere.
+        les groupes sont conserves, les appels suivants ne re-organisent pas les triangles, tant que les triangles ou leurs matieres ne sont pas modifies.
+     */
     std::vector<TriangleGroup> groups( );
-    //! renvoie les groupes de triangles de meme 'propriete'. re-organise les triangles.
-    std::vector<TriangleGroup> groups( const std::vector<unsigned int>& triangle_properties );
+    /*! renvoie les groupes de triangles de meme 'propriete'. re-organise les triangles, tri par denombrement, en parallele.
+        in_place= true : permute les attributs sans copie, plus lent mais n'alloue pas d'autres tableaux d'attributs.
+     */
+    std::vector<TriangleGroup> groups( const std::vector<unsigned int>& triangle_properties, const bool in_place= false );
     //@}
     
     //! renvoie min et max les coordonnees des extremites des positions des sommets de l'objet (boite englobante alignee sur les axes, aabb).
@@ -346,6 +390,31 @@ public:
     //@}
     
     
+    //! \name organisation des attributs dans le vertex buffer.
+    //@{
+    /*! choisit l'organisation des attributs dans le vertex buffer, cf VertexLayout. les buffers sont re-construits au prochain draw().
+        VERTEX_PACKED quantifie les positions dans l'englobant de l'objet, il faut composer position_decode() avec la transformation model, 
+        DrawParam::draw() le fait automatiquement.
+     */
+    Mesh& layout( const VertexLayout layout );
+    //! renvoie l'organisation des attributs dans le vertex buffer.
+    VertexLayout layout( ) const { return m_layout; }
+    //! renvoie la taille (en octets) du vertex buffer construit avec une organisation et les attributs utilises.
+    std::size_t layout_buffer_size( const VertexLayout layout, const bool use_texcoord, const bool use_normal, const bool use_color, const bool use_material_index ) const;
+    //! renvoie la transformation qui reconstruit les positions a partir des positions quantifiees du vertex buffer. identite, sauf pour VERTEX_PACKED.
+    Transform position_decode( );
+    //@}
+    
+    //! \name statistiques des transferts.
+    //@{
+    /*! renvoie les statistiques des transferts des buffers depuis le dernier clear_upload_stats(). 
+        modifier quelques sommets avec vertex(id, p), normal(id, n), texcoord(id, t) ou color(id, c) ne transfere que les sommets modifies.
+     */
+    const MeshUploadStats& upload_stats( ) const { return m_upload_stats; }
+    //! remet les statistiques a zero, au debut de chaque image, par exemple.
+    void clear_upload_stats( ) { m_upload_stats= MeshUploadStats(); }
+    //@}
+    
     //! construit les buffers et le vertex array object necessaires pour dessiner l'objet avec openGL. utilitaire. detruit par release( ).
     GLuint create_buffers( const bool use_texcoord, const bool use_normal, const bool use_color, const bool use_material_index );
     //! dessine l'objet avec un shader program. 
@@ -356,6 +425,10 @@ public:
 public:
     //! modifie les buffers openGL, si necessaire.
     int update_buffers( const bool use_texcoord, const bool use_normal, const bool use_color, const bool use_material_index );
+    //! transfere uniquement les sommets modifies. renvoie 0 si un transfert complet est necessaire.
+    int update_dirty_buffers( const bool use_texcoord, const bool use_normal, const bool use_color, const bool use_material_index );
+    //! renvoie vrai si des sommets ont ete modifies depuis le dernier transfert.
+    bool dirty( ) const { return !m_dirty_positions.empty() || !m_dirty_texcoords.empty() || !m_dirty_normals.empty() || !m_dirty_colors.empty(); }
     
     //
     std::vector<vec3> m_positions;
@@ -377,6 +450,19 @@ public:
     size_t m_vertex_buffer_size;
     size_t m_index_buffer_size;
     
+    VertexLayout m_layout;
+    vec3 m_decode_pmin;
+    vec3 m_decode_extent;
+    
+    DirtyRange m_dirty_positions;
+    DirtyRange m_dirty_texcoords;
+    DirtyRange m_dirty_normals;
+    DirtyRange m_dirty_colors;
+    MeshUploadStats m_upload_stats;
+    std::vector<unsigned char> m_vertex_materials;     //!< indice de matiere de chaque sommet, construit par le transfert complet des attributs entrelaces, et re-utilise par les transferts partiels.
+    
+    std::vector<TriangleGroup> m_groups;    //!< groupes construits par groups( ), vide si les triangles ont ete modifies.
+    
     bool m_update_buffers;
 };
 
@@ -0,0 +1,456 @@
+
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "files.h"
+#include "wavefront.h"
+#include "wavefront_fast.h"
+#include "gltf.h"
+#include "mesh_cache.h"
+
+
+// format du cache : entete + blocs alignes sur 64 octets, dans l'ordre de MeshCacheBlock.
+// les attributs sont stockes exactement comme dans les tableaux de Mesh : vec3, vec2, vec4, unsigned int.
+
+static const char mesh_cache_magic[8]= { 'g', 'k', 'm', 'e', 's', 'h', 0, 0 };
+static const uint32_t mesh_cache_version= 1;
+static const uint64_t mesh_cache_align= 64;
+
+enum MeshCacheBlock
+{
+    CACHE_POSITIONS= 0,
+    CACHE_TEXCOORDS,
+    CACHE_NORMALS,
+    CACHE_COLORS,
+    CACHE_INDICES,
+    CACHE_MATERIAL_INDICES,
+    CACHE_MATERIALS,        //!< description des matieres, cf write_materials_block()
+    CACHE_BLOCKS
+};
+
+struct MeshCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t primitives;            //!< GL_TRIANGLES, etc.
+    uint64_t source_timestamp;      //!< date de modification du fichier source.
+    float color[4];                 //!< couleur par defaut du mesh.
+    uint64_t count[CACHE_BLOCKS];   //!< nombre d'elements de chaque bloc.
+    uint64_t offset[CACHE_BLOCKS];  //!< position de chaque bloc dans le fichier.
+    uint64_t size[CACHE_BLOCKS];    //!< taille de chaque bloc, en octets.
+};
+
+
+// description des matieres : nombre de matieres, puis pour chaque matiere : nom, couleurs, ns et indices des textures.
+// puis nombre de textures et noms des fichiers, et enfin l'indice de la matiere par defaut.
+static void write_uint( std::vector<char>& block, const uint32_t v )
+{
+    const char *data= (const char *) &v;
+    block.insert(block.end(), data, data + sizeof(v));
+}
+
+static void write_int( std::vector<char>& block, const int v )
+{
+    write_uint(block, uint32_t(v));
+}
+
+static void write_float( std::vector<char>& block, const float v )
+{
+    const char *data= (const char *) &v;
+    block.insert(block.end(), data, data + sizeof(v));
+}
+
+static void write_color( std::vector<char>& block, const Color& c )
+{
+    write_float(block, c.r);
+    write_float(block, c.g);
+    write_float(block, c.b);
+    write_float(block, c.a);
+}
+
+static void write_string( std::vector<char>& block, const std::string& s )
+{
+    write_uint(block, uint32_t(s.size()));
+    block.insert(block.end(), s.begin(), s.end());
+}
+
+static std::vector<char> write_materials_block( const Materials& materials )
+{
+    std::vector<char> block;
+    write_uint(block, uint32_t(materials.count()));
+    for(int i= 0; i < materials.count(); i++)
+    {
+        const Material& m= materials.material(i);
+        write_string(block, materials.names[i]);
+        write_color(block, m.diffuse);
+        write_color(block, m.specular);
+        write_color(block, m.emission);
+        write_float(block, m.ns);
+        write_int(block, m.diffuse_texture);
+        write_int(block, m.specular_texture);
+        write_int(block, m.emission_texture);
+        write_int(block, m.ns_texture);
+    }
+
+    write_uint(block, uint32_t(materials.filename_count()));
+    for(int i= 0; i < materials.filename_count(); i++)
+        write_string(block, materials.texture_filenames[i]);
+
+    write_int(block, materials.default_material_id);
+    return block;
+}
+
+//! lecture du bloc des matieres, verifie les depassements.
+struct MaterialsReader
+{
+    const char *data;
+    const char *end;
+    bool error;
+
+    MaterialsReader( const char *_data, const size_t size ) : data(_data), end(_data + size), error(false) {}
+
+    bool read( void *v, const size_t size )
+    {
+        if(error || size_t(end - data) < size)
+        {
+            error= true;
+            return false;
+        }
+
+        memcpy(v, data, size);
+        data+= size;
+        return true;
+    }
+
+    uint32_t read_uint( ) { uint32_t v= 0; read(&v, sizeof(v)); return v; }
+    int read_int( ) { return int(read_uint()); }
+    float read_float( ) { float v= 0; read(&v, sizeof(v)); return v; }
+
+    Color read_color( )
+    {
+        Color c;
+        c.r= read_float();
+        c.g= read_float();
+        c.b= read_float();
+        c.a= read_float();
+        return c;
+    }
+
+    std::string read_string( )
+    {
+        uint32_t n= read_uint();
+        if(error || size_t(end - data) < n)
+        {
+            error= true;
+            return std::string();
+        }
+
+        std::string s(data, data + n);
+        data+= n;
+        return s;
+    }
+};
+
+static bool read_materials_block( const char *data, const size_t size, Materials& materials )
+{
+    MaterialsReader in(data, size);
+
+    uint32_t n= in.read_uint();
+    for(uint32_t i= 0; i < n && !in.error; i++)
+    {
+        std::string name= in.read_string();
+
+        Material m;
+        m.diffuse= in.read_color();
+        m.specular= in.read_color();
+        m.emission= in.read_color();
+        m.ns= in.read_float();
+        m.diffuse_texture= in.read_int();
+        m.specular_texture= in.read_int();
+        m.emission_texture= in.read_int();
+        m.ns_texture= in.read_int();
+
+        materials.names.push_back(name);
+        materials.materials.push_back(m);
+    }
+
+    uint32_t textures= in.read_uint();
+    for(uint32_t i= 0; i < textures && !in.error; i++)
+        materials.texture_filenames.push_back(in.read_string());
+
+    materials.default_material_id= in.read_int();
+    return !in.error;
+}
+
+
+int write_mesh_cache( const Mesh& mesh, const char *filename, const size_t source_timestamp )
+{
+    if(mesh.positions().size() == 0)
+        return -1;
+
+    std::vector<char> materials= write_materials_block(mesh.materials());
+
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, mesh_cache_magic, sizeof(header.magic));
+    header.version= mesh_cache_version;
+    header.primitives= uint32_t(mesh.primitives());
+    header.source_timestamp= uint64_t(source_timestamp);
+
+    Color color= mesh.default_color();
+    header.color[0]= color.r;
+    header.color[1]= color.g;
+    header.color[2]= color.b;
+    header.color[3]= color.a;
+
+    const void *data[CACHE_BLOCKS];
+    header.count[CACHE_POSITIONS]= mesh.positions().size();
+    header.size[CACHE_POSITIONS]= mesh.positions().size() * sizeof(vec3);
+    data[CACHE_POSITIONS]= mesh.positions().data();
+    header.count[CACHE_TEXCOORDS]= mesh.texcoords().size();
+    header.size[CACHE_TEXCOORDS]= mesh.texcoords().size() * sizeof(vec2);
+    data[CACHE_TEXCOORDS]= mesh.texcoords().data();
+    header.count[CACHE_NORMALS]= mesh.normals().size();
+    header.size[CACHE_NORMALS]= mesh.normals().size() * sizeof(vec3);
+    data[CACHE_NORMALS]= mesh.normals().data();
+    header.count[CACHE_COLORS]= mesh.colors().size();
+    header.size[CACHE_COLORS]= mesh.colors().size() * sizeof(vec4);
+    data[CACHE_COLORS]= mesh.colors().data();
+    header.count[CACHE_INDICES]= mesh.indices().size();
+    header.size[CACHE_INDICES]= mesh.indices().size() * sizeof(unsigned int);
+    data[CACHE_INDICES]= mesh.indices().data();
+    header.count[CACHE_MATERIAL_INDICES]= mesh.material_indices().size();
+    header.size[CACHE_MATERIAL_INDICES]= mesh.material_indices().size() * sizeof(unsigned int);
+    data[CACHE_MATERIAL_INDICES]= mesh.material_indices().data();
+    header.count[CACHE_MATERIALS]= uint64_t(mesh.materials().count());
+    header.size[CACHE_MATERIALS]= materials.size();
+    data[CACHE_MATERIALS]= materials.data();
+
+    // place les blocs
+    uint64_t offset= sizeof(header);
+    for(int i= 0; i < CACHE_BLOCKS; i++)
+    {
+        offset= (offset + mesh_cache_align -1) / mesh_cache_align * mesh_cache_align;
+        header.offset[i]= offset;
+        offset+= header.size[i];
+    }
+
+    // ecrit un fichier temporaire, puis le renomme : les autres processus ne voient jamais un cache incomplet.
+    // nom unique, plusieurs processus peuvent ecrire le meme cache en meme temps
+    std::string tmp= temporary_filename(filename);
+    FILE *out= fopen(tmp.c_str(), "wb");
+    if(out == nullptr)
+    {
+        printf("[error] writing mesh cache '%s'...\n", filename);
+        return -1;
+    }
+
+    printf("writing mesh cache '%s'...\n", filename);
+
+    bool error= (fwrite(&header, sizeof(header), 1, out) != 1);
+    const char padding[mesh_cache_align]= { };
+    uint64_t position= sizeof(header);
+    for(int i= 0; i < CACHE_BLOCKS && !error; i++)
+    {
+        if(header.offset[i] > position)
+            error= (fwrite(padding, header.offset[i] - position, 1, out) != 1);
+        if(header.size[i] > 0 && !error)
+            error= (fwrite(data[i], header.size[i], 1, out) != 1);
+
+        position= header.offset[i] + header.size[i];
+    }
+
+    if(fclose(out) != 0)
+        error= true;
+
+    if(!error)
+    {
+#ifdef _WIN32
+        remove(filename);   // windows ne remplace pas un fichier existant...
+#endif
+        // posix : rename() remplace le fichier de maniere atomique, l'ancien fichier reste lisible jusqu'au renommage
+        error= (rename(tmp.c_str(), filename) != 0);
+    }
+
+    if(error)
+    {
+        remove(tmp.c_str());
+        printf("[error] writing mesh cache '%s'...\n", filename);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+Mesh read_mesh_cache( const char *filename, const size_t source_timestamp )
+{
+    MappedFile file= map_file(filename);
+    if(file.data == nullptr)
+        return Mesh::error();
+
+    MeshCacheHeader header;
+    if(file.size < sizeof(header))
+    {
+        unmap_file(file);
+        return Mesh::error();
+    }
+
+    memcpy(&header, file.data, sizeof(header));
+    if(memcmp(header.magic, mesh_cache_magic, sizeof(header.magic)) != 0 || header.version != mesh_cache_version)
+    {
+        printf("[error] invalid mesh cache '%s'...\n", filename);
+        unmap_file(file);
+        return Mesh::error();
+    }
+
+    if(source_timestamp && header.source_timestamp != uint64_t(source_timestamp))
+    {
+        // cache perime
+        unmap_file(file);
+        return Mesh::error();
+    }
+
+    // verifie la taille des blocs
+    const uint64_t element_size[CACHE_BLOCKS]= { sizeof(vec3), sizeof(vec2), sizeof(vec3), sizeof(vec4), sizeof(unsigned int), sizeof(unsigned int), 0 };
+    for(int i= 0; i < CACHE_BLOCKS; i++)
+    {
+        if(header.offset[i] > file.size || header.size[i] > file.size - header.offset[i]
+        || (element_size[i] && header.count[i] * element_size[i] != header.size[i]))
+        {
+            printf("[error] invalid mesh cache '%s'...\n", filename);
+            unmap_file(file);
+            return Mesh::error();
+        }
+    }
+
+    Mesh mesh(GLenum(header.primitives));
+    if(!read_materials_block(file.data + header.offset[CACHE_MATERIALS], header.size[CACHE_MATERIALS], mesh.m_materials))
+    {
+        printf("[error] invalid mesh cache '%s'...\n", filename);
+        unmap_file(file);
+        return Mesh::error();
+    }
+
+    // recopie les attributs, directement depuis la projection du fichier
+    const vec3 *positions= (const vec3 *) (file.data + header.offset[CACHE_POSITIONS]);
+    const vec2 *texcoords= (const vec2 *) (file.data + header.offset[CACHE_TEXCOORDS]);
+    const vec3 *normals= (const vec3 *) (file.data + header.offset[CACHE_NORMALS]);
+    const vec4 *colors= (const vec4 *) (file.data + header.offset[CACHE_COLORS]);
+    const unsigned int *indices= (const unsigned int *) (file.data + header.offset[CACHE_INDICES]);
+    const unsigned int *material_indices= (const unsigned int *) (file.data + header.offset[CACHE_MATERIAL_INDICES]);
+
+    mesh.m_positions.assign(positions, positions + header.count[CACHE_POSITIONS]);
+    mesh.m_texcoords.assign(texcoords, texcoords + header.count[CACHE_TEXCOORDS]);
+    mesh.m_normals.assign(normals, normals + header.count[CACHE_NORMALS]);
+    mesh.m_colors.assign(colors, colors + header.count[CACHE_COLORS]);
+    mesh.m_indices.assign(indices, indices + header.count[CACHE_INDICES]);
+    mesh.m_triangle_materials.assign(material_indices, material_indices + header.count[CACHE_MATERIAL_INDICES]);
+    mesh.m_color= Color(header.color[0], header.color[1], header.color[2], header.color[3]);
+    mesh.m_update_buffers= true;
+
+    unmap_file(file);
+    return mesh;
+}
+
+
+// fnv-1a 64 bits, par mots de 8 octets, puis octet par octet pour la fin
+static uint64_t hash_data( uint64_t h, const void *data, const size_t size )
+{
+    const uint64_t prime= 1099511628211ull;
+    const char *bytes= (const char *) data;
+
+    size_t i= 0;
+    for(; i + sizeof(uint64_t) <= size; i+= sizeof(uint64_t))
+    {
+        uint64_t v;
+        memcpy(&v, bytes + i, sizeof(v));
+        h= (h ^ v) * prime;
+    }
+    for(; i < size; i++)
+        h= (h ^ uint64_t((unsigned char) bytes[i])) * prime;
+
+    // separe les tableaux consecutifs : {a, b} + {c} et {a} + {b, c} sont differents
+    return (h ^ uint64_t(size)) * prime;
+}
+
+static const uint64_t hash_basis= 14695981039346656037ull;
+
+uint64_t mesh_hash( const Mesh& mesh )
+{
+    uint64_t h= hash_basis;
+    h= hash_data(h, mesh.positions().data(), mesh.positions().size() * sizeof(vec3));
+    h= hash_data(h, mesh.indices().data(), mesh.indices().size() * sizeof(unsigned int));
+    return h;
+}
+
+uint64_t mesh_hash( const GLTFMesh& mesh )
+{
+    uint64_t h= hash_basis;
+    for(unsigned i= 0; i < mesh.primitives.size(); i++)
+    {
+        h= hash_data(h, mesh.primitives[i].positions.data(), mesh.primitives[i].positions.size() * sizeof(vec3));
+        h= hash_data(h, mesh.primitives[i].indices.data(), mesh.primitives[i].indices.size() * sizeof(unsigned));
+    }
+    return h;
+}
+
+
+static
+bool has_extension( const std::string& filename, const char *ext )
+{
+    size_t n= strlen(ext);
+    if(filename.size() < n)
+        return false;
+
+    for(size_t i= 0; i < n; i++)
+        if(tolower(filename[filename.size() - n + i]) != ext[i])
+            return false;
+
+    return true;
+}
+
+Mesh read_mesh_cached( const char *filename, const bool indexed )
+{
+    size_t source_timestamp= timestamp(filename);
+    if(source_timestamp == 0)
+    {
+        printf("[error] loading mesh '%s'...\n", filename);
+        return Mesh::error();
+    }
+
+    std::string cache= std::string(filename) + (indexed ? ".indexed.mesh" : ".mesh");
+
+    auto start= std::chrono::high_resolution_clock::now();
+    // Mesh::error() est un mesh vide, les copies ne peuvent pas etre comparees avec ==
+    Mesh mesh= read_mesh_cache(cache.c_str(), source_timestamp);
+    if(mesh.vertex_count() > 0)
+    {
+        auto stop= std::chrono::high_resolution_clock::now();
+        int cpu= int(std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count());
+        printf("mesh '%s': cache '%s', %d triangles, %d positions, %dms\n", filename, cache.c_str(), mesh.triangle_count(), mesh.vertex_count(), cpu);
+        return mesh;
+    }
+
+    // pas de cache, ou cache perime, charge le fichier source
+    if(has_extension(filename, ".obj"))
+        mesh= indexed ? read_indexed_mesh_parallel(filename) : read_mesh_parallel(filename);
+    else if(has_extension(filename, ".gltf") || has_extension(filename, ".glb"))
+        mesh= read_gltf_mesh(filename);
+    else
+    {
+        printf("[error] loading mesh '%s': unknown format...\n", filename);
+        return Mesh::error();
+    }
+
+    if(mesh.vertex_count() == 0)
+        return Mesh::error();
+
+    write_mesh_cache(mesh, cache.c_str(), source_timestamp);
+    return mesh;
+}
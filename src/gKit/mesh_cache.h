@@ -0,0 +1,40 @@
+#ifndef _MESH_CACHE_H
+#define _MESH_CACHE_H
+
+#include <cstdint>
+
+#include "mesh.h"
+
+struct GLTFMesh;
+
+
+//! \addtogroup objet3D
+///@{
+
+//! \file
+//! cache binaire des meshs : evite d'analyser plusieurs fois le meme fichier .obj / .gltf.
+
+/*! charge un fichier .obj, .gltf ou .glb et renvoie un mesh, indexe ou pas.
+    la premiere fois, le fichier est analyse normalement et le mesh est enregistre dans un cache binaire, a cote du fichier source,
+    'filename.mesh' ou 'filename.indexed.mesh'. les chargements suivants projettent le cache en memoire et recopient directement les attributs, sans analyse.
+    le cache est reconstruit si le fichier source a ete modifie, cf timestamp().
+ */
+Mesh read_mesh_cached( const char *filename, const bool indexed= false );
+
+//! enregistre un mesh dans un cache binaire. source_timestamp : date de modification du fichier source, cf timestamp(). renvoie -1 en cas d'erreur.
+int write_mesh_cache( const Mesh& mesh, const char *filename, const size_t source_timestamp= 0 );
+
+/*! charge un mesh enregistre par write_mesh_cache(). renvoie Mesh::error() si le fichier n'existe pas, n'est pas valide,
+    ou si la date du fichier source est differente de source_timestamp (0 : pas de verification).
+ */
+Mesh read_mesh_cache( const char *filename, const size_t source_timestamp= 0 );
+
+/*! empreinte du contenu d'un mesh : positions et indices. identifie les donnees derivees du mesh, quel que soit le fichier source,
+    cf BVHT::build_cached().
+ */
+uint64_t mesh_hash( const Mesh& mesh );
+//! empreinte du contenu d'un maillage glTF : positions et indices de chaque groupe de triangles.
+uint64_t mesh_hash( const GLTFMesh& mesh );
+
+///@}
+#endif
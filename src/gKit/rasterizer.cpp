@@ -0,0 +1,715 @@
+
+#include <cstdio>
+#include <cmath>
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
+
+#include "rasterizer.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+Rasterizer::Rasterizer( const int width, const int height, const int tile_size, const RasterizerMode mode )
+    : m_tiles(), m_triangles(), m_draws(), m_draw_count(0), m_bins(), m_clipped(), m_blocks(0), m_mode(mode),
+    m_width(width), m_height(height), m_tile_size()
+{
+    // tuiles decoupees en blocs 8x8
+    m_tile_size= std::max(1, (tile_size + raster_block_size -1) / raster_block_size) * raster_block_size;
+
+    m_tiles_x= (m_width + m_tile_size -1) / m_tile_size;
+    m_tiles_y= (m_height + m_tile_size -1) / m_tile_size;
+
+    m_tiles.resize(m_tiles_x * m_tiles_y);
+    for(int ty= 0; ty < m_tiles_y; ty++)
+    for(int tx= 0; tx < m_tiles_x; tx++)
+    {
+        Tile& tile= m_tiles[ty * m_tiles_x + tx];
+        tile.x= tx * m_tile_size;
+        tile.y= ty * m_tile_size;
+        tile.width= std::min(m_tile_size, m_width - tile.x);
+        tile.height= std::min(m_tile_size, m_height - tile.y);
+    }
+
+    clear();
+}
+
+void Rasterizer::clear( const Color& color, const float z )
+{
+    const int tiles= int(m_tiles.size());
+#pragma omp parallel for schedule(static)
+    for(int i= 0; i < tiles; i++)
+    {
+        Tile& tile= m_tiles[i];
+        tile.color.assign(m_tile_size * m_tile_size, color);
+        tile.depth.assign(m_tile_size * m_tile_size, z);
+        if(m_mode == RASTER_VISIBILITY)
+        {
+            Visibility empty= { -1, -1, 0, 0, 0 };
+            tile.visibility.assign(m_tile_size * m_tile_size, empty);
+        }
+
+        int blocks= m_tile_size / raster_block_size;
+        tile.block_zmin.assign(blocks * blocks, z);
+        tile.block_zmax.assign(blocks * blocks, z);
+        tile.zmin= z;
+        tile.zmax= z;
+    }
+
+    m_draw_count= 0;
+    stats= RasterizerStats();
+}
+
+Image Rasterizer::image( ) const
+{
+    Image image(m_width, m_height);
+    for(unsigned i= 0; i < m_tiles.size(); i++)
+    {
+        const Tile& tile= m_tiles[i];
+        for(int y= 0; y < tile.height; y++)
+        for(int x= 0; x < tile.width; x++)
+            image(tile.x + x, tile.y + y)= tile.color[y * m_tile_size + x];
+    }
+
+    return image;
+}
+
+ZBuffer Rasterizer::depth( ) const
+{
+    ZBuffer depth(m_width, m_height);
+    for(unsigned i= 0; i < m_tiles.size(); i++)
+    {
+        const Tile& tile= m_tiles[i];
+        for(int y= 0; y < tile.height; y++)
+        for(int x= 0; x < tile.width; x++)
+            depth(tile.x + x, tile.y + y)= tile.depth[y * m_tile_size + x];
+    }
+
+    return depth;
+}
+
+
+int Rasterizer::begin_draw( const unsigned int *indices, const int count, const int varyings )
+{
+    // conserve les sommets transformes de chaque draw jusqu'a shade(), ou uniquement ceux du dernier draw
+    const int draw= (m_mode == RASTER_VISIBILITY) ? m_draw_count : 0;
+    if(int(m_draws.size()) <= draw)
+        m_draws.resize(draw +1);
+    m_draw_count= draw +1;
+
+    // sommets utilises par les triangles
+    int first= 0;
+    int last= count -1;
+    if(indices)
+    {
+        first= int(indices[0]);
+        last= int(indices[0]);
+        for(int i= 1; i < count; i++)
+        {
+            first= std::min(first, int(indices[i]));
+            last= std::max(last, int(indices[i]));
+        }
+    }
+
+    Draw& vertices= m_draws[draw];
+    vertices.indices= indices;
+    vertices.first= first;
+    vertices.count= last - first +1;
+    vertices.varyings= varyings;
+    vertices.cx.resize(vertices.count);
+    vertices.cy.resize(vertices.count);
+    vertices.cz.resize(vertices.count);
+    vertices.cw.resize(vertices.count);
+    vertices.x.resize(vertices.count);
+    vertices.y.resize(vertices.count);
+    vertices.z.resize(vertices.count);
+    vertices.inv_w.resize(vertices.count);
+    vertices.clip.resize(vertices.count);
+    vertices.attributes.resize(size_t(varyings) * vertices.count);
+    return draw;
+}
+
+// bande de garde dans le repere projectif : |x| <= gx * w et |y| <= gy * w, les sommets restent a moins de 2^14 pixels de l'origine de l'image
+static void guard_band( const int width, const int height, float& gx, float& gy )
+{
+    const float guard= float(1 << raster_guard_bits);
+    gx= std::max(1.f, (guard - width / 2.f) / (width / 2.f));
+    gy= std::max(1.f, (guard - height / 2.f) / (height / 2.f));
+}
+
+void Rasterizer::viewport( Draw& draw, const int begin, const int end ) const
+{
+    // codes de decoupage dans le repere projectif, puis division par w et passage dans le repere image, cf Viewport(), par composantes
+    const float w= m_width / 2.f;
+    const float h= m_height / 2.f;
+    float gx, gy;
+    guard_band(m_width, m_height, gx, gy);
+
+    const float *cx= draw.cx.data();
+    const float *cy= draw.cy.data();
+    const float *cz= draw.cz.data();
+    const float *cw= draw.cw.data();
+    float *x= draw.x.data();
+    float *y= draw.y.data();
+    float *z= draw.z.data();
+    float *inv_w= draw.inv_w.data();
+    unsigned char *clip= draw.clip.data();
+    for(int i= begin; i < end; i++)
+    {
+        // les sommets hors de la bande de garde, ou invalides (nan), sont decoupes, cf clip()
+        bool guard= (std::abs(cx[i]) <= gx * cw[i]) & (std::abs(cy[i]) <= gy * cw[i]);
+        clip[i]= (unsigned char) ((cx[i] < -cw[i]) | (cx[i] > cw[i]) << 1 | (cy[i] < -cw[i]) << 2 | (cy[i] > cw[i]) << 3
+            | (cz[i] < -cw[i]) << 4 | (cz[i] > cw[i]) << 5 | !guard << 6);
+
+        inv_w[i]= 1 / cw[i];
+        x[i]= cx[i] * inv_w[i] * w + w;
+        y[i]= cy[i] * inv_w[i] * h + h;
+        z[i]= cz[i] * inv_w[i] * .5f + .5f;
+    }
+}
+
+int Rasterizer::setup( const Draw& draw, const int n )
+{
+    m_triangles.resize(n);
+    int culled= 0;
+#pragma omp parallel for schedule(dynamic, 1024) reduction(+: culled)
+    for(int i= 0; i < n; i++)
+        if(!setup(draw, i, m_triangles[i]))
+            culled++;
+
+    return culled;
+}
+
+long long Rasterizer::bin( const Draw& draw, const int n, int& clipped, int& culled )
+{
+    const int tiles= int(m_tiles.size());
+
+    // un bloc de triangles consecutifs par thread, et une liste par tuile pour chaque bloc : les triangles restent dans l'ordre.
+    m_blocks= 1;
+#ifdef _OPENMP
+    m_blocks= std::max(1, std::min(omp_get_max_threads(), n / 4096));
+#endif
+    if(m_bins.size() < size_t(m_blocks) * tiles)
+        m_bins.resize(size_t(m_blocks) * tiles);
+    if(m_clipped.size() < size_t(m_blocks))
+        m_clipped.resize(m_blocks);
+
+    long long binned= 0;
+    int clipped_count= 0;
+    int culled_count= 0;
+#pragma omp parallel for schedule(static, 1) reduction(+: binned, clipped_count, culled_count)
+    for(int b= 0; b < m_blocks; b++)
+    {
+        std::vector<int> *bins= m_bins.data() + size_t(b) * tiles;
+        for(int t= 0; t < tiles; t++)
+            bins[t].clear();
+
+        // les triangles decoupes sont stockes avec le bloc, indices negatifs dans les listes des tuiles
+        std::vector<RasterTriangle>& triangles= m_clipped[b];
+        triangles.clear();
+
+        int begin= int(size_t(n) * b / m_blocks);
+        int end= int(size_t(n) * (b+1) / m_blocks);
+        for(int i= begin; i < end; i++)
+        {
+            const RasterTriangle& triangle= m_triangles[i];
+            if(triangle.id < 0)
+                continue;
+
+            int first= i;
+            int last= i;
+            if(triangle.clip)
+            {
+                clipped_count++;
+                first= int(triangles.size());
+                last= first + clip(draw, triangle.id, triangles) -1;
+                if(last < first)
+                    culled_count++;
+            }
+
+            for(int k= first; k <= last; k++)
+            {
+                const RasterTriangle& t= triangle.clip ? triangles[k] : triangle;
+                int index= triangle.clip ? -(k+1) : k;
+                for(int ty= t.ymin / m_tile_size; ty <= t.ymax / m_tile_size; ty++)
+                for(int tx= t.xmin / m_tile_size; tx <= t.xmax / m_tile_size; tx++)
+                {
+                    bins[ty * m_tiles_x + tx].push_back(index);
+                    binned++;
+                }
+            }
+        }
+    }
+
+    clipped= clipped_count;
+    culled= culled_count;
+    return binned;
+}
+
+bool Rasterizer::setup( const Draw& draw, const int primitive_id, RasterTriangle& triangle ) const
+{
+    triangle.id= -1;
+    triangle.clip= false;
+
+    // sommets du triangle, deja transformes
+    int v[3];
+    for(int i= 0; i < 3; i++)
+        v[i]= (draw.indices ? int(draw.indices[3*primitive_id + i]) : 3*primitive_id + i) - draw.first;
+
+    // elimine les triangles dont tous les sommets sont du meme cote d'un plan de la region observee par la camera
+    int clip0= draw.clip[v[0]];
+    int clip1= draw.clip[v[1]];
+    int clip2= draw.clip[v[2]];
+    if(clip0 & clip1 & clip2 & 63)
+        return false;
+
+    // les triangles qui traversent le plan near, le plan far ou la bande de garde sont decoupes pendant la repartition dans les tuiles, cf bin()
+    if((clip0 | clip1 | clip2) & (clip_near | clip_far | clip_guard))
+    {
+        triangle.id= primitive_id;
+        triangle.clip= true;
+        return true;
+    }
+
+    Point p[3];
+    float inv_w[3];
+    float bary[3][3]= { };
+    for(int i= 0; i < 3; i++)
+    {
+        p[i]= Point(draw.x[v[i]], draw.y[v[i]], draw.z[v[i]]);
+        inv_w[i]= draw.inv_w[v[i]];
+    }
+    // sommets a, b, c : (u, v, w)= (0, 1, 0), (0, 0, 1), (1, 0, 0), cf Fragment
+    bary[0][1]= inv_w[0];
+    bary[1][2]= inv_w[1];
+    bary[2][0]= inv_w[2];
+
+    return setup(p, inv_w, bary, primitive_id, triangle);
+}
+
+bool Rasterizer::setup( const Point p[3], const float inv_w[3], const float bary[3][3], const int primitive_id, RasterTriangle& triangle ) const
+{
+    triangle.id= -1;
+    triangle.clip= false;
+
+    // les sommets decoupes peuvent sortir tres legerement de la bande de garde, a cause des arrondis, mais pas les calculs en virgule fixe
+    const float guard= float(2 << raster_guard_bits);
+    for(int i= 0; i < 3; i++)
+        if(!(std::abs(p[i].x) <= guard && std::abs(p[i].y) <= guard))
+            return false;
+
+    // arrondit les sommets sur la grille de sous-pixels
+    int64_t x[3], y[3];
+    for(int i= 0; i < 3; i++)
+    {
+        x[i]= int64_t(std::lround(p[i].x * raster_subpixels));
+        y[i]= int64_t(std::lround(p[i].y * raster_subpixels));
+    }
+
+    // aire du triangle abc, elimine les triangles mal orientes et degeneres
+    int64_t area= (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if(area <= 0)
+        return false;
+
+    // englobant : pixels dont le centre est a l'interieur de l'englobant du triangle
+    const int64_t half= raster_subpixels / 2;
+    int64_t xmin= std::min(x[0], std::min(x[1], x[2]));
+    int64_t xmax= std::max(x[0], std::max(x[1], x[2]));
+    int64_t ymin= std::min(y[0], std::min(y[1], y[2]));
+    int64_t ymax= std::max(y[0], std::max(y[1], y[2]));
+    // floor( (v - half) / subpixels ), ceil( (v - half) / subpixels ), decalages arithmetiques pour les valeurs negatives
+    triangle.xmin= int(std::max(int64_t(0), (xmin - half + raster_subpixels -1) >> raster_subpixel_bits));
+    triangle.ymin= int(std::max(int64_t(0), (ymin - half + raster_subpixels -1) >> raster_subpixel_bits));
+    triangle.xmax= int(std::min(int64_t(m_width -1), (xmax - half) >> raster_subpixel_bits));
+    triangle.ymax= int(std::min(int64_t(m_height -1), (ymax - half) >> raster_subpixel_bits));
+    // le triangle passe entre les pixels...
+    if(triangle.xmin > triangle.xmax || triangle.ymin > triangle.ymax)
+        return false;
+
+    // fonctions d'aretes ab, bc, ca, cf http://geomalgorithms.com/a01-_area.html
+    // calculs exacts en virgule fixe : une arete partagee par 2 triangles est parcourue dans les 2 sens, les fonctions sont exactement opposees,
+    // un pixel sur l'arete appartient a un seul des 2 triangles, celui pour lequel l'arete est "proprietaire".
+    triangle.owner= 0;
+    for(int i= 0; i < 3; i++)
+    {
+        int a= i;
+        int b= (i+1) % 3;
+        triangle.A[i]= y[a] - y[b];
+        triangle.B[i]= x[b] - x[a];
+        triangle.C[i]= x[a] * y[b] - y[a] * x[b];
+        if(triangle.A[i] > 0 || (triangle.A[i] == 0 && triangle.B[i] > 0))
+            triangle.owner|= 1 << i;
+
+        // les decoupes peuvent produire des profondeurs tres legerement hors de [0 1]
+        triangle.z[i]= std::min(1.f, std::max(0.f, p[i].z));
+        triangle.inv_w[i]= inv_w[i];
+        for(int k= 0; k < 3; k++)
+            triangle.bary[i][k]= bary[i][k];
+    }
+
+    triangle.zmin= std::min(triangle.z[0], std::min(triangle.z[1], triangle.z[2]));
+    triangle.zmax= std::max(triangle.z[0], std::max(triangle.z[1], triangle.z[2]));
+    triangle.inv_area= 1 / float(area);
+    triangle.id= primitive_id;
+    return true;
+}
+
+int Rasterizer::clip( const Draw& draw, const int primitive_id, std::vector<RasterTriangle>& triangles ) const
+{
+    // sommets du triangle dans le repere projectif, avant la division par w
+    ClipVertex polygons[2][16];
+    ClipVertex *polygon= polygons[0];
+    ClipVertex *output= polygons[1];
+    int n= 3;
+
+    int codes= 0;
+    for(int i= 0; i < 3; i++)
+    {
+        int v= (draw.indices ? int(draw.indices[3*primitive_id + i]) : 3*primitive_id + i) - draw.first;
+        ClipVertex& p= polygon[i];
+        p.x= draw.cx[v];
+        p.y= draw.cy[v];
+        p.z= draw.cz[v];
+        p.w= draw.cw[v];
+        p.b[0]= p.b[1]= p.b[2]= 0;
+        p.b[i]= 1;
+        p.source= v;
+        // elimine les triangles avec un sommet invalide
+        if(!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z) || !std::isfinite(p.w))
+            return 0;
+
+        codes|= draw.clip[v];
+    }
+
+    // plans near, far, et bande de garde : d(p)= dot(plane, p) >= 0 a l'interieur
+    float gx, gy;
+    guard_band(m_width, m_height, gx, gy);
+    const float planes[6][4]=
+    {
+        { 0, 0, 1, 1 }, { 0, 0, -1, 1 },
+        { 1, 0, 0, gx }, { -1, 0, 0, gx },
+        { 0, 1, 0, gy }, { 0, -1, 0, gy }
+    };
+    const int masks[6]= { clip_near, clip_far, clip_guard, clip_guard, clip_guard, clip_guard };
+
+    // algorithme de Sutherland-Hodgman, un plan apres l'autre
+    for(int k= 0; k < 6 && n >= 3; k++)
+    {
+        if((codes & masks[k]) == 0)
+            continue;
+
+        const float *plane= planes[k];
+        float d[16];
+        for(int i= 0; i < n; i++)
+            d[i]= plane[0] * polygon[i].x + plane[1] * polygon[i].y + plane[2] * polygon[i].z + plane[3] * polygon[i].w;
+
+        int m= 0;
+        for(int i= 0; i < n; i++)
+        {
+            int j= (i+1) % n;
+            bool in_i= d[i] >= 0;
+            bool in_j= d[j] >= 0;
+            if(in_i)
+                output[m++]= polygon[i];
+
+            if(in_i != in_j)
+            {
+                // calcule toujours l'intersection depuis le sommet interieur : une arete partagee par 2 triangles est decoupee au meme point
+                const ClipVertex& a= in_i ? polygon[i] : polygon[j];
+                const ClipVertex& b= in_i ? polygon[j] : polygon[i];
+                float da= in_i ? d[i] : d[j];
+                float db= in_i ? d[j] : d[i];
+                float t= da / (da - db);
+
+                ClipVertex& p= output[m++];
+                p.x= a.x + t * (b.x - a.x);
+                p.y= a.y + t * (b.y - a.y);
+                p.z= a.z + t * (b.z - a.z);
+                p.w= a.w + t * (b.w - a.w);
+                for(int c= 0; c < 3; c++)
+                    p.b[c]= a.b[c] + t * (b.b[c] - a.b[c]);
+                p.source= -1;
+            }
+        }
+
+        std::swap(polygon, output);
+        n= m;
+    }
+
+    if(n < 3)
+        return 0;
+
+    // passage dans le repere image, les sommets non modifies sont projetes exactement comme par viewport()
+    const float w= m_width / 2.f;
+    const float h= m_height / 2.f;
+    Point points[16];
+    float inv_w[16];
+    float bary[16][3];
+    for(int i= 0; i < n; i++)
+    {
+        const ClipVertex& p= polygon[i];
+        if(p.source >= 0)
+        {
+            inv_w[i]= draw.inv_w[p.source];
+            points[i]= Point(draw.x[p.source], draw.y[p.source], draw.z[p.source]);
+        }
+        else
+        {
+            inv_w[i]= 1 / p.w;
+            points[i]= Point(p.x * inv_w[i] * w + w, p.y * inv_w[i] * h + h, p.z * inv_w[i] * .5f + .5f);
+        }
+
+        // poids des sommets a, b, c, vers les coordonnees barycentriques (u, v, w), cf Fragment
+        bary[i][0]= p.b[2] * inv_w[i];
+        bary[i][1]= p.b[0] * inv_w[i];
+        bary[i][2]= p.b[1] * inv_w[i];
+    }
+
+    // triangule le polygone convexe
+    int count= 0;
+    for(int i= 1; i +1 < n; i++)
+    {
+        Point p[3]= { points[0], points[i], points[i+1] };
+        float iw[3]= { inv_w[0], inv_w[i], inv_w[i+1] };
+        float b[3][3];
+        for(int c= 0; c < 3; c++)
+        {
+            b[0][c]= bary[0][c];
+            b[1][c]= bary[i][c];
+            b[2][c]= bary[i+1][c];
+        }
+
+        RasterTriangle triangle;
+        if(setup(p, iw, b, primitive_id, triangle))
+        {
+            triangles.push_back(triangle);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+
+void Rasterizer::varyings( const Draw& draw, const int primitive_id, float *abc ) const
+{
+    for(int i= 0; i < 3; i++)
+    {
+        int v= (draw.indices ? int(draw.indices[3*primitive_id + i]) : 3*primitive_id + i) - draw.first;
+        for(int k= 0; k < draw.varyings; k++)
+            abc[3*k + i]= draw.attributes[size_t(k) * draw.count + v];
+    }
+}
+
+
+// e : fonctions d'aretes au centre du premier pixel du bloc, dx, dy : increments entre 2 pixels,
+// un pixel est a l'interieur si e > bias pour les 3 aretes.
+// les valeurs sont des entiers < 2^53, representes exactement par des doubles.
+uint64_t Rasterizer::block_coverage( const int64_t e[3], const int64_t dx[3], const int64_t dy[3], const int64_t bias[3] )
+{
+    uint64_t mask= ~uint64_t(0);
+    for(int i= 0; i < 3; i++)
+    {
+        uint64_t edge= 0;
+#ifdef __AVX__
+        double step= double(dx[i]);
+        __m256d step0= _mm256_set_pd(3 * step, 2 * step, step, 0);
+        __m256d step1= _mm256_add_pd(step0, _mm256_set1_pd(4 * step));
+        __m256d b= _mm256_set1_pd(double(bias[i]));
+        for(int y= 0; y < raster_block_size; y++)
+        {
+            __m256d row= _mm256_set1_pd(double(e[i] + y * dy[i]));
+            int bits= _mm256_movemask_pd(_mm256_cmp_pd(_mm256_add_pd(row, step0), b, _CMP_GT_OQ))
+                | _mm256_movemask_pd(_mm256_cmp_pd(_mm256_add_pd(row, step1), b, _CMP_GT_OQ)) << 4;
+            edge|= uint64_t(bits) << (y * raster_block_size);
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        double step= double(dx[i]);
+        __m128d step0= _mm_set_pd(step, 0);
+        __m128d step2= _mm_set1_pd(2 * step);
+        __m128d b= _mm_set1_pd(double(bias[i]));
+        for(int y= 0; y < raster_block_size; y++)
+        {
+            __m128d v= _mm_add_pd(_mm_set1_pd(double(e[i] + y * dy[i])), step0);
+            int bits= 0;
+            for(int x= 0; x < raster_block_size; x+= 2, v= _mm_add_pd(v, step2))
+                bits|= _mm_movemask_pd(_mm_cmpgt_pd(v, b)) << x;
+            edge|= uint64_t(bits) << (y * raster_block_size);
+        }
+#else
+        for(int y= 0; y < raster_block_size; y++)
+        for(int x= 0; x < raster_block_size; x++)
+            if(e[i] + x * dx[i] + y * dy[i] > bias[i])
+                edge|= uint64_t(1) << (y * raster_block_size + x);
+#endif
+        mask&= edge;
+    }
+
+    return mask;
+}
+
+void Rasterizer::update_block( Tile& tile, const int b ) const
+{
+    const int blocks_x= m_tile_size / raster_block_size;
+    const float *depth= tile.depth.data() + ((b / blocks_x) * m_tile_size + (b % blocks_x)) * raster_block_size;
+
+    float zmin= depth[0];
+    float zmax= depth[0];
+    for(int y= 0; y < raster_block_size; y++)
+    for(int x= 0; x < raster_block_size; x++)
+    {
+        zmin= std::min(zmin, depth[y * m_tile_size + x]);
+        zmax= std::max(zmax, depth[y * m_tile_size + x]);
+    }
+    tile.block_zmin[b]= zmin;
+    tile.block_zmax[b]= zmax;
+}
+
+void Rasterizer::update_tile( Tile& tile ) const
+{
+    tile.zmin= tile.block_zmin[0];
+    tile.zmax= tile.block_zmax[0];
+    for(unsigned k= 1; k < tile.block_zmin.size(); k++)
+    {
+        tile.zmin= std::min(tile.zmin, tile.block_zmin[k]);
+        tile.zmax= std::max(tile.zmax, tile.block_zmax[k]);
+    }
+}
+
+
+long long Rasterizer::shade( const int index )
+{
+    Tile& tile= m_tiles[index];
+
+    // regroupe les pixels visibles par draw, matiere et primitive, pour executer le meme shader sur les memes donnees
+    struct Pixel
+    {
+        int draw;
+        int material;
+        int primitive;
+        int offset;
+
+        bool operator< ( const Pixel& b ) const
+        {
+            if(draw != b.draw) return draw < b.draw;
+            if(material != b.material) return material < b.material;
+            if(primitive != b.primitive) return primitive < b.primitive;
+            return offset < b.offset;
+        }
+    };
+
+    std::vector<Pixel> pixels;
+    for(int y= 0; y < tile.height; y++)
+    for(int x= 0; x < tile.width; x++)
+    {
+        int offset= y * m_tile_size + x;
+        const Visibility& pixel= tile.visibility[offset];
+        if(pixel.primitive < 0)
+            continue;
+
+        const Draw& draw= m_draws[pixel.draw];
+        Pixel p= { pixel.draw, draw.material(draw.pipeline, pixel.primitive), pixel.primitive, offset };
+        pixels.push_back(p);
+    }
+
+    std::sort(pixels.begin(), pixels.end());
+
+    // shade les pixels par groupes de 8 pixels de la meme primitive, cf FragmentBatch
+    float abc[3 * raster_max_varyings];
+    FragmentBatch batch;
+    Color colors[FragmentBatch::size];
+    for(unsigned i= 0; i < pixels.size(); )
+    {
+        const Draw& draw= m_draws[pixels[i].draw];
+        const int primitive= pixels[i].primitive;
+        if(draw.varyings > 0)
+            varyings(draw, primitive, abc);
+
+        // reconstruit les fragments
+        int count= 0;
+        for(; count < FragmentBatch::size && i + count < pixels.size(); count++)
+        {
+            const Pixel& p= pixels[i + count];
+            if(p.draw != pixels[i].draw || p.primitive != primitive)
+                break;
+
+            const Visibility& pixel= tile.visibility[p.offset];
+            batch.x[count]= float(tile.x + p.offset % m_tile_size);
+            batch.y[count]= float(tile.y + p.offset / m_tile_size);
+            batch.z[count]= tile.depth[p.offset];
+            batch.u[count]= pixel.u;
+            batch.v[count]= pixel.v;
+            batch.w[count]= pixel.w;
+        }
+        // complete le groupe avec le dernier fragment, les fragments invalides ne sont pas dessines
+        for(int x= count; x < FragmentBatch::size; x++)
+        {
+            batch.x[x]= batch.x[count -1];
+            batch.y[x]= batch.y[count -1];
+            batch.z[x]= batch.z[count -1];
+            batch.u[x]= batch.u[count -1];
+            batch.v[x]= batch.v[count -1];
+            batch.w[x]= batch.w[count -1];
+        }
+
+        batch.mask= (1u << count) -1;
+        batch.varying_count= draw.varyings;
+        for(int k= 0; k < draw.varyings; k++)
+        for(int x= 0; x < FragmentBatch::size; x++)
+            batch.varyings[k][x]= batch.u[x] * abc[3*k +2] + batch.v[x] * abc[3*k] + batch.w[x] * abc[3*k +1];
+
+        // evalue la couleur des fragments
+        draw.shade(draw.pipeline, primitive, batch, colors);
+
+        for(int x= 0; x < count; x++)
+        {
+            const Pixel& p= pixels[i + x];
+            tile.color[p.offset]= Color(colors[x], 1);
+            // le pixel est shade, les prochains draw() peuvent le modifier
+            tile.visibility[p.offset].primitive= -1;
+        }
+
+        i+= count;
+    }
+
+    return (long long) pixels.size();
+}
+
+void Rasterizer::draw( const Pipeline& pipeline, const int vertex_count )
+{
+    draw_triangles(pipeline, nullptr, vertex_count);
+}
+
+void Rasterizer::draw( const Pipeline& pipeline, const std::vector<unsigned int>& indices )
+{
+    draw_triangles(pipeline, indices.data(), int(indices.size()));
+}
+
+void Rasterizer::shade( )
+{
+    if(m_mode != RASTER_VISIBILITY)
+        return;
+
+    auto start= std::chrono::high_resolution_clock::now();
+
+    // shade les tuiles en parallele
+    const int tiles= int(m_tiles.size());
+    long long shaded= 0;
+#pragma omp parallel for schedule(dynamic, 1) reduction(+: shaded)
+    for(int t= 0; t < tiles; t++)
+        shaded+= shade(t);
+
+    auto stop= std::chrono::high_resolution_clock::now();
+
+    stats.shaded+= shaded;
+    stats.shading_time+= std::chrono::duration<float, std::milli>(stop - start).count();
+}
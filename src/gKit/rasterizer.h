@@ -0,0 +1,786 @@
+#ifndef _RASTERIZER_H
+#define _RASTERIZER_H
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "color.h"
+#include "image.h"
+
+
+//! \addtogroup rasterizer pipeline graphique logiciel
+///@{
+
+//! \file
+//! pipeline graphique logiciel, sans gpu : les triangles sont repartis dans des tuiles, et les tuiles sont dessinees en parallele.
+
+//! zbuffer, profondeur de chaque pixel.
+struct ZBuffer
+{
+    std::vector<float> data;
+    int width;
+    int height;
+
+    ZBuffer( const int w, const int h, const float z= 1 ) : data(w*h, z), width(w), height(h) {}
+
+    void clear( const float value= 1 ) { data.assign(width * height, value); }
+
+    float& operator() ( const int x, const int y )
+    {
+        std::size_t offset= y * width + x;
+        return data[offset];
+    }
+
+    float operator() ( const int x, const int y ) const
+    {
+        std::size_t offset= y * width + x;
+        return data[offset];
+    }
+};
+
+
+//! fragment d'un triangle.
+struct Fragment
+{
+    float x, y, z;  //!< coordonnees espace image
+    float u, v, w;  //!< coordonnees barycentriques du fragment dans le triangle abc, p(u, v, w) = u * c + v * a + w * b, avec correction de perspective
+    const float *varyings;  //!< varyings interpoles du fragment, cf Pipeline::varyings()
+};
+
+
+//! precision des sommets dans l'image : 1/256 pixel.
+static const int raster_subpixel_bits= 8;
+static const int64_t raster_subpixels= 1 << raster_subpixel_bits;
+//! bande de garde : les triangles sont decoupes a 2^14 pixels de l'origine de l'image, pour que les calculs en virgule fixe ne debordent pas.
+static const int raster_guard_bits= 14;
+//! nombre max de varyings par sommet, cf Pipeline::varyings().
+static const int raster_max_varyings= 16;
+
+
+//! modes de dessin, cf Rasterizer.
+enum RasterizerMode
+{
+    RASTER_FORWARD= 0,      //!< le fragment shader est execute pour chaque fragment qui passe le test de profondeur.
+    RASTER_VISIBILITY       //!< visibility buffer : la fragmentation conserve la primitive visible de chaque pixel, shade() execute le fragment shader 1 fois par pixel.
+};
+
+//! taille des blocs de pixels testes ensemble, cf Rasterizer.
+static const int raster_block_size= 8;
+
+
+/*! groupe de fragments d'une ligne d'un bloc 8x8, stockes par composantes, cf ShaderPipeline::fragment_batch().
+    le fragment i est valide si mask & (1 << i), les autres ne sont pas dessines.
+ */
+struct FragmentBatch
+{
+    static const int size= raster_block_size;
+
+    unsigned mask;                                  //!< fragments valides
+    int varying_count;                              //!< nombre de varyings
+    float x[size], y[size], z[size];                //!< coordonnees espace image
+    float u[size], v[size], w[size];                //!< coordonnees barycentriques
+    float varyings[raster_max_varyings][size];      //!< varyings[k][i] : varying k du fragment i
+
+    //! renvoie le fragment i, ses varyings sont recopies dans data.
+    Fragment fragment( const int i, float *data ) const
+    {
+        for(int k= 0; k < varying_count; k++)
+            data[k]= varyings[k][i];
+
+        Fragment fragment= { x[i], y[i], z[i], u[i], v[i], w[i], data };
+        return fragment;
+    }
+};
+
+
+/*! interface du pipeline, cf Rasterizer::draw(). les shaders sont des fonctions virtuelles, cf ShaderPipeline pour un pipeline specialise a la compilation.
+    les shaders sont executes en parallele par plusieurs threads et ne doivent pas modifier de donnees partagees.
+ */
+struct Pipeline
+{
+    Pipeline( ) {}
+    virtual ~Pipeline( ) {}
+
+    /*! vertex shader, doit renvoyer les coordonnees homogenes du sommet dans le repere projectif, avant la division par w.
+        par exemple : return mvp( vec4(p) ); cf Transform::operator()( const vec4& ).
+     */
+    virtual vec4 vertex_shader( const int vertex_id ) const = 0;
+
+    /*! fragment shader, doit renvoyer la couleur du fragment de la primitive
+        les varyings declares par varyings() sont interpoles dans fragment.varyings.
+        sinon, il faut recuperer les infos des sommets de la primitive et faire l'interpolation, fragment.uvw definissent les coefficients.
+        remarque : les gpu amd gcn fonctionnent comme ca...
+     */
+    virtual Color fragment_shader( const int primitive_id, const Fragment fragment ) const = 0;
+
+    //! matiere de la primitive, regroupe les fragments de la meme matiere, cf RASTER_VISIBILITY.
+    virtual int material( const int primitive_id ) const { return 0; }
+
+    //! nombre de varyings par sommet, au plus raster_max_varyings, interpoles pour chaque fragment, cf Fragment::varyings.
+    virtual int varyings( ) const { return 0; }
+
+    /*! vertex shader avec varyings : renvoie les coordonnees homogenes du sommet dans le repere projectif et ecrit ses varyings() valeurs.
+        execute une seule fois par sommet, quel que soit le nombre de triangles qui l'utilisent. par defaut, vertex_shader( vertex_id ).
+     */
+    virtual vec4 vertex_shader( const int vertex_id, float *varyings ) const { return vertex_shader(vertex_id); }
+
+    // interface utilisee par Rasterizer, commune avec ShaderPipeline.
+
+    //! execute vertex_shader( vertex_id, varyings ).
+    vec4 shade_vertex( const int vertex_id, float *varyings ) const { return vertex_shader(vertex_id, varyings); }
+
+    //! execute fragment_shader() sur chaque fragment valide du groupe.
+    void shade_fragments( const int primitive_id, const FragmentBatch& batch, Color *colors ) const
+    {
+        float data[raster_max_varyings];
+        for(int i= 0; i < FragmentBatch::size; i++)
+            if(batch.mask & (1u << i))
+                colors[i]= fragment_shader(primitive_id, batch.fragment(i, data));
+    }
+};
+
+
+
+/*! pipeline specialise a la compilation, sans appels virtuels, cf Rasterizer::draw() : les shaders sont definis par Derived,
+    les varyings par V, une structure de floats, interpolee pour chaque fragment.
+
+    \code
+    struct Varyings { Vector n; };
+
+    struct MyPipeline : public ShaderPipeline<MyPipeline, Varyings>
+    {
+        vec4 vertex_shader( const int vertex_id, Varyings& varyings ) const { ... }
+        Color fragment_shader( const int primitive_id, const Fragment& fragment, const Varyings& varyings ) const { ... }
+    };
+    \endcode
+
+    Derived peut aussi definir material(), cf Pipeline::material(), et fragment_batch() pour shader les fragments d'un FragmentBatch ensemble, par composantes.
+ */
+template < typename Derived, typename V >
+struct ShaderPipeline
+{
+    typedef V Varyings;
+
+    //! nombre de varyings.
+    static const int varying_count= std::is_empty<V>::value ? 0 : int(sizeof(V) / sizeof(float));
+    static_assert(std::is_empty<V>::value || sizeof(V) % sizeof(float) == 0, "ShaderPipeline: varyings are floats");
+    static_assert(varying_count <= raster_max_varyings, "ShaderPipeline: too many varyings");
+
+    int varyings( ) const { return varying_count; }
+    int material( const int primitive_id ) const { return 0; }
+
+    //! par defaut, execute Derived::fragment_shader() sur chaque fragment valide du groupe.
+    void fragment_batch( const int primitive_id, const FragmentBatch& batch, Color *colors ) const
+    {
+        float data[raster_max_varyings];
+        for(int i= 0; i < FragmentBatch::size; i++)
+            if(batch.mask & (1u << i))
+            {
+                Fragment fragment= batch.fragment(i, data);
+                V v;
+                memcpy(&v, data, varying_count * sizeof(float));
+                colors[i]= derived().fragment_shader(primitive_id, fragment, v);
+            }
+    }
+
+    // interface utilisee par Rasterizer, commune avec Pipeline.
+
+    //! execute Derived::vertex_shader().
+    vec4 shade_vertex( const int vertex_id, float *data ) const
+    {
+        V v;
+        vec4 p= derived().vertex_shader(vertex_id, v);
+        memcpy(data, &v, varying_count * sizeof(float));
+        return p;
+    }
+
+    //! execute Derived::fragment_batch().
+    void shade_fragments( const int primitive_id, const FragmentBatch& batch, Color *colors ) const
+    {
+        derived().fragment_batch(primitive_id, batch, colors);
+    }
+
+protected:
+    const Derived& derived( ) const { return static_cast<const Derived&>(*this); }
+};
+
+
+//! statistiques des dessins depuis Rasterizer::clear().
+struct RasterizerStats
+{
+    int vertices;               //!< executions du vertex shader
+    int triangles;              //!< nombre de triangles dessines
+    int culled;                 //!< triangles elimines : hors champ, mal orientes, ou ne couvrant le centre d'aucun pixel
+    int clipped;                //!< triangles decoupes par le plan near, le plan far, ou la bande de garde
+    long long binned;           //!< nombre de paires triangle / tuile, un triangle peut toucher plusieurs tuiles
+    long long tiles_hidden;     //!< paires triangle / tuile eliminees par le hi-z de la tuile
+    long long blocks;           //!< blocs 8x8 de l'englobant des triangles
+    long long blocks_rejected;  //!< blocs elimines par les fonctions d'aretes, sans tester les pixels
+    long long blocks_hidden;    //!< blocs elimines par le hi-z du bloc
+    long long blocks_covered;   //!< blocs entierement couverts par le triangle, sans tester les pixels
+    long long fragments;        //!< fragments couverts par les triangles
+    long long shaded;           //!< executions du fragment shader : fragments qui passent le test de profondeur, ou pixels visibles, cf RASTER_VISIBILITY
+
+    float vertex_time;          //!< transformation des sommets et preparation des triangles, en ms
+    float binning_time;         //!< repartition des triangles dans les tuiles, en ms
+    float raster_time;          //!< fragmentation des tuiles, en ms
+    float shading_time;         //!< execution du fragment shader sur les pixels visibles, en ms, cf RASTER_VISIBILITY
+
+    RasterizerStats( ) : vertices(0), triangles(0), culled(0), clipped(0), binned(0), tiles_hidden(0), blocks(0), blocks_rejected(0), blocks_hidden(0), blocks_covered(0),
+        fragments(0), shaded(0), vertex_time(0), binning_time(0), raster_time(0), shading_time(0) {}
+
+    //! duree totale, en ms.
+    float time( ) const { return vertex_time + binning_time + raster_time + shading_time; }
+};
+
+
+/*! pipeline graphique logiciel, dessine des triangles avec un Pipeline, ou un ShaderPipeline.
+
+    l'image est decoupee en tuiles de tile_size x tile_size pixels, chaque tuile stocke ses couleurs et ses profondeurs.
+    les triangles sont d'abord transformes et prepares en parallele, puis repartis dans les tuiles touchees par leur englobant,
+    chaque tuile est ensuite dessinee par un seul thread.
+    le vertex shader est execute une seule fois par sommet, par groupes de sommets, avant la preparation des triangles,
+    les positions et les varyings des sommets sont stockes par composantes, les fragments interpolent directement les varyings.
+    les triangles sont dessines dans l'ordre dans chaque tuile, le resultat ne depend ni du nombre de threads, ni de la taille des tuiles.
+
+    dans une tuile, un triangle parcourt les blocs de 8x8 pixels de son englobant : les fonctions d'aretes evaluees aux 4 coins d'un bloc
+    eliminent les blocs a l'exterieur du triangle, et acceptent les blocs entierement couverts sans tester les pixels, seuls les blocs
+    partiellement couverts testent leurs pixels, en parallele (sse / avx).
+    la profondeur min / max de chaque bloc et de chaque tuile (hi-z) elimine les triangles caches, et le test de profondeur est fait
+    avant le fragment shader, qui n'est execute que pour les fragments visibles.
+
+    en mode RASTER_VISIBILITY, draw() conserve uniquement la profondeur, la primitive et les coordonnees barycentriques de chaque pixel,
+    et shade() execute ensuite le fragment shader une seule fois par pixel, quel que soit le nombre de triangles dessines par pixel.
+    les pixels de chaque tuile sont shades par matiere et par primitive.
+
+    les fragments visibles d'une ligne de 8 pixels d'un bloc sont shades ensemble, cf FragmentBatch. avec un ShaderPipeline,
+    les shaders sont connus a la compilation : draw() est specialise pour le pipeline, sans appels virtuels, et les shaders peuvent etre inlines et vectorises.
+
+    \code
+    Rasterizer rasterizer(1024, 640);
+    rasterizer.clear(Black());
+    rasterizer.draw(pipeline, mesh.vertex_count());
+    write_image(rasterizer.image(), "render.png");
+    \endcode
+
+    ou avec un mesh indexe, cf read_indexed_mesh() :
+    \code
+    rasterizer.draw(pipeline, mesh.indices());
+    \endcode
+
+    \code
+    Rasterizer rasterizer(1024, 640, 64, RASTER_VISIBILITY);
+    rasterizer.clear(Black());
+    rasterizer.draw(pipeline, mesh.vertex_count());
+    rasterizer.shade();
+    write_image(rasterizer.image(), "render.png");
+    \endcode
+ */
+class Rasterizer
+{
+public:
+    //! constructeur, dimensions de l'image et des tuiles, arrondies sur un multiple de raster_block_size.
+    Rasterizer( const int width, const int height, const int tile_size= 64, const RasterizerMode mode= RASTER_FORWARD );
+
+    //! efface l'image et le zbuffer, et les statistiques.
+    void clear( const Color& color= Black(), const float z= 1 );
+
+    /*! dessine les triangles formes par les sommets [0 .. vertex_count), le triangle i utilise les sommets 3i, 3i+1, 3i+2.
+        les triangles orientes dans le sens horaire, dans l'image, ne sont pas dessines.
+        les triangles qui traversent le plan near ou le plan far sont decoupes dans le repere projectif, avant la division par w,
+        ainsi que les triangles qui sortent de la bande de garde, cf raster_guard_bits.
+        en mode RASTER_VISIBILITY, pipeline doit rester valide jusqu'a shade().
+     */
+    void draw( const Pipeline& pipeline, const int vertex_count );
+
+    /*! dessine les triangles indexes, le triangle i utilise les sommets indices[3i], indices[3i+1], indices[3i+2].
+        chaque sommet de l'intervalle [min .. max] des indices est transforme une seule fois.
+        en mode RASTER_VISIBILITY, indices doit aussi rester valide jusqu'a shade().
+     */
+    void draw( const Pipeline& pipeline, const std::vector<unsigned int>& indices );
+
+    //! dessine les triangles formes par les sommets [0 .. vertex_count) avec un pipeline specialise a la compilation, cf ShaderPipeline.
+    template < typename Derived, typename V >
+    void draw( const ShaderPipeline<Derived, V>& pipeline, const int vertex_count )
+    {
+        draw_triangles(static_cast<const Derived&>(pipeline), nullptr, vertex_count);
+    }
+
+    //! dessine les triangles indexes avec un pipeline specialise a la compilation, cf ShaderPipeline.
+    template < typename Derived, typename V >
+    void draw( const ShaderPipeline<Derived, V>& pipeline, const std::vector<unsigned int>& indices )
+    {
+        draw_triangles(static_cast<const Derived&>(pipeline), indices.data(), int(indices.size()));
+    }
+
+    //! mode RASTER_VISIBILITY, execute le fragment shader des pixels visibles dessines depuis le dernier shade(), apres tous les draw().
+    void shade( );
+
+    //! renvoie l'image.
+    Image image( ) const;
+    //! renvoie le zbuffer.
+    ZBuffer depth( ) const;
+
+    int width( ) const { return m_width; }
+    int height( ) const { return m_height; }
+    int tile_size( ) const { return m_tile_size; }
+    RasterizerMode mode( ) const { return m_mode; }
+
+    //! statistiques depuis clear().
+    RasterizerStats stats;
+
+protected:
+    //! visibility buffer, primitive visible d'un pixel.
+    struct Visibility
+    {
+        int primitive;              //!< indice de la primitive, ou -1
+        int draw;                   //!< indice du draw(), cf Draw
+        float u, v, w;              //!< coordonnees barycentriques du fragment
+    };
+
+    /*! draw() : pipeline, indices et sommets transformes, conserves jusqu'a shade() en mode RASTER_VISIBILITY.
+        les sommets sont stockes par composantes, le sommet i est a l'indice i - first.
+     */
+    struct Draw
+    {
+        const void *pipeline;               //!< Pipeline ou ShaderPipeline
+        void (*shade)( const void *pipeline, const int primitive_id, const FragmentBatch& batch, Color *colors );  //!< shade_fragments() du pipeline
+        int (*material)( const void *pipeline, const int primitive_id );                                        //!< material() du pipeline
+        const unsigned int *indices;        //!< indices des sommets des triangles, ou nullptr : le triangle i utilise les sommets 3i, 3i+1, 3i+2
+        int first;                          //!< premier sommet
+        int count;                          //!< nombre de sommets
+        int varyings;                       //!< nombre de varyings par sommet
+        std::vector<float> cx, cy, cz, cw;  //!< positions dans le repere projectif, avant la division par w
+        std::vector<float> x, y, z;         //!< positions dans le repere image
+        std::vector<float> inv_w;           //!< 1 / w
+        std::vector<unsigned char> clip;    //!< bits 0 a 5 : sommet a l'exterieur des plans gauche, droit, bas, haut, near, far, bit 6 : sommet hors de la bande de garde, cf clip_near
+        std::vector<float> attributes;      //!< attributes[k * count + i - first] : varying k du sommet i
+    };
+
+    //! couleurs et profondeurs d'une tuile, tile_size x tile_size pixels, meme sur les bords de l'image.
+    struct Tile
+    {
+        int x, y;                       //!< premier pixel de la tuile
+        int width, height;              //!< pixels de la tuile dans l'image
+        std::vector<Color> color;
+        std::vector<float> depth;
+        std::vector<Visibility> visibility;    //!< mode RASTER_VISIBILITY
+        std::vector<float> block_zmin;  //!< profondeur min / max de chaque bloc 8x8, hi-z
+        std::vector<float> block_zmax;
+        float zmin, zmax;               //!< profondeur min / max de la tuile
+    };
+
+    /*! triangle prepare pour la fragmentation. fonctions d'aretes ab, bc, ca : e(x, y)= A*x + B*y + C,
+        proportionnelles a l'aire des triangles pab, pbc, pca. les sommets sont arrondis sur une grille de sous-pixels,
+        cf raster_subpixel_bits, et les fonctions d'aretes sont evaluees exactement, sur des entiers.
+     */
+    struct RasterTriangle
+    {
+        int64_t A[3], B[3], C[3];
+        float z[3];                 //!< profondeur des sommets a, b, c
+        float zmin, zmax;           //!< profondeur min / max du triangle
+        float inv_area;             //!< 1 / aire abc
+        float inv_w[3];             //!< 1 / w des sommets a, b, c
+        float bary[3][3];           //!< coordonnees barycentriques (u, v, w) des sommets a, b, c dans la primitive, divisees par w
+        int owner;                  //!< bit i : les pixels sur l'arete i appartiennent au triangle
+        int xmin, ymin, xmax, ymax; //!< pixels couverts par l'englobant
+        int id;                     //!< indice de la primitive, ou -1 si le triangle est elimine
+        bool clip;                  //!< le triangle doit etre decoupe, cf clip()
+    };
+
+    //! codes de decoupage des sommets, cf Draw::clip.
+    enum
+    {
+        clip_near= 16,
+        clip_far= 32,
+        clip_guard= 64
+    };
+
+    //! sommet d'un polygone decoupe, repere projectif.
+    struct ClipVertex
+    {
+        float x, y, z, w;
+        float b[3];                 //!< poids des sommets a, b, c de la primitive
+        int source;                 //!< indice du sommet dans Draw, ou -1 pour un nouveau sommet
+    };
+
+    //! dessine count / 3 triangles, indexes ou pas, cf Draw::indices. Shader : Pipeline, ou Derived d'un ShaderPipeline.
+    template < typename Shader >
+    void draw_triangles( const Shader& pipeline, const unsigned int *indices, const int count );
+    //! prepare un draw : conserve les indices et determine les sommets a transformer, renvoie l'indice du draw, cf Draw.
+    int begin_draw( const unsigned int *indices, const int count, const int varyings );
+    //! execute le vertex shader sur les sommets du draw, par groupes de sommets.
+    template < typename Shader >
+    void transform( const Shader& pipeline, Draw& draw ) const;
+    //! codes de decoupage et passage dans le repere image des sommets [begin .. end) du draw.
+    void viewport( Draw& draw, const int begin, const int end ) const;
+    //! prepare la fragmentation des n triangles du draw, renvoie le nombre de triangles elimines.
+    int setup( const Draw& draw, const int n );
+    //! prepare la fragmentation du triangle, a partir des sommets transformes, ou indique qu'il doit etre decoupe, cf RasterTriangle::clip.
+    bool setup( const Draw& draw, const int primitive_id, RasterTriangle& triangle ) const;
+    //! prepare la fragmentation d'un triangle, sommets p dans le repere image, cf RasterTriangle.
+    bool setup( const Point p[3], const float inv_w[3], const float bary[3][3], const int primitive_id, RasterTriangle& triangle ) const;
+    //! decoupe la primitive par le plan near, le plan far et la bande de garde, ajoute les triangles a triangles, renvoie leur nombre.
+    int clip( const Draw& draw, const int primitive_id, std::vector<RasterTriangle>& triangles ) const;
+    //! repartit les n triangles dans les tuiles, decoupe les triangles, renvoie le nombre de paires triangle / tuile.
+    long long bin( const Draw& draw, const int n, int& clipped, int& culled );
+    //! recupere les varyings des sommets a, b, c de la primitive : abc[3k], abc[3k+1], abc[3k+2] pour le varying k.
+    void varyings( const Draw& draw, const int primitive_id, float *abc ) const;
+    //! dessine les triangles du draw d'une tuile, compte les blocs et les fragments dans stats.
+    template < typename Shader >
+    void raster( const Shader& pipeline, const int draw, const int tile, RasterizerStats& stats );
+    //! pixels d'un bloc 8x8 couverts par le triangle, 1 bit par pixel, ligne par ligne.
+    static uint64_t block_coverage( const int64_t e[3], const int64_t dx[3], const int64_t dy[3], const int64_t bias[3] );
+    //! met a jour le hi-z du bloc b de la tuile.
+    void update_block( Tile& tile, const int b ) const;
+    //! met a jour le hi-z de la tuile.
+    void update_tile( Tile& tile ) const;
+    //! execute le fragment shader des pixels visibles d'une tuile, renvoie le nombre de fragments.
+    long long shade( const int tile );
+
+    //! shade_fragments() et material() du pipeline d'un draw, cf RASTER_VISIBILITY.
+    template < typename Shader >
+    static void shade_batch( const void *pipeline, const int primitive_id, const FragmentBatch& batch, Color *colors )
+    {
+        static_cast<const Shader *>(pipeline)->shade_fragments(primitive_id, batch, colors);
+    }
+    template < typename Shader >
+    static int material_id( const void *pipeline, const int primitive_id )
+    {
+        return static_cast<const Shader *>(pipeline)->material(primitive_id);
+    }
+
+    std::vector<Tile> m_tiles;
+    std::vector<RasterTriangle> m_triangles;
+    std::vector<Draw> m_draws;      //!< draw() depuis clear() en mode RASTER_VISIBILITY, ou dernier draw()
+    int m_draw_count;
+    std::vector< std::vector<int> > m_bins;     //!< m_bins[block * tiles + tile] : triangles d'un bloc de triangles qui touchent la tuile, i ou -(k+1) pour m_clipped[block][k]
+    std::vector< std::vector<RasterTriangle> > m_clipped;       //!< m_clipped[block] : triangles decoupes d'un bloc de triangles
+    int m_blocks;
+
+    RasterizerMode m_mode;
+    int m_width;
+    int m_height;
+    int m_tile_size;
+    int m_tiles_x;
+    int m_tiles_y;
+};
+
+
+// implementation des templates
+
+template < typename Shader >
+void Rasterizer::draw_triangles( const Shader& pipeline, const unsigned int *indices, const int count )
+{
+    const int n= count / 3;
+    const int tiles= int(m_tiles.size());
+    if(n == 0)
+        return;
+
+    if(pipeline.varyings() > raster_max_varyings)
+    {
+        printf("[error] Rasterizer::draw(): %d varyings, max %d...\n", pipeline.varyings(), raster_max_varyings);
+        return;
+    }
+
+    // 1. transforme les sommets, une seule fois par sommet, et prepare les triangles
+    auto start= std::chrono::high_resolution_clock::now();
+
+    const int draw= begin_draw(indices, 3*n, pipeline.varyings());
+    Draw& vertices= m_draws[draw];
+    vertices.pipeline= &pipeline;
+    vertices.shade= shade_batch<Shader>;
+    vertices.material= material_id<Shader>;
+
+    transform(pipeline, vertices);
+    int culled= setup(vertices, n);
+
+    auto setup_stop= std::chrono::high_resolution_clock::now();
+
+    // 2. decoupe les triangles, si necessaire, et les repartit dans les tuiles touchees par leur englobant
+    int clipped= 0;
+    int clipped_culled= 0;
+    long long binned= bin(vertices, n, clipped, clipped_culled);
+    culled+= clipped_culled;
+
+    auto binning_stop= std::chrono::high_resolution_clock::now();
+
+    // 3. dessine les tuiles en parallele, un thread par tuile
+    std::vector<RasterizerStats> counters(tiles);
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int t= 0; t < tiles; t++)
+        raster(pipeline, draw, t, counters[t]);
+
+    auto stop= std::chrono::high_resolution_clock::now();
+
+    stats.vertices+= vertices.count;
+    stats.triangles+= n - culled;
+    stats.culled+= culled;
+    stats.clipped+= clipped;
+    stats.binned+= binned;
+    for(int t= 0; t < tiles; t++)
+    {
+        stats.tiles_hidden+= counters[t].tiles_hidden;
+        stats.blocks+= counters[t].blocks;
+        stats.blocks_rejected+= counters[t].blocks_rejected;
+        stats.blocks_hidden+= counters[t].blocks_hidden;
+        stats.blocks_covered+= counters[t].blocks_covered;
+        stats.fragments+= counters[t].fragments;
+        stats.shaded+= counters[t].shaded;
+    }
+    stats.vertex_time+= std::chrono::duration<float, std::milli>(setup_stop - start).count();
+    stats.binning_time+= std::chrono::duration<float, std::milli>(binning_stop - setup_stop).count();
+    stats.raster_time+= std::chrono::duration<float, std::milli>(stop - binning_stop).count();
+}
+
+template < typename Shader >
+void Rasterizer::transform( const Shader& pipeline, Draw& draw ) const
+{
+    // taille des groupes de sommets transformes ensemble
+    const int batch_size= 256;
+    const int batches= (draw.count + batch_size -1) / batch_size;
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int batch= 0; batch < batches; batch++)
+    {
+        const int begin= batch * batch_size;
+        const int end= std::min(draw.count, begin + batch_size);
+
+        // execute le vertex shader sur le groupe de sommets
+        float varyings[raster_max_varyings];
+        for(int i= begin; i < end; i++)
+        {
+            vec4 p= pipeline.shade_vertex(draw.first + i, varyings);
+            draw.cx[i]= p.x;
+            draw.cy[i]= p.y;
+            draw.cz[i]= p.z;
+            draw.cw[i]= p.w;
+            for(int k= 0; k < draw.varyings; k++)
+                draw.attributes[size_t(k) * draw.count + i]= varyings[k];
+        }
+
+        viewport(draw, begin, end);
+    }
+}
+
+template < typename Shader >
+void Rasterizer::raster( const Shader& pipeline, const int draw, const int index, RasterizerStats& stats )
+{
+    const Draw& vertices= m_draws[draw];
+    Tile& tile= m_tiles[index];
+    const int tiles= int(m_tiles.size());
+    const int blocks_x= m_tile_size / raster_block_size;
+    const int last= raster_block_size -1;
+
+    // varyings des sommets du triangle, et fragments d'une ligne d'un bloc, interpoles uniquement en mode RASTER_FORWARD
+    const int n= (m_mode == RASTER_FORWARD) ? vertices.varyings : 0;
+    float abc[3 * raster_max_varyings];
+    FragmentBatch batch;
+    batch.varying_count= n;
+    Color colors[FragmentBatch::size];
+
+    // parcours les triangles dans l'ordre : par bloc, puis dans chaque bloc
+    for(int block= 0; block < m_blocks; block++)
+    {
+        const std::vector<int>& bin= m_bins[block * tiles + index];
+        const std::vector<RasterTriangle>& clipped= m_clipped[block];
+        for(unsigned i= 0; i < bin.size(); i++)
+        {
+            const RasterTriangle& triangle= (bin[i] >= 0) ? m_triangles[bin[i]] : clipped[-bin[i] -1];
+
+            // hi-z : le triangle est derriere tous les pixels de la tuile
+            if(triangle.zmin >= tile.zmax)
+            {
+                stats.tiles_hidden++;
+                continue;
+            }
+
+            if(n > 0)
+                varyings(vertices, triangle.id, abc);
+
+            // blocs de l'englobant du triangle dans la tuile
+            int bx0= (std::max(triangle.xmin, tile.x) - tile.x) / raster_block_size;
+            int by0= (std::max(triangle.ymin, tile.y) - tile.y) / raster_block_size;
+            int bx1= (std::min(triangle.xmax, tile.x + tile.width -1) - tile.x) / raster_block_size;
+            int by1= (std::min(triangle.ymax, tile.y + tile.height -1) - tile.y) / raster_block_size;
+
+            // fonctions d'aretes au centre du premier pixel du premier bloc, increments entre 2 pixels
+            // un pixel sur une arete appartient au triangle si l'arete est "proprietaire" : e >= 0, sinon e > 0, soit e > -1 ou e > 0
+            int64_t row[3], dx[3], dy[3], bias[3];
+            int64_t px= int64_t(tile.x + bx0 * raster_block_size) * raster_subpixels + raster_subpixels / 2;
+            int64_t py= int64_t(tile.y + by0 * raster_block_size) * raster_subpixels + raster_subpixels / 2;
+            for(int k= 0; k < 3; k++)
+            {
+                row[k]= triangle.A[k] * px + triangle.B[k] * py + triangle.C[k];
+                dx[k]= triangle.A[k] * raster_subpixels;
+                dy[k]= triangle.B[k] * raster_subpixels;
+                bias[k]= (triangle.owner & (1 << k)) ? -1 : 0;
+            }
+
+            bool updated= false;
+            for(int by= by0; by <= by1; by++, row[0]+= raster_block_size * dy[0], row[1]+= raster_block_size * dy[1], row[2]+= raster_block_size * dy[2])
+            {
+                int64_t e[3]= { row[0], row[1], row[2] };
+                for(int bx= bx0; bx <= bx1; bx++, e[0]+= raster_block_size * dx[0], e[1]+= raster_block_size * dx[1], e[2]+= raster_block_size * dx[2])
+                {
+                    stats.blocks++;
+
+                    // evalue les fonctions d'aretes aux 4 coins du bloc : les valeurs min et max sur le bloc
+                    int inside= 0;
+                    bool outside= false;
+                    for(int k= 0; k < 3; k++)
+                    {
+                        int64_t e10= e[k] + last * dx[k];
+                        int64_t e01= e[k] + last * dy[k];
+                        int64_t e11= e10 + last * dy[k];
+                        int64_t emin= std::min(std::min(e[k], e10), std::min(e01, e11));
+                        int64_t emax= std::max(std::max(e[k], e10), std::max(e01, e11));
+                        if(emax <= bias[k])
+                            outside= true;      // tous les pixels du bloc sont a l'exterieur de l'arete
+                        if(emin > bias[k])
+                            inside++;           // tous les pixels du bloc sont a l'interieur de l'arete
+                    }
+
+                    if(outside)
+                    {
+                        stats.blocks_rejected++;
+                        continue;
+                    }
+
+                    // hi-z : le triangle est derriere tous les pixels du bloc
+                    int b= by * blocks_x + bx;
+                    if(triangle.zmin >= tile.block_zmax[b])
+                    {
+                        stats.blocks_hidden++;
+                        continue;
+                    }
+
+                    // pixels du bloc dans l'image
+                    int columns= std::min(raster_block_size, tile.width - bx * raster_block_size);
+                    int rows= std::min(raster_block_size, tile.height - by * raster_block_size);
+                    uint64_t valid= 0;
+                    for(int y= 0; y < rows; y++)
+                        valid|= ((uint64_t(1) << columns) -1) << (y * raster_block_size);
+
+                    uint64_t mask;
+                    if(inside == 3)
+                    {
+                        // bloc entierement couvert
+                        mask= valid;
+                        stats.blocks_covered++;
+                    }
+                    else
+                        mask= block_coverage(e, dx, dy, bias) & valid;
+
+                    if(mask == 0)
+                        continue;
+
+                    // hi-z : le triangle est devant tous les pixels du bloc, pas de test de profondeur
+                    bool ztest= !(triangle.zmax < tile.block_zmin[b]);
+
+                    int offset= (by * m_tile_size + bx) * raster_block_size;
+                    bool written= false;
+                    for(int y= 0; y < raster_block_size; y++)
+                    {
+                        unsigned bits= unsigned(mask >> (y * raster_block_size)) & 0xff;
+                        if(bits == 0)
+                            continue;
+
+                        float *depth= tile.depth.data() + offset + y * m_tile_size;
+                        Color *color= tile.color.data() + offset + y * m_tile_size;
+
+                        // fragments de la ligne, par composantes
+                        unsigned visible= 0;
+                        for(int x= 0; x < FragmentBatch::size; x++)
+                        {
+                            int64_t u= e[0] + x * dx[0] + y * dy[0];      // distance c / ab
+                            int64_t v= e[1] + x * dx[1] + y * dy[1];      // distance a / bc
+                            int64_t w= e[2] + x * dx[2] + y * dy[2];      // distance b / ca
+
+                            batch.x[x]= float(tile.x + bx * raster_block_size + x);
+                            batch.y[x]= float(tile.y + by * raster_block_size + y);
+                            // normalise les coordonnees barycentriques du fragment dans le triangle, poids des sommets a, b, c
+                            float sa= float(v) * triangle.inv_area;
+                            float sb= float(w) * triangle.inv_area;
+                            float sc= float(u) * triangle.inv_area;
+                            // interpole z, reste dans l'intervalle des sommets, malgre les arrondis, pour que le hi-z reste conservatif
+                            float z= sc * triangle.z[2] + sa * triangle.z[0] + sb * triangle.z[1];
+                            batch.z[x]= std::min(triangle.zmax, std::max(triangle.zmin, z));
+                            // coordonnees barycentriques dans la primitive, avec correction de perspective
+                            float k= 1 / (sa * triangle.inv_w[0] + sb * triangle.inv_w[1] + sc * triangle.inv_w[2]);
+                            batch.u[x]= (sa * triangle.bary[0][0] + sb * triangle.bary[1][0] + sc * triangle.bary[2][0]) * k;
+                            batch.v[x]= (sa * triangle.bary[0][1] + sb * triangle.bary[1][1] + sc * triangle.bary[2][1]) * k;
+                            batch.w[x]= (sa * triangle.bary[0][2] + sb * triangle.bary[1][2] + sc * triangle.bary[2][2]) * k;
+
+                            // ztest, avant le fragment shader : il ne modifie pas la profondeur du fragment
+                            if(!ztest || batch.z[x] < depth[x])
+                                visible|= 1u << x;
+                        }
+
+                        visible&= bits;
+                        for(int x= 0; x < FragmentBatch::size; x++)
+                            if(bits & (1u << x))
+                                stats.fragments++;
+                        if(visible == 0)
+                            continue;
+
+                        for(int x= 0; x < FragmentBatch::size; x++)
+                            if(visible & (1u << x))
+                                depth[x]= batch.z[x];
+                        written= true;
+
+                        if(m_mode == RASTER_VISIBILITY)
+                        {
+                            // conserve la primitive visible, cf shade(), visibility est vide en mode RASTER_FORWARD
+                            Visibility *visibility= tile.visibility.data() + offset + y * m_tile_size;
+                            for(int x= 0; x < FragmentBatch::size; x++)
+                                if(visible & (1u << x))
+                                {
+                                    Visibility& pixel= visibility[x];
+                                    pixel.primitive= triangle.id;
+                                    pixel.draw= draw;
+                                    pixel.u= batch.u[x];
+                                    pixel.v= batch.v[x];
+                                    pixel.w= batch.w[x];
+                                }
+                            continue;
+                        }
+
+                        // interpole les varyings
+                        for(int k= 0; k < n; k++)
+                        for(int x= 0; x < FragmentBatch::size; x++)
+                            batch.varyings[k][x]= batch.u[x] * abc[3*k +2] + batch.v[x] * abc[3*k] + batch.w[x] * abc[3*k +1];
+
+                        // evalue la couleur des fragments visibles du triangle
+                        batch.mask= visible;
+                        pipeline.shade_fragments(triangle.id, batch, colors);
+                        for(int x= 0; x < FragmentBatch::size; x++)
+                            if(visible & (1u << x))
+                            {
+                                color[x]= Color(colors[x], 1);
+                                stats.shaded++;
+                            }
+                    }
+
+                    if(written)
+                    {
+                        update_block(tile, b);
+                        updated= true;
+                    }
+                }
+            }
+
+            if(updated)
+                update_tile(tile);
+        }
+    }
+}
+
+///@}
+#endif
@@ -5,6 +5,7 @@
 
 #include "texture.h"
 #include "image_io.h"
+#include "update_buffer.h"
 
 
 int miplevels( const int width, const int height )
@@ -96,10 +97,11 @@ GLuint make_texture( const int unit, const Image& im, const GLenum texel_type )
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    // transfere les donnees dans la texture, 4 float par texel
+    // alloue la texture et transfere les donnees, 4 float par texel
     glTexImage2D(GL_TEXTURE_2D, 0,
         texel_type, im.width(), im.height(), 0,
-        GL_RGBA, GL_FLOAT, im.data());
+        GL_RGBA, GL_FLOAT, nullptr);
+    UpdateBuffer::manager().copy_texture(GL_TEXTURE_2D, 0, im.width(), im.height(), GL_RGBA, GL_FLOAT, im.data());
     
     // prefiltre la texture
     glGenerateMipmap(GL_TEXTURE_2D);
@@ -141,10 +143,11 @@ GLuint make_texture( const int unit, const ImageData& im, const GLenum texel_typ
         default: type= GL_UNSIGNED_BYTE;
     }
     
-    // transfere les donnees dans la texture
+    // alloue la texture et transfere les donnees
     glTexImage2D(GL_TEXTURE_2D, 0,
         texel_type, im.width, im.height, 0,
-        format, type, im.data());
+        format, type, nullptr);
+    UpdateBuffer::manager().copy_texture(GL_TEXTURE_2D, 0, im.width, im.height, format, type, im.data());
     
     // prefiltre la texture
     glGenerateMipmap(GL_TEXTURE_2D);
@@ -0,0 +1,254 @@
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+#include "update_buffer.h"
+
+
+// taille du buffer circulaire. une copie utilise au plus 1/4 du buffer, les transferts plus gros sont decoupes.
+static const size_t RING_SIZE= 32*1024*1024;
+// alignement des copies dans le buffer circulaire, suffisant pour tous les types de donnees.
+static const size_t RING_ALIGNMENT= 256;
+
+static
+bool has_buffer_storage( )
+{
+#ifdef NO_GLEW
+    return false;
+#else
+    return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+#endif
+}
+
+void UpdateBuffer::create( const size_t length )
+{
+    assert(m_buffer == 0);
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+
+    m_size= 0;
+    m_head= 0;
+    m_data= nullptr;
+    m_persistent= false;
+
+#ifndef NO_GLEW
+    if(has_buffer_storage())
+    {
+        // openGL 4.4, buffer circulaire mappe en permanence
+        GLbitfield flags= GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_READ_BUFFER, RING_SIZE, nullptr, flags);
+        m_data= (unsigned char *) glMapBufferRange(GL_COPY_READ_BUFFER, 0, RING_SIZE, flags);
+        if(m_data)
+        {
+            m_size= RING_SIZE;
+            m_persistent= true;
+            printf("[UpdateBuffer] allocate %dMo persistent ring buffer...\n", int(m_size / 1024 / 1024));
+            return;
+        }
+
+        // le buffer est immuable, il faut en creer un autre...
+        printf("[error] UpdateBuffer: can't map ring buffer...\n");
+        glDeleteBuffers(1, &m_buffer);
+        glGenBuffers(1, &m_buffer);
+        glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+    }
+#endif
+    // openGL 3, buffer intermediaire alloue par copy()
+}
+
+void UpdateBuffer::release( )
+{
+    for(unsigned i= 0; i < m_fences.size(); i++)
+        glDeleteSync(m_fences[i].sync);
+    m_fences.clear();
+
+    if(m_buffer && m_persistent)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+    }
+
+    glDeleteBuffers(1, &m_buffer);
+    m_buffer= 0;
+    m_size= 0;
+    m_head= 0;
+    m_data= nullptr;
+    m_persistent= false;
+}
+
+size_t UpdateBuffer::allocate( const size_t length )
+{
+    assert(m_persistent);
+    size_t n= (length + RING_ALIGNMENT -1) / RING_ALIGNMENT * RING_ALIGNMENT;
+    assert(n <= m_size);
+
+    if(m_head + n > m_size)
+    {
+        // recommence au debut du buffer
+        m_head= 0;
+        m_stats.wraps++;
+    }
+
+    size_t begin= m_head;
+    size_t end= m_head + n;
+
+    // oublie les regions deja copiees par le gpu
+    while(!m_fences.empty() && glClientWaitSync(m_fences.front().sync, 0, 0) != GL_TIMEOUT_EXPIRED)
+    {
+        glDeleteSync(m_fences.front().sync);
+        m_fences.pop_front();
+    }
+
+    // attend la fin des copies qui utilisent encore la region
+    int last= -1;
+    for(int i= 0; i < int(m_fences.size()); i++)
+        if(m_fences[i].begin < end && begin < m_fences[i].end)
+            last= i;
+
+    if(last != -1)
+    {
+        m_stats.fence_waits++;
+        while(glClientWaitSync(m_fences[last].sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+            {}
+
+        // les commandes s'executent dans l'ordre, les copies precedentes sont aussi terminees
+        for(int i= 0; i <= last; i++)
+        {
+            glDeleteSync(m_fences.front().sync);
+            m_fences.pop_front();
+        }
+    }
+
+    m_head= end;
+    return begin;
+}
+
+void UpdateBuffer::fence( const size_t begin, const size_t end )
+{
+    Fence f= { begin, end, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) };
+    m_fences.push_back(f);
+}
+
+void UpdateBuffer::copy( const GLenum target, const size_t offset, const size_t length, const void *data )
+{
+    if(length == 0)
+        return;
+
+    if(m_buffer == 0)
+        create(length);
+
+    assert(m_buffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+    if(!m_persistent)
+    {
+        if(length > m_size)
+        {
+            m_size= (length / (16*1024*1024) + 1) * (16*1024*1024); // alloue par bloc de 16Mo
+            assert(m_size >= length);
+
+            // alloue un buffer intermediaire dynamique...
+            glBufferData(GL_COPY_READ_BUFFER, m_size, nullptr, GL_DYNAMIC_DRAW);
+            printf("[UpdateBuffer] allocate %dMo staging buffer...\n", int(m_size / 1024 / 1024));
+        }
+
+        // place les donnees dans le buffer intermediaire
+        glBufferSubData(GL_COPY_READ_BUFFER, 0, length, data);
+        // copie les donnees dans le buffer statique
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, target, 0, offset, length);
+
+        m_stats.bytes+= length;
+        m_stats.copies++;
+        return;
+    }
+
+    // decoupe les transferts importants, le gpu copie les premieres parties pendant que le cpu prepare la suite
+    const size_t chunk= m_size / 4;
+    for(size_t first= 0; first < length; first+= chunk)
+    {
+        size_t n= std::min(chunk, length - first);
+        size_t position= allocate(n);
+
+        memcpy(m_data + position, (const unsigned char *) data + first, n);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, target, position, offset + first, n);
+        fence(position, position + n);
+
+        m_stats.bytes+= n;
+        m_stats.copies++;
+    }
+}
+
+static
+size_t pixel_size( const GLenum format, const GLenum type )
+{
+    size_t components= 4;
+    switch(format)
+    {
+        case GL_RED:
+        case GL_RED_INTEGER:
+        case GL_DEPTH_COMPONENT: components= 1; break;
+        case GL_RG:
+        case GL_RG_INTEGER: components= 2; break;
+        case GL_RGB:
+        case GL_BGR:
+        case GL_RGB_INTEGER: components= 3; break;
+        default: components= 4;
+    }
+
+    size_t size= 4;
+    switch(type)
+    {
+        case GL_UNSIGNED_BYTE:
+        case GL_BYTE: size= 1; break;
+        case GL_UNSIGNED_SHORT:
+        case GL_SHORT:
+        case GL_HALF_FLOAT: size= 2; break;
+        default: size= 4;
+    }
+
+    return components * size;
+}
+
+void UpdateBuffer::copy_texture( const GLenum target, const int level, const int width, const int height, const GLenum format, const GLenum type, const void *data )
+{
+    if(width <= 0 || height <= 0 || data == nullptr)
+        return;
+
+    if(m_buffer == 0)
+        create(0);
+
+    // lignes de pixels alignees sur 4 octets, cf GL_UNPACK_ALIGNMENT
+    size_t line= size_t(width) * pixel_size(format, type);
+    size_t row= (line + 3) / 4 * 4;
+
+    const size_t chunk= m_size / 4;
+    if(!m_persistent || row > chunk)
+    {
+        // pas de buffer circulaire, ou lignes trop longues, transfert direct
+        glTexSubImage2D(target, level, 0, 0, width, height, format, type, data);
+
+        m_stats.bytes+= row * (height -1) + line;
+        m_stats.copies++;
+        return;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+
+    // transfere des blocs de lignes
+    int rows= int(chunk / row);
+    for(int y= 0; y < height; y+= rows)
+    {
+        int n= std::min(rows, height - y);
+        size_t length= row * (n -1) + line;    // la derniere ligne de l'image n'est pas forcement completee...
+        size_t position= allocate(length);
+
+        memcpy(m_data + position, (const unsigned char *) data + size_t(y) * row, length);
+        glTexSubImage2D(target, level, 0, y, width, n, format, type, (const void *) position);
+        fence(position, position + length);
+
+        m_stats.bytes+= length;
+        m_stats.copies++;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
@@ -0,0 +1,96 @@
+#ifndef _UPDATE_BUFFER_H
+#define _UPDATE_BUFFER_H
+
+#include <cstddef>
+#include <deque>
+
+#include "glcore.h"
+
+
+//! \addtogroup openGL
+///@{
+
+//! \file
+//! buffer de copie / transfert des donnees vers les buffers et les textures openGL, cf Mesh::update_buffers() et make_texture().
+
+//! statistiques des transferts, cf UpdateBuffer::stats().
+struct UpdateBufferStats
+{
+    size_t bytes;       //!< octets transferes.
+    int copies;         //!< nombre de copies, un transfert important est decoupe en plusieurs copies.
+    int fence_waits;    //!< nombre d'attentes, le gpu n'avait pas fini de copier les donnees precedentes.
+    int wraps;          //!< nombre de tours du buffer circulaire.
+};
+
+/*! buffer unique de copie / mise a jour des buffers et des textures statiques. singleton. tous les transferts utilisent le meme buffer de copie...
+
+    openGL 4.4 ou GL_ARB_buffer_storage : buffer circulaire, mappe en permanence (cf glBufferStorage(), glMapBufferRange() et tuto_stream.cpp).
+    chaque copie est protegee par une fence, le cpu n'attend le gpu que si le buffer circulaire est plein.
+    sinon, glBufferSubData() dans un buffer intermediaire, puis copie.
+
+    \code
+    UpdateBuffer& update= UpdateBuffer::manager();
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    update.copy(GL_ARRAY_BUFFER, offset, length, data);
+    \endcode
+ */
+class UpdateBuffer
+{
+public:
+    //! transfere les donnees dans le buffer associe a target, a partir de offset.
+    void copy( const GLenum target, const size_t offset, const size_t length, const void *data );
+
+    /*! transfere les pixels du mipmap level de la texture 2d selectionnee sur l'unite active, cf glTexSubImage2D().
+        le mipmap doit etre alloue, cf glTexImage2D( ..., nullptr ). les lignes de pixels sont alignees sur 4 octets, cf GL_UNPACK_ALIGNMENT.
+     */
+    void copy_texture( const GLenum target, const int level, const int width, const int height, const GLenum format, const GLenum type, const void *data );
+
+    //! renvoie les statistiques des transferts.
+    const UpdateBufferStats& stats( ) const { return m_stats; }
+    //! remet les statistiques a zero.
+    void clear_stats( ) { m_stats= UpdateBufferStats(); }
+
+    //! detruit le buffer.
+    ~UpdateBuffer( ) { release(); }
+
+    //! detruit le buffer et les fences.
+    void release( );
+
+    //! acces au singleton.
+    static UpdateBuffer& manager( )
+    {
+        static UpdateBuffer buffer;
+        return buffer;
+    }
+
+protected:
+    //! constructeur prive. singleton.
+    UpdateBuffer( ) : m_buffer(0), m_size(0), m_head(0), m_data(nullptr), m_persistent(false), m_fences(), m_stats() {}
+
+    //! cree le buffer, circulaire si possible.
+    void create( const size_t length );
+    //! reserve length octets dans le buffer circulaire, attend le gpu si necessaire. renvoie la position des donnees dans le buffer.
+    size_t allocate( const size_t length );
+    //! protege la region [begin, end) du buffer circulaire jusqu'a la fin de la copie par le gpu.
+    void fence( const size_t begin, const size_t end );
+
+    //! region du buffer circulaire en cours de copie par le gpu.
+    struct Fence
+    {
+        size_t begin;
+        size_t end;
+        GLsync sync;
+    };
+
+    GLuint m_buffer;
+    size_t m_size;
+    size_t m_head;
+    unsigned char *m_data;
+    bool m_persistent;
+
+    std::deque<Fence> m_fences;
+    UpdateBufferStats m_stats;
+};
+
+///@}
+#endif
@@ -1,6 +1,19 @@
 
+#include <cfloat>
 #include <algorithm>
 #include <cmath>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "vec.h"
 
@@ -37,6 +50,140 @@ Point max( const Point& a, const Point& b )
     return Point( std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z) ); 
 }
 
+
+// points extremes d'un bloc de points, complete pmin et pmax.
+// les coordonnees des points sont contigues : x0 y0 z0 x1 y1 z1 x2..., 
+// 3 registres contiennent toujours les memes coordonnees, la coordonnee de l'element k des registres est k % 3.
+static
+void bounds_block( const vec3 *points, const size_t count, float pmin[3], float pmax[3] )
+{
+    const float *data= &points[0].x;
+    size_t i= 0;
+    
+#if defined(__AVX__)
+    // 8 points par iteration
+    if(count >= 8)
+    {
+        __m256 min0= _mm256_loadu_ps(data);
+        __m256 min1= _mm256_loadu_ps(data + 8);
+        __m256 min2= _mm256_loadu_ps(data + 16);
+        __m256 max0= min0;
+        __m256 max1= min1;
+        __m256 max2= min2;
+        
+        for(i= 8; i + 8 <= count; i+= 8)
+        {
+            const float *p= data + 3*i;
+            __m256 a= _mm256_loadu_ps(p);
+            __m256 b= _mm256_loadu_ps(p + 8);
+            __m256 c= _mm256_loadu_ps(p + 16);
+            min0= _mm256_min_ps(min0, a); max0= _mm256_max_ps(max0, a);
+            min1= _mm256_min_ps(min1, b); max1= _mm256_max_ps(max1, b);
+            min2= _mm256_min_ps(min2, c); max2= _mm256_max_ps(max2, c);
+        }
+        
+        alignas(32) float mins[24];
+        alignas(32) float maxs[24];
+        _mm256_store_ps(mins, min0); _mm256_store_ps(mins + 8, min1); _mm256_store_ps(mins + 16, min2);
+        _mm256_store_ps(maxs, max0); _mm256_store_ps(maxs + 8, max1); _mm256_store_ps(maxs + 16, max2);
+        for(int k= 0; k < 24; k++)
+        {
+            pmin[k % 3]= std::min(pmin[k % 3], mins[k]);
+            pmax[k % 3]= std::max(pmax[k % 3], maxs[k]);
+        }
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    // 4 points par iteration
+    if(count >= 4)
+    {
+        __m128 min0= _mm_loadu_ps(data);
+        __m128 min1= _mm_loadu_ps(data + 4);
+        __m128 min2= _mm_loadu_ps(data + 8);
+        __m128 max0= min0;
+        __m128 max1= min1;
+        __m128 max2= min2;
+        
+        for(i= 4; i + 4 <= count; i+= 4)
+        {
+            const float *p= data + 3*i;
+            __m128 a= _mm_loadu_ps(p);
+            __m128 b= _mm_loadu_ps(p + 4);
+            __m128 c= _mm_loadu_ps(p + 8);
+            min0= _mm_min_ps(min0, a); max0= _mm_max_ps(max0, a);
+            min1= _mm_min_ps(min1, b); max1= _mm_max_ps(max1, b);
+            min2= _mm_min_ps(min2, c); max2= _mm_max_ps(max2, c);
+        }
+        
+        alignas(16) float mins[12];
+        alignas(16) float maxs[12];
+        _mm_store_ps(mins, min0); _mm_store_ps(mins + 4, min1); _mm_store_ps(mins + 8, min2);
+        _mm_store_ps(maxs, max0); _mm_store_ps(maxs + 4, max1); _mm_store_ps(maxs + 8, max2);
+        for(int k= 0; k < 12; k++)
+        {
+            pmin[k % 3]= std::min(pmin[k % 3], mins[k]);
+            pmax[k % 3]= std::max(pmax[k % 3], maxs[k]);
+        }
+    }
+#endif
+    
+    // derniers points
+    for(; i < count; i++)
+        for(int k= 0; k < 3; k++)
+        {
+            pmin[k]= std::min(pmin[k], data[3*i + k]);
+            pmax[k]= std::max(pmax[k], data[3*i + k]);
+        }
+}
+
+void bounds( const vec3 *points, const size_t count, Point& pmin, Point& pmax )
+{
+    if(count == 0)
+        return;
+    
+    float bmin[3]= { FLT_MAX, FLT_MAX, FLT_MAX };
+    float bmax[3]= { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    
+    // decoupe les ensembles importants, un bloc par thread
+    int blocks= 1;
+#ifdef _OPENMP
+    if(count > 256*1024 && !omp_in_parallel())
+        blocks= omp_get_max_threads();
+#endif
+    
+    if(blocks == 1)
+        bounds_block(points, count, bmin, bmax);
+    else
+    {
+        std::vector<float> block_bounds(6 * blocks);
+        
+#pragma omp parallel for schedule(static, 1)
+        for(int b= 0; b < blocks; b++)
+        {
+            float *block_min= &block_bounds[6*b];
+            float *block_max= &block_bounds[6*b + 3];
+            for(int k= 0; k < 3; k++)
+            {
+                block_min[k]= FLT_MAX;
+                block_max[k]= -FLT_MAX;
+            }
+            
+            size_t begin= count * b / blocks;
+            size_t end= count * (b+1) / blocks;
+            bounds_block(points + begin, end - begin, block_min, block_max);
+        }
+        
+        for(int b= 0; b < blocks; b++)
+            for(int k= 0; k < 3; k++)
+            {
+                bmin[k]= std::min(bmin[k], block_bounds[6*b + k]);
+                bmax[k]= std::max(bmax[k], block_bounds[6*b + 3 + k]);
+            }
+    }
+    
+    pmin= Point(bmin[0], bmin[1], bmin[2]);
+    pmax= Point(bmax[0], bmax[1], bmax[2]);
+}
+
  
 Vector operator- ( const Point& a, const Point& b )
 {
@@ -2,6 +2,7 @@
 #ifndef _VEC_H
 #define _VEC_H
 
+#include <cstddef>
 
 //! \addtogroup math
 ///@{
@@ -187,6 +188,10 @@ struct vec4
 };
 
 
+//! renvoie les points extremes d'un ensemble de points, cf Mesh::bounds(). vectorise (sse / avx) et en parallele sur les ensembles importants. pmin et pmax ne sont pas modifies si count == 0.
+void bounds( const vec3 *points, const size_t count, Point& pmin, Point& pmax );
+
+
 // implementation des constructeurs explicites.
 inline Point::Point( const vec2& v, const float z ) : x(v.x), y(v.y), z(z) {}
 inline Point::Point( const vec3& v ) : x(v.x), y(v.y), z(v.z) {}
@@ -0,0 +1,139 @@
+#ifndef _VERTEX_REMAP_H
+#define _VERTEX_REMAP_H
+
+#include <cstdint>
+#include <vector>
+#include <cassert>
+
+
+//! \addtogroup objet3D
+///@{
+
+//! \file
+//! table de hachage des sommets d'un mesh indexe, utilisee par read_indexed_mesh() et read_indexed_mesh_fast().
+
+/*! associe l'indexation complete d'un sommet (matiere, position, texcoord, normale) a l'indice du sommet dans le mesh.
+
+    table a adressage ouvert, les cles sont stockees directement dans un tableau, sans allocation par sommet.
+    les sommets sont numerotes dans l'ordre d'insertion, comme avec un std::map<vertex, int>.
+
+    \code
+    VertexRemap remap(n);
+
+    bool inserted;
+    int id= remap.insert(material, p, t, n, inserted);
+    if(inserted)
+        // nouveau sommet, copier ses attributs
+    \endcode
+ */
+class VertexRemap
+{
+public:
+    //! constructeur. n: nombre de sommets prevus, la table s'agrandit si necessaire.
+    VertexRemap( const size_t n= 0 ) : m_entries(), m_mask(0), m_count(0) { reserve(n); }
+
+    //! prepare la table pour stocker n sommets, sans re-allocation.
+    void reserve( const size_t n )
+    {
+        // au plus 1/2 de la table occupee
+        size_t capacity= 1024;
+        while(capacity < 2*n)
+            capacity= capacity * 2;
+
+        if(capacity > m_entries.size())
+            rehash(capacity);
+    }
+
+    /*! renvoie l'indice du sommet (m, p, t, n). insere le sommet s'il n'existe pas deja, et inserted= true.
+        p doit etre >= 0, t et n peuvent valoir -1 (pas d'attribut).
+     */
+    int insert( const int m, const int p, const int t, const int n, bool& inserted )
+    {
+        assert(p >= 0);
+        if(2 * (m_count +1) > m_entries.size())
+            rehash(m_entries.size() * 2);
+
+        for(size_t i= hash(m, p, t, n) & m_mask;; i= (i +1) & m_mask)
+        {
+            entry& e= m_entries[i];
+            if(e.value == -1)
+            {
+                // pas trouve, insere le sommet
+                e.key[0]= m; e.key[1]= p; e.key[2]= t; e.key[3]= n;
+                e.value= int(m_count++);
+                inserted= true;
+                return e.value;
+            }
+
+            if(e.key[1] == p && e.key[2] == t && e.key[3] == n && e.key[0] == m)
+            {
+                inserted= false;
+                return e.value;
+            }
+        }
+    }
+
+    //! renvoie le nombre de sommets uniques.
+    int size( ) const { return int(m_count); }
+
+    //! vide la table, sans liberer la memoire.
+    void clear( )
+    {
+        for(size_t i= 0; i < m_entries.size(); i++)
+            m_entries[i].value= -1;
+        m_count= 0;
+    }
+
+protected:
+    struct entry
+    {
+        int key[4];     //!< matiere, position, texcoord, normale.
+        int value;      //!< indice du sommet, ou -1 si l'entree est libre.
+    };
+
+    static size_t hash( const int m, const int p, const int t, const int n )
+    {
+        uint64_t h= uint64_t(uint32_t(p)) * 0x9E3779B97F4A7C15ull;
+        h^= (uint64_t(uint32_t(t)) << 32 | uint32_t(n)) * 0xC2B2AE3D27D4EB4Full;
+        h^= uint64_t(uint32_t(m)) * 0x165667B19E3779F9ull;
+
+        // melange les bits de poids fort dans les bits de poids faible, utilises par le masque
+        h^= h >> 31;
+        h*= 0xBF58476D1CE4E5B9ull;
+        h^= h >> 32;
+        return size_t(h);
+    }
+
+    void rehash( const size_t capacity )
+    {
+        assert((capacity & (capacity -1)) == 0);    // puissance de 2
+
+        entry empty;
+        empty.key[0]= empty.key[1]= empty.key[2]= empty.key[3]= -1;
+        empty.value= -1;
+
+        std::vector<entry> entries(capacity, empty);
+        std::swap(m_entries, entries);
+        m_mask= capacity -1;
+
+        // re-insere les sommets
+        for(size_t k= 0; k < entries.size(); k++)
+        {
+            const entry& e= entries[k];
+            if(e.value == -1)
+                continue;
+
+            size_t i= hash(e.key[0], e.key[1], e.key[2], e.key[3]) & m_mask;
+            while(m_entries[i].value != -1)
+                i= (i +1) & m_mask;
+            m_entries[i]= e;
+        }
+    }
+
+    std::vector<entry> m_entries;
+    size_t m_mask;
+    size_t m_count;
+};
+
+///@}
+#endif
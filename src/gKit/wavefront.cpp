@@ -4,11 +4,11 @@
 #include <ctype.h>
 #include <climits>
 
-#include <map>
 #include <algorithm>
 
 #include "files.h"
 #include "wavefront.h"
+#include "vertex_remap.h"
 
 
 Mesh read_mesh( const char *filename )
@@ -171,29 +171,6 @@ Mesh read_mesh( const char *filename )
 }
 
 
-//! representation de l'indexation complete d'un sommet
-struct vertex
-{
-    int material;
-    int position;
-    int texcoord;
-    int normal;
-    
-    vertex( ) : material(-1), position(-1), texcoord(-1), normal(-1) {}
-    vertex( const int m, const int p, const int t, const int n ) : material(m), position(p), texcoord(t), normal(n) {}
-    
-    // comparaison lexicographique de 2 sommets / des indices de leurs attributs
-    bool operator< ( const vertex& b ) const
-    {
-        if(material != b.material) return material < b.material;
-        if(position != b.position) return position < b.position;
-        if(texcoord != b.texcoord) return texcoord < b.texcoord;
-        if(normal != b.normal) return normal < b.normal;
-        return false;
-    }
-};
-
-
 Mesh read_indexed_mesh( const char *filename )
 {
     FILE *in= fopen(filename, "rb");
@@ -216,7 +193,7 @@ Mesh read_indexed_mesh( const char *filename )
     std::vector<int> idt;
     std::vector<int> idn;
     
-    std::map<vertex, int> remap;
+    VertexRemap remap;
     
     char tmp[1024];
     char line_buffer[1024];
@@ -312,8 +289,9 @@ Mesh read_indexed_mesh( const char *filename )
                     if(p < 0) break; // error
                     
                     // recherche / insere le sommet 
-                    auto found= remap.insert( std::make_pair(vertex(material_id, p, t, n), int(remap.size())) );
-                    if(found.second)
+                    bool inserted;
+                    int id= remap.insert(material_id, p, t, n, inserted);
+                    if(inserted)
                     {
                         // pas trouve, copie les nouveaux attributs
                         if(t != -1) data.texcoord(texcoords[t]);
@@ -322,7 +300,7 @@ Mesh read_indexed_mesh( const char *filename )
                     }
                     
                     // construit l'index buffer
-                    data.index(found.first->second);
+                    data.index(id);
                 }
             }
         }
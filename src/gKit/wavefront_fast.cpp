@@ -1,13 +1,20 @@
 
 #include <cstdio>
+#include <cstring>
 #include <ctype.h>
 #include <climits>
 
-#include <map>
+#include <string>
+#include <chrono>
 #include <algorithm>
 
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
 #include "files.h"
 #include "wavefront.h"
+#include "vertex_remap.h"
 #include "wavefront_fast.h"
 
 // parse_int() + parse_float() + tools from fast_obj parser
@@ -303,29 +310,6 @@ Mesh read_mesh_fast( const char *filename )
 }
 
 
-//! representation de l'indexation complete d'un sommet
-struct vertex
-{
-    int material;
-    int position;
-    int texcoord;
-    int normal;
-    
-    vertex( ) : material(-1), position(-1), texcoord(-1), normal(-1) {}
-    vertex( const int m, const int p, const int t, const int n ) : material(m), position(p), texcoord(t), normal(n) {}
-    
-    // comparaison lexicographique de 2 sommets / des indices de leurs attributs
-    bool operator< ( const vertex& b ) const
-    {
-        if(material != b.material) return material < b.material;
-        if(position != b.position) return position < b.position;
-        if(texcoord != b.texcoord) return texcoord < b.texcoord;
-        if(normal != b.normal) return normal < b.normal;
-        return false;
-    }
-};
-
-
 Mesh read_indexed_mesh_fast( const char *filename )
 {
     FILE *in= fopen(filename, "rb");
@@ -348,7 +332,7 @@ Mesh read_indexed_mesh_fast( const char *filename )
     std::vector<int> idt;
     std::vector<int> idn;
     
-    std::map<vertex, int> remap;
+    VertexRemap remap;
     
     char tmp[1024*64];
     char line_buffer[1024*64];
@@ -453,8 +437,9 @@ Mesh read_indexed_mesh_fast( const char *filename )
                     if(p < 0) break; // error
                     
                     // recherche / insere le sommet 
-                    auto found= remap.insert( std::make_pair(vertex(material_id, p, t, n), int(remap.size())) );
-                    if(found.second)
+                    bool inserted;
+                    int id= remap.insert(material_id, p, t, n, inserted);
+                    if(inserted)
                     {
                         // pas trouve, copie les nouveaux attributs
                         if(t != -1) data.texcoord(texcoords[t]);
@@ -463,7 +448,7 @@ Mesh read_indexed_mesh_fast( const char *filename )
                     }
                     
                     // construit l'index buffer
-                    data.index(found.first->second);
+                    data.index(id);
                 }
             }
         }
@@ -495,3 +480,583 @@ Mesh read_indexed_mesh_fast( const char *filename )
     
     return data;
 }
+
+
+// version parallele : le fichier est projete en memoire, decoupe en blocs de lignes completes, et chaque bloc est analyse par un thread.
+// les attributs et les faces de chaque bloc sont ensuite concatenes, dans l'ordre du fichier.
+
+//! evenement mtllib / usemtl d'un bloc, a traiter dans l'ordre du fichier.
+struct obj_event
+{
+    bool mtllib;
+    std::string name;
+};
+
+//! resultat de l'analyse d'un bloc de lignes.
+struct obj_chunk
+{
+    const char *begin;
+    const char *end;
+    
+    std::vector<vec3> positions;
+    std::vector<vec2> texcoords;
+    std::vector<vec3> normals;
+    
+    std::vector<int> corners;               //!< indices p, t, n de chaque sommet, -1 si l'attribut n'est pas defini.
+    std::vector<unsigned char> relative;    //!< indices relatifs au debut du bloc, bit 0: p, bit 1: t, bit 2: n.
+    std::vector<int> faces;                 //!< nombre de sommets de chaque face.
+    std::vector<int> face_events;           //!< indice de l'evenement usemtl de chaque face, ou -1 si la matiere est definie par un bloc precedent.
+    std::vector<obj_event> events;
+    int usemtl;                             //!< dernier evenement usemtl du bloc, ou -1.
+    
+    int triangles;
+    int missing_texcoords;
+    int missing_normals;
+    bool error;
+    
+    obj_chunk( ) : begin(nullptr), end(nullptr), usemtl(-1), triangles(0), missing_texcoords(0), missing_normals(0), error(false) {}
+};
+
+// convertit un indice obj, numerote a partir de 1 ou a partir de la fin (< 0), en indice relatif au debut du bloc.
+static
+int obj_index( const int id, const int count, unsigned char& relative, const unsigned char bit )
+{
+    if(id > 0)
+        return id -1;
+    if(id == 0)
+        return -1;  // pas d'attribut
+    
+    // indice relatif, peut designer un attribut d'un bloc precedent
+    relative|= bit;
+    return count + id;
+}
+
+static
+void parse_obj_line( obj_chunk& chunk, const char *line )
+{
+    line= skip_whitespace(line);
+    if(line[0] == 'v')
+    {
+        float x, y, z;
+        if(line[1] == ' ')          // position x y z
+        {
+            line+= 2;
+            line= parse_float(line, &x);
+            line= parse_float(line, &y);
+            line= parse_float(line, &z);
+            
+            chunk.positions.push_back( vec3(x, y, z) );
+        }
+        else if(line[1] == 'n')     // normal x y z
+        {
+            line+= 3;
+            line= parse_float(line, &x);
+            line= parse_float(line, &y);
+            line= parse_float(line, &z);
+            
+            chunk.normals.push_back( vec3(x, y, z) );
+        }
+        else if(line[1] == 't')     // texcoord x y
+        {
+            line+= 3;
+            line= parse_float(line, &x);
+            line= parse_float(line, &y);
+            
+            chunk.texcoords.push_back( vec2(x, y) );
+        }
+    }
+    
+    else if(line[0] == 'f')         // face a b c ...
+    {
+        int count= 0;
+        for(line= line +1;; count++)
+        {
+            line= skip_whitespace(line);
+            if(!is_digit(*line) && *line != '-')
+                break;  // fin de ligne
+            
+            int idp= 0, idt= 0, idn= 0;
+            line= parse_int(line, &idp);
+            if(*line == '/')
+            {
+                line++;
+                if(*line != '/')
+                    line= parse_int(line, &idt);
+                
+                if(*line == '/')
+                {
+                    line++;
+                    line= parse_int(line, &idn);
+                }
+            }
+            
+            unsigned char relative= 0;
+            int p= obj_index(idp, int(chunk.positions.size()), relative, 1);
+            int t= obj_index(idt, int(chunk.texcoords.size()), relative, 2);
+            int n= obj_index(idn, int(chunk.normals.size()), relative, 4);
+            if(idp == 0)
+                chunk.error= true;
+            if(t == -1 && !(relative & 2))
+                chunk.missing_texcoords++;
+            if(n == -1 && !(relative & 4))
+                chunk.missing_normals++;
+            
+            chunk.corners.push_back(p);
+            chunk.corners.push_back(t);
+            chunk.corners.push_back(n);
+            chunk.relative.push_back(relative);
+        }
+        
+        if(count < 3)
+        {
+            // face degeneree, ignoree
+            chunk.corners.resize(chunk.corners.size() - 3*count);
+            chunk.relative.resize(chunk.relative.size() - count);
+            return;
+        }
+        
+        // la matiere de la face est definie par le dernier usemtl du bloc, s'il existe
+        chunk.faces.push_back(count);
+        chunk.face_events.push_back(chunk.usemtl);
+        chunk.triangles+= count -2;
+    }
+    
+    else if(line[0] == 'm' || line[0] == 'u')
+    {
+        bool mtllib= (strncmp(line, "mtllib", 6) == 0);
+        bool usemtl= (strncmp(line, "usemtl", 6) == 0);
+        if(!mtllib && !usemtl)
+            return;
+        
+        line= skip_whitespace(line + 6);
+        const char *last= line;
+        while(*last && *last != '\n' && *last != '\r')
+            last++;
+        
+        obj_event event;
+        event.mtllib= mtllib;
+        event.name.assign(line, last);
+        if(usemtl)
+            chunk.usemtl= int(chunk.events.size());
+        chunk.events.push_back(event);
+    }
+}
+
+static
+void parse_obj_chunk( obj_chunk& chunk )
+{
+    const char *line= chunk.begin;
+    while(line < chunk.end)
+    {
+        const char *eol= (const char *) memchr(line, '\n', chunk.end - line);
+        if(eol == nullptr)
+        {
+            // derniere ligne du fichier, sans \n... le fichier projete n'est pas termine par un 0, copie la ligne.
+            std::string last(line, chunk.end);
+            parse_obj_line(chunk, last.c_str());
+            break;
+        }
+        
+        parse_obj_line(chunk, line);
+        line= eol +1;
+    }
+}
+
+static
+int obj_threads( )
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+//! analyse un fichier projete en memoire, en parallele. renvoie les blocs dans l'ordre du fichier.
+static
+bool parse_obj_chunks( const MappedFile& file, std::vector<obj_chunk>& chunks )
+{
+    // decoupe le fichier en blocs de lignes completes, au moins 1Mo par bloc
+    int threads= obj_threads();
+    int n= int(std::min(file.size / (1024*1024), size_t(4 * threads)));
+    if(n < 1) n= 1;
+    
+    chunks.resize(n);
+    for(int i= 0; i < n; i++)
+    {
+        const char *begin= file.data + file.size / n * i;
+        if(i > 0)
+        {
+            // commence au debut de la ligne suivante
+            const char *eol= (const char *) memchr(begin -1, '\n', file.data + file.size - begin +1);
+            begin= eol ? eol +1 : file.data + file.size;
+        }
+        
+        chunks[i].begin= begin;
+        if(i > 0)
+            chunks[i-1].end= begin;
+    }
+    chunks[n-1].end= file.data + file.size;
+    
+    #pragma omp parallel for schedule(dynamic, 1)
+    for(int i= 0; i < n; i++)
+        parse_obj_chunk(chunks[i]);
+    
+    for(int i= 0; i < n; i++)
+        if(chunks[i].error)
+            return false;
+    
+    return true;
+}
+
+//! concatene les attributs des blocs et resout les indices relatifs.
+static
+bool merge_obj_chunks( std::vector<obj_chunk>& chunks, std::vector<vec3>& positions, std::vector<vec2>& texcoords, std::vector<vec3>& normals )
+{
+    int n= int(chunks.size());
+    std::vector<int> base(3*n +3, 0);
+    for(int i= 0; i < n; i++)
+    {
+        base[3*(i+1)]= base[3*i] + int(chunks[i].positions.size());
+        base[3*(i+1) +1]= base[3*i +1] + int(chunks[i].texcoords.size());
+        base[3*(i+1) +2]= base[3*i +2] + int(chunks[i].normals.size());
+    }
+    
+    positions.resize(base[3*n]);
+    texcoords.resize(base[3*n +1]);
+    normals.resize(base[3*n +2]);
+    
+    int errors= 0;
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+: errors)
+    for(int i= 0; i < n; i++)
+    {
+        obj_chunk& chunk= chunks[i];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + base[3*i]);
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + base[3*i +1]);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + base[3*i +2]);
+        
+        // indices globaux
+        for(int k= 0; k < int(chunk.relative.size()); k++)
+        {
+            int *corner= &chunk.corners[3*k];
+            for(int a= 0; a < 3; a++)
+            {
+                if(chunk.relative[k] & (1 << a))
+                    corner[a]+= base[3*i +a];
+                else if(corner[a] == -1)
+                    continue;       // pas d'attribut
+                
+                if(corner[a] < 0 || corner[a] >= base[3*n +a])
+                    errors++;       // indice invalide
+            }
+        }
+        
+        // libere la memoire temporaire
+        std::vector<vec3>().swap(chunk.positions);
+        std::vector<vec2>().swap(chunk.texcoords);
+        std::vector<vec3>().swap(chunk.normals);
+    }
+    
+    return (errors == 0);
+}
+
+//! resout les matieres des faces de chaque bloc, dans l'ordre du fichier. renvoie l'indice de la matiere de chaque evenement usemtl et la matiere active au debut de chaque bloc.
+static
+void resolve_obj_materials( const char *filename, std::vector<obj_chunk>& chunks, Mesh& data, std::vector<std::vector<int> >& event_materials, std::vector<int>& start_materials )
+{
+    int n= int(chunks.size());
+    event_materials.resize(n);
+    start_materials.resize(n);
+    
+    int material_id= -1;
+    for(int i= 0; i < n; i++)
+    {
+        start_materials[i]= material_id;
+        
+        obj_chunk& chunk= chunks[i];
+        event_materials[i].assign(chunk.events.size(), -1);
+        for(int k= 0; k < int(chunk.events.size()); k++)
+        {
+            if(chunk.events[k].mtllib)
+            {
+                Materials materials= read_materials( normalize_filename(pathname(filename) + chunk.events[k].name).c_str() );
+                // enregistre les matieres dans le mesh
+                data.materials(materials);
+            }
+            else
+                material_id= data.materials().find(chunk.events[k].name.c_str());
+            
+            event_materials[i][k]= material_id;
+        }
+    }
+    
+    // force une matiere par defaut, si necessaire
+    bool missing= false;
+    for(int i= 0; i < n && !missing; i++)
+    {
+        if(start_materials[i] == -1)
+            for(int k= 0; k < int(chunks[i].face_events.size()); k++)
+                if(chunks[i].face_events[k] == -1)
+                {
+                    missing= true;
+                    break;
+                }
+        
+        for(int k= 0; k < int(event_materials[i].size()) && !missing; k++)
+            if(!chunks[i].events[k].mtllib && event_materials[i][k] == -1)
+                missing= true;
+    }
+    
+    if(missing)
+    {
+        int default_id= data.materials().default_material_index();
+        for(int i= 0; i < n; i++)
+        {
+            if(start_materials[i] == -1)
+                start_materials[i]= default_id;
+            for(int k= 0; k < int(event_materials[i].size()); k++)
+                if(event_materials[i][k] == -1)
+                    event_materials[i][k]= default_id;
+        }
+    }
+}
+
+static
+void print_obj_stats( const char *filename, const Mesh& data, const size_t size, const std::chrono::high_resolution_clock::time_point start, const int chunks )
+{
+    auto stop= std::chrono::high_resolution_clock::now();
+    int cpu= int(std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count());
+    double mb= double(size) / (1024*1024);
+    
+    printf("mesh '%s': %d triangles, %d positions %s %s\n", filename, data.triangle_count(), int(data.positions().size()), 
+        data.has_texcoord() ? "texcoord" : "", data.has_normal() ? "normal" : "");
+    printf("  %.1fMo in %dms: %.1fMo/s, %d threads, %d chunks\n", mb, cpu, cpu ? mb * 1000 / cpu : 0.0, obj_threads(), chunks);
+}
+
+
+Mesh read_mesh_parallel( const char *filename )
+{
+    auto start= std::chrono::high_resolution_clock::now();
+    
+    MappedFile file= map_file(filename);
+    if(file.data == nullptr)
+    {
+        printf("[error] loading mesh '%s'...\n", filename);
+        return Mesh::error();
+    }
+    
+    printf("loading mesh '%s'...\n", filename);
+    
+    std::vector<obj_chunk> chunks;
+    std::vector<vec3> positions;
+    std::vector<vec2> texcoords;
+    std::vector<vec3> normals;
+    if(!parse_obj_chunks(file, chunks) || !merge_obj_chunks(chunks, positions, texcoords, normals))
+    {
+        unmap_file(file);
+        printf("[error] loading mesh '%s'... invalid face\n", filename);
+        return Mesh::error();
+    }
+    
+    Mesh data(GL_TRIANGLES);
+    std::vector<std::vector<int> > event_materials;
+    std::vector<int> start_materials;
+    resolve_obj_materials(filename, chunks, data, event_materials, start_materials);
+    
+    // position des triangles de chaque bloc dans le mesh
+    int n= int(chunks.size());
+    std::vector<int> first(n +1, 0);
+    int missing_texcoords= 0;
+    int missing_normals= 0;
+    for(int i= 0; i < n; i++)
+    {
+        first[i+1]= first[i] + chunks[i].triangles;
+        missing_texcoords+= chunks[i].missing_texcoords;
+        missing_normals+= chunks[i].missing_normals;
+    }
+    
+    // les attributs absents de quelques sommets reprennent la valeur du sommet precedent, comme read_mesh_fast() et Mesh::vertex(),
+    // ou une valeur par defaut avant le premier sommet qui definit l'attribut.
+    int triangles= first[n];
+    bool use_texcoords= (texcoords.size() > 0 && missing_texcoords < 3*triangles);
+    bool use_normals= (normals.size() > 0 && missing_normals < 3*triangles);
+    
+    data.m_positions.resize(3*triangles);
+    if(use_texcoords) data.m_texcoords.resize(3*triangles);
+    if(use_normals) data.m_normals.resize(3*triangles);
+    data.m_triangle_materials.resize(triangles);
+    
+    // nombre de sommets sans attribut au debut de chaque bloc, le sommet precedent appartient a un autre bloc...
+    std::vector<int> leading_texcoords(n, 0);
+    std::vector<int> leading_normals(n, 0);
+    
+    #pragma omp parallel for schedule(dynamic, 1)
+    for(int i= 0; i < n; i++)
+    {
+        const obj_chunk& chunk= chunks[i];
+        int triangle_id= first[i];
+        int corner_id= 0;
+        for(int f= 0; f < int(chunk.faces.size()); f++)
+        {
+            int material_id= (chunk.face_events[f] == -1) ? start_materials[i] : event_materials[i][chunk.face_events[f]];
+            
+            // triangulation de la face (supposee convexe)
+            const int *corners= &chunk.corners[3*corner_id];
+            for(int v= 2; v < chunk.faces[f]; v++, triangle_id++)
+            {
+                data.m_triangle_materials[triangle_id]= material_id;
+                
+                int idv[3]= { 0, v -1, v };
+                for(int k= 0; k < 3; k++)
+                {
+                    const int *corner= corners + 3*idv[k];
+                    int id= 3*triangle_id + k;
+                    int previous= id - 3*first[i];      // nombre de sommets deja copies dans le bloc
+                    data.m_positions[id]= positions[corner[0]];
+                    if(use_texcoords)
+                    {
+                        if(corner[1] != -1)
+                            data.m_texcoords[id]= texcoords[corner[1]];
+                        else if(previous > 0)
+                            data.m_texcoords[id]= data.m_texcoords[id -1];
+                        
+                        if(corner[1] == -1 && leading_texcoords[i] == previous)
+                            leading_texcoords[i]++;
+                    }
+                    if(use_normals)
+                    {
+                        if(corner[2] != -1)
+                            data.m_normals[id]= normals[corner[2]];
+                        else if(previous > 0)
+                            data.m_normals[id]= data.m_normals[id -1];
+                        
+                        if(corner[2] == -1 && leading_normals[i] == previous)
+                            leading_normals[i]++;
+                    }
+                }
+            }
+            
+            corner_id+= chunk.faces[f];
+        }
+    }
+    
+    // termine les premiers sommets de chaque bloc avec le dernier sommet du bloc precedent, dans l'ordre du fichier
+    for(int i= 1; i < n; i++)
+    {
+        int begin= 3*first[i];
+        if(begin == 0)
+            continue;
+        
+        if(use_texcoords)
+            std::fill(data.m_texcoords.begin() + begin, data.m_texcoords.begin() + begin + leading_texcoords[i], data.m_texcoords[begin -1]);
+        if(use_normals)
+            std::fill(data.m_normals.begin() + begin, data.m_normals.begin() + begin + leading_normals[i], data.m_normals[begin -1]);
+    }
+    data.m_update_buffers= true;
+    
+    print_obj_stats(filename, data, file.size, start, n);
+    unmap_file(file);
+    return data;
+}
+
+
+Mesh read_indexed_mesh_parallel( const char *filename )
+{
+    auto start= std::chrono::high_resolution_clock::now();
+    
+    MappedFile file= map_file(filename);
+    if(file.data == nullptr)
+    {
+        printf("[error] loading indexed mesh '%s'...\n", filename);
+        return Mesh::error();
+    }
+    
+    printf("loading indexed mesh '%s'...\n", filename);
+    
+    std::vector<obj_chunk> chunks;
+    std::vector<vec3> positions;
+    std::vector<vec2> texcoords;
+    std::vector<vec3> normals;
+    if(!parse_obj_chunks(file, chunks) || !merge_obj_chunks(chunks, positions, texcoords, normals))
+    {
+        unmap_file(file);
+        printf("[error] loading indexed mesh '%s'... invalid face\n", filename);
+        return Mesh::error();
+    }
+    
+    Mesh data(GL_TRIANGLES);
+    std::vector<std::vector<int> > event_materials;
+    std::vector<int> start_materials;
+    resolve_obj_materials(filename, chunks, data, event_materials, start_materials);
+    
+    int n= int(chunks.size());
+    int triangles= 0;
+    int missing_texcoords= 0;
+    int missing_normals= 0;
+    for(int i= 0; i < n; i++)
+    {
+        triangles+= chunks[i].triangles;
+        missing_texcoords+= chunks[i].missing_texcoords;
+        missing_normals+= chunks[i].missing_normals;
+    }
+    
+    bool use_texcoords= (texcoords.size() > 0 && missing_texcoords < 3*triangles);
+    bool use_normals= (normals.size() > 0 && missing_normals < 3*triangles);
+    
+    data.m_indices.reserve(3*triangles);
+    data.m_triangle_materials.reserve(triangles);
+    data.m_positions.reserve(positions.size());
+    if(use_texcoords) data.m_texcoords.reserve(positions.size());
+    if(use_normals) data.m_normals.reserve(positions.size());
+    
+    // construit les sommets uniques, dans l'ordre du fichier. au plus 3 sommets par triangle, en general autant que d'attributs...
+    size_t vertices= std::max(positions.size(), std::max(texcoords.size(), normals.size()));
+    VertexRemap remap(std::min(size_t(3*triangles), vertices));
+    for(int i= 0; i < n; i++)
+    {
+        const obj_chunk& chunk= chunks[i];
+        int corner_id= 0;
+        for(int f= 0; f < int(chunk.faces.size()); f++)
+        {
+            int material_id= (chunk.face_events[f] == -1) ? start_materials[i] : event_materials[i][chunk.face_events[f]];
+            
+            // triangule la face
+            const int *corners= &chunk.corners[3*corner_id];
+            for(int v= 2; v < chunk.faces[f]; v++)
+            {
+                data.m_triangle_materials.push_back(material_id);
+                
+                int idv[3]= { 0, v -1, v };
+                for(int k= 0; k < 3; k++)
+                {
+                    const int *corner= corners + 3*idv[k];
+                    
+                    // recherche / insere le sommet 
+                    bool inserted;
+                    int id= remap.insert(material_id, corner[0], corner[1], corner[2], inserted);
+                    if(inserted)
+                    {
+                        // pas trouve, copie les nouveaux attributs
+                        data.m_positions.push_back(positions[corner[0]]);
+                        // ou reprend les attributs du sommet precedent, comme read_indexed_mesh_fast() et Mesh::vertex()
+                        if(use_texcoords) data.m_texcoords.push_back((corner[1] != -1) ? texcoords[corner[1]] : data.m_texcoords.empty() ? vec2() : data.m_texcoords.back());
+                        if(use_normals) data.m_normals.push_back((corner[2] != -1) ? normals[corner[2]] : data.m_normals.empty() ? vec3() : data.m_normals.back());
+                    }
+                    
+                    // construit l'index buffer
+                    data.m_indices.push_back(id);
+                }
+            }
+            
+            corner_id+= chunk.faces[f];
+        }
+    }
+    data.m_update_buffers= true;
+    
+    print_obj_stats(filename, data, file.size, start, n);
+    printf("  %d indices, %d positions %d texcoords %d normals\n", 
+        int(data.indices().size()), int(data.positions().size()), int(data.texcoords().size()), int(data.normals().size()));
+    
+    unmap_file(file);
+    return data;
+}
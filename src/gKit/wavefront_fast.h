@@ -17,5 +17,15 @@ Mesh read_mesh_fast( const char *filename );
 //! charge un fichier wavefront .obj et renvoie un mesh compose de triangles indexes. utiliser glDrawElements pour l'afficher. a detruire avec Mesh::release( ).
 Mesh read_indexed_mesh_fast( const char *filename );
 
+/*! charge un fichier wavefront .obj et renvoie un mesh compose de triangles non indexes. meme resultat que read_mesh_fast(). 
+    le fichier est projete en memoire et analyse en parallele, par blocs de lignes. affiche le debit de chargement en Mo/s.
+ */
+Mesh read_mesh_parallel( const char *filename );
+
+/*! charge un fichier wavefront .obj et renvoie un mesh compose de triangles indexes. meme resultat que read_indexed_mesh_fast(). 
+    le fichier est projete en memoire et analyse en parallele, par blocs de lignes. affiche le debit de chargement en Mo/s.
+ */
+Mesh read_indexed_mesh_parallel( const char *filename );
+
 ///@}
 #endif
@@ -316,9 +316,8 @@ struct IS : public App
                             m_hitn(x, y)= Color(hit.n.x, hit.n.y, hit.n.z);
                             
                             Ray shadow(hit.p + hit.n * 0.001f, point + normal * 0.001f);
-                            Hit shadow_hit;
                             int v= 1;
-                            if(intersect(shadow, shadow_hit))
+                            if(occluded(shadow))
                                 v= 0;
                             
                             m_hitv(x, y)= Color(v, v, v);
@@ -457,6 +456,19 @@ struct IS : public App
         return (hit.object_id != -1);
     }
 
+    // renvoie vrai si le rayon touche un triangle, pas besoin de trouver l'intersection la plus proche
+    bool occluded( const Ray& ray )
+    {
+        for(size_t i= 0; i < m_triangles.size(); i++)
+        {
+            float t, u, v;
+            if(m_triangles[i].intersect(ray, ray.tmax, t, u, v))
+                return true;
+        }
+        
+        return false;
+    }
+
 protected:
     Mesh m_mesh;
     Orbiter m_camera;
@@ -0,0 +1,201 @@
+//! \file bench_bvh.cpp compare les constructions de bvh : repartitions, lbvh, taille des feuilles, cout / sah, et temps de parcours des rayons primaires. compare aussi le parcours des noeuds binaires et des noeuds a 4 ou 8 fils, et les tests des triangles des feuilles un par un ou par blocs.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "orbiter.h"
+#include "mesh.h"
+#include "wavefront.h"
+#include "gltf.h"
+#include "bvh.h"
+#include "bench_rays.h"
+
+
+// recupere les triangles d'un fichier .obj ou d'une scene .gltf, dans le repere de la scene.
+std::vector<Triangle> read_triangles( const char *filename )
+{
+    std::vector<Triangle> triangles;
+
+    const char *ext= strrchr(filename, '.');
+    if(ext && (strcmp(ext, ".gltf") == 0 || strcmp(ext, ".glb") == 0))
+    {
+        GLTFScene scene= read_gltf_scene(filename);
+        for(unsigned node_id= 0; node_id < scene.nodes.size(); node_id++)
+        {
+            const GLTFNode& node= scene.nodes[node_id];
+            const GLTFMesh& mesh= scene.meshes[node.mesh_index];
+            for(unsigned primitive_id= 0; primitive_id < mesh.primitives.size(); primitive_id++)
+            {
+                const GLTFPrimitives& primitives= mesh.primitives[primitive_id];
+                for(unsigned i= 0; i +2 < primitives.indices.size(); i+= 3)
+                {
+                    Point a= node.model( Point(primitives.positions[primitives.indices[i]]) );
+                    Point b= node.model( Point(primitives.positions[primitives.indices[i+1]]) );
+                    Point c= node.model( Point(primitives.positions[primitives.indices[i+2]]) );
+                    triangles.push_back( Triangle(a, b, c, node.mesh_index, primitive_id, i/3) );
+                }
+            }
+        }
+    }
+    else
+    {
+        Mesh mesh= read_mesh(filename);
+        int n= mesh.triangle_count();
+        for(int i= 0; i < n; i++)
+            triangles.push_back( Triangle(mesh.triangle(i), i) );
+    }
+
+    return triangles;
+}
+
+
+int main( int argc, char **argv )
+{
+    const char *filename= "data/bigguy.obj";
+    if(argc > 1)
+        filename= argv[1];
+
+    std::vector<Triangle> triangles= read_triangles(filename);
+    if(triangles.empty())
+        return 1;
+    printf("%s: %d triangles\n", filename, int(triangles.size()));
+
+    // regle la camera sur l'englobant des triangles
+    BBox bounds= EmptyBox();
+    for(unsigned i= 0; i < triangles.size(); i++)
+        bounds.insert(triangles[i].bounds());
+
+    const int width= 1024;
+    const int height= 640;
+    Orbiter camera;
+    camera.lookat(bounds.pmin, bounds.pmax);
+    camera.projection(width, height, 45);
+    Transform inv= Inverse(camera.viewport() * camera.projection() * camera.view());
+
+    // un rayon par pixel
+    std::vector<Ray> rays;
+    for(int y= 0; y < height; y++)
+    for(int x= 0; x < width; x++)
+    {
+        Point o= inv(Point(x + .5f, y + .5f, 0));
+        Point e= inv(Point(x + .5f, y + .5f, 1));
+        rays.push_back( Ray(o, e) );
+    }
+
+    struct Config
+    {
+        char name[64];
+        BVHOptions options;
+
+        Config( const BVHOptions& _options ) : options(_options)
+        {
+            if(options.builder == BVH_MIDPOINT)
+                sprintf(name, "midpoint leaf %d", options.leaf_max);
+            else if(options.builder == BVH_LBVH)
+                sprintf(name, "lbvh%s leaf %d", options.treelet ? " + treelets" : "", options.leaf_max);
+            else
+                sprintf(name, "sah leaf %d, %d bins", options.leaf_max, options.bins);
+        }
+    };
+
+    std::vector<Config> configs;
+    configs.push_back( Config(BVHOptions(BVH_MIDPOINT, 1)) );
+    configs.push_back( Config(BVHOptions(BVH_MIDPOINT, 4)) );
+    for(int leaf : {1, 4, 8})
+    for(int bins : {8, 16, 32})
+    {
+        BVHOptions options(BVH_SAH, leaf);
+        options.bins= bins;
+        configs.push_back( Config(options) );
+    }
+    for(int leaf : {1, 4})
+    for(bool treelet : {false, true})
+    {
+        BVHOptions options(BVH_LBVH, leaf);
+        options.treelet= treelet;
+        configs.push_back( Config(options) );
+    }
+
+    for(unsigned k= 0; k < configs.size(); k++)
+    {
+        BVH bvh;
+        bvh.build(triangles, configs[k].options);
+        BVHStats stats= bvh.stats();
+
+        // parcours, en parallele
+        int hits= 0;
+        float time= trace(bvh, rays, hits);
+        const int n= int(rays.size());
+
+        printf("%-24s build %8.1fms, sah %7.2f, %7d nodes, %7d leaves, depth %2d max %5.1f avg, leaf %5.2f avg, trace %7.1fms %6.2f Mrays/s (%d hits)\n",
+            configs[k].name, stats.build_time, stats.sah_cost, stats.nodes, stats.leaves, stats.depth_max, stats.depth_average, stats.leaf_average,
+            time, float(n) / time / 1000, hits);
+    }
+
+    // rayons incoherents, entre 2 points aleatoires de l'englobant
+    std::vector<Ray> random_rays;
+    srand(1);
+    for(unsigned i= 0; i < rays.size(); i++)
+    {
+        Point a= Point(random_float(), random_float(), random_float());
+        Point b= Point(random_float(), random_float(), random_float());
+        Vector extent= Vector(bounds.pmin, bounds.pmax);
+        random_rays.push_back( Ray(bounds.pmin + Vector(a) * extent, bounds.pmin + Vector(b) * extent) );
+    }
+
+    // parcours des noeuds binaires et des noeuds larges, cf BVHT::collapse()
+    printf("\ntraversal, sah leaf 4:\n");
+    BVH bvh;
+    bvh.build(triangles, BVHOptions(BVH_SAH, 4));
+    for(int width : {2, 4, 8})
+    {
+        bvh.collapse(width);
+        int nodes= (width == 2) ? int(bvh.nodes.size()) : (width == 4) ? int(bvh.nodes4.size()) : int(bvh.nodes8.size());
+
+        for(int k= 0; k < 2; k++)
+        {
+            const std::vector<Ray>& set= (k == 0) ? rays : random_rays;
+
+            int hits= 0;
+            float time= trace(bvh, set, hits);
+            const int n= int(set.size());
+
+            printf("  width %d, %7d nodes, %-7s rays: trace %7.1fms %6.2f Mrays/s (%d hits)\n",
+                width, nodes, (k == 0) ? "primary" : "random", time, float(n) / time / 1000, hits);
+        }
+    }
+
+    // triangles des feuilles testes un par un ou par blocs, cf BVHOptions::leaf_block
+    printf("\nleaf blocks, sah, width 8:\n");
+    for(int leaf : {4, 8})
+    for(int block : {0, 4, 8})
+    for(bool watertight : {false, true})
+    {
+        if(block == 0 && watertight)
+            continue;
+
+        BVHOptions options(BVH_SAH, leaf);
+        options.width= 8;
+        options.leaf_block= block;
+        options.watertight= watertight;
+        bvh.build(triangles, options);
+
+        for(int k= 0; k < 2; k++)
+        {
+            const std::vector<Ray>& set= (k == 0) ? rays : random_rays;
+
+            int hits= 0;
+            float time= trace(bvh, set, hits);
+            const int n= int(set.size());
+
+            printf("  leaf %d, block %d%-11s %-7s rays: trace %7.1fms %6.2f Mrays/s (%d hits)\n",
+                leaf, block, watertight ? " watertight" : "", (k == 0) ? "primary" : "random", time, float(n) / time / 1000, hits);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+//! \file bench_bvh_build.cpp temps de construction du bvh en fonction du nombre de threads, sur plusieurs millions de triangles.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "vec.h"
+#include "mesh.h"
+#include "wavefront.h"
+#include "bvh.h"
+
+
+int main( int argc, char **argv )
+{
+    const char *filename= "data/bigguy.obj";
+    if(argc > 1)
+        filename= argv[1];
+
+    // nombre de copies de l'objet, 2 millions de triangles par defaut
+    int copies= 0;
+    if(argc > 2)
+        copies= atoi(argv[2]);
+
+    Mesh mesh= read_mesh(filename);
+    if(mesh.vertex_count() == 0)
+        return 1;
+
+    const int n= mesh.triangle_count();
+    if(copies < 1)
+        copies= std::max(1, 2000000 / n);
+
+    Point pmin, pmax;
+    mesh.bounds(pmin, pmax);
+    Vector extent= Vector(pmin, pmax) * 1.5f;
+
+    // replique l'objet sur une grille
+    int grid= int(std::ceil(std::cbrt(float(copies))));
+    std::vector<Triangle> triangles;
+    triangles.reserve(size_t(n) * copies);
+    for(int k= 0; k < copies; k++)
+    {
+        Vector offset= Vector(extent.x * (k % grid), extent.y * (k / grid % grid), extent.z * (k / grid / grid));
+        for(int i= 0; i < n; i++)
+        {
+            TriangleData t= mesh.triangle(i);
+            triangles.push_back( Triangle(Point(t.a) + offset, Point(t.b) + offset, Point(t.c) + offset, 0, 0, k*n + i) );
+        }
+    }
+    printf("%s: %d copies, %d triangles\n", filename, copies, int(triangles.size()));
+
+    int threads_max= 1;
+#ifdef _OPENMP
+    threads_max= omp_get_max_threads();
+#endif
+
+    for(int builder : {BVH_SAH, BVH_MIDPOINT, BVH_LBVH})
+    {
+        printf("%s\n", builder == BVH_SAH ? "sah leaf 4" : builder == BVH_MIDPOINT ? "midpoint leaf 4" : "lbvh leaf 4");
+
+        float reference= 0;
+        for(int threads= 1; ; threads= std::min(2*threads, threads_max))
+        {
+        #ifdef _OPENMP
+            omp_set_num_threads(threads);
+        #endif
+
+            BVH bvh;
+            bvh.build(triangles, BVHOptions(BVHBuilder(builder), 4));
+            BVHStats stats= bvh.stats();
+            if(threads == 1)
+                reference= stats.build_time;
+
+            // l'arbre ne depend pas du nombre de threads...
+            printf("  %2d threads: build %8.1fms, speedup %5.2f, sah %7.2f, %8d nodes\n",
+                threads, stats.build_time, reference / stats.build_time, stats.sah_cost, stats.nodes);
+
+            if(threads == threads_max)
+                break;
+        }
+    }
+
+#ifdef _OPENMP
+    omp_set_num_threads(threads_max);
+#endif
+    return 0;
+}
@@ -0,0 +1,164 @@
+//! \file bench_bvh_cache.cpp demarrage d'une application : construction des bvh des objets, cf BVHT::build(), ou chargement des bvh enregistres, cf BVHT::write() et BVHT::read().
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "gltf.h"
+#include "files.h"
+#include "bvh.h"
+
+
+// triangles d'un objet, et empreinte de son maillage
+struct Object
+{
+    std::vector<Triangle> triangles;
+    uint64_t key;
+};
+
+float elapsed( const std::chrono::high_resolution_clock::time_point& start )
+{
+    auto stop= std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<float, std::milli>(stop - start).count();
+}
+
+
+int main( int argc, char **argv )
+{
+    const char *filename= "data/robot.gltf";
+    if(argc > 1)
+        filename= argv[1];
+
+    std::string directory= pathname(filename);
+    if(argc > 2)
+        directory= argv[2];
+
+    // charge les objets, un .obj ou les maillages d'une scene gltf
+    auto start= std::chrono::high_resolution_clock::now();
+    std::vector<Mesh> meshes;
+    GLTFScene scene;
+    bool gltf= (strstr(filename, ".gltf") || strstr(filename, ".glb"));
+    if(gltf)
+        scene= read_gltf_scene(filename);
+    else
+        meshes.push_back( read_mesh_cached(filename) );
+    float load_time= elapsed(start);
+
+    // empreinte du contenu des maillages
+    start= std::chrono::high_resolution_clock::now();
+    std::vector<Object> objects(gltf ? scene.meshes.size() : meshes.size());
+    for(unsigned i= 0; i < objects.size(); i++)
+        objects[i].key= gltf ? mesh_hash(scene.meshes[i]) : mesh_hash(meshes[i]);
+    float hash_time= elapsed(start);
+
+    int triangle_count= 0;
+    for(unsigned i= 0; i < objects.size(); i++)
+    {
+        if(gltf)
+        {
+            const GLTFMesh& mesh= scene.meshes[i];
+            for(unsigned p= 0; p < mesh.primitives.size(); p++)
+            {
+                const GLTFPrimitives& primitives= mesh.primitives[p];
+                for(unsigned k= 0; k +2 < primitives.indices.size(); k+= 3)
+                    objects[i].triangles.push_back( Triangle(primitives.positions[primitives.indices[k]], primitives.positions[primitives.indices[k+1]], primitives.positions[primitives.indices[k+2]], i, p, k/3) );
+            }
+        }
+        else
+        {
+            for(int k= 0; k < meshes[i].triangle_count(); k++)
+                objects[i].triangles.push_back( Triangle(meshes[i].triangle(k), k) );
+        }
+
+        triangle_count+= int(objects[i].triangles.size());
+    }
+
+    if(triangle_count == 0)
+        return 1;
+
+    printf("%s: %d objects, %d triangles, load %.1fms, hash %.2fms\n", filename, int(objects.size()), triangle_count, load_time, hash_time);
+
+    for(int width : {2, 8})
+    {
+        BVHOptions options(BVH_SAH, 4);
+        options.width= width;
+
+        // construit les bvh
+        std::vector<BVH> built(objects.size());
+        start= std::chrono::high_resolution_clock::now();
+        for(unsigned i= 0; i < objects.size(); i++)
+            built[i].build(objects[i].triangles, options);
+        float build_time= elapsed(start);
+
+        // enregistre les bvh
+        std::vector<std::string> filenames;
+        start= std::chrono::high_resolution_clock::now();
+        for(unsigned i= 0; i < objects.size(); i++)
+        {
+            char name[64];
+            snprintf(name, sizeof(name), "bench_%016llx_%d.bvh", (unsigned long long) objects[i].key, width);
+            filenames.push_back(directory + name);
+            built[i].write(filenames.back().c_str(), objects[i].key);
+        }
+        float write_time= elapsed(start);
+
+        size_t bytes= 0;
+        for(unsigned i= 0; i < filenames.size(); i++)
+        {
+            MappedFile file= map_file(filenames[i]);
+            bytes+= file.size;
+            unmap_file(file);
+        }
+
+        // relit les bvh, garde le meilleur temps de 3 essais
+        std::vector<BVH> loaded(objects.size());
+        float read_time= FLT_MAX;
+        int errors= 0;
+        for(int run= 0; run < 3; run++)
+        {
+            start= std::chrono::high_resolution_clock::now();
+            for(unsigned i= 0; i < objects.size(); i++)
+                if(!loaded[i].read(filenames[i].c_str(), objects[i].key, objects[i].triangles, options))
+                    errors++;
+            read_time= std::min(read_time, elapsed(start));
+        }
+
+        // verifie que les arbres relus trouvent les memes intersections
+        srand(1);
+        int mismatches= 0;
+        for(unsigned i= 0; i < objects.size(); i++)
+        {
+            BBox bounds= built[i].bounds();
+            for(int r= 0; r < 4096; r++)
+            {
+                Point o= bounds.pmin + (bounds.pmax - bounds.pmin) * Vector(float(rand()) / RAND_MAX, float(rand()) / RAND_MAX, float(rand()) / RAND_MAX);
+                Point e= bounds.pmin + (bounds.pmax - bounds.pmin) * Vector(float(rand()) / RAND_MAX, float(rand()) / RAND_MAX, float(rand()) / RAND_MAX);
+                Ray ray(o, e);
+                Hit a= built[i].intersect(ray);
+                Hit b= loaded[i].intersect(ray);
+                if(bool(a) != bool(b) || (a && (a.t != b.t || a.triangle_id != b.triangle_id)))
+                    mismatches++;
+            }
+        }
+
+        // un cache qui ne correspond pas aux primitives est ignore
+        BVH other;
+        bool rejected= !other.read(filenames[0].c_str(), objects[0].key ^ 1, objects[0].triangles, options);
+
+        for(unsigned i= 0; i < filenames.size(); i++)
+            remove(filenames[i].c_str());
+
+        printf("  sah leaf 4, width %d: build %8.2fms, write %6.2fms, %7.1f KB, read %6.2fms x%.1f (%d errors, %d mismatches, %s)\n",
+            width, build_time, write_time, bytes / 1024.f, read_time, build_time / read_time, errors, mismatches, rejected ? "wrong key rejected" : "[error] wrong key accepted");
+        printf("    start-up: load + build %8.2fms, load + hash + read %8.2fms\n", load_time + build_time, load_time + hash_time + read_time);
+    }
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+//! \file bench_layout.cpp compare les organisations des attributs dans le vertex buffer : separes, entrelaces, compresses. cf Mesh::layout().
+
+#include <cstdio>
+
+#include "app.h"
+
+#include "mat.h"
+#include "mesh.h"
+#include "wavefront.h"
+#include "wavefront_fast.h"
+#include "orbiter.h"
+#include "draw.h"
+
+
+const char *layout_names[]= { "separate", "interleaved", "packed" };
+const int LAYOUTS= 3;
+const int FRAMES= 100;      // nombre d'images mesurees par organisation
+const int DRAWS= 8;         // nombre d'affichages de l'objet par image
+
+class BenchLayout : public App
+{
+public:
+    BenchLayout( const char *filename ) : App(1024, 640), m_filename(filename)
+    {
+        vsync_off();
+    }
+
+    int init( )
+    {
+        Mesh mesh= read_indexed_mesh_fast(m_filename);
+        if(mesh.vertex_count() == 0)
+            return -1;
+
+        Point pmin, pmax;
+        mesh.bounds(pmin, pmax);
+        m_camera.lookat(pmin, pmax);
+
+        // une copie de l'objet par organisation, chaque copie a son propre vertex buffer
+        printf("%s: %d vertices, %d triangles\n", m_filename, mesh.vertex_count(), mesh.triangle_count());
+        for(int i= 0; i < LAYOUTS; i++)
+        {
+            m_meshes[i]= mesh;
+            m_meshes[i].layout(VertexLayout(i));
+
+            size_t size= m_meshes[i].layout_buffer_size(VertexLayout(i), mesh.has_texcoord(), mesh.has_normal(), mesh.has_color(), mesh.has_material_index());
+            printf("  %-12s %8.1fMo, %3d octets par sommet\n", layout_names[i], double(size) / 1024 / 1024, int(size / mesh.vertex_count()));
+
+            m_times[i]= 0;
+            m_discard_times[i]= 0;
+        }
+
+        glGenQueries(1, &m_time_query);
+
+        glClearColor(0.2f, 0.2f, 0.2f, 1.f);
+        glClearDepth(1.f);
+        glDepthFunc(GL_LESS);
+        glEnable(GL_DEPTH_TEST);
+
+        m_frame= 0;
+        return 0;
+    }
+
+    int quit( )
+    {
+        for(int i= 0; i < LAYOUTS; i++)
+            m_meshes[i].release();
+        glDeleteQueries(1, &m_time_query);
+        return 0;
+    }
+
+    int render( )
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // une passe normale, puis une passe sans fragments, pour mesurer uniquement le traitement des sommets
+        int pass= m_frame / FRAMES;
+        int layout= pass % LAYOUTS;
+        bool discard= (pass >= LAYOUTS);
+        if(pass >= 2*LAYOUTS)
+        {
+            print_stats();
+            return 0;
+        }
+
+        // premier affichage, construit les buffers, pas de mesure
+        bool warmup= (m_frame % FRAMES == 0);
+
+        if(discard)
+            glEnable(GL_RASTERIZER_DISCARD);
+
+        glBeginQuery(GL_TIME_ELAPSED, m_time_query);
+        for(int i= 0; i < DRAWS; i++)
+            draw(m_meshes[layout], Identity(), m_camera);
+        glEndQuery(GL_TIME_ELAPSED);
+
+        if(discard)
+            glDisable(GL_RASTERIZER_DISCARD);
+
+        GLint64 time= 0;
+        glGetQueryObjecti64v(m_time_query, GL_QUERY_RESULT, &time);
+        if(!warmup)
+        {
+            if(discard)
+                m_discard_times[layout]+= time;
+            else
+                m_times[layout]+= time;
+        }
+
+        m_frame++;
+        return 1;
+    }
+
+    void print_stats( )
+    {
+        const Mesh& mesh= m_meshes[0];
+        int draws= (FRAMES -1) * DRAWS;
+
+        printf("%d draws per layout:\n", draws);
+        for(int i= 0; i < LAYOUTS; i++)
+        {
+            size_t size= m_meshes[i].layout_buffer_size(VertexLayout(i), mesh.has_texcoord(), mesh.has_normal(), mesh.has_color(), mesh.has_material_index());
+            double time= double(m_times[i]) / 1000000 / draws;
+            double discard= double(m_discard_times[i]) / 1000000 / draws;
+            // estimation, suppose que chaque sommet n'est lu qu'une fois
+            double bandwidth= double(size) / (discard / 1000) / 1024 / 1024 / 1024;
+
+            printf("  %-12s draw %7.3fms, vertices only %7.3fms, %6.1fGo/s\n", layout_names[i], time, discard, bandwidth);
+        }
+    }
+
+protected:
+    const char *m_filename;
+    Mesh m_meshes[LAYOUTS];
+    Orbiter m_camera;
+
+    GLuint m_time_query;
+    GLint64 m_times[LAYOUTS];
+    GLint64 m_discard_times[LAYOUTS];
+    int m_frame;
+};
+
+
+int main( int argc, char **argv )
+{
+    const char *filename= "data/bigguy.obj";
+    if(argc > 1)
+        filename= argv[1];
+
+    BenchLayout app(filename);
+    app.run();
+
+    return 0;
+}
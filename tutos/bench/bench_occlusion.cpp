@@ -0,0 +1,188 @@
+//! \file bench_occlusion.cpp occultation ambiante : intersection la plus proche, cf BVHT::intersect(), ou premiere intersection, cf BVHT::occluded(), un rayon a la fois ou par paquets. avec un bvh de triangles et un tlas d'instances.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "orbiter.h"
+#include "mesh.h"
+#include "wavefront.h"
+#include "bvh.h"
+#include "bench_rays.h"
+
+
+/*! genere les rayons d'occultation ambiante : rayons primaires, puis samples rayons de longueur radius autour de la normale de chaque intersection.
+    models[] transforme les normales des instances, vide pour un bvh de triangles.
+ */
+template < typename T >
+std::vector<Ray> ambient_rays( const BVHT<T>& bvh, const Mesh& mesh, const std::vector<Transform>& models, const Orbiter& camera, const int width, const int height, const int samples, const float radius )
+{
+    Transform inv= Inverse(camera.viewport() * camera.projection() * camera.view());
+
+    std::vector<Ray> rays;
+    for(int y= 0; y < height; y++)
+    for(int x= 0; x < width; x++)
+    {
+        Point o= inv(Point(x + .5f, y + .5f, 0));
+        Point e= inv(Point(x + .5f, y + .5f, 1));
+        Ray ray(o, e);
+
+        Hit hit= bvh.intersect(ray);
+        if(!hit)
+            continue;
+
+        // normale geometrique du triangle, orientee vers l'origine du rayon
+        TriangleData triangle= mesh.triangle(hit.triangle_id);
+        Vector n= cross(Vector(Point(triangle.a), Point(triangle.b)), Vector(Point(triangle.a), Point(triangle.c)));
+        if(hit.instance_id != -1)
+            n= models[hit.instance_id].normal()(n);
+        n= normalize(n);
+        if(dot(n, ray.d) > 0)
+            n= -n;
+
+        Point p= ray.o + hit.t * ray.d + n * (radius * 0.001f);
+        for(int i= 0; i < samples; i++)
+            rays.push_back( Ray(p, cosine_direction(n), radius) );
+    }
+
+    return rays;
+}
+
+
+// compare les 3 requetes sur les memes rayons
+template < typename T >
+void bench( const char *name, const BVHT<T>& bvh, const std::vector<Ray>& rays )
+{
+    const int n= int(rays.size());
+
+    // intersection la plus proche
+    int closest= 0;
+    auto start= std::chrono::high_resolution_clock::now();
+    {
+    #pragma omp parallel for schedule(dynamic, 256) reduction(+: closest)
+        for(int i= 0; i < n; i++)
+            if(bvh.intersect(rays[i]))
+                closest++;
+    }
+    auto stop= std::chrono::high_resolution_clock::now();
+    float closest_time= std::chrono::duration<float, std::milli>(stop - start).count();
+
+    // premiere intersection, un rayon a la fois
+    int occluded= 0;
+    start= std::chrono::high_resolution_clock::now();
+    {
+    #pragma omp parallel for schedule(dynamic, 256) reduction(+: occluded)
+        for(int i= 0; i < n; i++)
+            if(bvh.occluded(rays[i]))
+                occluded++;
+    }
+    stop= std::chrono::high_resolution_clock::now();
+    float occluded_time= std::chrono::duration<float, std::milli>(stop - start).count();
+
+    // premiere intersection, tous les rayons
+    std::vector<unsigned char> results(rays.size());
+    start= std::chrono::high_resolution_clock::now();
+    int batch= bvh.occluded(rays.data(), n, results.data());
+    stop= std::chrono::high_resolution_clock::now();
+    float batch_time= std::chrono::duration<float, std::milli>(stop - start).count();
+
+    printf("  %-24s intersect %7.1fms %6.2f Mrays/s, occluded %7.1fms %6.2f Mrays/s x%.2f, batch %7.1fms %6.2f Mrays/s x%.2f (%d / %d / %d occluded, %d rays)\n",
+        name,
+        closest_time, float(n) / closest_time / 1000,
+        occluded_time, float(n) / occluded_time / 1000, closest_time / occluded_time,
+        batch_time, float(n) / batch_time / 1000, closest_time / batch_time,
+        closest, occluded, batch, n);
+}
+
+
+int main( int argc, char **argv )
+{
+    const char *filename= "data/bigguy.obj";
+    if(argc > 1)
+        filename= argv[1];
+
+    int samples= 16;
+    if(argc > 2)
+        samples= std::max(1, atoi(argv[2]));
+
+    Mesh mesh= read_mesh(filename);
+    if(mesh.vertex_count() == 0)
+        return 1;
+
+    std::vector<Triangle> triangles;
+    for(int i= 0; i < mesh.triangle_count(); i++)
+        triangles.push_back( Triangle(mesh.triangle(i), i) );
+
+    Point pmin, pmax;
+    mesh.bounds(pmin, pmax);
+    float size= length(Vector(pmin, pmax));
+
+    const int width= 512;
+    const int height= 320;
+
+    // un seul objet
+    {
+        BVHOptions options(BVH_SAH, 4);
+        options.width= 8;
+        BVH bvh;
+        bvh.build(triangles, options);
+
+        Orbiter camera;
+        camera.lookat(pmin, pmax);
+        camera.projection(width, height, 45);
+
+        printf("%s: %d triangles, %d samples\n", filename, int(triangles.size()), samples);
+        for(float radius : {0.05f, 0.2f, 1.0f})
+        {
+            srand(1);
+            std::vector<Ray> rays= ambient_rays(bvh, mesh, std::vector<Transform>(), camera, width, height, samples, radius * size);
+
+            char name[64];
+            sprintf(name, "bvh, radius %.2f", radius);
+            bench(name, bvh, rays);
+        }
+    }
+
+    // instances sur une grille
+    {
+        BLAS blas;
+        blas.build(triangles);
+
+        const int grid= 8;
+        Vector extent= Vector(pmin, pmax) * 1.2f;
+        std::vector<Instance> instances;
+        std::vector<Transform> models;
+        for(int i= 0; i < grid*grid*grid; i++)
+        {
+            Vector t= Vector(extent.x * (i % grid), extent.y * (i / grid % grid), extent.z * (i / grid / grid));
+            Transform model= Translation(t) * RotationY(float(i * 37 % 360));
+            models.push_back(model);
+            instances.push_back( Instance(BBox(pmin, pmax), model, blas, i) );
+        }
+
+        TLAS tlas;
+        tlas.build(instances, BVHOptions(BVH_SAH, 1));
+
+        BBox bounds= tlas.bounds();
+        Orbiter camera;
+        camera.lookat(bounds.pmin, bounds.pmax);
+        camera.projection(width, height, 45);
+
+        printf("%d instances\n", int(instances.size()));
+        for(float radius : {0.05f, 0.2f, 1.0f})
+        {
+            srand(1);
+            std::vector<Ray> rays= ambient_rays(tlas, mesh, models, camera, width, height, samples, radius * size);
+
+            char name[64];
+            sprintf(name, "tlas, radius %.2f", radius);
+            bench(name, tlas, rays);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+//! \file bench_packet.cpp parcours rayon par rayon, cf BVHT::intersect( ray ), ou par paquets de 8 rayons, cf BVHT::intersect( rays, n, hits ). rayons primaires par lignes ou par tuiles, et rebonds diffus.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cfloat>
+#include <chrono>
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "orbiter.h"
+#include "mesh.h"
+#include "wavefront.h"
+#include "bvh.h"
+#include "bench_rays.h"
+
+
+void bench( const char *name, const BVH& bvh, const std::vector<Ray>& rays )
+{
+    const int n= int(rays.size());
+    std::vector<Hit> hits(n);
+
+    // garde le meilleur temps de 3 essais
+    float single_time= FLT_MAX;
+    float packet_time= FLT_MAX;
+    int single= 0;
+    int packet= 0;
+    PacketStats stats;
+    for(int run= 0; run < 3; run++)
+    {
+        // rayon par rayon
+        single= 0;
+        auto start= std::chrono::high_resolution_clock::now();
+        {
+        #pragma omp parallel for schedule(dynamic, 256) reduction(+: single)
+            for(int i= 0; i < n; i++)
+            {
+                hits[i]= bvh.intersect(rays[i]);
+                if(hits[i])
+                    single++;
+            }
+        }
+        auto stop= std::chrono::high_resolution_clock::now();
+        single_time= std::min(single_time, std::chrono::duration<float, std::milli>(stop - start).count());
+
+        // paquets
+        start= std::chrono::high_resolution_clock::now();
+        packet= bvh.intersect(rays.data(), n, hits.data(), &stats);
+        stop= std::chrono::high_resolution_clock::now();
+        packet_time= std::min(packet_time, std::chrono::duration<float, std::milli>(stop - start).count());
+    }
+
+    printf("  %-20s single %7.1fms %6.2f Mrays/s, packets %7.1fms %6.2f Mrays/s x%.2f, %5.1f%% lanes, %5.1f%% incoherent packets, %7lld fallback rays (%d / %d hits)\n",
+        name, single_time, float(n) / single_time / 1000,
+        packet_time, float(n) / packet_time / 1000, single_time / packet_time,
+        stats.utilization() * 100, 100.f * stats.incoherent / float(std::max(1, stats.packets + stats.incoherent)), stats.fallbacks,
+        single, packet);
+}
+
+
+int main( int argc, char **argv )
+{
+    const char *filename= "data/bigguy.obj";
+    if(argc > 1)
+        filename= argv[1];
+
+    Mesh mesh= read_mesh(filename);
+    if(mesh.vertex_count() == 0)
+        return 1;
+
+    std::vector<Triangle> triangles;
+    for(int i= 0; i < mesh.triangle_count(); i++)
+        triangles.push_back( Triangle(mesh.triangle(i), i) );
+    printf("%s: %d triangles\n", filename, int(triangles.size()));
+
+    Point pmin, pmax;
+    mesh.bounds(pmin, pmax);
+
+    const int width= 1024;
+    const int height= 640;
+    Orbiter camera;
+    camera.lookat(pmin, pmax);
+    camera.projection(width, height, 45);
+    Transform inv= Inverse(camera.viewport() * camera.projection() * camera.view());
+
+    // rayons primaires, par lignes : un paquet = 8 pixels sur une ligne
+    std::vector<Ray> lines;
+    for(int y= 0; y < height; y++)
+    for(int x= 0; x < width; x++)
+        lines.push_back( Ray(inv(Point(x + .5f, y + .5f, 0)), inv(Point(x + .5f, y + .5f, 1))) );
+
+    // par tuiles de 4x2 pixels
+    std::vector<Ray> tiles;
+    for(int ty= 0; ty < height; ty+= 2)
+    for(int tx= 0; tx < width; tx+= 4)
+        for(int y= ty; y < ty + 2; y++)
+        for(int x= tx; x < tx + 4; x++)
+            tiles.push_back( Ray(inv(Point(x + .5f, y + .5f, 0)), inv(Point(x + .5f, y + .5f, 1))) );
+
+    for(int width : {2, 8})
+    for(int packet_min : {1, 3})
+    {
+        BVHOptions options(BVH_SAH, 4);
+        options.width= width;
+        options.packet_min= packet_min;
+
+        BVH bvh;
+        bvh.build(triangles, options);
+        printf("sah leaf 4, width %d, packet_min %d\n", width, packet_min);
+
+        bench("primary, lines", bvh, lines);
+        bench("primary, 4x2 tiles", bvh, tiles);
+
+        // rebonds diffus, dans l'ordre des tuiles, regroupes par octant dans les paquets
+        std::vector<Hit> hits(tiles.size());
+        bvh.intersect(tiles.data(), int(tiles.size()), hits.data());
+
+        srand(1);
+        std::vector<Ray> bounces;
+        for(unsigned i= 0; i < tiles.size(); i++)
+        {
+            if(!hits[i])
+                continue;
+
+            TriangleData triangle= mesh.triangle(hits[i].triangle_id);
+            Vector n= normalize(cross(Vector(Point(triangle.a), Point(triangle.b)), Vector(Point(triangle.a), Point(triangle.c))));
+            if(dot(n, tiles[i].d) > 0)
+                n= -n;
+
+            Point p= tiles[i].o + hits[i].t * tiles[i].d + n * 0.001f;
+            bounces.push_back( Ray(p, cosine_direction(n)) );
+        }
+        bench("diffuse bounces", bvh, bounces);
+    }
+
+    return 0;
+}
@@ -0,0 +1,117 @@
+//! \file bench_quantized.cpp noeuds larges, cf WideNode, ou noeuds compresses, englobants quantifies sur 8 bits, cf QuantizedNode et BVHOptions::quantized : memoire et rayons / s.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cfloat>
+#include <chrono>
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "orbiter.h"
+#include "mesh.h"
+#include "wavefront.h"
+#include "bvh.h"
+#include "bench_rays.h"
+
+
+// taille des noeuds parcourus par intersect()
+size_t node_memory( const BVH& bvh )
+{
+    return bvh.nodes4.size() * sizeof(WideNode<4>) + bvh.nodes8.size() * sizeof(WideNode<8>)
+        + bvh.qnodes4.size() * sizeof(QuantizedNode<4>) + bvh.qnodes8.size() * sizeof(QuantizedNode<8>);
+}
+
+
+int main( int argc, char **argv )
+{
+    const char *filename= "data/bigguy.obj";
+    if(argc > 1)
+        filename= argv[1];
+
+    // copies de l'objet sur une grille, pour obtenir un gros arbre, sans instances
+    int grid= 6;
+    if(argc > 2)
+        grid= std::max(1, atoi(argv[2]));
+
+    Mesh mesh= read_mesh(filename);
+    if(mesh.vertex_count() == 0)
+        return 1;
+
+    Point pmin, pmax;
+    mesh.bounds(pmin, pmax);
+    Vector extent= Vector(pmin, pmax) * 1.2f;
+
+    std::vector<Triangle> triangles;
+    for(int i= 0; i < grid*grid*grid; i++)
+    {
+        Vector t= Vector(extent.x * (i % grid), extent.y * (i / grid % grid), extent.z * (i / grid / grid));
+        Transform model= Translation(t) * RotationY(float(i * 37 % 360));
+        for(int k= 0; k < mesh.triangle_count(); k++)
+        {
+            TriangleData triangle= mesh.triangle(k);
+            triangles.push_back( Triangle(model(Point(triangle.a)), model(Point(triangle.b)), model(Point(triangle.c)), i * mesh.triangle_count() + k) );
+        }
+    }
+    printf("%s: %d copies, %d triangles\n", filename, grid*grid*grid, int(triangles.size()));
+
+    // rayons primaires, puis rebonds diffus
+    BVH reference;
+    reference.build(triangles, BVHOptions(BVH_SAH, 4));
+    BBox bounds= reference.bounds();
+
+    const int width= 1024;
+    const int height= 640;
+    Orbiter camera;
+    camera.lookat(bounds.pmin, bounds.pmax);
+    camera.projection(width, height, 45);
+    Transform inv= Inverse(camera.viewport() * camera.projection() * camera.view());
+
+    std::vector<Ray> primary;
+    for(int y= 0; y < height; y++)
+    for(int x= 0; x < width; x++)
+        primary.push_back( Ray(inv(Point(x + .5f, y + .5f, 0)), inv(Point(x + .5f, y + .5f, 1))) );
+
+    srand(1);
+    std::vector<Ray> bounces;
+    for(unsigned i= 0; i < primary.size(); i++)
+    {
+        Hit hit= reference.intersect(primary[i]);
+        if(!hit)
+            continue;
+
+        const Triangle& triangle= triangles[hit.triangle_id];
+        Vector n= normalize(cross(Vector(triangle.a, triangle.b), Vector(triangle.a, triangle.c)));
+        if(dot(n, primary[i].d) > 0)
+            n= -n;
+
+        Point p= primary[i].o + hit.t * primary[i].d + n * 0.001f;
+        bounces.push_back( Ray(p, cosine_direction(n)) );
+    }
+
+    printf("  %-26s %10s %14s %16s\n", "", "nodes", "primary", "diffuse");
+    for(int leaf : {1, 4})
+    for(int width : {4, 8})
+    for(bool quantized : {false, true})
+    {
+        BVHOptions options(BVH_SAH, leaf);
+        options.width= width;
+        options.quantized= quantized;
+
+        BVH bvh;
+        bvh.build(triangles, options);
+
+        int primary_hits, bounce_hits;
+        // garde le meilleur temps de 3 essais, millions de rayons par seconde
+        float primary_rate= float(primary.size()) / trace(bvh, primary, primary_hits, 3) / 1000;
+        float bounce_rate= float(bounces.size()) / trace(bvh, bounces, bounce_hits, 3) / 1000;
+
+        char name[64];
+        sprintf(name, "leaf %d, width %d%s", leaf, width, quantized ? ", quantized" : "");
+        printf("  %-26s %7.1f MB %7.2f Mrays/s %7.2f Mrays/s (%d / %d hits)\n", name,
+            node_memory(bvh) / (1024.f * 1024.f), primary_rate, bounce_rate, primary_hits, bounce_hits);
+    }
+
+    return 0;
+}
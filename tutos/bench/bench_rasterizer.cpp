@@ -0,0 +1,169 @@
+//! \file bench_rasterizer.cpp pipeline graphique logiciel, cf Rasterizer : temps par image et triangles / s, selon la taille des tuiles et le nombre de threads, blocs elimines et fragments shades.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "orbiter.h"
+#include "mesh.h"
+#include "wavefront.h"
+#include "rasterizer.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+// triangles non indexes, normale par sommet
+struct BenchPipeline : public Pipeline
+{
+    std::vector<Point> positions;
+    std::vector<Vector> normals;
+    Transform mvp;
+    Transform mv;
+
+    vec4 vertex_shader( const int vertex_id ) const
+    {
+        return mvp(vec4(positions[vertex_id]));
+    }
+
+    Color fragment_shader( const int primitive_id, const Fragment fragment ) const
+    {
+        Vector a= mv(normals[primitive_id * 3]);
+        Vector b= mv(normals[primitive_id * 3 +1]);
+        Vector c= mv(normals[primitive_id * 3 +2]);
+
+        Vector n= normalize(fragment.u * c + fragment.v * a + fragment.w * b);
+        return White() * std::abs(n.z);
+    }
+};
+
+
+// empreinte de l'image, pour verifier que le resultat ne depend pas des parametres
+uint64_t hash( const Image& image )
+{
+    uint64_t h= 14695981039346656037ull;
+    for(int y= 0; y < image.height(); y++)
+    for(int x= 0; x < image.width(); x++)
+    {
+        Color color= image(x, y);
+        uint32_t bits[3];
+        memcpy(bits, &color, sizeof(bits));
+        for(int i= 0; i < 3; i++)
+            h= (h ^ bits[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+
+// garde le meilleur temps de 5 images
+RasterizerStats bench( Rasterizer& rasterizer, const BenchPipeline& pipeline, uint64_t& image_hash )
+{
+    RasterizerStats best;
+    best.raster_time= FLT_MAX;
+    for(int run= 0; run < 5; run++)
+    {
+        rasterizer.clear(Black());
+        rasterizer.draw(pipeline, int(pipeline.positions.size()));
+        if(rasterizer.stats.time() < best.time())
+            best= rasterizer.stats;
+    }
+
+    image_hash= hash(rasterizer.image());
+    return best;
+}
+
+
+int main( int argc, char **argv )
+{
+    const char *filename= "data/bigguy.obj";
+    if(argc > 1)
+        filename= argv[1];
+
+    Mesh mesh= read_mesh(filename);
+    if(mesh.vertex_count() == 0 || !mesh.has_normal())
+        return 1;
+
+    Point pmin, pmax;
+    mesh.bounds(pmin, pmax);
+    Vector extent= Vector(pmin, pmax) * 1.2f;
+
+    const int width= 1024;
+    const int height= 640;
+
+    int threads= 1;
+#ifdef _OPENMP
+    threads= omp_get_max_threads();
+#endif
+
+    // l'objet, puis des copies sur une grille, pour obtenir de gros maillages
+    for(int grid : {1, 3, 6})
+    {
+        BenchPipeline pipeline;
+        for(int i= 0; i < grid*grid*grid; i++)
+        {
+            Vector t= Vector(extent.x * (i % grid), extent.y * (i / grid % grid), extent.z * (i / grid / grid));
+            Transform model= Translation(t) * RotationY(float(i * 37 % 360));
+            for(int k= 0; k < mesh.vertex_count(); k++)
+            {
+                pipeline.positions.push_back( model(Point(mesh.positions()[k])) );
+                pipeline.normals.push_back( model(Vector(mesh.normals()[k])) );
+            }
+        }
+
+        Point bmin= pmin;
+        Point bmax= pmax + extent * float(grid -1);
+        Orbiter camera;
+        camera.lookat(bmin, bmax);
+        Transform projection= camera.projection(width, height, 45);
+        pipeline.mvp= projection * camera.view();
+        pipeline.mv= camera.view();
+
+        int triangles= int(pipeline.positions.size()) / 3;
+        printf("%s: %d copies, %d triangles, %dx%d\n", filename, grid*grid*grid, triangles, width, height);
+
+        uint64_t reference= 0;
+        for(int tile_size : {16, 32, 64, 128})
+        {
+            // et un seul thread, pour comparer
+            std::vector<int> counts= { threads };
+            if(tile_size == 64 && threads > 1)
+                counts.insert(counts.begin(), 1);
+
+            for(int n : counts)
+            {
+            #ifdef _OPENMP
+                omp_set_num_threads(n);
+            #endif
+
+                Rasterizer rasterizer(width, height, tile_size);
+                uint64_t image_hash;
+                RasterizerStats stats= bench(rasterizer, pipeline, image_hash);
+                if(reference == 0)
+                    reference= image_hash;
+
+                printf("  tile %3d, %2d threads: %8.2fms %7.2f Mtriangles/s (vertex %6.2fms, binning %6.2fms, raster %7.2fms) %6.2f tiles / triangle, %s\n",
+                    tile_size, n, stats.time(), float(triangles) / stats.time() / 1000,
+                    stats.vertex_time, stats.binning_time, stats.raster_time,
+                    double(stats.binned) / std::max(1, stats.triangles),
+                    image_hash == reference ? "same image" : "[error] different image");
+                printf("    blocks %9lld: %5.1f%% rejected, %5.1f%% hidden, %5.1f%% covered, %6lld hidden tiles; fragments %9lld, %5.1f%% shaded\n",
+                    stats.blocks, 100.0 * stats.blocks_rejected / std::max(1ll, stats.blocks), 100.0 * stats.blocks_hidden / std::max(1ll, stats.blocks),
+                    100.0 * stats.blocks_covered / std::max(1ll, stats.blocks), stats.tiles_hidden,
+                    stats.fragments, 100.0 * stats.shaded / std::max(1ll, stats.fragments));
+            }
+        }
+
+    #ifdef _OPENMP
+        omp_set_num_threads(threads);
+    #endif
+    }
+
+    return 0;
+}
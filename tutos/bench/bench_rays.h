@@ -0,0 +1,59 @@
+//! \file bench_rays.h utilitaires communs aux benchs de lancer de rayons : directions aleatoires et temps de parcours d'un ensemble de rayons.
+
+#ifndef _BENCH_RAYS_H
+#define _BENCH_RAYS_H
+
+#include <cstdlib>
+#include <cmath>
+#include <cfloat>
+#include <chrono>
+#include <vector>
+
+#include "vec.h"
+#include "bvh.h"
+
+
+inline float random_float( ) { return float(rand()) / RAND_MAX; }
+
+// direction aleatoire autour de la normale n, distribution cos theta / pi
+inline Vector cosine_direction( const Vector& n )
+{
+    float u1= random_float();
+    float u2= random_float();
+    float cos_theta= std::sqrt(u1);
+    float sin_theta= std::sqrt(1 - u1);
+    float phi= float(2 * M_PI) * u2;
+
+    // repere local autour de n, cf "building an orthonormal basis, revisited", Duff et al 2017
+    float sign= std::copysign(1.0f, n.z);
+    float a= -1 / (sign + n.z);
+    float d= n.x * n.y * a;
+    Vector t= Vector(1 + sign * n.x * n.x * a, sign * d, -sign * n.x);
+    Vector b= Vector(d, sign + n.y * n.y * a, -n.y);
+
+    return std::cos(phi) * sin_theta * t + std::sin(phi) * sin_theta * b + cos_theta * n;
+}
+
+// intersection la plus proche de chaque rayon, un rayon a la fois, garde le meilleur temps de runs essais, en millisecondes
+inline float trace( const BVH& bvh, const std::vector<Ray>& rays, int& hits, const int runs= 1 )
+{
+    const int n= int(rays.size());
+    float time= FLT_MAX;
+    for(int run= 0; run < runs; run++)
+    {
+        hits= 0;
+        auto start= std::chrono::high_resolution_clock::now();
+        {
+        #pragma omp parallel for schedule(dynamic, 256) reduction(+: hits)
+            for(int i= 0; i < n; i++)
+                if(bvh.intersect(rays[i]))
+                    hits++;
+        }
+        auto stop= std::chrono::high_resolution_clock::now();
+        time= std::min(time, std::chrono::duration<float, std::milli>(stop - start).count());
+    }
+
+    return time;
+}
+
+#endif
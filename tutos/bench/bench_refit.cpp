@@ -0,0 +1,399 @@
+//! \file bench_refit.cpp objets animes : mise a jour des englobants du bvh, cf BVHT::refit(), ou reconstruction a chaque image, cf BVHT::build(). skinning sur cpu d'un maillage glTF anime, ou d'un objet .obj plie par un squelette procedural.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <chrono>
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "orbiter.h"
+#include "mesh.h"
+#include "wavefront.h"
+#include "cgltf.h"
+#include "bvh.h"
+#include "bench_rays.h"
+
+
+// maillage anime par un squelette, 4 os par sommet
+struct Skin
+{
+    std::vector<Point> positions;       // position des sommets au repos
+    std::vector<unsigned> joints;       // 4 os par sommet
+    std::vector<float> weights;         // 4 poids par sommet
+    std::vector<unsigned> indices;      // 3 sommets par triangle
+    std::vector< std::vector<Transform> > frames;       // transformation des os pour chaque image
+};
+
+// linear blend skinning : transforme les sommets, puis construit les triangles
+void skinning( const Skin& skin, const std::vector<Transform>& bones, std::vector<Point>& positions, std::vector<Triangle>& triangles )
+{
+    const int n= int(skin.positions.size());
+    positions.resize(n);
+#pragma omp parallel for schedule(static, 4096)
+    for(int i= 0; i < n; i++)
+    {
+        Vector p= Vector(0, 0, 0);
+        for(int k= 0; k < 4; k++)
+        {
+            float w= skin.weights[4*i + k];
+            if(w > 0)
+                p= p + w * Vector(bones[skin.joints[4*i + k]](skin.positions[i]));
+        }
+        positions[i]= Point(p);
+    }
+
+    const int m= int(skin.indices.size() / 3);
+    triangles.resize(m, Triangle(vec3(), vec3(), vec3(), 0));
+#pragma omp parallel for schedule(static, 4096)
+    for(int i= 0; i < m; i++)
+        triangles[i]= Triangle(positions[skin.indices[3*i]], positions[skin.indices[3*i+1]], positions[skin.indices[3*i+2]], i);
+}
+
+
+// interpole une cle d'animation glTF, lineaire ou constante, les splines utilisent la valeur de la cle sans les tangentes
+void sample( const cgltf_animation_sampler *sampler, const float time, float *value, const int size )
+{
+    const int n= int(sampler->input->count);
+    int k= 0;
+    float u= 0;
+    for(; k+1 < n; k++)
+    {
+        float t0, t1;
+        cgltf_accessor_read_float(sampler->input, k, &t0, 1);
+        cgltf_accessor_read_float(sampler->input, k+1, &t1, 1);
+        if(time < t1)
+        {
+            if(sampler->interpolation == cgltf_interpolation_type_linear && t1 > t0)
+                u= std::max(0.f, (time - t0) / (t1 - t0));
+            break;
+        }
+    }
+
+    const int stride= (sampler->interpolation == cgltf_interpolation_type_cubic_spline) ? 3 : 1;
+    const int offset= (stride == 3) ? 1 : 0;
+    float a[4]= { }, b[4]= { };
+    cgltf_accessor_read_float(sampler->output, k*stride + offset, a, size);
+    cgltf_accessor_read_float(sampler->output, std::min(k+1, n-1)*stride + offset, b, size);
+    for(int i= 0; i < size; i++)
+        value[i]= a[i] * (1 - u) + b[i] * u;
+
+    if(size == 4)
+    {
+        // quaternion : le plus court chemin, puis normalise
+        float d= a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+        if(d < 0)
+            for(int i= 0; i < 4; i++)
+                value[i]= a[i] * (1 - u) - b[i] * u;
+
+        float l= std::sqrt(value[0]*value[0] + value[1]*value[1] + value[2]*value[2] + value[3]*value[3]);
+        if(l > 0)
+            for(int i= 0; i < 4; i++)
+                value[i]/= l;
+    }
+}
+
+// charge le premier maillage anime d'un fichier glTF, et les transformations de ses os pour frames images de la premiere animation
+bool read_skin( const char *filename, const int frames, Skin& skin )
+{
+    cgltf_options options= { };
+    cgltf_data *data= nullptr;
+    if(cgltf_parse_file(&options, filename, &data) != cgltf_result_success)
+    {
+        printf("[error] loading glTF '%s'...\n", filename);
+        return false;
+    }
+    if(cgltf_load_buffers(&options, data, filename) != cgltf_result_success)
+    {
+        printf("[error] loading glTF buffers '%s'...\n", filename);
+        cgltf_free(data);
+        return false;
+    }
+
+    cgltf_node *node= nullptr;
+    for(unsigned i= 0; i < data->nodes_count && node == nullptr; i++)
+        if(data->nodes[i].mesh && data->nodes[i].skin)
+            node= &data->nodes[i];
+
+    if(node == nullptr || data->animations_count == 0)
+    {
+        printf("[error] glTF '%s': no skinned mesh or no animation...\n", filename);
+        cgltf_free(data);
+        return false;
+    }
+
+    // sommets, os et poids de chaque groupe de triangles
+    cgltf_mesh *mesh= node->mesh;
+    for(unsigned p= 0; p < mesh->primitives_count; p++)
+    {
+        cgltf_primitive *primitive= &mesh->primitives[p];
+        if(primitive->type != cgltf_primitive_type_triangles)
+            continue;
+
+        cgltf_accessor *positions= nullptr;
+        cgltf_accessor *joints= nullptr;
+        cgltf_accessor *weights= nullptr;
+        for(unsigned a= 0; a < primitive->attributes_count; a++)
+        {
+            cgltf_attribute *attribute= &primitive->attributes[a];
+            if(attribute->type == cgltf_attribute_type_position)
+                positions= attribute->data;
+            else if(attribute->type == cgltf_attribute_type_joints && attribute->index == 0)
+                joints= attribute->data;
+            else if(attribute->type == cgltf_attribute_type_weights && attribute->index == 0)
+                weights= attribute->data;
+        }
+        if(positions == nullptr || joints == nullptr || weights == nullptr)
+            continue;
+
+        unsigned offset= unsigned(skin.positions.size());
+        for(unsigned i= 0; i < positions->count; i++)
+        {
+            float position[3];
+            cgltf_accessor_read_float(positions, i, position, 3);
+            skin.positions.push_back( Point(position[0], position[1], position[2]) );
+
+            cgltf_uint joint[4];
+            float weight[4];
+            cgltf_accessor_read_uint(joints, i, joint, 4);
+            cgltf_accessor_read_float(weights, i, weight, 4);
+            for(int k= 0; k < 4; k++)
+            {
+                skin.joints.push_back(joint[k]);
+                skin.weights.push_back(weight[k]);
+            }
+        }
+
+        if(primitive->indices)
+            for(unsigned i= 0; i < primitive->indices->count; i++)
+                skin.indices.push_back( offset + unsigned(cgltf_accessor_read_index(primitive->indices, i)) );
+        else
+            for(unsigned i= 0; i < positions->count; i++)
+                skin.indices.push_back(offset + i);
+    }
+
+    // joue la premiere animation, et calcule la transformation de chaque os
+    cgltf_skin *joints= node->skin;
+    cgltf_animation *animation= &data->animations[0];
+    float duration= 0;
+    for(unsigned i= 0; i < animation->samplers_count; i++)
+        if(animation->samplers[i].input->has_max)
+            duration= std::max(duration, animation->samplers[i].input->max[0]);
+
+    for(int f= 0; f < frames; f++)
+    {
+        float time= duration * float(f) / float(frames);
+        for(unsigned i= 0; i < animation->channels_count; i++)
+        {
+            cgltf_animation_channel *channel= &animation->channels[i];
+            cgltf_node *target= channel->target_node;
+            if(target == nullptr)
+                continue;
+
+            if(channel->target_path == cgltf_animation_path_type_translation)
+            {
+                sample(channel->sampler, time, target->translation, 3);
+                target->has_translation= 1;
+            }
+            else if(channel->target_path == cgltf_animation_path_type_rotation)
+            {
+                sample(channel->sampler, time, target->rotation, 4);
+                target->has_rotation= 1;
+            }
+            else if(channel->target_path == cgltf_animation_path_type_scale)
+            {
+                sample(channel->sampler, time, target->scale, 3);
+                target->has_scale= 1;
+            }
+        }
+
+        std::vector<Transform> bones(joints->joints_count);
+        for(unsigned j= 0; j < joints->joints_count; j++)
+        {
+            float matrix[16];
+            cgltf_node_transform_world(joints->joints[j], matrix);
+            Transform model;
+            model.column_major(matrix);
+
+            Transform bind;
+            if(joints->inverse_bind_matrices)
+            {
+                cgltf_accessor_read_float(joints->inverse_bind_matrices, j, matrix, 16);
+                bind.column_major(matrix);
+            }
+            bones[j]= model * bind;
+        }
+        skin.frames.push_back(bones);
+    }
+
+    cgltf_free(data);
+    return !skin.indices.empty();
+}
+
+// plie un objet .obj avec un squelette procedural : une chaine d'os le long de son axe le plus long, chaque os tourne par rapport au precedent
+bool make_skin( const char *filename, const int frames, Skin& skin )
+{
+    Mesh mesh= read_mesh(filename);
+    if(mesh.vertex_count() == 0)
+        return false;
+
+    for(unsigned i= 0; i < mesh.positions().size(); i++)
+        skin.positions.push_back( Point(mesh.positions()[i]) );
+    if(mesh.index_count() > 0)
+        skin.indices= mesh.indices();
+    else
+        for(unsigned i= 0; i < skin.positions.size(); i++)
+            skin.indices.push_back(i);
+
+    Point pmin, pmax;
+    mesh.bounds(pmin, pmax);
+    int axis= 0;
+    for(int k= 1; k < 3; k++)
+        if(pmax(k) - pmin(k) > pmax(axis) - pmin(axis))
+            axis= k;
+
+    // chaque sommet depend des 2 os les plus proches
+    const int bones= 4;
+    for(unsigned i= 0; i < skin.positions.size(); i++)
+    {
+        float s= (skin.positions[i](axis) - pmin(axis)) / (pmax(axis) - pmin(axis)) * bones - .5f;
+        int b= std::max(0, std::min(bones -2, int(std::floor(s))));
+        float w= std::max(0.f, std::min(1.f, s - b));
+
+        unsigned joint[4]= { unsigned(b), unsigned(b+1), 0, 0 };
+        float weight[4]= { 1 - w, w, 0, 0 };
+        for(int k= 0; k < 4; k++)
+        {
+            skin.joints.push_back(joint[k]);
+            skin.weights.push_back(weight[k]);
+        }
+    }
+
+    // os b : rotation autour de son origine, sur l'axe, composee avec les rotations des os precedents
+    Vector bend= Vector(0, 0, 0);
+    bend((axis + 1) % 3)= 1;
+    Vector twist= Vector(0, 0, 0);
+    twist(axis)= 1;
+    for(int f= 0; f < frames; f++)
+    {
+        float phase= float(2 * M_PI) * float(f) / float(frames);
+        std::vector<Transform> transforms(bones);
+        Transform parent= Identity();
+        for(int b= 0; b < bones; b++)
+        {
+            Point origin= pmin + (pmax - pmin) / 2;
+            origin(axis)= pmin(axis) + (pmax(axis) - pmin(axis)) * float(b) / float(bones);
+
+            float angle= (b == 0) ? 0 : 40 * std::sin(phase + b);
+            parent= parent * Translation(Vector(origin)) * Rotation(bend, angle) * Rotation(twist, angle / 2) * Translation(-Vector(origin));
+            transforms[b]= parent;
+        }
+        skin.frames.push_back(transforms);
+    }
+
+    return true;
+}
+
+
+int main( int argc, char **argv )
+{
+    const char *filename= "data/bigguy.obj";
+    if(argc > 1)
+        filename= argv[1];
+
+    const int frames= 32;
+    Skin skin;
+    bool gltf= (strstr(filename, ".gltf") || strstr(filename, ".glb"));
+    if(gltf ? !read_skin(filename, frames, skin) : !make_skin(filename, frames, skin))
+        return 1;
+
+    printf("%s: %d triangles, %d bones, %d frames\n", filename, int(skin.indices.size() / 3), int(skin.frames[0].size()), frames);
+
+    // camera fixe, sur l'objet dans la premiere image
+    std::vector<Point> positions;
+    std::vector<Triangle> triangles;
+    skinning(skin, skin.frames[0], positions, triangles);
+
+    BBox bounds= EmptyBox();
+    for(unsigned i= 0; i < positions.size(); i++)
+        bounds.insert(positions[i]);
+
+    const int width= 512;
+    const int height= 320;
+    Orbiter camera;
+    camera.lookat(bounds.pmin, bounds.pmax);
+    camera.projection(width, height, 45);
+    Transform inv= Inverse(camera.viewport() * camera.projection() * camera.view());
+
+    std::vector<Ray> rays;
+    for(int y= 0; y < height; y++)
+    for(int x= 0; x < width; x++)
+        rays.push_back( Ray(inv(Point(x + .5f, y + .5f, 0)), inv(Point(x + .5f, y + .5f, 1))) );
+
+    BVHOptions options(BVH_SAH, 4);
+    options.width= 8;
+
+    // refit seul, refit et reconstruction automatique, reconstruction a chaque image
+    BVH refit;
+    BVHOptions refit_options= options;
+    refit_options.refit_threshold= FLT_MAX;
+    refit.build(triangles, refit_options);
+
+    BVH automatic;
+    automatic.build(triangles, options);
+
+    BVH rebuild;
+
+    float skinning_time= 0;
+    float refit_time= 0, automatic_time= 0, build_time= 0;
+    float refit_rays= 0, automatic_rays= 0, build_rays= 0;
+    int rebuilds= 0;
+
+    printf("frame   refit: ms  sah/build  Mrays/s | auto %.1f: ms  sah/build  Mrays/s | build: ms  Mrays/s\n", options.refit_threshold);
+    for(int f= 0; f < 2*frames; f++)
+    {
+        auto start= std::chrono::high_resolution_clock::now();
+        skinning(skin, skin.frames[f % frames], positions, triangles);
+        auto stop= std::chrono::high_resolution_clock::now();
+        skinning_time+= std::chrono::duration<float, std::milli>(stop - start).count();
+
+        refit.refit(triangles);
+        bool rebuilt= automatic.refit(triangles);
+        rebuild.build(triangles, options);
+        if(rebuilt)
+            rebuilds++;
+
+        // cout sah de l'arbre mis a jour, par rapport a un arbre construit sur les memes triangles
+        float fresh_cost= rebuild.build_cost;
+
+        int refit_hits, automatic_hits, build_hits;
+        float trace_refit= trace(refit, rays, refit_hits);
+        float trace_automatic= trace(automatic, rays, automatic_hits);
+        float trace_build= trace(rebuild, rays, build_hits);
+        if(refit_hits != build_hits || automatic_hits != build_hits)
+            printf("[error] frame %d: %d / %d / %d hits...\n", f, refit_hits, automatic_hits, build_hits);
+
+        refit_time+= refit.refit_time;
+        automatic_time+= automatic.refit_time;
+        build_time+= rebuild.build_time;
+        refit_rays+= trace_refit;
+        automatic_rays+= trace_automatic;
+        build_rays+= trace_build;
+
+        if(f % 4 == 0 || rebuilt)
+            printf("%5d  %9.2f  %9.2f  %7.2f | %12.2f  %9.2f  %7.2f%s | %9.2f  %7.2f\n", f,
+                refit.refit_time, refit.refit_cost / fresh_cost, float(rays.size()) / trace_refit / 1000,
+                automatic.refit_time, automatic.refit_cost / fresh_cost, float(rays.size()) / trace_automatic / 1000, rebuilt ? " rebuild" : "",
+                rebuild.build_time, float(rays.size()) / trace_build / 1000);
+    }
+
+    const int n= 2*frames;
+    printf("average: skinning %.2fms\n", skinning_time / n);
+    printf("  refit      %7.2fms %6.2f Mrays/s\n", refit_time / n, float(rays.size()) * n / refit_rays / 1000);
+    printf("  automatic  %7.2fms %6.2f Mrays/s, %d rebuilds\n", automatic_time / n, float(rays.size()) * n / automatic_rays / 1000, rebuilds);
+    printf("  build      %7.2fms %6.2f Mrays/s\n", build_time / n, float(rays.size()) * n / build_rays / 1000);
+    return 0;
+}
@@ -0,0 +1,238 @@
+//! \file bench_remap.cpp compare std::map et VertexRemap pour construire les sommets uniques d'un mesh indexe.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#include "vertex_remap.h"
+#include "wavefront.h"
+#include "wavefront_fast.h"
+
+
+//! indexation complete d'un sommet, version std::map.
+struct vertex
+{
+    int material;
+    int position;
+    int texcoord;
+    int normal;
+
+    vertex( const int m, const int p, const int t, const int n ) : material(m), position(p), texcoord(t), normal(n) {}
+
+    bool operator< ( const vertex& b ) const
+    {
+        if(material != b.material) return material < b.material;
+        if(position != b.position) return position < b.position;
+        if(texcoord != b.texcoord) return texcoord < b.texcoord;
+        if(normal != b.normal) return normal < b.normal;
+        return false;
+    }
+};
+
+//! sommets des triangles, 4 indices par sommet : matiere, position, texcoord, normale.
+typedef std::vector<int> Corners;
+
+// relit les faces d'un fichier .obj, sans les attributs, triangule les faces.
+Corners read_corners( const char *filename )
+{
+    Corners corners;
+
+    FILE *in= fopen(filename, "rt");
+    if(in == nullptr)
+    {
+        printf("[error] loading '%s'...\n", filename);
+        return corners;
+    }
+
+    int np= 0, nt= 0, nn= 0;
+    int material= -1;
+    int materials= 0;
+
+    char line[1024*64];
+    while(fgets(line, sizeof(line), in))
+    {
+        if(line[0] == 'v' && line[1] == ' ') np++;
+        else if(line[0] == 'v' && line[1] == 't') nt++;
+        else if(line[0] == 'v' && line[1] == 'n') nn++;
+        else if(strncmp(line, "usemtl", 6) == 0) material= materials++;
+        else if(line[0] == 'f')
+        {
+            std::vector<int> face;
+            char *ptr= line +1;
+            for(;;)
+            {
+                int p= 0, t= 0, n= 0, next= 0;
+                if(sscanf(ptr, " %d/%d/%d%n", &p, &t, &n, &next) == 3) {}
+                else if(sscanf(ptr, " %d//%d%n", &p, &n, &next) == 2) {}
+                else if(sscanf(ptr, " %d/%d%n", &p, &t, &next) == 2) {}
+                else if(sscanf(ptr, " %d%n", &p, &next) == 1) {}
+                else break;
+                ptr+= next;
+
+                face.push_back(material);
+                face.push_back(p < 0 ? np + p : p -1);
+                face.push_back(t < 0 ? nt + t : t -1);
+                face.push_back(n < 0 ? nn + n : n -1);
+            }
+
+            int count= int(face.size()) / 4;
+            for(int v= 2; v < count; v++)
+            {
+                corners.insert(corners.end(), face.begin(), face.begin() +4);
+                corners.insert(corners.end(), face.begin() + 4*(v-1), face.begin() + 4*v);
+                corners.insert(corners.end(), face.begin() + 4*v, face.begin() + 4*(v+1));
+            }
+        }
+    }
+
+    fclose(in);
+    return corners;
+}
+
+// grille de n x n quads, 2 triangles par quad, sommets partages.
+Corners grid_corners( const int n )
+{
+    Corners corners;
+    corners.reserve(size_t(n) * n * 6 * 4);
+
+    for(int y= 0; y < n; y++)
+    for(int x= 0; x < n; x++)
+    {
+        int a= y * (n+1) + x;
+        int b= a +1;
+        int c= a + n+1;
+        int d= c +1;
+        int quad[6]= { a, b, d, a, d, c };
+        for(int i= 0; i < 6; i++)
+        {
+            corners.push_back(0);
+            corners.push_back(quad[i]);
+            corners.push_back(quad[i]);
+            corners.push_back(quad[i]);
+        }
+    }
+
+    return corners;
+}
+
+// ecrit la grille dans un fichier .obj, pour mesurer le temps de chargement complet.
+int write_grid( const int n, const char *filename )
+{
+    FILE *out= fopen(filename, "wt");
+    if(out == nullptr)
+        return -1;
+
+    printf("writing '%s'...\n", filename);
+    for(int y= 0; y <= n; y++)
+    for(int x= 0; x <= n; x++)
+        fprintf(out, "v %f %f %f\n", float(x) / n, float(y) / n, 0.f);
+    for(int y= 0; y <= n; y++)
+    for(int x= 0; x <= n; x++)
+        fprintf(out, "vn 0 0 1\n");
+
+    for(int y= 0; y < n; y++)
+    for(int x= 0; x < n; x++)
+    {
+        int a= y * (n+1) + x +1;
+        int b= a +1;
+        int c= a + n+1;
+        int d= c +1;
+        fprintf(out, "f %d//%d %d//%d %d//%d\n", a, a, b, b, d, d);
+        fprintf(out, "f %d//%d %d//%d %d//%d\n", a, a, d, d, c, c);
+    }
+
+    fclose(out);
+    return 0;
+}
+
+
+double bench_map( const Corners& corners, std::vector<unsigned>& indices )
+{
+    auto start= std::chrono::high_resolution_clock::now();
+
+    std::map<vertex, int> remap;
+    indices.clear();
+    indices.reserve(corners.size() / 4);
+    for(size_t i= 0; i +3 < corners.size(); i+= 4)
+    {
+        auto found= remap.insert( std::make_pair(vertex(corners[i], corners[i+1], corners[i+2], corners[i+3]), int(remap.size())) );
+        indices.push_back(found.first->second);
+    }
+
+    auto stop= std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+double bench_hash( const Corners& corners, std::vector<unsigned>& indices, const bool presize )
+{
+    auto start= std::chrono::high_resolution_clock::now();
+
+    VertexRemap remap(presize ? corners.size() / 4 / 3 : 0);   // 1 sommet unique pour 3 coins, approximativement...
+    indices.clear();
+    indices.reserve(corners.size() / 4);
+    for(size_t i= 0; i +3 < corners.size(); i+= 4)
+    {
+        bool inserted;
+        indices.push_back(remap.insert(corners[i], corners[i+1], corners[i+2], corners[i+3], inserted));
+    }
+
+    auto stop= std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+void bench( const char *name, const Corners& corners )
+{
+    std::vector<unsigned> reference;
+    std::vector<unsigned> indices;
+
+    double map= bench_map(corners, reference);
+    double hash= bench_hash(corners, indices, false);
+    bool valid= (indices == reference);
+    double presized= bench_hash(corners, indices, true);
+    valid= valid && (indices == reference);
+
+    unsigned vertices= reference.empty() ? 0 : *std::max_element(reference.begin(), reference.end()) +1;
+    printf("%s: %d triangles, %u vertices\n", name, int(corners.size() / 12), vertices);
+    printf("  std::map     %10.1fms\n", map);
+    printf("  VertexRemap  %10.1fms  x%.1f\n", hash, map / hash);
+    printf("  presized     %10.1fms  x%.1f\n", presized, map / presized);
+    if(!valid)
+        printf("[error] different indices !!\n");
+}
+
+
+int main( int argc, char **argv )
+{
+    const char *filename= "data/bigguy.obj";
+    int grid= 2237;     // 2 * 2237 * 2237 ~ 10M triangles
+    const char *grid_filename= nullptr;
+
+    for(int i= 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--grid") == 0 && i +1 < argc)
+            grid= atoi(argv[++i]);
+        else if(strcmp(argv[i], "-o") == 0 && i +1 < argc)
+            grid_filename= argv[++i];
+        else
+            filename= argv[i];
+    }
+
+    // 1. construction des sommets uniques seule
+    bench(filename, read_corners(filename));
+    bench("grid", grid_corners(grid));
+
+    // 2. chargement complet, si le fichier de la grille est demande
+    if(grid_filename && write_grid(grid, grid_filename) == 0)
+    {
+        auto start= std::chrono::high_resolution_clock::now();
+        Mesh mesh= read_indexed_mesh_parallel(grid_filename);
+        auto stop= std::chrono::high_resolution_clock::now();
+        printf("read_indexed_mesh_parallel( ) %.1fms\n", std::chrono::duration<double, std::milli>(stop - start).count());
+    }
+
+    return 0;
+}
@@ -0,0 +1,220 @@
+//! \file bench_shader.cpp pipeline graphique logiciel, cf Rasterizer : shaders virtuels, cf Pipeline, ou specialises a la compilation, cf ShaderPipeline, fragment par fragment ou par groupes de 8 fragments, cf FragmentBatch.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "orbiter.h"
+#include "mesh.h"
+#include "wavefront.h"
+#include "rasterizer.h"
+
+
+// triangles indexes, normale par sommet, une source de lumiere dans le repere camera
+struct Scene
+{
+    std::vector<Point> positions;
+    std::vector<Vector> normals;
+    std::vector<unsigned int> indices;
+    Transform mvp;
+    Transform mv;
+    Point light;
+};
+
+// diffus + reflet, meme calcul pour tous les pipelines : n normale, p position du fragment, repere camera
+inline Color lighting( const Point& light, float nx, float ny, float nz, float px, float py, float pz )
+{
+    float kn= 1 / std::sqrt(nx*nx + ny*ny + nz*nz);
+    nx*= kn; ny*= kn; nz*= kn;
+
+    float lx= light.x - px, ly= light.y - py, lz= light.z - pz;
+    float kl= 1 / std::sqrt(lx*lx + ly*ly + lz*lz);
+    lx*= kl; ly*= kl; lz*= kl;
+
+    float ko= 1 / std::sqrt(px*px + py*py + pz*pz);
+    float hx= lx - px * ko, hy= ly - py * ko, hz= lz - pz * ko;
+    float kh= 1 / std::sqrt(hx*hx + hy*hy + hz*hz);
+
+    float cos_theta= std::abs(nx*lx + ny*ly + nz*lz);
+    float s= std::abs(nx*hx + ny*hy + nz*hz) * kh;
+    s= s*s; s= s*s; s= s*s; s= s*s;     // s^16
+    float k= 0.8f * cos_theta + 0.2f * s;
+    return Color(k, k, k);
+}
+
+
+// shaders virtuels, varyings : normale et position du sommet
+struct VirtualPipeline : public Pipeline
+{
+    const Scene& scene;
+
+    VirtualPipeline( const Scene& _scene ) : Pipeline(), scene(_scene) {}
+
+    int varyings( ) const { return 6; }
+
+    vec4 vertex_shader( const int vertex_id ) const
+    {
+        return scene.mvp(vec4(scene.positions[vertex_id]));
+    }
+
+    vec4 vertex_shader( const int vertex_id, float *varyings ) const
+    {
+        Vector n= scene.mv(scene.normals[vertex_id]);
+        Point p= scene.mv(scene.positions[vertex_id]);
+        varyings[0]= n.x; varyings[1]= n.y; varyings[2]= n.z;
+        varyings[3]= p.x; varyings[4]= p.y; varyings[5]= p.z;
+        return scene.mvp(vec4(scene.positions[vertex_id]));
+    }
+
+    Color fragment_shader( const int primitive_id, const Fragment fragment ) const
+    {
+        const float *v= fragment.varyings;
+        return lighting(scene.light, v[0], v[1], v[2], v[3], v[4], v[5]);
+    }
+};
+
+
+// shaders specialises a la compilation, meme calcul
+struct Varyings
+{
+    Vector n;
+    Point p;
+};
+
+struct TemplatePipeline : public ShaderPipeline<TemplatePipeline, Varyings>
+{
+    const Scene& scene;
+
+    TemplatePipeline( const Scene& _scene ) : scene(_scene) {}
+
+    vec4 vertex_shader( const int vertex_id, Varyings& varyings ) const
+    {
+        varyings.n= scene.mv(scene.normals[vertex_id]);
+        varyings.p= scene.mv(scene.positions[vertex_id]);
+        return scene.mvp(vec4(scene.positions[vertex_id]));
+    }
+
+    Color fragment_shader( const int primitive_id, const Fragment& fragment, const Varyings& varyings ) const
+    {
+        return lighting(scene.light, varyings.n.x, varyings.n.y, varyings.n.z, varyings.p.x, varyings.p.y, varyings.p.z);
+    }
+};
+
+// et les fragments par groupes de 8, par composantes
+struct BatchPipeline : public TemplatePipeline
+{
+    BatchPipeline( const Scene& _scene ) : TemplatePipeline(_scene) {}
+
+    void fragment_batch( const int primitive_id, const FragmentBatch& batch, Color *colors ) const
+    {
+        for(int i= 0; i < FragmentBatch::size; i++)
+            colors[i]= lighting(scene.light, batch.varyings[0][i], batch.varyings[1][i], batch.varyings[2][i],
+                batch.varyings[3][i], batch.varyings[4][i], batch.varyings[5][i]);
+    }
+};
+
+
+// garde le meilleur temps de 5 images
+template < typename P >
+RasterizerStats bench( Rasterizer& rasterizer, const P& pipeline, const Scene& scene, Image& image )
+{
+    RasterizerStats best;
+    best.raster_time= FLT_MAX;
+    for(int run= 0; run < 5; run++)
+    {
+        rasterizer.clear(Black());
+        rasterizer.draw(pipeline, scene.indices);
+        rasterizer.shade();
+        if(rasterizer.stats.time() < best.time())
+            best= rasterizer.stats;
+    }
+
+    image= rasterizer.image();
+    return best;
+}
+
+int differences( const Image& a, const Image& b )
+{
+    int count= 0;
+    for(int y= 0; y < a.height(); y++)
+    for(int x= 0; x < a.width(); x++)
+        if(a(x, y).r != b(x, y).r)
+            count++;
+
+    return count;
+}
+
+
+int main( int argc, char **argv )
+{
+    const char *filename= "data/bigguy.obj";
+    if(argc > 1)
+        filename= argv[1];
+
+    Mesh mesh= read_indexed_mesh(filename);
+    if(mesh.vertex_count() == 0 || mesh.index_count() == 0 || !mesh.has_normal())
+        return 1;
+
+    Point pmin, pmax;
+    mesh.bounds(pmin, pmax);
+    Vector extent= Vector(pmin, pmax) * 1.2f;
+
+    const int width= 1024;
+    const int height= 640;
+
+    // l'objet, puis des copies sur une grille : peu de gros triangles, ou beaucoup de petits
+    for(int grid : {1, 3})
+    {
+        Scene scene;
+        for(int i= 0; i < grid*grid*grid; i++)
+        {
+            Vector t= Vector(extent.x * (i % grid), extent.y * (i / grid % grid), extent.z * (i / grid / grid));
+            Transform model= Translation(t) * RotationY(float(i * 37 % 360));
+
+            unsigned int first= unsigned(scene.positions.size());
+            for(int k= 0; k < mesh.vertex_count(); k++)
+            {
+                scene.positions.push_back( model(Point(mesh.positions()[k])) );
+                scene.normals.push_back( model(Vector(mesh.normals()[k])) );
+            }
+            for(int k= 0; k < mesh.index_count(); k++)
+                scene.indices.push_back(first + mesh.indices()[k]);
+        }
+
+        Point bmax= pmax + extent * float(grid -1);
+        Orbiter camera;
+        camera.lookat(pmin, bmax);
+        scene.mvp= camera.projection(width, height, 45) * camera.view();
+        scene.mv= camera.view();
+        scene.light= scene.mv(bmax);
+
+        VirtualPipeline virtual_pipeline(scene);
+        TemplatePipeline template_pipeline(scene);
+        BatchPipeline batch_pipeline(scene);
+
+        printf("%s: %d copies, %d triangles, %dx%d\n", filename, grid*grid*grid, int(scene.indices.size()) / 3, width, height);
+        for(RasterizerMode mode : {RASTER_FORWARD, RASTER_VISIBILITY})
+        {
+            Rasterizer rasterizer(width, height, 64, mode);
+            Image images[3];
+            RasterizerStats stats[3];
+            stats[0]= bench(rasterizer, virtual_pipeline, scene, images[0]);
+            stats[1]= bench(rasterizer, template_pipeline, scene, images[1]);
+            stats[2]= bench(rasterizer, batch_pipeline, scene, images[2]);
+
+            const char *names[3]= { "virtual", "template", "template batch" };
+            for(int i= 0; i < 3; i++)
+                printf("  %-10s %-14s %8.2fms (vertex %6.2fms, raster %7.2fms, shading %7.2fms), %9lld fragments shaded, x%.2f, %s\n",
+                    mode == RASTER_FORWARD ? "forward" : "visibility", names[i],
+                    stats[i].time(), stats[i].vertex_time, stats[i].raster_time, stats[i].shading_time, stats[i].shaded,
+                    stats[0].time() / stats[i].time(),
+                    differences(images[0], images[i]) ? "[error] different image" : "same image");
+        }
+    }
+
+    return 0;
+}
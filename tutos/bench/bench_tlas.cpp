@@ -0,0 +1,127 @@
+//! \file bench_tlas.cpp reconstruction du bvh d'instances / TLAS a chaque image : temps de construction et temps de parcours, midpoint, sah et lbvh.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "orbiter.h"
+#include "mesh.h"
+#include "wavefront.h"
+#include "bvh.h"
+
+
+int main( int argc, char **argv )
+{
+    const char *filename= "data/bigguy.obj";
+    if(argc > 1)
+        filename= argv[1];
+
+    int instance_count= 128*1024;
+    if(argc > 2)
+        instance_count= std::max(1, atoi(argv[2]));
+
+    Mesh mesh= read_mesh(filename);
+    if(mesh.vertex_count() == 0)
+        return 1;
+
+    // un seul blas, partage par toutes les instances
+    std::vector<Triangle> triangles;
+    for(int i= 0; i < mesh.triangle_count(); i++)
+        triangles.push_back( Triangle(mesh.triangle(i), i) );
+
+    BLAS blas;
+    blas.build(triangles);
+
+    Point pmin, pmax;
+    mesh.bounds(pmin, pmax);
+    float size= length(Vector(pmin, pmax));
+
+    // instances placees et orientees au hasard, dans un cube
+    const float extent= size * std::cbrt(float(instance_count)) * 1.5f;
+    srand(1);
+    std::vector<Instance> instances;
+    for(int i= 0; i < instance_count; i++)
+    {
+        Vector t= Vector(float(rand()) / RAND_MAX, float(rand()) / RAND_MAX, float(rand()) / RAND_MAX) * extent;
+        float scale= float(rand()) / RAND_MAX + .5f;
+        Transform model= Translation(t) * RotationY(float(rand()) / RAND_MAX * 360) * Scale(scale, scale, scale);
+        instances.push_back( Instance(BBox(pmin, pmax), model, blas, i) );
+    }
+    printf("%s: %d triangles, %d instances\n", filename, int(triangles.size()), instance_count);
+
+    BBox bounds= EmptyBox();
+    for(unsigned i= 0; i < instances.size(); i++)
+        bounds.insert(instances[i].bounds());
+
+    const int width= 512;
+    const int height= 320;
+    Orbiter camera;
+    camera.lookat(bounds.pmin, bounds.pmax);
+    camera.projection(width, height, 45);
+    Transform inv= Inverse(camera.viewport() * camera.projection() * camera.view());
+
+    std::vector<Ray> rays;
+    for(int y= 0; y < height; y++)
+    for(int x= 0; x < width; x++)
+    {
+        Point o= inv(Point(x + .5f, y + .5f, 0));
+        Point e= inv(Point(x + .5f, y + .5f, 1));
+        rays.push_back( Ray(o, e) );
+    }
+
+    struct Config
+    {
+        const char *name;
+        BVHOptions options;
+    };
+
+    BVHOptions midpoint(BVH_MIDPOINT, 1);
+    BVHOptions sah(BVH_SAH, 1);
+    BVHOptions lbvh(BVH_LBVH, 1);
+    BVHOptions treelet(BVH_LBVH, 1);
+    treelet.treelet= true;
+
+    Config configs[]=
+    {
+        { "midpoint", midpoint },
+        { "sah", sah },
+        { "lbvh", lbvh },
+        { "lbvh + treelets", treelet },
+    };
+
+    // une image = reconstruction du tlas + rayons primaires
+    const int frames= 10;
+    for(const Config& config : configs)
+    {
+        TLAS tlas;
+        float build= 0;
+        for(int i= 0; i < frames; i++)
+        {
+            tlas.build(instances, config.options);
+            build+= tlas.build_time;
+        }
+        build/= frames;
+
+        int hits= 0;
+        auto start= std::chrono::high_resolution_clock::now();
+
+        const int n= int(rays.size());
+    #pragma omp parallel for schedule(dynamic, 256) reduction(+: hits)
+        for(int i= 0; i < n; i++)
+            if(tlas.intersect(rays[i]))
+                hits++;
+
+        auto stop= std::chrono::high_resolution_clock::now();
+        float trace= std::chrono::duration<float, std::milli>(stop - start).count();
+
+        BVHStats stats= tlas.stats();
+        printf("%-16s build %7.1fms, sah %7.2f, depth %2d max, trace %7.1fms %6.2f Mrays/s, frame %7.1fms (%d hits)\n",
+            config.name, build, stats.sah_cost, stats.depth_max, trace, float(n) / trace / 1000, build + trace, hits);
+    }
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+//! \file bench_triangle.cpp tests rayon / triangle : un triangle a la fois, cf Triangle::intersect(), ou par blocs de 4 ou 8 triangles, cf intersect_block() et intersect_block_watertight().
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+
+#include "vec.h"
+#include "bvh.h"
+
+
+float random_float( ) { return float(rand()) / RAND_MAX * 2 - 1; }
+Point random_point( ) { return Point(random_float(), random_float(), random_float()); }
+
+
+// teste chaque rayon avec tous les blocs, renvoie le nombre de tests par seconde.
+template < int W >
+float bench_blocks( const std::vector<Triangle>& triangles, const std::vector<Ray>& rays, const bool watertight, int& hits )
+{
+    std::vector<TriangleBlock<W>> blocks(triangles.size() / W);
+    for(unsigned i= 0; i < blocks.size(); i++)
+        make_block(blocks[i], triangles.data(), i*W, W, watertight);
+
+    hits= 0;
+    auto start= std::chrono::high_resolution_clock::now();
+
+    for(unsigned r= 0; r < rays.size(); r++)
+    {
+        WatertightRay wray(rays[r]);
+        for(unsigned i= 0; i < blocks.size(); i++)
+        {
+            float t[W], u[W], v[W];
+            int mask= watertight ? intersect_block_watertight(blocks[i], wray, rays[r].tmax, t, u, v)
+                : intersect_block(blocks[i], rays[r], rays[r].tmax, t, u, v);
+            for(; mask; mask&= mask -1)
+                hits++;
+        }
+    }
+
+    auto stop= std::chrono::high_resolution_clock::now();
+    float time= std::chrono::duration<float, std::milli>(stop - start).count();
+    return float(rays.size()) * float(blocks.size() * W) / time / 1000;
+}
+
+
+int main( int argc, char **argv )
+{
+    // triangles et rayons aleatoires dans le cube [-1 1], multiple de 8 triangles
+    int triangle_count= 1024;
+    if(argc > 1)
+        triangle_count= std::max(8, atoi(argv[1]) / 8 * 8);
+    int ray_count= 16*1024;
+    if(argc > 2)
+        ray_count= std::max(1, atoi(argv[2]));
+
+    srand(1);
+    std::vector<Triangle> triangles;
+    for(int i= 0; i < triangle_count; i++)
+    {
+        // petits triangles, autour d'un point aleatoire
+        Point p= random_point();
+        triangles.push_back( Triangle(p + Vector(random_point()) * .25f, p + Vector(random_point()) * .25f, p + Vector(random_point()) * .25f, 0, 0, i) );
+    }
+
+    std::vector<Ray> rays;
+    for(int i= 0; i < ray_count; i++)
+        rays.push_back( Ray(random_point() * 2, random_point() * 2) );
+
+    printf("%d triangles, %d rays\n", triangle_count, ray_count);
+
+    // reference, un triangle a la fois
+    {
+        int hits= 0;
+        auto start= std::chrono::high_resolution_clock::now();
+
+        for(unsigned r= 0; r < rays.size(); r++)
+        for(unsigned i= 0; i < triangles.size(); i++)
+            if(triangles[i].intersect(rays[r], rays[r].tmax))
+                hits++;
+
+        auto stop= std::chrono::high_resolution_clock::now();
+        float time= std::chrono::duration<float, std::milli>(stop - start).count();
+        printf("  %-16s %8.1f Mtests/s (%d hits)\n", "triangle", float(rays.size()) * float(triangles.size()) / time / 1000, hits);
+    }
+
+    int hits= 0;
+    float rate= bench_blocks<4>(triangles, rays, false, hits);
+    printf("  %-16s %8.1f Mtests/s (%d hits)\n", "block 4", rate, hits);
+    rate= bench_blocks<8>(triangles, rays, false, hits);
+    printf("  %-16s %8.1f Mtests/s (%d hits)\n", "block 8", rate, hits);
+    rate= bench_blocks<4>(triangles, rays, true, hits);
+    printf("  %-16s %8.1f Mtests/s (%d hits)\n", "watertight 4", rate, hits);
+    rate= bench_blocks<8>(triangles, rays, true, hits);
+    printf("  %-16s %8.1f Mtests/s (%d hits)\n", "watertight 8", rate, hits);
+
+    return 0;
+}
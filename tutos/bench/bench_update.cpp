@@ -0,0 +1,157 @@
+//! \file bench_update.cpp stress test du buffer de copie UpdateBuffer : transferts de tailles aleatoires, verification du contenu des buffers et des textures.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+
+#include "app.h"
+#include "update_buffer.h"
+
+
+const size_t BUFFER_SIZE= 256*1024*1024;
+const int FRAMES= 200;
+const int COPIES= 64;           // nombre de transferts par image
+const int CHECK_FRAMES= 50;     // verifie le contenu du buffer toutes les CHECK_FRAMES images
+
+class BenchUpdate : public App
+{
+public:
+    BenchUpdate( ) : App(1024, 640, 4, 4)
+    {
+        vsync_off();
+    }
+
+    int init( )
+    {
+        // copie du contenu du buffer, pour verifier les transferts
+        m_data.assign(BUFFER_SIZE, 0);
+
+        glGenBuffers(1, &m_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+        glBufferData(GL_ARRAY_BUFFER, BUFFER_SIZE, m_data.data(), GL_STATIC_DRAW);
+
+        m_frame= 0;
+        m_errors= 0;
+        m_time= 0;
+        srand(1);
+
+        UpdateBuffer::manager().clear_stats();
+        return 0;
+    }
+
+    int quit( )
+    {
+        glDeleteBuffers(1, &m_buffer);
+        return 0;
+    }
+
+    int render( )
+    {
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        UpdateBuffer& update= UpdateBuffer::manager();
+        std::vector<unsigned char> tmp;
+
+        for(int i= 0; i < COPIES; i++)
+        {
+            // quelques gros transferts, beaucoup de petits...
+            size_t length= (i == 0) ? size_t(rand()) % (64*1024*1024) +1 : size_t(rand()) % (256*1024) +1;
+            size_t offset= size_t(rand()) % (BUFFER_SIZE - length);
+
+            tmp.resize(length);
+            unsigned char value= rand();
+            for(size_t k= 0; k < length; k++)
+                tmp[k]= value + k;
+            memcpy(m_data.data() + offset, tmp.data(), length);
+
+            // mesure uniquement le transfert
+            auto start= std::chrono::high_resolution_clock::now();
+            glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+            update.copy(GL_ARRAY_BUFFER, offset, length, tmp.data());
+            auto stop= std::chrono::high_resolution_clock::now();
+            m_time+= std::chrono::duration<double, std::milli>(stop - start).count();
+        }
+
+        m_frame++;
+        if(m_frame % CHECK_FRAMES == 0)
+        {
+            check_buffer();
+            check_texture();
+        }
+
+        if(m_frame == FRAMES)
+        {
+            const UpdateBufferStats& stats= update.stats();
+            printf("%d frames, %dMo, %.1fms cpu, %.1fGo/s\n", m_frame, int(stats.bytes / 1024 / 1024), m_time,
+                double(stats.bytes) / (m_time / 1000) / 1024 / 1024 / 1024);
+            printf("  %d copies, %d fence waits, %d wraps\n", stats.copies, stats.fence_waits, stats.wraps);
+            printf("  %d errors\n", m_errors);
+            return 0;
+        }
+
+        return 1;
+    }
+
+    // relit le contenu du buffer et compare avec la copie
+    void check_buffer( )
+    {
+        std::vector<unsigned char> data(BUFFER_SIZE);
+        glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+        glGetBufferSubData(GL_ARRAY_BUFFER, 0, BUFFER_SIZE, data.data());
+
+        if(data != m_data)
+        {
+            printf("[error] frame %d: buffer content...\n", m_frame);
+            m_errors++;
+        }
+    }
+
+    // transfere une texture rgb, lignes non alignees sur 4 octets, relit et compare
+    void check_texture( )
+    {
+        int width= 1000 + rand() % 1000;
+        int height= 1000 + rand() % 4000;
+        size_t row= (size_t(width) * 3 + 3) / 4 * 4;
+
+        std::vector<unsigned char> pixels(row * height);
+        for(size_t i= 0; i < pixels.size(); i++)
+            pixels[i]= rand();
+
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+        UpdateBuffer::manager().copy_texture(GL_TEXTURE_2D, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+        std::vector<unsigned char> data(pixels.size());
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, data.data());
+        glDeleteTextures(1, &texture);
+
+        for(int y= 0; y < height; y++)
+            if(memcmp(&data[y * row], &pixels[y * row], size_t(width) * 3) != 0)
+            {
+                printf("[error] frame %d: texture content, line %d...\n", m_frame, y);
+                m_errors++;
+                break;
+            }
+    }
+
+protected:
+    std::vector<unsigned char> m_data;
+    GLuint m_buffer;
+
+    int m_frame;
+    int m_errors;
+    double m_time;
+};
+
+
+int main( int argc, char **argv )
+{
+    BenchUpdate app;
+    app.run();
+
+    return 0;
+}
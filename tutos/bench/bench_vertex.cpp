@@ -0,0 +1,168 @@
+//! \file bench_vertex.cpp pipeline graphique logiciel, cf Rasterizer : triangles non indexes, normales transformees par le fragment shader, ou triangles indexes, normales transformees 1 fois par sommet et interpolees, cf Pipeline::varyings().
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "orbiter.h"
+#include "mesh.h"
+#include "wavefront.h"
+#include "rasterizer.h"
+
+
+// triangles non indexes : 3 sommets par triangle, le fragment shader transforme les normales des sommets
+struct SoupPipeline : public Pipeline
+{
+    std::vector<Point> positions;
+    std::vector<Vector> normals;
+    Transform mvp;
+    Transform mv;
+
+    vec4 vertex_shader( const int vertex_id ) const
+    {
+        return mvp(vec4(positions[vertex_id]));
+    }
+
+    Color fragment_shader( const int primitive_id, const Fragment fragment ) const
+    {
+        Vector a= mv(normals[primitive_id * 3]);
+        Vector b= mv(normals[primitive_id * 3 +1]);
+        Vector c= mv(normals[primitive_id * 3 +2]);
+
+        Vector n= normalize(fragment.u * c + fragment.v * a + fragment.w * b);
+        return White() * std::abs(n.z);
+    }
+};
+
+// triangles indexes : le vertex shader transforme la normale de chaque sommet, le fragment shader l'interpole
+struct IndexedPipeline : public Pipeline
+{
+    std::vector<Point> positions;
+    std::vector<Vector> normals;
+    std::vector<unsigned int> indices;
+    Transform mvp;
+    Transform mv;
+
+    int varyings( ) const { return 3; }
+
+    vec4 vertex_shader( const int vertex_id ) const
+    {
+        return mvp(vec4(positions[vertex_id]));
+    }
+
+    vec4 vertex_shader( const int vertex_id, float *varyings ) const
+    {
+        Vector n= mv(normals[vertex_id]);
+        varyings[0]= n.x;
+        varyings[1]= n.y;
+        varyings[2]= n.z;
+        return mvp(vec4(positions[vertex_id]));
+    }
+
+    Color fragment_shader( const int primitive_id, const Fragment fragment ) const
+    {
+        Vector n= normalize(Vector(fragment.varyings[0], fragment.varyings[1], fragment.varyings[2]));
+        return White() * std::abs(n.z);
+    }
+};
+
+
+// garde le meilleur temps de 5 images
+template < typename F >
+RasterizerStats bench( Rasterizer& rasterizer, F draw )
+{
+    RasterizerStats best;
+    best.raster_time= FLT_MAX;
+    for(int run= 0; run < 5; run++)
+    {
+        rasterizer.clear(Black());
+        draw();
+        if(rasterizer.stats.time() < best.time())
+            best= rasterizer.stats;
+    }
+
+    return best;
+}
+
+
+int main( int argc, char **argv )
+{
+    const char *filename= "data/bigguy.obj";
+    if(argc > 1)
+        filename= argv[1];
+
+    Mesh mesh= read_indexed_mesh(filename);
+    if(mesh.vertex_count() == 0 || mesh.index_count() == 0 || !mesh.has_normal())
+        return 1;
+
+    Point pmin, pmax;
+    mesh.bounds(pmin, pmax);
+    Vector extent= Vector(pmin, pmax) * 1.2f;
+
+    const int width= 1024;
+    const int height= 640;
+
+    // l'objet, puis des copies sur une grille, pour obtenir de gros maillages
+    for(int grid : {1, 3, 6})
+    {
+        SoupPipeline soup;
+        IndexedPipeline indexed;
+        for(int i= 0; i < grid*grid*grid; i++)
+        {
+            Vector t= Vector(extent.x * (i % grid), extent.y * (i / grid % grid), extent.z * (i / grid / grid));
+            Transform model= Translation(t) * RotationY(float(i * 37 % 360));
+
+            unsigned int first= unsigned(indexed.positions.size());
+            for(int k= 0; k < mesh.vertex_count(); k++)
+            {
+                indexed.positions.push_back( model(Point(mesh.positions()[k])) );
+                indexed.normals.push_back( model(Vector(mesh.normals()[k])) );
+            }
+
+            for(int k= 0; k < mesh.index_count(); k++)
+            {
+                unsigned int index= mesh.indices()[k];
+                indexed.indices.push_back(first + index);
+                soup.positions.push_back( model(Point(mesh.positions()[index])) );
+                soup.normals.push_back( model(Vector(mesh.normals()[index])) );
+            }
+        }
+
+        Orbiter camera;
+        camera.lookat(pmin, pmax + extent * float(grid -1));
+        Transform projection= camera.projection(width, height, 45);
+        soup.mvp= projection * camera.view();
+        soup.mv= camera.view();
+        indexed.mvp= soup.mvp;
+        indexed.mv= soup.mv;
+
+        printf("%s: %d copies, %d triangles, %d vertices, %dx%d\n", filename, grid*grid*grid,
+            int(indexed.indices.size()) / 3, int(indexed.positions.size()), width, height);
+
+        Rasterizer rasterizer(width, height);
+        RasterizerStats stats[2];
+        stats[0]= bench(rasterizer, [&]( ) { rasterizer.draw(soup, int(soup.positions.size())); });
+        Image reference= rasterizer.image();
+        stats[1]= bench(rasterizer, [&]( ) { rasterizer.draw(indexed, indexed.indices); });
+        Image image= rasterizer.image();
+
+        // les normales sont transformees puis interpolees, ou interpolees puis transformees : arrondis differents
+        float difference= 0;
+        for(int y= 0; y < height; y++)
+        for(int x= 0; x < width; x++)
+            difference= std::max(difference, std::abs(reference(x, y).r - image(x, y).r));
+
+        const char *names[2]= { "soup", "indexed" };
+        for(int i= 0; i < 2; i++)
+            printf("  %-8s %8.2fms (vertex %6.2fms, binning %6.2fms, raster %7.2fms), %8d vertices shaded, %.2f / triangle, %9lld fragments shaded\n",
+                names[i], stats[i].time(), stats[i].vertex_time, stats[i].binning_time, stats[i].raster_time,
+                stats[i].vertices, float(stats[i].vertices) / std::max(1, stats[i].triangles + stats[i].culled), stats[i].shaded);
+        printf("  x%.2f faster, max difference %g\n", stats[0].time() / stats[1].time(), difference);
+    }
+
+    return 0;
+}
@@ -0,0 +1,195 @@
+//! \file bench_visibility.cpp pipeline graphique logiciel, cf Rasterizer : fragment shader execute pour chaque fragment visible au moment du dessin, ou 1 fois par pixel avec un visibility buffer, cf RASTER_VISIBILITY.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "orbiter.h"
+#include "mesh.h"
+#include "wavefront.h"
+#include "rasterizer.h"
+
+
+// triangles non indexes, avec une matiere par triangle
+struct Scene
+{
+    std::vector<Point> positions;
+    std::vector<Vector> normals;
+    std::vector<int> materials;
+    Materials material_data;
+};
+
+// copies de l'objet sur une grille de n x n x n, les copies se cachent les unes les autres
+Scene make_scene( const Mesh& mesh, const int n )
+{
+    Scene scene;
+    scene.material_data= mesh.materials();
+    if(scene.material_data.count() == 0)
+        scene.material_data.insert(Material(Color(0.8f)), "default");
+
+    Point pmin, pmax;
+    mesh.bounds(pmin, pmax);
+    Vector extent= Vector(pmin, pmax) * 0.6f;
+    for(int i= 0; i < n*n*n; i++)
+    {
+        Transform model= Translation(extent.x * (i % n), extent.y * (i / n % n), extent.z * (i / n / n)) * RotationY(float(i * 37 % 360));
+        for(int k= 0; k < mesh.vertex_count(); k++)
+        {
+            scene.positions.push_back( model(Point(mesh.positions()[k])) );
+            if(mesh.has_normal())
+                scene.normals.push_back( model(Vector(mesh.normals()[k])) );
+        }
+        for(int k= 0; k < mesh.triangle_count(); k++)
+            scene.materials.push_back( std::max(0, mesh.triangle_material_index(k)) );
+    }
+
+    return scene;
+}
+
+
+// matieres diffuses + reflets, eclairees par quelques sources
+struct MaterialPipeline : public Pipeline
+{
+    const Scene& scene;
+    Transform mvp;
+    Transform mv;
+    Transform mvn;
+    std::vector<Point> lights;
+
+    MaterialPipeline( const Scene& _scene ) : Pipeline(), scene(_scene) {}
+
+    vec4 vertex_shader( const int vertex_id ) const
+    {
+        return mvp(vec4(scene.positions[vertex_id]));
+    }
+
+    int material( const int primitive_id ) const
+    {
+        return scene.materials[primitive_id];
+    }
+
+    Color fragment_shader( const int primitive_id, const Fragment fragment ) const
+    {
+        // position et normale du fragment, repere camera
+        Point a= mv(scene.positions[3*primitive_id]);
+        Point b= mv(scene.positions[3*primitive_id +1]);
+        Point c= mv(scene.positions[3*primitive_id +2]);
+        Point p= fragment.u * c + fragment.v * a + fragment.w * b;
+
+        Vector n;
+        if(!scene.normals.empty())
+            n= fragment.u * mvn(scene.normals[3*primitive_id +2]) + fragment.v * mvn(scene.normals[3*primitive_id]) + fragment.w * mvn(scene.normals[3*primitive_id +1]);
+        else
+            n= cross(Vector(a, b), Vector(a, c));
+        n= normalize(n);
+
+        const Material& material= scene.material_data.material(scene.materials[primitive_id]);
+        Vector o= normalize(Vector(p, Point(0, 0, 0)));
+
+        Color color= material.emission;
+        for(unsigned i= 0; i < lights.size(); i++)
+        {
+            Vector l= Vector(p, lights[i]);
+            float d2= length2(l);
+            l= l / std::sqrt(d2);
+            Vector h= normalize(o + l);
+            float cos_theta= std::abs(dot(n, l));
+            float blinn= std::pow(std::abs(dot(n, h)), std::max(1.f, material.ns));
+            color= color + (material.diffuse + material.specular * blinn) * cos_theta / (1 + d2);
+        }
+
+        return color;
+    }
+};
+
+
+int main( int argc, char **argv )
+{
+    // fichier, nombre de copies
+    std::vector<const char *> filenames= { "data/cornell.obj", "data/robot.obj", "data/bigguy.obj", "data/bigguy.obj" };
+    std::vector<int> grids= { 1, 1, 1, 3 };
+    if(argc > 1)
+    {
+        filenames.assign(argv + 1, argv + argc);
+        grids.assign(filenames.size(), 1);
+    }
+
+    const int width= 1024;
+    const int height= 640;
+
+    for(unsigned f= 0; f < filenames.size(); f++)
+    {
+        Mesh mesh= read_mesh(filenames[f]);
+        if(mesh.vertex_count() == 0)
+            continue;
+
+        Scene scene= make_scene(mesh, grids[f]);
+        int triangles= int(scene.positions.size()) / 3;
+
+        Point pmin, pmax;
+        mesh.bounds(pmin, pmax);
+        pmax= pmax + Vector(pmin, pmax) * 0.6f * float(grids[f] -1);
+
+        Orbiter camera;
+        camera.lookat(pmin, pmax);
+
+        MaterialPipeline pipeline(scene);
+        pipeline.mv= camera.view();
+        pipeline.mvn= Normal(pipeline.mv);
+        pipeline.mvp= camera.projection(width, height, 45) * camera.view();
+        for(int i= 0; i < 4; i++)
+        {
+            Point p= Point(pmin + (pmax - pmin) * Vector(0.25f + 0.5f * (i & 1), 0.9f, 0.25f + 0.5f * (i >> 1)));
+            pipeline.lights.push_back(pipeline.mv(p));
+        }
+
+        printf("%s: %d copies, %d triangles, %d materials, %dx%d\n", filenames[f], grids[f]*grids[f]*grids[f], triangles, scene.material_data.count(), width, height);
+
+        // garde le meilleur temps de 5 images
+        Image images[2];
+        RasterizerStats best[2];
+        for(int mode= 0; mode < 2; mode++)
+        {
+            Rasterizer rasterizer(width, height, 64, mode ? RASTER_VISIBILITY : RASTER_FORWARD);
+            best[mode].raster_time= FLT_MAX;
+            for(int run= 0; run < 5; run++)
+            {
+                rasterizer.clear(Black());
+                rasterizer.draw(pipeline, int(scene.positions.size()));
+                rasterizer.shade();
+                if(rasterizer.stats.time() < best[mode].time())
+                    best[mode]= rasterizer.stats;
+            }
+
+            images[mode]= rasterizer.image();
+        }
+
+        int differences= 0;
+        for(int y= 0; y < height; y++)
+        for(int x= 0; x < width; x++)
+        {
+            Color a= images[0](x, y);
+            Color b= images[1](x, y);
+            if(a.r != b.r || a.g != b.g || a.b != b.b)
+                differences++;
+        }
+
+        const RasterizerStats& forward= best[0];
+        const RasterizerStats& visibility= best[1];
+        printf("  forward    %8.2fms (raster %7.2fms), %9lld fragments, %9lld shaded\n",
+            forward.time(), forward.raster_time, forward.fragments, forward.shaded);
+        printf("  visibility %8.2fms (raster %7.2fms, shading %7.2fms), %9lld shaded\n",
+            visibility.time(), visibility.raster_time, visibility.shading_time, visibility.shaded);
+        printf("  overdraw x%.2f, shaded fragments x%.2f, x%.2f faster, %s\n",
+            double(forward.fragments) / std::max(1ll, visibility.shaded),
+            double(forward.shaded) / std::max(1ll, visibility.shaded),
+            forward.time() / visibility.time(),
+            differences ? "[error] different images" : "same image");
+    }
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+//! \file test_clipping.cpp pipeline graphique logiciel, cf Rasterizer : decoupage des triangles qui traversent le plan near et la bande de garde.
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "rasterizer.h"
+
+
+// un sol, 2 triangles, y= 0, observe par une camera a 1m de hauteur
+struct FloorPipeline : public Pipeline
+{
+    std::vector<Point> positions;
+    Transform mvp;
+
+    FloorPipeline( const float xmin, const float xmax, const float zmin, const float zmax, const Transform& _mvp ) : Pipeline(), positions(), mvp(_mvp)
+    {
+        Point a(xmin, 0, zmax), b(xmax, 0, zmax), c(xmax, 0, zmin), d(xmin, 0, zmin);
+        positions= { a, b, c, a, c, d };
+    }
+
+    vec4 vertex_shader( const int vertex_id ) const
+    {
+        return mvp( vec4(positions[vertex_id]) );
+    }
+
+    // verifie les coordonnees barycentriques des fragments : r= u + v + w, g= profondeur
+    Color fragment_shader( const int primitive_id, const Fragment fragment ) const
+    {
+        return Color(fragment.u + fragment.v + fragment.w, fragment.z, 0);
+    }
+};
+
+
+int test( const char *name, const FloorPipeline& pipeline, const RasterizerMode mode, const int width, const int height )
+{
+    Rasterizer rasterizer(width, height, 64, mode);
+    rasterizer.clear(Color(-1));
+    rasterizer.draw(pipeline, int(pipeline.positions.size()));
+    rasterizer.shade();
+    Image image= rasterizer.image();
+
+    // la moitie basse de l'image observe le sol, a quelques lignes pres, l'horizon est au centre de l'image, la moitie haute reste vide
+    int covered= 0;
+    int holes= 0;
+    int errors= 0;
+    for(int y= 0; y < height; y++)
+    for(int x= 0; x < width; x++)
+    {
+        Color color= image(x, y);
+        if(color.r < 0)
+        {
+            if(y < height / 2 - 16)
+                holes++;
+            continue;
+        }
+
+        covered++;
+        if(y >= height / 2)
+            errors++;
+        if(std::abs(color.r - 1) > 0.001f || color.g < 0 || color.g > 1)
+            errors++;
+    }
+
+    // chaque pixel est couvert une seule fois : les triangles decoupes restent jointifs
+    bool failed= (rasterizer.stats.clipped == 0 || rasterizer.stats.triangles == 0 || covered == 0
+        || holes > 0 || errors > 0 || rasterizer.stats.fragments != covered);
+    printf("%s %-10s: %d triangles, %d clipped, %lld fragments, %d pixels, %d holes, %d errors\n",
+        failed ? "[error]" : "[ok]   ", name, rasterizer.stats.triangles, rasterizer.stats.clipped,
+        rasterizer.stats.fragments, covered, holes, errors);
+    return failed ? 1 : 0;
+}
+
+
+int main( int argc, char **argv )
+{
+    const int width= 1024;
+    const int height= 640;
+    Transform projection= Perspective(45, float(width) / float(height), .1f, 1000);
+    Transform view= Lookat(Point(0, 1, 0), Point(0, 1, -1), Vector(0, 1, 0));
+    Transform mvp= projection * view;
+
+    // le sol traverse le plan near, ou reste devant la camera mais sort de la bande de garde
+    FloorPipeline near_floor(-100, 100, -100, 100, mvp);
+    FloorPipeline guard_floor(-100, 100, -100, -.5f, mvp);
+
+    int failed= 0;
+    for(RasterizerMode mode : {RASTER_FORWARD, RASTER_VISIBILITY})
+    {
+        printf("%s\n", mode == RASTER_FORWARD ? "forward" : "visibility");
+        failed+= test("near", near_floor, mode, width, height);
+        failed+= test("guard band", guard_floor, mode, width, height);
+    }
+
+    return failed;
+}
@@ -53,10 +53,12 @@ struct GLTF : public AppCamera
 {
     GLTF( const char *filename ) : AppCamera(1024,640, 3,3) 
     {
-        m_mesh= read_gltf_mesh( filename );
+        GLTFAsset asset;
+        asset.load( filename );
+        m_mesh= asset.mesh();
         
-        m_cameras= read_gltf_cameras( filename );
-        m_lights= read_gltf_lights( filename );
+        m_cameras= asset.cameras();
+        m_lights= asset.lights();
         
 	// conversion wavefront / blinn phong + textures
         if(1)
@@ -78,7 +80,7 @@ struct GLTF : public AppCamera
             }
             
             //~ read_gltf_materials( filename );
-            m_images= read_gltf_images( filename );
+            m_images= asset.images();
             
             const Materials& materials= m_mesh.materials();
             int n= materials.filename_count();